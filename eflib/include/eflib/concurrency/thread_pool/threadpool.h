@@ -2,6 +2,8 @@
 
 #include "./detail/pool.hpp"
 
+#include <eflib/platform/affinity.h>
+
 #include <atomic>
 #include <functional>
 #include <thread>
@@ -20,6 +22,19 @@ public:
     initialize();
   }
 
+  // Worker i is pinned to worker_cpus[i % worker_cpus.size()]. Workers prefer memory of
+  // 'numa_node' if it is not negative.
+  thread_pool(uint32_t thread_count,
+              std::vector<uint32_t> const& worker_cpus,
+              int32_t numa_node = -1)
+    : terminate_{false}
+    , worker_count_{thread_count}
+    , pending_count_{0}
+    , worker_cpus_{worker_cpus}
+    , numa_node_{numa_node} {
+    initialize();
+  }
+
   template <typename F>
   void schedule(F&& job) {
     ++pending_count_;
@@ -57,7 +72,15 @@ public:
 private:
   void initialize() {
     for (uint32_t i_worker = 0; i_worker < worker_count_; ++i_worker) {
-      workers_.emplace_back([this]() { thread_func(); });
+      workers_.emplace_back([this, i_worker]() {
+        if (!worker_cpus_.empty()) {
+          pin_current_thread(worker_cpus_[i_worker % worker_cpus_.size()]);
+        }
+        if (numa_node_ >= 0) {
+          prefer_numa_node(static_cast<uint32_t>(numa_node_));
+        }
+        thread_func();
+      });
     }
   }
 
@@ -93,6 +116,8 @@ private:
 
   uint32_t worker_count_;
   std::atomic<intptr_t> pending_count_;
+  std::vector<uint32_t> worker_cpus_;
+  int32_t numa_node_ = -1;
   std::vector<std::thread> workers_;
   std::vector<std::function<void()>> tasks_;
 };
@@ -105,6 +105,7 @@ public:
   void reserve(size_t capacity, size_t alignment, size_t stride = sizeof(T)) {
     if (sz == 0 && data_mem != nullptr) {
       if (stride * capacity <= this->stride * cap && align % alignment == 0) {
+        cap = this->stride * cap / stride;
         this->stride = stride;
         return;
       } else {
@@ -148,8 +149,25 @@ public:
     return ret;
   }
 
+  // Allocates 'count' adjacent objects, which are 'object_stride()' bytes apart.
+  T* alloc(size_t count) {
+#if defined(EFLIB_DEBUG)
+    if (sz + count > cap) {
+      assert(false);
+      return nullptr;
+    }
+#endif
+    T* ret = advance_bytes(data_mem, stride * sz);
+    sz += count;
+    return ret;
+  }
+
   void dealloc(T*) {}
 
+  size_t object_stride() const { return stride; }
+
+  size_t size() const { return sz; }
+
   void clear() { sz = 0; }
 
   vls_vector_iterator<T> begin() const { return vls_vector_iterator<T>(data_mem, stride); }
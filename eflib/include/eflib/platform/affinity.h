@@ -0,0 +1,19 @@
+#pragma once
+
+#include <eflib/platform/stdint.h>
+
+#include <vector>
+
+namespace eflib {
+
+// Logical CPUs of a NUMA node. It is empty if the node does not exist or NUMA is not supported.
+std::vector<uint32_t> numa_node_cpus(uint32_t node);
+
+// Pins the calling thread to a logical CPU. Returns false if it is failed or not supported.
+bool pin_current_thread(uint32_t cpu);
+
+// Memory allocated by the calling thread and by threads created by it later is taken from the
+// node if it is possible. Returns false if it is failed or not supported.
+bool prefer_numa_node(uint32_t node);
+
+}  // namespace eflib
@@ -16,6 +16,7 @@ enum cpu_features {
   cpu_sse42,
   cpu_sse4a,
   cpu_avx,
+  cpu_avx2,
 
   cpu_arm,
   cpu_neon,
@@ -0,0 +1,119 @@
+#include <eflib/platform/affinity.h>
+#include <eflib/platform/config.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(EFLIB_WINDOWS)
+#  if !defined NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#elif defined(EFLIB_LINUX)
+#  include <pthread.h>
+#  include <sched.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace eflib {
+
+#if defined(EFLIB_WINDOWS)
+
+std::vector<uint32_t> numa_node_cpus(uint32_t node) {
+  std::vector<uint32_t> cpus;
+  ULONGLONG mask = 0;
+  if (node > 0xFF || !::GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask)) {
+    return cpus;
+  }
+  for (uint32_t cpu = 0; cpu < 64; ++cpu) {
+    if (mask & (1ULL << cpu)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+bool pin_current_thread(uint32_t cpu) {
+  if (cpu >= 64) {
+    return false;
+  }
+  return ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(1ULL << cpu)) != 0;
+}
+
+// Windows allocates memory from the node of the CPU which touches it first, so pinned threads use
+// memory of their node already.
+bool prefer_numa_node(uint32_t) {
+  return false;
+}
+
+#elif defined(EFLIB_LINUX)
+
+// CPU lists of sysfs are like "0-3,8,10-11".
+std::vector<uint32_t> numa_node_cpus(uint32_t node) {
+  std::vector<uint32_t> cpus;
+  std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+  std::string range;
+  while (std::getline(cpulist, range, ',')) {
+    std::istringstream range_stream(range);
+    uint32_t first = 0;
+    if (!(range_stream >> first)) {
+      continue;
+    }
+    uint32_t last = first;
+    char dash = 0;
+    if (range_stream >> dash && dash == '-') {
+      range_stream >> last;
+    }
+    for (uint32_t cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+bool pin_current_thread(uint32_t cpu) {
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+}
+
+// Uses the system call directly, so it does not depend on libnuma.
+bool prefer_numa_node(uint32_t node) {
+#  if defined(SYS_set_mempolicy)
+  constexpr int MPOL_PREFERRED_MODE = 1;
+  unsigned long node_mask = 0;
+  if (node >= sizeof(node_mask) * 8) {
+    return false;
+  }
+  node_mask = 1UL << node;
+  long const ret =
+      syscall(SYS_set_mempolicy, MPOL_PREFERRED_MODE, &node_mask, sizeof(node_mask) * 8 + 1);
+  return ret == 0;
+#  else
+  return false;
+#  endif
+}
+
+#else
+
+std::vector<uint32_t> numa_node_cpus(uint32_t) {
+  return {};
+}
+
+bool pin_current_thread(uint32_t) {
+  return false;
+}
+
+bool prefer_numa_node(uint32_t) {
+  return false;
+}
+
+#endif
+
+}  // namespace eflib
@@ -20,12 +20,15 @@ public:
   x86_cpuinfo() {
     int cpu_infos[4];
     int cpu_infos_ex[4];
+    int cpu_infos_7[4] = {};
 #  if defined(EFLIB_MSVC) || defined(EFLIB_MINGW64)
     __cpuid(cpu_infos, 1);
     __cpuid(cpu_infos_ex, 0x80000001);
+    __cpuidex(cpu_infos_7, 7, 0);
 #  elif defined(EFLIB_MINGW32) || defined(EFLIB_GCC) || defined(EFLIB_CLANG)
     __cpuid(1, cpu_infos[0], cpu_infos[1], cpu_infos[2], cpu_infos[3]);
     __cpuid(0x80000001, cpu_infos_ex[0], cpu_infos_ex[1], cpu_infos_ex[2], cpu_infos_ex[3]);
+    __cpuid_count(7, 0, cpu_infos_7[0], cpu_infos_7[1], cpu_infos_7[2], cpu_infos_7[3]);
 #  endif
     feats[cpu_sse2] = (cpu_infos[3] & (1 << 26)) || false;
     feats[cpu_sse3] = (cpu_infos[2] & 0x1) || false;
@@ -34,6 +37,7 @@ public:
     feats[cpu_sse42] = (cpu_infos[2] & 0x100000) || false;
     feats[cpu_sse4a] = (cpu_infos_ex[2] & 0x40) || false;
     feats[cpu_avx] = ((cpu_infos[2] & (1 << 27)) && (cpu_infos[2] & (1 << 28))) || false;
+    feats[cpu_avx2] = (feats[cpu_avx] && (cpu_infos_7[1] & (1 << 5))) || false;
 
     // others are unchecked.
   };
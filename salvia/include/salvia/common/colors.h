@@ -300,6 +300,167 @@ private:
   }
 };
 
+// Depth stencil formats. Unorm depth is rounded to nearest. Depth is converted as red and stencil
+// as green, only low 8 bits of stencil are stored.
+struct color_d16 {
+  typedef uint16_t comp_t;
+  comp_t depth;
+
+  color_d16() {}
+
+  template <class T>
+  color_d16(const T& rhs) {
+    *this = rhs;
+  }
+
+  color_d16& operator=(const color_d16& rhs) {
+    depth = rhs.depth;
+    return *this;
+  }
+
+  color_d16& operator=(const color_rgba32f& rhs) { return assign(rhs); }
+
+  template <class T>
+  color_d16& operator=(const T& rhs) {
+    return assign(rhs.to_rgba32f());
+  }
+
+  float get_depth() const { return depth / 65535.0f; }
+  void set_depth(float d) { depth = comp_t(eflib::clamp(d, 0.0f, 1.0f) * 65535.0f + 0.5f); }
+  uint32_t get_stencil() const { return 0; }
+  void set_stencil(uint32_t /*s*/) {}
+
+  color_rgba32f to_rgba32f() const { return color_rgba32f(get_depth(), 0.0f, 0.0f, 0.0f); }
+
+private:
+  color_d16& assign(const color_rgba32f& rhs) {
+    set_depth(rhs.r);
+    return *this;
+  }
+};
+
+struct color_d24s8 {
+  typedef uint32_t comp_t;
+  comp_t value;  // Depth in low 24 bits and stencil in high 8 bits.
+
+  color_d24s8() {}
+
+  template <class T>
+  color_d24s8(const T& rhs) {
+    *this = rhs;
+  }
+
+  color_d24s8& operator=(const color_d24s8& rhs) {
+    value = rhs.value;
+    return *this;
+  }
+
+  color_d24s8& operator=(const color_rgba32f& rhs) { return assign(rhs); }
+
+  template <class T>
+  color_d24s8& operator=(const T& rhs) {
+    return assign(rhs.to_rgba32f());
+  }
+
+  // Unorm24 is out of float precision, so it is scaled in double.
+  float get_depth() const { return static_cast<float>((value & 0xFFFFFF) / 16777215.0); }
+  void set_depth(float d) {
+    comp_t const z = comp_t(eflib::clamp(d, 0.0f, 1.0f) * 16777215.0 + 0.5);
+    value = (value & 0xFF000000) | z;
+  }
+  uint32_t get_stencil() const { return value >> 24; }
+  void set_stencil(uint32_t s) { value = (value & 0xFFFFFF) | (s << 24); }
+
+  color_rgba32f to_rgba32f() const {
+    return color_rgba32f(get_depth(), float(get_stencil()), 0.0f, 0.0f);
+  }
+
+private:
+  color_d24s8& assign(const color_rgba32f& rhs) {
+    value = 0;
+    set_depth(rhs.r);
+    set_stencil(comp_t(eflib::clamp(rhs.g, 0.0f, 255.0f) + 0.5f));
+    return *this;
+  }
+};
+
+struct color_d32f {
+  typedef float comp_t;
+  comp_t depth;
+
+  color_d32f() {}
+
+  template <class T>
+  color_d32f(const T& rhs) {
+    *this = rhs;
+  }
+
+  color_d32f& operator=(const color_d32f& rhs) {
+    depth = rhs.depth;
+    return *this;
+  }
+
+  color_d32f& operator=(const color_rgba32f& rhs) { return assign(rhs); }
+
+  template <class T>
+  color_d32f& operator=(const T& rhs) {
+    return assign(rhs.to_rgba32f());
+  }
+
+  float get_depth() const { return depth; }
+  void set_depth(float d) { depth = d; }
+  uint32_t get_stencil() const { return 0; }
+  void set_stencil(uint32_t /*s*/) {}
+
+  color_rgba32f to_rgba32f() const { return color_rgba32f(depth, 0.0f, 0.0f, 0.0f); }
+
+private:
+  color_d32f& assign(const color_rgba32f& rhs) {
+    depth = rhs.r;
+    return *this;
+  }
+};
+
+struct color_d32f_s8x24 {
+  typedef float comp_t;
+  comp_t depth;
+  uint32_t stencil;  // Stencil in low 8 bits, others are zero.
+
+  color_d32f_s8x24() {}
+
+  template <class T>
+  color_d32f_s8x24(const T& rhs) {
+    *this = rhs;
+  }
+
+  color_d32f_s8x24& operator=(const color_d32f_s8x24& rhs) {
+    depth = rhs.depth;
+    stencil = rhs.stencil;
+    return *this;
+  }
+
+  color_d32f_s8x24& operator=(const color_rgba32f& rhs) { return assign(rhs); }
+
+  template <class T>
+  color_d32f_s8x24& operator=(const T& rhs) {
+    return assign(rhs.to_rgba32f());
+  }
+
+  float get_depth() const { return depth; }
+  void set_depth(float d) { depth = d; }
+  uint32_t get_stencil() const { return stencil; }
+  void set_stencil(uint32_t s) { stencil = s & 0xFF; }
+
+  color_rgba32f to_rgba32f() const { return color_rgba32f(depth, float(stencil), 0.0f, 0.0f); }
+
+private:
+  color_d32f_s8x24& assign(const color_rgba32f& rhs) {
+    depth = rhs.r;
+    set_stencil(uint32_t(eflib::clamp(rhs.g, 0.0f, 255.0f) + 0.5f));
+    return *this;
+  }
+};
+
 inline color_rgba32f lerp(const color_rgba32f& c0, const color_rgba32f& c1, float t) {
 #ifndef EFLIB_NO_SIMD
   __m128 mc0 = _mm_loadu_ps(&c0.r);
@@ -337,6 +498,18 @@ inline color_rgba32f lerp(const color_rg32f& c0, const color_rg32f& c1, float t)
 inline color_rgba32f lerp(const color_r32i& c0, const color_r32i& c1, float t) {
   return color_r32i(static_cast<color_r32i::comp_t>(c0.r + (c1.r - c0.r) * t)).to_rgba32f();
 }
+inline color_rgba32f lerp(const color_d16& c0, const color_d16& c1, float t) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), t);
+}
+inline color_rgba32f lerp(const color_d24s8& c0, const color_d24s8& c1, float t) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), t);
+}
+inline color_rgba32f lerp(const color_d32f& c0, const color_d32f& c1, float t) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), t);
+}
+inline color_rgba32f lerp(const color_d32f_s8x24& c0, const color_d32f_s8x24& c1, float t) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), t);
+}
 
 inline color_rgba32f lerp(const color_rgba32f& c0,
                           const color_rgba32f& c1,
@@ -486,4 +659,36 @@ inline color_rgba32f lerp(const color_r32i& c0,
   color_r32f c23(c2.r + (c3.r - c2.r) * tx);
   return color_r32f(c01.r + (c23.r - c01.r) * ty).to_rgba32f();
 }
+inline color_rgba32f lerp(const color_d16& c0,
+                          const color_d16& c1,
+                          const color_d16& c2,
+                          const color_d16& c3,
+                          float tx,
+                          float ty) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), c2.to_rgba32f(), c3.to_rgba32f(), tx, ty);
+}
+inline color_rgba32f lerp(const color_d24s8& c0,
+                          const color_d24s8& c1,
+                          const color_d24s8& c2,
+                          const color_d24s8& c3,
+                          float tx,
+                          float ty) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), c2.to_rgba32f(), c3.to_rgba32f(), tx, ty);
+}
+inline color_rgba32f lerp(const color_d32f& c0,
+                          const color_d32f& c1,
+                          const color_d32f& c2,
+                          const color_d32f& c3,
+                          float tx,
+                          float ty) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), c2.to_rgba32f(), c3.to_rgba32f(), tx, ty);
+}
+inline color_rgba32f lerp(const color_d32f_s8x24& c0,
+                          const color_d32f_s8x24& c1,
+                          const color_d32f_s8x24& c2,
+                          const color_d32f_s8x24& c3,
+                          float tx,
+                          float ty) {
+  return lerp(c0.to_rgba32f(), c1.to_rgba32f(), c2.to_rgba32f(), c3.to_rgba32f(), tx, ty);
+}
 }  // namespace salvia
@@ -44,7 +44,11 @@ decl_type_fmt_pair(color_rgba8, 3);
 decl_type_fmt_pair(color_r32f, 4);
 decl_type_fmt_pair(color_rg32f, 5);
 decl_type_fmt_pair(color_r32i, 6);
-decl_type_fmt_pair(color_max, 7);
+decl_type_fmt_pair(color_d16, 7);
+decl_type_fmt_pair(color_d24s8, 8);
+decl_type_fmt_pair(color_d32f, 9);
+decl_type_fmt_pair(color_d32f_s8x24, 10);
+decl_type_fmt_pair(color_max, 11);
 
 int const pixel_format_color_ub = pixel_format_color_max - 1;
 int const pixel_format_invalid = -1;
@@ -58,7 +62,11 @@ const pixel_information color_infos[pixel_type_to_fmt<color_max>::fmt] = {
     decl_color_info(color_rgba8),
     decl_color_info(color_r32f),
     decl_color_info(color_rg32f),
-    decl_color_info(color_r32i)};
+    decl_color_info(color_r32i),
+    decl_color_info(color_d16),
+    decl_color_info(color_d24s8),
+    decl_color_info(color_d32f),
+    decl_color_info(color_d32f_s8x24)};
 
 inline const pixel_information& get_color_info(pixel_format pf) {
   return color_infos[pf];
@@ -40,11 +40,7 @@ enum resource_usage {
   resource_staging = 0xf  // 1111
 };
 
-#define RESERVED(i) 0xFFFF0000 + i
 enum primitive_topology {
-  primitive_point_list = RESERVED(0),
-  primitive_point_sprite = RESERVED(1),
-
   primitive_line_list = 0,
   primitive_line_strip = 1,
 
@@ -52,7 +48,11 @@ enum primitive_topology {
   primitive_triangle_fan = 3,
   primitive_triangle_strip = 4,
 
-  primivite_topology_count = 5
+  // Point sprites are squares of raster_desc::point_size pixels.
+  primitive_point_list = 5,
+  primitive_point_sprite = 6,
+
+  primivite_topology_count = 7
 };
 
 enum cull_mode {
@@ -162,6 +162,35 @@ enum stencil_op {
   stencil_op_decr_wrap = 8,
 };
 
+enum blend_factor {
+  blend_factor_zero = 1,
+  blend_factor_one = 2,
+  blend_factor_src_color = 3,
+  blend_factor_inv_src_color = 4,
+  blend_factor_src_alpha = 5,
+  blend_factor_inv_src_alpha = 6,
+  blend_factor_dest_alpha = 7,
+  blend_factor_inv_dest_alpha = 8,
+  blend_factor_dest_color = 9,
+  blend_factor_inv_dest_color = 10
+};
+
+enum blend_op {
+  blend_op_add = 1,
+  blend_op_subtract = 2,
+  blend_op_rev_subtract = 3,
+  blend_op_min = 4,
+  blend_op_max = 5
+};
+
+enum color_write_mask {
+  color_write_red = 0x1,
+  color_write_green = 0x2,
+  color_write_blue = 0x4,
+  color_write_alpha = 0x8,
+  color_write_all = 0xF
+};
+
 enum clear_flag { clear_depth = 0x1, clear_stencil = 0x2 };
 
 enum class async_object_ids : uint32_t {
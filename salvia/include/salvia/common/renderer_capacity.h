@@ -13,5 +13,6 @@ constexpr uint32_t MAX_RENDER_TARGET_WIDTH = 8192;
 constexpr uint32_t MAX_RENDER_TARGET_HEIGHT = 8192;
 constexpr uint32_t MAX_SAMPLE_COUNT = 16;
 constexpr uint32_t SAMPLE_MASK = 0xFFFF;
+constexpr uint32_t MAX_SUBPIXEL_BITS = 8;
 
 }  // namespace salvia
@@ -96,6 +96,10 @@ struct pipeline_statistics {
   uint64_t cinvocations;
   uint64_t cprimitives;
   uint64_t ps_invocations;
+  uint64_t hiz_rejects;  // Tiles and sub-tiles of primitives culled by hierarchical Z.
+  // Vertexes of primitives which are shaded already. Hit rate of vertex cache is
+  // vs_cache_hits / ia_vertices.
+  uint64_t vs_cache_hits;
 };
 
 enum class pipeline_statistic_id : uint32_t {
@@ -106,7 +110,10 @@ enum class pipeline_statistic_id : uint32_t {
   gs_primitives,
   cinvocations,
   cprimitives,
-  ps_invocations
+  ps_invocations,
+  hiz_rejects,
+  vs_cache_hits,
+  count
 };
 
 class async_pipeline_statistics final : public async_object {
@@ -121,7 +128,7 @@ public:
   virtual async_object_ids id() override { return async_object_ids::pipeline_statistics; }
 
 protected:
-  std::array<std::atomic<uint64_t>, 8> counters_;
+  std::array<std::atomic<uint64_t>, static_cast<uint32_t>(pipeline_statistic_id::count)> counters_;
 
   void get_value(void* v) override {
     auto ret = reinterpret_cast<pipeline_statistics*>(v);
@@ -133,6 +140,8 @@ protected:
     ret->ia_vertices = counters_[static_cast<uint32_t>(pipeline_statistic_id::ia_vertices)];
     ret->ps_invocations = counters_[static_cast<uint32_t>(pipeline_statistic_id::ps_invocations)];
     ret->vs_invocations = counters_[static_cast<uint32_t>(pipeline_statistic_id::vs_invocations)];
+    ret->hiz_rejects = counters_[static_cast<uint32_t>(pipeline_statistic_id::hiz_rejects)];
+    ret->vs_cache_hits = counters_[static_cast<uint32_t>(pipeline_statistic_id::vs_cache_hits)];
   }
 
   virtual void init_async_data() override {
@@ -177,21 +186,49 @@ protected:
 struct pipeline_profiles {
   uint64_t gather_vtx;  // Including: Generate index of primitives and unique indexes
   uint64_t vtx_proc;
+  // Stages of primitive pipeline are overlapped, so they are measured as time spent by threads.
+  // Occupancy of a stage is the ratio of its time to pipeline_thread_time.
   uint64_t clipping;
-  uint64_t compact_clip;
   uint64_t vp_trans;
+  uint64_t tri_setup;
   uint64_t tri_dispatch;
   uint64_t ras;
+  uint64_t pipeline_thread_time;
+  // Draws binned with 16x16, 32x32, 64x64 and 128x128 tiles.
+  uint64_t tile_16_draws;
+  uint64_t tile_32_draws;
+  uint64_t tile_64_draws;
+  uint64_t tile_128_draws;
+  // Time which threads are idle waiting for the last thread of pipeline. Load of threads is
+  // balanced if it is small compared to pipeline_thread_time.
+  uint64_t load_imbalance;
+  // Tiles rasterized by threads other than the one they were scheduled to.
+  uint64_t tile_steals;
+  // Pixel shaders cloned for threads. Clones are reused by draws until the shader or its constants
+  // are changed.
+  uint64_t shader_clones;
+  // Bytes saved by storing shaded, clipped and projected vertexes and triangle derivatives with
+  // only the attributes written by vertex shader.
+  uint64_t vso_bytes_saved;
 };
 
 enum class pipeline_profile_id : uint32_t {
   gather_vtx = 0,
   vtx_proc,
   clipping,
-  compact_clip,
   vp_trans,
+  tri_setup,
   tri_dispatch,
   ras,
+  pipeline_thread_time,
+  tile_16_draws,
+  tile_32_draws,
+  tile_64_draws,
+  tile_128_draws,
+  load_imbalance,
+  tile_steals,
+  shader_clones,
+  vso_bytes_saved,
   count
 };
 
@@ -218,11 +255,22 @@ protected:
     auto ret = reinterpret_cast<pipeline_profiles*>(v);
     ret->gather_vtx = counters_[static_cast<uint32_t>(pipeline_profile_id::gather_vtx)];
     ret->clipping = counters_[static_cast<uint32_t>(pipeline_profile_id::clipping)];
-    ret->compact_clip = counters_[static_cast<uint32_t>(pipeline_profile_id::compact_clip)];
     ret->vp_trans = counters_[static_cast<uint32_t>(pipeline_profile_id::vp_trans)];
+    ret->tri_setup = counters_[static_cast<uint32_t>(pipeline_profile_id::tri_setup)];
     ret->tri_dispatch = counters_[static_cast<uint32_t>(pipeline_profile_id::tri_dispatch)];
     ret->ras = counters_[static_cast<uint32_t>(pipeline_profile_id::ras)];
+    ret->pipeline_thread_time =
+        counters_[static_cast<uint32_t>(pipeline_profile_id::pipeline_thread_time)];
     ret->vtx_proc = counters_[static_cast<uint32_t>(pipeline_profile_id::vtx_proc)];
+    ret->tile_16_draws = counters_[static_cast<uint32_t>(pipeline_profile_id::tile_16_draws)];
+    ret->tile_32_draws = counters_[static_cast<uint32_t>(pipeline_profile_id::tile_32_draws)];
+    ret->tile_64_draws = counters_[static_cast<uint32_t>(pipeline_profile_id::tile_64_draws)];
+    ret->tile_128_draws = counters_[static_cast<uint32_t>(pipeline_profile_id::tile_128_draws)];
+    ret->load_imbalance = counters_[static_cast<uint32_t>(pipeline_profile_id::load_imbalance)];
+    ret->tile_steals = counters_[static_cast<uint32_t>(pipeline_profile_id::tile_steals)];
+    ret->shader_clones = counters_[static_cast<uint32_t>(pipeline_profile_id::shader_clones)];
+    ret->vso_bytes_saved =
+        counters_[static_cast<uint32_t>(pipeline_profile_id::vso_bytes_saved)];
   }
 
   virtual void init_async_data() override {
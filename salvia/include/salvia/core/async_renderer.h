@@ -13,6 +13,6 @@ namespace salvia::core {
 
 EFLIB_DECLARE_CLASS_SHARED_PTR(renderer);
 
-renderer_ptr create_async_renderer();
+renderer_ptr create_async_renderer(renderer_parameters const* params = nullptr);
 
 }  // namespace salvia::core
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <salvia/common/colors_convertors.h>
+#include <salvia/common/constants.h>
+#include <salvia/common/renderer_capacity.h>
+
+#include <eflib/math/vector.h>
+#include <eflib/platform/stdint.h>
+
+namespace salvia::core {
+
+// Blending of a render target, as in D3D. Result is 'src * src_blend (color_op) dest * dest_blend'
+// for color, and with alpha factors and operation for alpha. Only channels in write mask are
+// written. Pixel shader output is the source if blending is disabled.
+struct render_target_blend_desc {
+  bool blend_enable;
+  blend_factor src_blend;
+  blend_factor dest_blend;
+  blend_op color_op;
+  blend_factor src_blend_alpha;
+  blend_factor dest_blend_alpha;
+  blend_op alpha_op;
+  uint8_t render_target_write_mask;
+
+  render_target_blend_desc()
+    : blend_enable(false)
+    , src_blend(blend_factor_one)
+    , dest_blend(blend_factor_zero)
+    , color_op(blend_op_add)
+    , src_blend_alpha(blend_factor_one)
+    , dest_blend_alpha(blend_factor_zero)
+    , alpha_op(blend_op_add)
+    , render_target_write_mask(color_write_all) {}
+};
+
+// Blend kernels blend colors of a 2x2 quad into samples of a render target.
+//
+// 'rows' are addresses of the first sample of pixel (x, y) and (x, y + 1), each followed by samples
+// of pixel x + 1, as texels of the format of the kernel. A row is null if none of its samples is
+// covered. 'quad_mask' has MAX_SAMPLE_COUNT bits per pixel, pixels are (x, y), (x + 1, y),
+// (x, y + 1) and (x + 1, y + 1). 'colors' are source colors of pixels, and only colors of covered
+// pixels are read. 'desc' is the blend of the kernel.
+typedef void (*blend_quad_fn)(void* const* rows,
+                              uint32_t sample_count,
+                              uint64_t quad_mask,
+                              eflib::vec4 const* colors,
+                              render_target_blend_desc const* desc);
+
+// Kernel is specialized for writing, alpha, premultiplied alpha and additive blending of rgba32f,
+// rgba8 and bgra8, and evaluates 'desc' for other blends and color formats. It is null if write
+// mask is empty or the format is not a color format.
+blend_quad_fn select_blend_quad_kernel(pixel_format fmt, render_target_blend_desc const& desc);
+
+}  // namespace salvia::core
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <eflib/platform/config.h>
+#include <eflib/platform/stdint.h>
+
+namespace salvia::core {
+
+// Solid triangles are classified in batches before clipping. Only triangles which cross near or far
+// plane are clipped one by one.
+constexpr uint32_t TRIANGLE_BATCH_SIZE = 8;
+
+// Clip-space position of vertex i of triangle t is (x[i][t], y[i][t], z[i][t], w[i][t]).
+struct triangle_batch {
+  EFLIB_ALIGN(32) float x[3][TRIANGLE_BATCH_SIZE];
+  EFLIB_ALIGN(32) float y[3][TRIANGLE_BATCH_SIZE];
+  EFLIB_ALIGN(32) float z[3][TRIANGLE_BATCH_SIZE];
+  EFLIB_ALIGN(32) float w[3][TRIANGLE_BATCH_SIZE];
+};
+
+// Bit t of masks is for triangle t of the batch.
+struct triangle_batch_masks {
+  uint32_t rejected;  // Out of a frustum plane, culled or zero area.
+  uint32_t inside;    // Not rejected and needs no clipping.
+  uint32_t front;     // Facing of 'inside' triangles.
+};
+
+// Triangles are rejected if all vertexes are out of one of frustum planes. Triangles whose
+// vertexes are all between near and far plane are inside; they are rejected by facing as
+// 'cull_front' and 'cull_back', or by zero area. Other triangles are left for the clipper.
+// Lanes from 'count' are neither rejected nor inside.
+typedef void (*classify_triangles_fn)(triangle_batch const& batch,
+                                      uint32_t count,
+                                      bool cull_front,
+                                      bool cull_back,
+                                      triangle_batch_masks& masks);
+
+void classify_triangles_generic(triangle_batch const& batch,
+                                uint32_t count,
+                                bool cull_front,
+                                bool cull_back,
+                                triangle_batch_masks& masks);
+void classify_triangles_avx2(triangle_batch const& batch,
+                             uint32_t count,
+                             bool cull_front,
+                             bool cull_back,
+                             triangle_batch_masks& masks);
+
+// Fastest kernel supported by current CPU.
+classify_triangles_fn select_classify_triangles_kernel();
+
+}  // namespace salvia::core
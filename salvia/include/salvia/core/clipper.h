@@ -48,6 +48,8 @@ private:
   void clip_triangle_to_poly_general(shader::vs_output** tri_verts, clip_results*) const;
   void clip_triangle_to_poly_simple(shader::vs_output** tri_verts, clip_results*) const;
 
+  void clip_point(shader::vs_output** point_vert, clip_results* rslt);
+  void clip_line(shader::vs_output** line_verts, clip_results* rslt);
   void clip_wireframe_triangle(shader::vs_output** tri_verts, clip_results* rslt);
   void clip_solid_triangle(shader::vs_output** tri_verts, clip_results* rslt);
 
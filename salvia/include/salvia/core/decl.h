@@ -12,6 +12,7 @@ EFLIB_DECLARE_CLASS_SHARED_PTR(renderer);
 EFLIB_DECLARE_CLASS_SHARED_PTR(clipper);
 EFLIB_DECLARE_CLASS_SHARED_PTR(raster_state);
 EFLIB_DECLARE_CLASS_SHARED_PTR(depth_stencil_state);
+EFLIB_DECLARE_CLASS_SHARED_PTR(blend_state);
 
 EFLIB_DECLARE_CLASS_SHARED_PTR(cpp_vertex_shader);
 EFLIB_DECLARE_CLASS_SHARED_PTR(cpp_pixel_shader);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <salvia/common/constants.h>
+#include <salvia/common/renderer_capacity.h>
+
+#include <eflib/platform/stdint.h>
+
+namespace salvia::core {
+
+// Depth-only kernels test and write depth of samples without pixel shading and blending.
+//
+// Samples are in layout of pixel_format_color_rg32f or pixel_format_color_d32f_s8x24: depth is the
+// first component of a sample, samples of a pixel are adjacent and pixels of a row are adjacent.
+// Stencil is never modified.
+//
+// Depth of pixel i in the row is z + i * dzdx, and depth of sample s of the pixel is offset by
+// sample_z_offset[s]. 'pixel_masks' are sample masks of pixels, or null if all samples are covered.
+// Returns true if any depth is written.
+typedef bool (*depth_row_fn)(float* ds_row,
+                             uint32_t sample_count,
+                             uint32_t count,
+                             float z,
+                             float dzdx,
+                             float const* sample_z_offset,
+                             uint32_t const* pixel_masks);
+
+// Kernels are null if no depth could pass the test of 'func'.
+depth_row_fn generic_depth_row_kernel(compare_function func);
+depth_row_fn avx2_depth_row_kernel(compare_function func);
+
+// Fastest kernel supported by current CPU.
+depth_row_fn select_depth_row_kernel(compare_function func);
+
+// Quad kernels test depth and stencil of all samples of a 2x2 quad, and write samples which pass
+// both tests. Samples are in the layout of depth-only kernels.
+//
+// 'ds_rows' are addresses of the first sample of pixel (x, y) and (x, y + 1), each followed by
+// samples of pixel x + 1. A row is null if none of its samples is covered. 'quad_mask' has
+// MAX_SAMPLE_COUNT bits per pixel, pixels are (x, y), (x + 1, y), (x, y + 1) and (x + 1, y + 1).
+// Depth of sample s of pixel i is depth[i] + sample_z_offset[s], or depth[i] for one sample.
+// Returns mask of samples which pass tests, in layout of 'quad_mask'.
+//
+// Stencil is tested and written only if 'stencil' is not null. Stencil is masked by 'read_mask'
+// before test and operation, and result of 'pass_op' is masked by 'write_mask' before written.
+// Masks have 8 bits as stencil.
+struct stencil_quad_params {
+  uint32_t ref;  // Masked by read_mask.
+  uint32_t read_mask;
+  uint32_t write_mask;
+  compare_function func;
+  stencil_op pass_op;
+};
+
+typedef uint64_t (*depth_stencil_quad_fn)(float* const* ds_rows,
+                                          uint32_t sample_count,
+                                          uint64_t quad_mask,
+                                          float const* depth,
+                                          float const* sample_z_offset,
+                                          stencil_quad_params const* stencil);
+
+// Depth is tested by 'depth_func' and written only if 'write_depth' is true. Kernels with 'stencil'
+// must be called with stencil parameters.
+depth_stencil_quad_fn
+generic_depth_stencil_quad_kernel(compare_function depth_func, bool write_depth, bool stencil);
+depth_stencil_quad_fn
+avx2_depth_stencil_quad_kernel(compare_function depth_func, bool write_depth, bool stencil);
+
+// Fastest kernel supported by current CPU.
+depth_stencil_quad_fn
+select_depth_stencil_quad_kernel(compare_function depth_func, bool write_depth, bool stencil);
+
+}  // namespace salvia::core
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <eflib/platform/config.h>
+#include <eflib/platform/stdint.h>
+
+namespace salvia::core {
+
+// Fixed-point edge equations of a triangle in window coordinates.
+//
+// Positions are snapped to 1/2^subpixel_bits pixel. A sample at fixed-point position (x, y) is
+// covered if a[e] * x + b[e] * y - c[e] >= 0 for all edges. Top-left fill rule has been folded
+// into c, so edges shared by adjacent triangles are covered exactly once.
+struct fixed_edge_equations {
+  EFLIB_ALIGN(32) int64_t c[4];
+  EFLIB_ALIGN(16) int32_t a[4];
+  EFLIB_ALIGN(16) int32_t b[4];
+  int32_t bounding_box[4];  // Candidate pixels: [x_min, x_max] x [y_min, y_max].
+  uint32_t subpixel_bits;
+  bool valid;      // False if vertexes are out of fixed-point range. Use float equations instead.
+  bool lane_safe;  // Edge values of a partially covered 4x4 block fit in 31-bit.
+};
+
+enum class block_coverage { rejected, partial, accepted };
+
+// Returns false and leaves 'eq' invalid if positions could not be represented in fixed point.
+bool setup_fixed_edge_equations(fixed_edge_equations& eq,
+                                float const* xs,
+                                float const* ys,
+                                uint32_t subpixel_bits);
+
+// Classifies all samples of pixels [left, left + width) x [top, top + height).
+block_coverage classify_block(fixed_edge_equations const& eq,
+                              int left,
+                              int top,
+                              int width,
+                              int height);
+
+struct edge_kernels {
+  // Classifies 4x4 children of the block at (left, top), each child is 'child_size' pixels.
+  // Children which are not rejected are appended to 'regions' as
+  //   (region_x + child_x) | (region_y + child_y) << 8 | accepted << 31
+  void (*subdivide)(fixed_edge_equations const& eq,
+                    int left,
+                    int top,
+                    uint32_t region_x,
+                    uint32_t region_y,
+                    uint32_t child_size,
+                    uint32_t* regions,
+                    uint32_t& region_count);
+
+  // Computes sample coverage of 4x4 pixels from (left, top), one bit per sample.
+  // Sample offsets are in fixed point.
+  void (*coverage)(fixed_edge_equations const& eq,
+                   int left,
+                   int top,
+                   int32_t const* sample_x,
+                   int32_t const* sample_y,
+                   uint32_t sample_count,
+                   uint32_t* pixel_mask);
+};
+
+edge_kernels const* generic_edge_kernels();
+edge_kernels const* avx2_edge_kernels();
+
+// Fastest kernels supported by current CPU.
+edge_kernels const* select_edge_kernels();
+
+}  // namespace salvia::core
@@ -5,7 +5,10 @@
 
 #include <salvia/common/colors.h>
 
+#include <salvia/core/blend_kernels.h>
 #include <salvia/core/decl.h>
+#include <salvia/core/depth_kernels.h>
+#include <salvia/core/hierarchical_z.h>
 
 #include <eflib/math/collision_detection.h>
 
@@ -76,6 +79,50 @@ public:
   uint32_t mask_stencil(uint32_t stencil, uint32_t stencil_mask) const;
 };
 
+struct blend_desc {
+  // Blend of the first target is used by all targets if it is false.
+  bool independent_blend_enable;
+  render_target_blend_desc render_target[MAX_RENDER_TARGETS];
+
+  blend_desc() : independent_blend_enable(false) {}
+};
+
+// Blending of targets if blend shader is not set. It is compiled to blend kernels of targets.
+class blend_state {
+  blend_desc desc_;
+
+public:
+  blend_state(const blend_desc& desc);
+  const blend_desc& get_desc() const;
+
+  const render_target_blend_desc& render_target(size_t index) const;
+};
+
+// Color and depth stencil of a tile of targets, copied to contiguous buffers. While the tile is
+// bound to a thread by framebuffer::begin_tile, framebuffers of the same targets draw samples on
+// that thread to the buffers, and framebuffer::end_tile writes back buffers which are drawn.
+// Buffers are reused by the next tiles.
+class framebuffer_tile {
+public:
+  framebuffer_tile();
+
+private:
+  friend class framebuffer;
+
+  size_t left_;
+  size_t top_;
+  resource::surface* color_targets_[MAX_RENDER_TARGETS];
+  resource::surface* ds_target_;
+  // Buffers of bound targets, null if target is not bound.
+  resource::surface* color_buffers_[MAX_RENDER_TARGETS];
+  resource::surface* ds_buffer_;
+  bool color_drawn_;
+  bool ds_drawn_;
+
+  resource::surface_ptr color_storage_[MAX_RENDER_TARGETS];
+  resource::surface_ptr ds_storage_;
+};
+
 class framebuffer {
 private:
   resource::surface* color_targets_[MAX_RENDER_TARGETS];
@@ -93,9 +140,81 @@ private:
                               uint32_t stencil_mask,
                               void const* ds_data);
   void (*write_depth_stencil_)(void* ds_data, float depth, uint32_t stencil, uint32_t stencil_mask);
+  float (*quantize_depth_)(float depth);  // Null if depth is stored as float.
+  bool write_depth_enabled_;
+  depth_row_fn depth_row_;  // Null if depth-only drawing writes nothing or has no kernel.
+  // Tests and writes samples of a quad. Null if samples are tested one by one.
+  depth_stencil_quad_fn depth_stencil_quad_;
+  stencil_quad_params stencil_params_[2];  // Front and back face.
+
+  // Blend kernels of targets are used instead of blend shader if it is not set.
+  bool blend_kernels_enabled_;
+  blend_quad_fn blend_quad_[MAX_RENDER_TARGETS];  // Null if target is not written.
+  render_target_blend_desc blend_descs_[MAX_RENDER_TARGETS];
+
+  hierarchical_z hiz_;
+  bool hiz_disabled_;
+  bool hiz_enabled_;
+  bool hiz_track_writes_;
+  // Target cleared while it was not bound. Its Hi-Z could be initialized from clear value.
+  resource::surface const* hiz_cleared_target_;
+  uint64_t hiz_cleared_generation_;
+  float hiz_cleared_depth_;
 
   void
   update_ds_rw_functions(bool ds_format_changed, bool ds_state_changed, bool output_depth_enabled);
+  template <uint32_t Format>
+  void
+  update_ds_accessors(bool read_depth, bool read_stencil, bool write_depth, bool write_stencil);
+  void update_hiz(bool output_depth_enabled);
+  // Depth is tested in precision of target, as it is read back.
+  float quantized_depth(float depth) const {
+    return quantize_depth_ != nullptr ? quantize_depth_(depth) : depth;
+  }
+
+  // Targets which samples are drawn to by calling thread, they are buffers of the tile if a tile is
+  // bound. Pixel (x, y) is (x - left, y - top) in targets.
+  struct draw_targets {
+    resource::surface** color;
+    resource::surface* ds;
+    size_t left;
+    size_t top;
+    framebuffer_tile* tile;  // Null if no tile is bound.
+
+    // Drawn buffers of tile are written back.
+    void mark_drawn(bool color_drawn, bool ds_drawn) const {
+      if (tile != nullptr) {
+        tile->color_drawn_ |= color_drawn;
+        tile->ds_drawn_ |= ds_drawn;
+      }
+    }
+  };
+  draw_targets bound_targets();
+
+  // Rows of depth stencil target for quad kernels. Rows without covered samples are null.
+  void quad_ds_rows(
+      draw_targets const& targets, size_t x, size_t y, uint64_t quad_mask, float** ds_rows) const;
+  // Tests depth and stencil of a sample, and writes them if both tests pass.
+  bool depth_stencil_test(draw_targets const& targets,
+                          size_t x,
+                          size_t y,
+                          size_t i_sample,
+                          float depth,
+                          bool front_face);
+  // Tests depth and stencil of samples in 'quad_mask' of quad (x, y), returns passed samples.
+  uint64_t depth_stencil_test_quad(draw_targets const& targets,
+                                   size_t x,
+                                   size_t y,
+                                   uint64_t quad_mask,
+                                   float const* depth,
+                                   bool front_face,
+                                   float const* aa_offset);
+  // Blends samples in 'quad_mask' of quad (x, y) into targets by blend kernels.
+  void blend_quad(draw_targets const& targets,
+                  size_t x,
+                  size_t y,
+                  uint64_t quad_mask,
+                  shader::ps_output const* quad);
 
 public:
   void initialize(render_stages const* stages);
@@ -106,6 +225,25 @@ public:
 
   bool early_z_enabled() const { return early_z_enabled_; }
 
+  // Hi-Z rejection is available only if depth test could be done before pixel shader.
+  bool hiz_enabled() const { return hiz_enabled_; }
+  bool hiz_reject(size_t left, size_t top, size_t right, size_t bottom, float min_z, float max_z)
+      const {
+    return hiz_.reject(ds_state_->get_desc().depth_func,
+                       left,
+                       top,
+                       right,
+                       bottom,
+                       quantized_depth(min_z),
+                       quantized_depth(max_z));
+  }
+  void refresh_hiz();
+  void hiz_depth_cleared(resource::surface const* tar, float depth);
+  // Hi-Z is neither used nor tracked, e.g. targets are written by other framebuffers.
+  void disable_hiz() { hiz_disabled_ = true; }
+  // Depth is modified out of this framebuffer, Hi-Z is rebuilt from target at next update.
+  void invalidate_hiz();
+
   void render_sample(cpp_blend_shader* cpp_bs,
                      size_t x,
                      size_t y,
@@ -128,6 +266,41 @@ public:
   uint64_t early_z_test_quad(
       size_t x, size_t y, uint64_t quad_mask, float const* depth, float const* aa_z_offset);
 
+  // Samples are drawn without pixel shader, e.g. shadow maps or depth prepasses with stencil. Depth
+  // and stencil are tested and written, and color targets are kept. Only available if early Z is
+  // disabled, otherwise the samples have been drawn by early Z test.
+  void late_depth_stencil(
+      size_t x, size_t y, uint32_t px_mask, float depth, bool front_face, float const* aa_offset);
+  void late_depth_stencil_quad(size_t x,
+                               size_t y,
+                               uint64_t quad_mask,
+                               float const* depth,
+                               bool front_face,
+                               float const* aa_offset);
+
+  // Depth-only drawing: tests and writes depth of pixels [x, x + count) in row y without shading.
+  // Depth of pixel x + i is z + i * dzdx. 'pixel_masks' are sample masks of pixels or null if all
+  // samples are covered. Only available if early Z is enabled.
+  void draw_depth_row(size_t x,
+                      size_t y,
+                      uint32_t count,
+                      float z,
+                      float dzdx,
+                      uint32_t const* pixel_masks,
+                      float const* aa_z_offset);
+
+  // Tile-resident drawing. Pixels [left, left + size) x [top, top + size) of current targets are
+  // loaded to 'tile', which is bound to calling thread until end_tile. Only samples in the tile
+  // could be drawn on the thread while it is bound.
+  void begin_tile(framebuffer_tile* tile, size_t left, size_t top, size_t size) const;
+  static void end_tile(framebuffer_tile* tile);
+
+  // Fast clears of current targets in the tile are expanded before it is drawn without a bound
+  // tile. Tiles which are loaded by begin_tile are never expanded.
+  void expand_clears(size_t left, size_t top, size_t size) const;
+
+  // Target is cleared by fast clear. Depth or stencil alone is cleared on the texel of pending
+  // clear if the whole target is pending, otherwise target is expanded and cleared per texel.
   static void
   clear_depth_stencil(resource::surface* tar, uint32_t flag, float depth, uint32_t stencil);
 };
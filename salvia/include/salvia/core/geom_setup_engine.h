@@ -3,10 +3,9 @@
 #include <salvia/common/constants.h>
 #include <salvia/core/async_object.h>
 
-#include <eflib/concurrency/thread_context.h>
 #include <eflib/memory/pool.h>
 
-#include <memory>
+#include <vector>
 
 namespace salvia::shader {
 struct vs_output_op;
@@ -15,67 +14,64 @@ class vs_output;
 
 namespace salvia::core {
 
+class clipper;
 class vertex_cache;
+struct clip_results;
 struct viewport;
 
 struct geom_setup_context {
   shader::vs_output_op const* vso_ops;
+  size_t vso_size;  // Bytes of clipped and projected vertexes.
   vertex_cache* dvc;
+  viewport const* vp;
   prim_type prim;
   size_t prim_size;
-  size_t prim_count;
   bool (*cull)(float area);
 
   async_object* pipeline_stat;
   accumulate_fn<uint64_t>::type acc_cinvocations;
 };
 
-// Processing:
-//   Primitive Vertexes -> Primitive Packages -> Clipped Packages (Sparse)
-//   -> Compacted Clipped Primitive Vertexes
-class geom_setup_engine {
-public:
-  geom_setup_engine();
-
-  void execute(geom_setup_context const*, uint64_t (*fetch_time_stamp)());
-
-  [[nodiscard]] size_t vertex_count() const {
-    return clipped_package_compacted_addresses_[clipping_package_count_];
-  }
-
-  [[nodiscard]] shader::vs_output** vertexes() const { return compacted_vertexes_.get(); }
-
-  [[nodiscard]] uint64_t compact_start_time() const { return compact_start_time_; }
-
-private:
+// Clipped primitives of a chunk of primitives.
+// Projected vertexes are owned by the chunk. Vertexes in vertex cache are never modified, so they
+// could be shared by chunks.
+struct clipped_primitives {
   typedef eflib::pool::reserved_pool<shader::vs_output> vs_output_pool;
 
-  void clip_geometries();
-  void compact_geometries();
+  std::vector<shader::vs_output*> verts;  // 'prim_size' vertexes per primitive in drawing order.
+  size_t prim_count = 0;
 
-  void threaded_clip_geometries(eflib::thread_context const* thread_ctx);
-  void threaded_compact_geometries(eflib::thread_context const* thread_ctx);
-
-  std::shared_ptr<vs_output_pool[]> vso_pools_;
-
-  std::shared_ptr<shader::vs_output*[]> clipped_verts_;
-  size_t clipped_verts_cap_;
-
-  std::shared_ptr<uint32_t[]> clipped_package_verts_count_;
-  size_t clipped_package_verts_count_cap_;
-
-  std::shared_ptr<shader::vs_output*[]> compacted_vertexes_;
-  size_t compacted_vertex_cap_;
+  vs_output_pool clipper_verts;
+  vs_output_pool projected_verts;
+  std::vector<shader::vs_output*> unique_verts;
+  std::vector<shader::vs_output*> projected_addresses;
+};
 
-  std::shared_ptr<uint32_t[]> clipped_package_compacted_addresses_;
-  size_t clipped_package_compacted_addresses_cap_;
+// Processing:
+//   Primitive Vertexes of Chunk -> Clipped Primitive Vertexes -> Projected Vertexes
+class geom_setup_engine {
+public:
+  // Every triangle can clipped out 3 triangles at most.
+  static constexpr size_t MAX_CLIPPED_VERTS_PER_PRIM = 9;
 
-  size_t clipping_package_count_;
+  void clip(geom_setup_context const*,
+            size_t prim_begin,
+            size_t prim_end,
+            uint32_t thread_id,
+            clipped_primitives& out) const;
 
-  size_t thread_count_;
-  uint64_t compact_start_time_{};
+  // Transforms vertexes of clipped primitives to viewport, and projects attributes.
+  void project(geom_setup_context const*, clipped_primitives& prims) const;
 
-  geom_setup_context const* ctxt_;
+private:
+  // Solid triangles are classified in batches, and only those crossing near or far plane are
+  // clipped by 'clp'.
+  void clip_solid_triangles(geom_setup_context const*,
+                            size_t prim_begin,
+                            size_t prim_end,
+                            uint32_t thread_id,
+                            clipper& clp,
+                            clip_results& result) const;
 };
 
 }  // namespace salvia::core
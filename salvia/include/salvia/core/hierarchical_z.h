@@ -0,0 +1,75 @@
+#pragma once
+
+#include <salvia/common/constants.h>
+
+#include <salvia/core/decl.h>
+
+#include <eflib/platform/stdint.h>
+
+#include <vector>
+
+namespace salvia::core {
+
+// Conservative depth bounds of a depth-stencil target, kept on two levels:
+// HIZ_TILE_SIZE tiles which match the rasterizer's bins and HIZ_SUBTILE_SIZE sub-tiles.
+//
+// Depth writes only mark the sub-tile as dirty. Until the next refresh() the stale bounds are
+// still conservative for the current depth function, because a passing write moves the depth
+// towards the reference side only (i.e. smaller for LESS, larger for GREATER).
+class hierarchical_z {
+public:
+  static constexpr size_t HIZ_TILE_SIZE = 64;
+  static constexpr size_t HIZ_SUBTILE_SIZE = 4;
+
+  typedef float (*read_depth_fn)(void const* ds_data);
+
+  hierarchical_z();
+
+  // Binds a new target. Bounds are unknown (never reject) until the next refresh.
+  void reset(resource::surface const* ds_target, read_depth_fn read_depth);
+  resource::surface const* target() const { return target_; }
+  read_depth_fn read_depth() const { return read_depth_; }
+  // Bounds are of 'ds_target', and it is not written out of framebuffers since reset.
+  bool tracks(resource::surface const* ds_target) const;
+
+  void clear(float depth);
+
+  void mark_dirty(size_t x, size_t y) {
+    dirty_[(y / HIZ_SUBTILE_SIZE) * subtile_x_count_ + x / HIZ_SUBTILE_SIZE] = 1;
+  }
+
+  // Rebuild bounds of dirty sub-tiles and their tiles. Must not overlap with depth writes.
+  void refresh();
+
+  // Returns true if no sample in [left, right) x [top, bottom) with depth in [min_z, max_z]
+  // could pass the depth test 'func'.
+  bool reject(compare_function func,
+              size_t left,
+              size_t top,
+              size_t right,
+              size_t bottom,
+              float min_z,
+              float max_z) const;
+
+private:
+  resource::surface const* target_;
+  uint64_t target_generation_;
+  read_depth_fn read_depth_;
+
+  size_t width_;
+  size_t height_;
+  size_t tile_x_count_;
+  size_t tile_y_count_;
+  size_t subtile_x_count_;
+  size_t subtile_y_count_;
+
+  std::vector<float> tile_min_;
+  std::vector<float> tile_max_;
+  std::vector<float> subtile_min_;
+  std::vector<float> subtile_max_;
+  std::vector<uint8_t> dirty_;
+
+  void refresh_tile(size_t tile_x, size_t tile_y);
+};
+
+}  // namespace salvia::core
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <eflib/platform/stdint.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace salvia::core {
+
+// Primitives binned into tiles.
+//
+// Primitives are split into slices, each slice is a contiguous range of primitives and it is
+// binned by one thread. Bins of a slice are lists of chunks allocated from the arena of that
+// thread, so writers never share memory. Walking a tile slice by slice yields primitives in
+// drawing order, without merging or sorting.
+class primitive_bins {
+public:
+  static constexpr uint32_t CHUNK_CAPACITY = 62;
+
+  struct chunk {
+    chunk* next;
+    uint32_t count;
+    uint32_t prims[CHUNK_CAPACITY];
+  };
+
+  // Chunks are reused by the next draws, memory is only grown.
+  class chunk_arena {
+  public:
+    chunk* allocate() {
+      if (used_ == blocks_.size() * BLOCK_CHUNKS) {
+        blocks_.emplace_back(new chunk[BLOCK_CHUNKS]);
+      }
+      chunk* ret = blocks_[used_ / BLOCK_CHUNKS].get() + used_ % BLOCK_CHUNKS;
+      ++used_;
+      ret->next = nullptr;
+      ret->count = 0;
+      return ret;
+    }
+
+    void reset() { used_ = 0; }
+
+  private:
+    static constexpr size_t BLOCK_CHUNKS = 256;
+
+    std::vector<std::unique_ptr<chunk[]>> blocks_;
+    size_t used_ = 0;
+  };
+
+  struct chunk_list {
+    chunk* head;
+    chunk* tail;
+  };
+
+  // Writes bins of one slice.
+  class slice_writer {
+  public:
+    slice_writer(chunk_list* lists, chunk_arena* arena) : lists_(lists), arena_(arena) {}
+
+    void push(size_t tile_id, uint32_t prim) {
+      chunk_list& list = lists_[tile_id];
+      chunk* tail = list.tail;
+      if (tail == nullptr || tail->count == CHUNK_CAPACITY) {
+        chunk* new_tail = arena_->allocate();
+        if (tail == nullptr) {
+          list.head = new_tail;
+        } else {
+          tail->next = new_tail;
+        }
+        list.tail = tail = new_tail;
+      }
+      tail->prims[tail->count++] = prim;
+    }
+
+  private:
+    chunk_list* lists_;
+    chunk_arena* arena_;
+  };
+
+  // Arenas are released for reusing. Bins are invalid until all slices are opened.
+  void reset(size_t tile_count, size_t slice_count, size_t thread_count);
+
+  // Clears bins of the slice and returns the writer which allocates from the thread's arena.
+  slice_writer open_slice(size_t slice, size_t thread_id);
+
+  size_t slice_count() const { return slice_count_; }
+
+  // Calls fn(prim) for all primitives in the tile in drawing order.
+  template <typename Fn>
+  void for_each(size_t tile_id, Fn&& fn) const {
+    for_each(tile_id, 0, slice_count_, std::forward<Fn>(fn));
+  }
+
+  template <typename Fn>
+  void for_each(size_t tile_id, size_t slice_begin, size_t slice_end, Fn&& fn) const {
+    for (size_t slice = slice_begin; slice < slice_end; ++slice) {
+      for (chunk const* c = lists_[slice * tile_count_ + tile_id].head; c != nullptr; c = c->next) {
+        for (uint32_t i = 0; i < c->count; ++i) {
+          fn(c->prims[i]);
+        }
+      }
+    }
+  }
+
+  bool empty(size_t tile_id) const { return empty(tile_id, 0, slice_count_); }
+
+  bool empty(size_t tile_id, size_t slice_begin, size_t slice_end) const {
+    for (size_t slice = slice_begin; slice < slice_end; ++slice) {
+      if (lists_[slice * tile_count_ + tile_id].head != nullptr) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  size_t tile_count_ = 0;
+  size_t slice_count_ = 0;
+  std::vector<chunk_list> lists_;  // lists_[slice * tile_count_ + tile_id]
+  std::vector<chunk_arena> arenas_;
+};
+
+}  // namespace salvia::core
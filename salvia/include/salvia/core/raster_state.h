@@ -1,6 +1,7 @@
 #pragma once
 
 #include <salvia/common/constants.h>
+#include <salvia/common/renderer_capacity.h>
 
 #include <eflib/utility/shared_declaration.h>
 
@@ -25,6 +26,8 @@ struct raster_desc {
   bool scissor_enable;
   bool multisample_enable;
   bool anti_aliased_line_enable;
+  float point_size;        // Width of point sprites in pixels. Points of point lists are 1 pixel.
+  uint32_t subpixel_bits;  // Fraction bits of fixed-point positions, clamped to MAX_SUBPIXEL_BITS.
 
   raster_desc()
     : fm(fill_solid)
@@ -36,7 +39,9 @@ struct raster_desc {
     , depth_clip_enable(true)
     , scissor_enable(false)
     , multisample_enable(true)
-    , anti_aliased_line_enable(false) {}
+    , anti_aliased_line_enable(false)
+    , point_size(1.0f)
+    , subpixel_bits(MAX_SUBPIXEL_BITS) {}
 };
 
 EFLIB_DECLARE_CLASS_SHARED_PTR(clipper);
@@ -4,16 +4,22 @@
 
 #include <salvia/core/async_object.h>
 #include <salvia/core/decl.h>
+#include <salvia/core/edge_kernels.h>
 #include <salvia/core/framebuffer.h>
 #include <salvia/core/geom_setup_engine.h>
+#include <salvia/core/primitive_bins.h>
 #include <salvia/core/raster_state.h>
 #include <salvia/core/shader.h>
+#include <salvia/core/thread_pool.h>
+#include <salvia/core/tile_scheduler.h>
 
 #include <eflib/concurrency/atomic.h>
+#include <eflib/concurrency/thread_context.h>
 #include <eflib/memory/allocator.h>
 #include <eflib/memory/pool.h>
 
 #include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
 
@@ -30,9 +36,14 @@ struct scanline_info;
 class pixel_shader_unit;
 class host;
 struct clip_context;
-struct pixel_statistic;
 struct drawing_triangle_context;
 
+struct pixel_statistic {
+  uint64_t ps_invocations;
+  uint64_t backend_input_pixels;
+  uint64_t hiz_rejects;
+};
+
 template <typename T, int Alignment>
 using aligned_vector = std::vector<T, eflib::aligned_allocator<T, Alignment>>;
 
@@ -43,7 +54,10 @@ struct drawing_shader_context {
 };
 
 struct rasterize_multi_prim_context {
-  std::vector<uint32_t> const* sorted_prims;
+  primitive_bins const* bins;
+  size_t tile_id;
+  size_t slice_begin;
+  size_t slice_end;
   viewport const* tile_vp;
   pixel_statistic* pixel_stat;
   drawing_shader_context shaders;
@@ -56,12 +70,31 @@ struct rasterize_prim_context {
   drawing_shader_context shaders;
 };
 
+// Clipped and set up primitives of a chunk of primitives.
+struct primitive_chunk {
+  clipped_primitives prims;
+  aligned_vector<shader::triangle_info, 16> tri_infos;
+  vs_output_pool derivatives;  // ddx and ddy of tri_infos.
+  aligned_vector<fixed_edge_equations, 32> tri_edges;
+  double area;
+};
+
+// Time of stages spent by a thread.
+struct pipeline_stage_times {
+  uint64_t clipping;
+  uint64_t vp_trans;
+  uint64_t tri_setup;
+  uint64_t tri_dispatch;
+  uint64_t ras;
+};
+
 class rasterizer {
 private:
   static const int MAX_NUM_MULTI_SAMPLES = 4;
 
   // Status per drawing.
   uint32_t num_vs_output_attributes_;
+  size_t vso_size_;  // Bytes of vertexes and derivatives stored by the draw.
 
   vertex_cache* vert_cache_;
   host* host_;
@@ -74,13 +107,27 @@ private:
   cpp_blend_shader* cpp_bs_;
   viewport const* vp_;
   viewport const* target_vp_;
+  // Pixels could be drawn, which are in render target and scissor rectangle.
+  int draw_left_;
+  int draw_top_;
+  int draw_right_;
+  int draw_bottom_;
   size_t target_sample_count_;
   uint64_t full_mask_;
   uint64_t quad_full_mask_;
   shader::vs_output_op const* vso_ops_;
   bool has_centroid_;
+  uint32_t used_attributes_;  // Attributes of vs_output read by pixel shader.
+  bool hiz_enabled_;
+  bool deferred_;
   uint32_t prim_count_;
   bool prim_reorderable_;  // Primitives could be reordered to rendering.
+  // Pixel shader is bound. Without it, samples are only tested by depth and stencil.
+  bool has_pixel_shader_;
+  // Pixel shader is not bound or no color target could be written by it.
+  bool depth_only_shading_;
+  // Only depth is drawn by interpolating z, without pixel shader and blending.
+  bool depth_only_;
 
   async_object* pipeline_stat_;
   async_object* internal_stat_;
@@ -90,6 +137,7 @@ private:
   accumulate_fn<uint64_t>::type acc_cinvocations_;
   accumulate_fn<uint64_t>::type acc_cprimitives_;
   accumulate_fn<uint64_t>::type acc_ps_invocations_;
+  accumulate_fn<uint64_t>::type acc_hiz_rejects_;
   accumulate_fn<uint64_t>::type acc_backend_input_pixels_;
 
   time_stamp_fn::type fetch_time_stamp_;
@@ -97,35 +145,110 @@ private:
   accumulate_fn<uint64_t>::type acc_tri_dispatch_;
   accumulate_fn<uint64_t>::type acc_ras_;
   accumulate_fn<uint64_t>::type acc_clipping_;
-  accumulate_fn<uint64_t>::type acc_compact_clip_;
+  accumulate_fn<uint64_t>::type acc_tri_setup_;
+  accumulate_fn<uint64_t>::type acc_pipeline_thread_time_;
+  accumulate_fn<uint64_t>::type acc_load_imbalance_;
+  accumulate_fn<uint64_t>::type acc_tile_steals_;
+  accumulate_fn<uint64_t>::type acc_shader_clones_;
+  accumulate_fn<uint64_t>::type acc_vso_bytes_saved_;
+  std::array<accumulate_fn<uint64_t>::type, 4> acc_tile_size_draws_;  // 16, 32, 64, 128
 
   // Intermediate data
   prim_type prim_;
   uint32_t prim_size_;
+  bool point_sprite_;
+  float point_size_;
   eflib::vec2 samples_pattern_[MAX_NUM_MULTI_SAMPLES];
+  int32_t samples_fixed_x_[MAX_NUM_MULTI_SAMPLES];
+  int32_t samples_fixed_y_[MAX_NUM_MULTI_SAMPLES];
+  uint32_t subpixel_bits_;
+  edge_kernels const* edge_kernels_;
 
-  std::vector<std::vector<std::vector<uint32_t>>>
-      threaded_tiled_prims_;  // vector<prim> prims = thread_tiled_prims[ThreadID][TileID]
-  aligned_vector<shader::triangle_info, 16> tri_infos_;
-
-  shader::vs_output** clipped_verts_;
-  size_t clipped_verts_count_;
-  size_t clipped_prims_count_;
+  geom_setup_context gse_ctx_;
+  std::vector<std::unique_ptr<primitive_chunk>> chunks_;
+  size_t chunk_count_;
+  primitive_bins bins_;  // A slice per chunk.
 
+  int tile_size_;
   size_t tile_x_count_;
   size_t tile_y_count_;
   size_t tile_count_;
 
+  // Progress of pipeline. Chunks are set up in any order but binned in drawing order, and a tile
+  // is rasterized with chunks binned so far.
+  enum chunk_state : uint32_t { chunk_pending, chunk_set_up, chunk_binned };
+  struct tile_progress {
+    std::atomic<bool> locked;
+    std::atomic<size_t> next_chunk;
+    std::atomic<uint64_t> pending_cost;  // Estimated cost of chunks binned but not rasterized.
+  };
+
+  // Costs of tiles estimated by a thread while it bins a chunk.
+  struct bin_costs {
+    std::vector<uint64_t> costs;
+    std::vector<uint32_t> tiles;  // Tiles with non-zero costs.
+  };
+
+  // Once all chunks are binned, remaining tiles are scheduled by their costs.
+  enum schedule_state : uint32_t { schedule_none, schedule_building, schedule_ready };
+
+  // Pool and count of threads the current draw runs or is binned with.
+  std::shared_ptr<eflib::thread_pool> thread_pool_;
+  size_t num_threads_;
+  std::unique_ptr<std::atomic<uint32_t>[]> chunk_states_;
+  size_t chunk_states_capacity_ = 0;
+  std::unique_ptr<tile_progress[]> tile_progress_;
+  size_t tile_progress_capacity_ = 0;
+  std::atomic<size_t> setup_cursor_;
+  std::atomic<size_t> bin_cursor_;
+  std::atomic<size_t> binned_chunks_;
+  std::atomic<size_t> finished_tiles_;
+  std::atomic<bool> tiles_ready_;
+  // Counted up whenever work is published or a tile is released. Idle threads block on it.
+  std::atomic<uint32_t> pipeline_progress_;
+  std::vector<bin_costs> threaded_bin_costs_;
+  std::vector<framebuffer_tile> threaded_fb_tiles_;
+  std::atomic<uint32_t> schedule_state_;
+  std::vector<uint64_t> tile_costs_;
+  tile_scheduler tile_scheduler_;
+  std::vector<uint64_t> thread_end_times_;
+
   shader::shader_reflection const* vs_reflection_;
 
-  std::vector<cpp_pixel_shader*> threaded_cpp_ps_;
-  std::vector<pixel_shader_unit*> threaded_psu_;
+  std::vector<cpp_pixel_shader_ptr> threaded_cpp_ps_;
+  std::vector<pixel_shader_unit_ptr> threaded_psu_;
+  uint64_t threaded_cpp_ps_version_ = 0;
+  uint64_t threaded_psu_version_ = 0;
+  std::vector<pixel_statistic> threaded_pixel_stat_;
 
   std::function<void(rasterizer*, rasterize_multi_prim_context*)> rasterize_prims_;
   geom_setup_engine gse_;
 
-  void threaded_dispatch_primitive(eflib::thread_context const*);
-  void threaded_rasterize_multi_prim(eflib::thread_context const*);
+  void threaded_pipeline(eflib::thread_context const*);
+  bool try_setup_chunk(uint32_t thread_id, pipeline_stage_times& times);
+  bool try_bin_chunk(uint32_t thread_id, pipeline_stage_times& times, uint64_t& hiz_rejects);
+  bool try_rasterize_tile(size_t thread_id,
+                          size_t& tile_cursor,
+                          pipeline_stage_times& times,
+                          pixel_statistic* pixel_stat);
+  bool try_rasterize_scheduled_tile(size_t thread_id,
+                                    pipeline_stage_times& times,
+                                    pixel_statistic* pixel_stat);
+  bool pipeline_finished() const;
+  void signal_progress();
+  // Spins for a while then blocks, until progress is signaled after 'progress' was observed.
+  void wait_progress(uint32_t progress) const;
+  void unlock_tile(tile_progress& progress);
+
+  void setup_chunk(size_t chunk_id, uint32_t thread_id, pipeline_stage_times& times);
+  void bin_chunk(size_t chunk_id, uint32_t thread_id, uint64_t& hiz_rejects);
+  // Targets of tile are loaded to 'fb_tile' if it is not null.
+  void rasterize_tile(size_t tile_id,
+                      size_t chunk_begin,
+                      size_t chunk_end,
+                      size_t thread_id,
+                      pixel_statistic* pixel_stat,
+                      framebuffer_tile* fb_tile);
 
   void draw_full_tile(int left,
                       int top,
@@ -138,6 +261,22 @@ private:
                          const eflib::vec4* edge_factors,
                          drawing_shader_context const* shaders,
                          drawing_triangle_context const* triangle_ctx);
+  void draw_partial_tile_fixed(int left,
+                               int top,
+                               fixed_edge_equations const& edges,
+                               drawing_shader_context const* shaders,
+                               drawing_triangle_context const* triangle_ctx);
+  void draw_pixel_masks(int left,
+                        int top,
+                        uint32_t const* pixel_mask,
+                        drawing_shader_context const* shaders,
+                        drawing_triangle_context const* triangle_ctx);
+  void draw_depth_only(int left,
+                       int top,
+                       int right,
+                       int bottom,
+                       uint32_t const* pixel_masks,
+                       drawing_triangle_context const* triangle_ctx);
   void subdivide_tile(int left,
                       int top,
                       const eflib::rect<uint32_t>& cur_region,
@@ -163,10 +302,17 @@ private:
                  drawing_shader_context const* shaders,
                  drawing_triangle_context const* triangle_ctx);
 
-  void viewport_and_project_transform(shader::vs_output** vertexes, size_t num_verts);
-  void compute_triangle_info(uint32_t prim_id);
+  void draw_point_sprite(shader::vs_output const& point, rasterize_multi_prim_context const* ctx);
+
+  uint64_t clip_quad_mask(int left, int top, uint64_t quad_mask) const;
+  void compute_aa_z_offset(shader::triangle_info const* tri_info, float* aa_z_offset) const;
+  float compute_triangle_info(primitive_chunk& chunk, uint32_t i);
+  void compute_line_info(primitive_chunk& chunk, uint32_t i);
+  void update_tile_size();
 
   void prepare_draw();
+  void run_pipeline();
+  void update_threaded_shaders();
 
 public:
   // inherited
@@ -181,11 +327,28 @@ public:
   void rasterize_line(rasterize_prim_context const*);
   void rasterize_triangle(rasterize_prim_context const*);
 
+  void rasterize_multi_point(rasterize_multi_prim_context const*);
   void rasterize_multi_line(rasterize_multi_prim_context const*);
   void rasterize_multi_triangle(rasterize_multi_prim_context const*);
 
   void draw();
 
+  // Deferred drawing bins primitives only. Tiles are rasterized later by rasterize_deferred_tile()
+  // in any order of tiles, then finish_deferred() accumulates statistics and releases the draw.
+  void bin_deferred();
+  void rasterize_deferred_tile(size_t tile_x, size_t tile_y, size_t thread_id);
+  void finish_deferred();
+  // Threads the deferred draw is binned with. Thread IDs of rasterize_deferred_tile() are below the
+  // count of them.
+  pipeline_threads binned_threads() const { return pipeline_threads{thread_pool_, num_threads_}; }
+  size_t tile_x_count() const { return tile_x_count_; }
+  size_t tile_y_count() const { return tile_y_count_; }
+  // Estimated cost of rasterizing the tile, for scheduling deferred tiles.
+  uint64_t tile_cost(size_t tile_x, size_t tile_y) const;
+  int tile_size() const { return tile_size_; }
+  // Tile of the cost is drawn in tile-resident mode of framebuffer.
+  bool tile_resident(uint64_t cost) const;
+
   void update_prim_info(render_state const* state);
 };
 
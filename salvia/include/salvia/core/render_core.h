@@ -1,10 +1,16 @@
 #pragma once
 
+#include <salvia/core/framebuffer.h>
 #include <salvia/core/render_stages.h>
+#include <salvia/core/renderer.h>
 #include <salvia/core/render_state.h>
+#include <salvia/core/tile_scheduler.h>
 
 #include <eflib/utility/shared_declaration.h>
 
+#include <memory>
+#include <vector>
+
 namespace saliva::shader {
 EFLIB_DECLARE_CLASS_SHARED_PTR(shader_object);
 struct vs_input_op;
@@ -26,16 +32,34 @@ EFLIB_DECLARE_STRUCT_SHARED_PTR(render_state);
 class render_core {
 private:
 public:
-  render_core();
+  explicit render_core(vertex_cache_types vertex_cache_type = vertex_cache_post_transform);
   void update(render_state_ptr const& state);
   result execute();
 
 private:
+  // Draw binned in deferred mode. It owns stages except host, which only works at binning.
+  struct deferred_draw {
+    render_state_ptr state;
+    render_stages stages;
+  };
+
+  vertex_cache_types vertex_cache_type_;
   uint64_t batch_id_;
 
   render_stages stages_;
   render_state_ptr state_;
 
+  std::vector<std::unique_ptr<deferred_draw>> deferred_draws_;
+  std::vector<std::unique_ptr<deferred_draw>> free_deferred_draws_;
+  std::vector<uint64_t> deferred_tile_costs_;
+  tile_scheduler deferred_tile_scheduler_;
+  std::vector<framebuffer_tile> deferred_fb_tiles_;
+
+  void update_stages(render_stages const& stages, render_state* state);
+  std::unique_ptr<deferred_draw> create_deferred_draw();
+  result defer_draw();
+  void flush_deferred_draws();
+
   result draw();
   result clear_color();
   result clear_depth_stencil();
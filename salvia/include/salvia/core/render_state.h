@@ -8,6 +8,7 @@
 #include <salvia/core/stream_state.h>
 #include <salvia/core/viewport.h>
 
+#include <eflib/math/collision_detection.h>
 #include <eflib/math/vector.h>
 #include <eflib/utility/shared_declaration.h>
 
@@ -26,6 +27,7 @@ struct vs_output_op;
 namespace salvia::core {
 EFLIB_DECLARE_CLASS_SHARED_PTR(counter);
 EFLIB_DECLARE_CLASS_SHARED_PTR(depth_stencil_state);
+EFLIB_DECLARE_CLASS_SHARED_PTR(blend_state);
 EFLIB_DECLARE_CLASS_SHARED_PTR(raster_state);
 EFLIB_DECLARE_CLASS_SHARED_PTR(cpp_blend_shader);
 EFLIB_DECLARE_CLASS_SHARED_PTR(cpp_pixel_shader);
@@ -40,7 +42,8 @@ enum class command_id {
   clear_depth_stencil,
   clear_color,
   async_begin,
-  async_end
+  async_end,
+  flush
 };
 
 struct render_state {
@@ -52,11 +55,14 @@ struct render_state {
   int32_t base_vertex;
   uint32_t start_index;
   uint32_t prim_count;
+  uint32_t instance_count;
+  uint32_t start_instance;
 
   stream_state str_state;
   resource::input_layout_ptr layout;
 
   viewport vp;
+  eflib::rect<int32_t> scissor_rect;
   raster_state_ptr ras_state;
 
   int32_t stencil_ref;
@@ -65,6 +71,8 @@ struct render_state {
   cpp_vertex_shader_ptr cpp_vs;
   cpp_pixel_shader_ptr cpp_ps;
   cpp_blend_shader_ptr cpp_bs;
+  // Used if blend shader is not set.
+  blend_state_ptr bl_state;
 
   shader::shader_object_ptr vx_shader;
   shader::shader_object_ptr px_shader;
@@ -85,6 +93,9 @@ struct render_state {
   viewport target_vp;
   size_t target_sample_count;
 
+  // Draws are binned only, and rasterized with following draws at flush.
+  bool deferred;
+
   resource::surface_ptr clear_color_target;
   resource::surface_ptr clear_ds_target;
   uint32_t clear_f;
@@ -30,6 +30,16 @@ namespace salvia::core {
 EFLIB_DECLARE_CLASS_SHARED_PTR(renderer);
 EFLIB_DECLARE_CLASS_SHARED_PTR(async_object);
 
+enum vertex_cache_types {
+  // Shades unique vertexes of a draw in parallel before primitives are set up.
+  vertex_cache_precomputed,
+  // Shades vertexes on demand while primitives are set up, and reuses them by a post-transform
+  // cache of each thread.
+  vertex_cache_post_transform,
+  // Same as vertex_cache_post_transform, and a cache shared by threads is checked before shading.
+  vertex_cache_shared
+};
+
 struct renderer_parameters {
   size_t backbuffer_width;
   size_t backbuffer_height;
@@ -37,6 +47,19 @@ struct renderer_parameters {
   pixel_format backbuffer_format;
   void* native_window;
   bool shader_enabled{true};
+
+  // Threads running the pipeline, including the thread calling it. If it is 0, there is a thread
+  // for each CPU in 'thread_cpus' or of 'numa_node', or for each hardware thread.
+  size_t thread_count{0};
+  // CPUs which threads are pinned to. The first one is for the thread calling the pipeline, which
+  // is pinned by asynchronous renderers only. Threads are not pinned if it is empty.
+  std::vector<uint32_t> thread_cpus;
+  // If it is not negative, threads are pinned to CPUs of the node unless 'thread_cpus' is given,
+  // and memory is preferred from the node by workers and the rendering thread of asynchronous
+  // renderers. The thread creating the renderer is not changed.
+  int32_t numa_node{-1};
+
+  vertex_cache_types vertex_cache{vertex_cache_post_transform};
 };
 
 class renderer {
@@ -82,6 +105,8 @@ public:
   virtual result set_ps_variable(std::string const& name, void const* data, size_t sz) = 0;
   virtual result set_ps_sampler(std::string const& name, sampler_ptr const& samp) = 0;
   virtual result set_blend_shader(cpp_blend_shader_ptr const& hbs) = 0;
+  // Blend state is used if blend shader is not set, it writes colors of pixel shader by default.
+  virtual result set_blend_state(blend_state_ptr const& bs) = 0;
   virtual result set_pixel_shader(cpp_pixel_shader_ptr const& hps) = 0;
   virtual result set_pixel_shader_code(shader::shader_object_ptr const&) = 0;
   virtual result set_depth_stencil_state(depth_stencil_state_ptr const& dss,
@@ -90,6 +115,11 @@ public:
                                     surface_ptr const* color_targets,
                                     surface_ptr const& ds_target) = 0;
   virtual result set_viewport(viewport const& vp) = 0;
+  // Pixels out of the rectangle are discarded if raster_desc::scissor_enable is set. There is one
+  // viewport, so rectangles but the first are ignored.
+  virtual result set_scissor_rects(size_t rect_count, eflib::rect<int32_t> const* rects) = 0;
+  // Draws are rasterized tile by tile together at flush, instead of one by one.
+  virtual result set_deferred_rendering(bool enabled) = 0;
 
   template <typename T>
   result set_vs_variable(std::string const& name, T const* data) {
@@ -110,7 +140,9 @@ public:
   virtual cpp_pixel_shader_ptr get_pixel_shader() const = 0;
   virtual shader::shader_object_ptr get_pixel_shader_code() const = 0;
   virtual cpp_blend_shader_ptr get_blend_shader() const = 0;
+  virtual blend_state_ptr get_blend_state() const = 0;
   virtual viewport get_viewport() const = 0;
+  virtual eflib::rect<int32_t> get_scissor_rect() const = 0;
 
   // render operations
   virtual result begin(async_object_ptr const& async_obj) = 0;
@@ -120,6 +152,16 @@ public:
 
   virtual result draw(size_t startpos, size_t primcnt) = 0;
   virtual result draw_index(size_t startpos, size_t primcnt, int basevert) = 0;
+  // Primitives of all instances are drawn in one pass, instance by instance.
+  virtual result draw_instanced(size_t startpos,
+                                size_t primcnt,
+                                size_t instance_count,
+                                size_t start_instance) = 0;
+  virtual result draw_index_instanced(size_t startpos,
+                                      size_t primcnt,
+                                      int basevert,
+                                      size_t instance_count,
+                                      size_t start_instance) = 0;
 
   virtual result clear_color(surface_ptr const& color_target, color_rgba32f const& c) = 0;
   virtual result
@@ -130,8 +172,9 @@ public:
   virtual ~renderer() {}
 };
 
-renderer_ptr create_software_renderer();
-renderer_ptr create_benchmark_renderer();
+// Threads of pipeline are configured by parameters if they are given.
+renderer_ptr create_software_renderer(renderer_parameters const* params = nullptr);
+renderer_ptr create_benchmark_renderer(renderer_parameters const* params = nullptr);
 
 shader::shader_object_ptr compile(std::string const& code,
                                   shader::shader_profile const& profile,
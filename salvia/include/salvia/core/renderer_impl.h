@@ -68,9 +68,15 @@ public:
 
   result set_blend_shader(cpp_blend_shader_ptr const& hbs) override;
   [[nodiscard]] cpp_blend_shader_ptr get_blend_shader() const override;
+  result set_blend_state(blend_state_ptr const& bs) override;
+  [[nodiscard]] blend_state_ptr get_blend_state() const override;
 
   result set_viewport(viewport const& vp) override;
   [[nodiscard]] viewport get_viewport() const override;
+  result set_scissor_rects(size_t rect_count, eflib::rect<int32_t> const* rects) override;
+  [[nodiscard]] eflib::rect<int32_t> get_scissor_rect() const override;
+
+  result set_deferred_rendering(bool enabled) override;
 
   result set_render_targets(size_t color_target_count,
                             surface_ptr const* color_targets,
@@ -78,6 +84,15 @@ public:
 
   result draw(size_t startpos, size_t primcnt) override;
   result draw_index(size_t startpos, size_t primcnt, int basevert) override;
+  result draw_instanced(size_t startpos,
+                        size_t primcnt,
+                        size_t instance_count,
+                        size_t start_instance) override;
+  result draw_index_instanced(size_t startpos,
+                              size_t primcnt,
+                              int basevert,
+                              size_t instance_count,
+                              size_t start_instance) override;
   result clear_color(surface_ptr const& color_target, color_rgba32f const& c) override;
   result clear_depth_stencil(surface_ptr const& depth_stencil_target,
                              uint32_t f,
@@ -105,7 +120,7 @@ public:
   result map(mapped_resource&, surface_ptr const& buf, map_mode mm) override;
   result unmap() override;
 
-  renderer_impl();
+  explicit renderer_impl(renderer_parameters const* params = nullptr);
 
 protected:
   virtual result commit_state_and_command() = 0;
@@ -91,6 +91,7 @@ public:
       return result::failed;
     }
     *(samp_it->second) = samp;
+    constants_changed();
     return result::ok;
   }
 
@@ -100,6 +101,7 @@ public:
       return result::failed;
     }
     if (shader_constant::assign(var_it->second, pval)) {
+      constants_changed();
       return result::ok;
     }
     return result::failed;
@@ -113,6 +115,7 @@ public:
       return result::failed;
     }
     cont_it->second->set(pval, index);
+    constants_changed();
     return result::ok;
   }
 
@@ -121,6 +124,12 @@ public:
   void bind_semantic(char const* name, size_t semantic_index, size_t register_index);
   void bind_semantic(shader::semantic_value const& s, size_t register_index);
 
+  // Shaders with the same version are copies with the same constants. Versions are unique among
+  // shaders, a new one is taken when constants or samplers are set.
+  uint64_t version() const { return version_; }
+  // Must be called if constants are changed other than by set_constant() or set_sampler().
+  void constants_changed() { version_ = new_version(); }
+
   template <class T>
   result declare_constant(const std::string& varname, T& var) {
     varmap_[varname] = shader_constant::voidptr(&var);
@@ -147,6 +156,9 @@ private:
   container_variable_map contmap_;
   register_map regmap_;
   sampler_map sampmap_;
+  uint64_t version_ = new_version();
+
+  static uint64_t new_version();
 
   template <class T, class ElemType>
   result declare_container_constant_impl(const std::string& varname, T& var, const ElemType&) {
@@ -156,10 +168,19 @@ private:
   }
 };
 
+// Vertexes are shaded in batches of this size at most.
+inline constexpr size_t VS_BATCH_SIZE = 8;
+
 class cpp_vertex_shader : public cpp_shader_impl {
 public:
   void execute(const shader::vs_input& in, shader::vs_output& out);
+  void execute_batch(shader::vs_input const* ins, shader::vs_output* const* outs, size_t count);
   virtual void shader_prog(const shader::vs_input& in, shader::vs_output& out) = 0;
+  // Shades 'count' vertexes, which is at most VS_BATCH_SIZE. Shaders can override it to shade
+  // vertexes together, such as with SIMD over attributes in SoA layout. Outputs are sized by
+  // num_output_attributes(), so they are passed by addresses.
+  virtual void
+  shader_prog_batch(shader::vs_input const* ins, shader::vs_output* const* outs, size_t count);
   virtual uint32_t num_output_attributes() const = 0;
   virtual uint32_t output_attribute_modifiers(uint32_t index) const = 0;
 };
@@ -204,6 +225,9 @@ public:
 
   virtual bool shader_prog(shader::vs_output const& in, shader::ps_output& out) = 0;
   virtual bool output_depth() const;
+  // Bit i is set if attribute i of vs_output is read by shader, only these attributes are
+  // interpolated. Registers of bound semantics are used, or all attributes if none is bound.
+  virtual uint32_t input_attribute_mask();
 };
 
 // it is called when render a shaded pixel into framebuffer
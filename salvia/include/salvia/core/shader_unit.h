@@ -39,7 +39,15 @@ public:
   void set_variable(std::string const&, void const* data);
   void set_sampler(std::string const&, resource::sampler_ptr const& samp);
 
+  // Units with the same version are copies with the same constants.
+  [[nodiscard]] uint64_t version() const { return version_; }
+  // Copies constants of a unit which is a copy of this unit or of the same prototype.
+  // Returns false if units are initialized separately, and nothing is copied.
+  bool update_constants(pixel_shader_unit const& rhs);
+
   void update(shader::vs_output* inputs, shader::shader_reflection const* vs_abi);
+  // Bit i is set if attribute i of vertex shader outputs is read. Inputs are mapped as update().
+  [[nodiscard]] uint32_t input_attribute_mask(shader::shader_reflection const* vs_abi) const;
   void execute(shader::ps_output* outs, float* depths);
 
 public:
@@ -54,6 +62,10 @@ public:
 
   aligned_vector stream_odata;
   aligned_vector buffer_odata;
+
+private:
+  uint64_t layout_version_;
+  uint64_t version_;
 };
 
 EFLIB_DECLARE_CLASS_SHARED_PTR(vx_shader_unit);
@@ -64,6 +76,14 @@ public:
 
   virtual void execute(size_t i_vertex, void* out_data) = 0;
   virtual void execute(size_t i_vertex, shader::vs_output& out) = 0;
+  // Shades 'count' vertexes, which is at most VS_BATCH_SIZE. Code generator has no batched vertex
+  // entry yet, so vertexes are shaded one by one unless a unit overrides it.
+  virtual void
+  execute_batch(uint32_t const* vert_indices, size_t count, shader::vs_output* const* outs) {
+    for (size_t i = 0; i < count; ++i) {
+      execute(vert_indices[i], *outs[i]);
+    }
+  }
 
   virtual ~vx_shader_unit() = default;
 };
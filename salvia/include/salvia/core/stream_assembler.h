@@ -4,6 +4,7 @@
 
 #include <eflib/utility/shared_declaration.h>
 
+#include <limits>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
@@ -36,7 +37,13 @@ public:
 
   // Used by Cpp Vertex Shader
   void update_register_map(std::unordered_map<shader::semantic_value, size_t> const& reg_map);
-  void fetch_vertex(shader::vs_input& vertex, size_t vert_index) const;
+  void fetch_vertex(shader::vs_input& vertex, size_t vert_index, uint32_t instance_id) const;
+  void fetch_vertices(shader::vs_input* vertices,
+                      uint32_t const* vert_indices,
+                      size_t count,
+                      uint32_t instance_id) const;
+  // Vertexes are the same in all instances if they read no per-instance data or SV_InstanceID.
+  [[nodiscard]] bool instance_invariant() const;
 
   // Used by Old Shader Unit
   void const* element_address(resource::input_element_desc const&, size_t vert_index) const;
@@ -53,6 +60,12 @@ private:
     float default_wcomp;
   };
   std::vector<reg_ied_extra_t> reg_ied_extra_;
+  static constexpr size_t NO_REGISTER = std::numeric_limits<size_t>::max();
+  std::vector<reg_ied_extra_t> instance_reg_ied_extra_;
+  size_t instance_id_reg_ = NO_REGISTER;
+  uint32_t start_instance_ = 0;
+
+  void fetch_instance(shader::vs_input* vertices, size_t count, uint32_t instance_id) const;
 
   // Used by new shader unit
   std::vector<stream_desc> stream_descs_;
@@ -24,9 +24,9 @@ class sync_renderer : public renderer_impl {
 public:
   result flush() override;
   result commit_state_and_command() override;
-  sync_renderer();
+  explicit sync_renderer(renderer_parameters const* params = nullptr);
 };
 
-renderer_ptr create_sync_renderer();
+renderer_ptr create_sync_renderer(renderer_parameters const* params = nullptr);
 
 }  // namespace salvia::core
\ No newline at end of file
@@ -3,8 +3,31 @@
 #include <eflib/platform/config.h>
 #include <eflib/concurrency/thread_pool/threadpool.h>
 
+#include <memory>
+
 namespace salvia::core {
 
-eflib::thread_pool& global_thread_pool();
+struct renderer_parameters;
+
+// Pool and thread count of pipeline threads, taken together so they always match. Pool is kept
+// alive by the snapshot, e.g. while 'execute_threads(*threads.pool, ...)' runs, even if pipeline
+// threads are reconfigured.
+struct pipeline_threads {
+  std::shared_ptr<eflib::thread_pool> pool;
+  // Threads which run the pipeline, including the thread calling it.
+  size_t count = 1;
+};
+
+pipeline_threads current_pipeline_threads();
+
+// Applies thread count, CPUs and NUMA node of parameters to pipeline threads. Workers of the global
+// thread pool are re-created in a new pool if they are changed. Draws of other renderers finish on
+// the pool they started with, which is released after them.
+void configure_pipeline_threads(renderer_parameters const& params);
+
+// Pins the calling thread to the CPU reserved for the thread calling the pipeline, and prefers
+// memory of the NUMA node of pipeline threads. Renderers call it before each command on the thread
+// running the pipeline; it does nothing if the thread is pinned by the current configuration.
+void pin_pipeline_calling_thread();
 
 }
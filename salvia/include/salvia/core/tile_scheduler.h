@@ -0,0 +1,45 @@
+#pragma once
+
+#include <eflib/platform/stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace salvia::core {
+
+// Schedules tiles to threads by estimated costs.
+//
+// Tiles are assigned in descending order of cost, each to the thread with the least cost so far,
+// so expensive tiles are started first and threads get similar loads. A thread takes tiles from
+// the front of its own queue. Once its queue is empty, it steals the cheapest tiles from the back
+// of the longest queue of other threads.
+class tile_scheduler {
+public:
+  // Must not overlap with pop().
+  void reset(uint64_t const* tile_costs, size_t tile_count, size_t thread_count);
+
+  // Returns false if all tiles have been taken.
+  bool pop(size_t thread_id, size_t& tile_id);
+
+  uint64_t steal_count() const { return steal_count_.load(std::memory_order_relaxed); }
+
+private:
+  // Begin and end of a queue in 'tiles_' are packed, so the owner and thieves update them with
+  // one CAS and never take the same tile.
+  static uint64_t pack_range(uint32_t begin, uint32_t end) { return uint64_t(end) << 32 | begin; }
+  static uint32_t range_begin(uint64_t range) { return static_cast<uint32_t>(range); }
+  static uint32_t range_end(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+
+  std::vector<uint32_t> tiles_;  // Queues of threads in order of thread.
+  std::vector<uint32_t> sorted_tiles_;
+  std::vector<uint32_t> tile_threads_;
+  std::vector<std::pair<uint64_t, uint32_t>> thread_loads_;
+  std::unique_ptr<std::atomic<uint64_t>[]> queues_;
+  size_t queue_capacity_ = 0;
+  size_t thread_count_ = 0;
+  std::atomic<uint64_t> steal_count_{0};
+};
+
+}  // namespace salvia::core
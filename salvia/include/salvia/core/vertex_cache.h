@@ -3,6 +3,7 @@
 #include <salvia/core/decl.h>
 #include <salvia/core/index_fetcher.h>
 #include <salvia/core/renderer.h>
+#include <salvia/core/thread_pool.h>
 
 #include <eflib/concurrency/atomic.h>
 
@@ -26,13 +27,15 @@ public:
   virtual void initialize(render_stages const* stages) = 0;
   virtual void update(render_state const* state) = 0;
 
-  virtual void prepare_vertices() = 0;
+  // Shades vertexes of the draw by the threads. Only these threads fetch primitives of the draw.
+  virtual void prepare_vertices(pipeline_threads const& threads) = 0;
+  // Fetches shaded vertexes of a primitive, 2 for lines and 3 for triangles.
   virtual void fetch3(shader::vs_output** v, cache_entry_index id, uint32_t thread_id) = 0;
   virtual void update_statistic() = 0;
 
   virtual ~vertex_cache() {}
 };
 
-vertex_cache_ptr create_default_vertex_cache();
+vertex_cache_ptr create_default_vertex_cache(vertex_cache_types type = vertex_cache_post_transform);
 
 }  // namespace salvia::core
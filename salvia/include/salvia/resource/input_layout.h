@@ -11,10 +11,10 @@
 namespace salvia::resource {
 
 enum input_classifications {
-  input_per_vertex
-
-  // TODO:
-  // input_per_instance
+  input_per_vertex,
+  // Data of instance 'start_instance + instance_id / instance_data_step_rate' is fetched for all
+  // vertexes of the instance. Data of 'start_instance' is used by all instances if step rate is 0.
+  input_per_instance
 };
 
 struct input_element_desc {
@@ -6,6 +6,7 @@
 
 #include <eflib/math/collision_detection.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -49,8 +50,16 @@ public:
 
   pixel_format get_pixel_format() const { return format_; }
 
+  // Generation changes when texels are written out of framebuffers, i.e. by set_texel, fill,
+  // clear, map for writing, resolve and mark_written. Surfaces are numbered in high 32 bits, so generations of
+  // different surfaces never match, even if a surface reuses the address of a freed one.
+  uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+  // Texels of pending clears are not filled by texel_address(). Expand clears of texels first.
   void* texel_address(size_t x, size_t y, size_t sample);
   void const* texel_address(size_t x, size_t y, size_t sample) const;
+  // Caller has written texels by texel_address() out of framebuffers.
+  void mark_written() { new_generation(); }
 
   color_rgba32f get_texel(size_t x, size_t y, size_t sample) const;
   color_rgba32f
@@ -63,6 +72,28 @@ public:
   void fill(size_t sx, size_t sy, size_t width, size_t height, const color_rgba32f& color);
   void fill(color_rgba32f const& color);
 
+  // Fast clear. Clears are recorded per CLEAR_TILE_SIZE tile, and a tile is filled by the texel of
+  // clear only when its texels are accessed. Tiles could be expanded by many threads at a time.
+  static constexpr size_t CLEAR_TILE_SIZE = 16;
+
+  void clear(color_rgba32f const& color);
+  void clear(void const* texel);
+
+  // Texel of clear if all tiles overlapped by the rect are pending, otherwise null.
+  void const* pending_clear(size_t x, size_t y, size_t width, size_t height) const;
+
+  // Fills tiles overlapped by the rect if they are pending.
+  void expand_clears(size_t x, size_t y, size_t width, size_t height) const {
+    if (pending_clears_.load(std::memory_order_acquire) != 0) {
+      expand_pending_clears(x, y, width, height);
+    }
+  }
+  void expand_clears() const { expand_clears(0, 0, size_[0], size_[1]); }
+
+  // Caller has written all texels of tiles in the rect, so pending clears of them are dropped.
+  // Tiles must not be accessed by other threads.
+  void discard_clears(size_t x, size_t y, size_t width, size_t height);
+
 private:
   size_t elem_size_;
   size_t sample_count_;
@@ -70,6 +101,14 @@ private:
   pixel_format format_;
   std::vector<uint8_t, eflib::aligned_allocator<uint8_t, 16>> data_;
 
+  size_t clear_tile_x_count_;
+  std::unique_ptr<std::atomic<uint8_t>[]> clear_states_;
+  mutable std::atomic<size_t> pending_clears_;
+  uint8_t clear_texel_[sizeof(color_rgba32f)];
+
+  std::atomic<uint64_t> generation_;
+  void new_generation() { generation_.fetch_add(1, std::memory_order_release); }
+
 #if SALVIA_TILED_SURFACE
   size_t tile_width_;
   size_t tile_height_;
@@ -78,6 +117,9 @@ private:
 
   size_t texel_offset(size_t x, size_t y, size_t sample) const;
 
+  void fill_texels(size_t sx, size_t sy, size_t width, size_t height, void const* texel);
+  void expand_pending_clears(size_t x, size_t y, size_t width, size_t height) const;
+
 #if SALVIA_TILED_SURFACE
   void tile(internal_mapped_resource const& mapped);
   void untile(internal_mapped_resource& mapped);
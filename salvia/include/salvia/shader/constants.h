@@ -33,6 +33,8 @@ enum system_values {
   sv_target,
   sv_depth,
 
+  sv_instance_id,
+
   sv_customized
 };
 
@@ -72,6 +74,8 @@ public:
       sv = sv_blend_weights;
     } else if (lower_name == "psize") {
       sv = sv_psize;
+    } else if (lower_name == "sv_instanceid") {
+      sv = sv_instance_id;
     } else {
       sv = sv_customized;
       this->name = lower_name;
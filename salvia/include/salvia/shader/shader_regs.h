@@ -77,6 +77,12 @@ public:
 
   vs_output() {}
 
+  // Bytes of a vertex which has 'attr_count' attributes. Vertexes of a draw are stored with this
+  // size, so they could only be accessed by vs_output_op of the same attribute count.
+  static constexpr size_t size_of(size_t attr_count) {
+    return sizeof(eflib::vec4) * (attr_count + 1);
+  }
+
 private:
   typedef std::array<eflib::vec4, MAX_VS_OUTPUT_ATTRS + 1> register_array;
   register_array registers_;
@@ -93,14 +99,12 @@ private:
 struct triangle_info {
   vs_output const* v0;
   bool front_face;
+  float depth_range[2];  // Min and max depth of vertexes.
   EFLIB_ALIGN(16) eflib::vec4 bounding_box;
   EFLIB_ALIGN(16) eflib::vec4 edge_factors[3];
-  vs_output ddx;
-  vs_output ddy;
-
-  triangle_info() {}
-  triangle_info(triangle_info const& /*rhs*/) {}
-  triangle_info& operator=(triangle_info const& /*rhs*/) { return *this; }
+  // Derivatives are sized by vertexes, and owned by the primitive chunk.
+  vs_output* ddx;
+  vs_output* ddy;
 };
 
 #if defined(EFLIB_MSVC)
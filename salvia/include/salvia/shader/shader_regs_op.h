@@ -35,8 +35,14 @@ typedef vs_output& (*sub)(vs_output& out, const vs_output& vso0, const vs_output
 typedef vs_output& (*mul)(vs_output& out, const vs_output& vso0, float f);
 typedef vs_output& (*div)(vs_output& out, const vs_output& vso0, float f);
 
-typedef void (*compute_derivative)(
-    vs_output& ddx, vs_output& ddy, vs_output const& e01, vs_output const& e02, float inv_area);
+// Attributes which are not in 'used_attributes' are neither computed nor interpolated by the
+// functions taking it, they are left undefined. Bit i is for attribute i.
+typedef void (*compute_derivative)(vs_output& ddx,
+                                   vs_output& ddy,
+                                   vs_output const& e01,
+                                   vs_output const& e02,
+                                   float inv_area,
+                                   uint32_t used_attributes);
 
 typedef vs_output& (*lerp)(vs_output& out,
                            const vs_output& start,
@@ -54,6 +60,20 @@ typedef vs_output& (*step_2d_unproj_quad)(vs_output* out,
                                           vs_output const& derivation0,
                                           float step1,
                                           vs_output const& derivation1);
+typedef vs_output& (*step_2d_unproj_attr)(vs_output& out,
+                                          vs_output const& start,
+                                          float step0,
+                                          vs_output const& derivation0,
+                                          float step1,
+                                          vs_output const& derivation1,
+                                          uint32_t used_attributes);
+typedef vs_output& (*step_2d_unproj_attr_quad)(vs_output* out,
+                                               vs_output const& start,
+                                               float step0,
+                                               vs_output const& derivation0,
+                                               float step1,
+                                               vs_output const& derivation1,
+                                               uint32_t used_attributes);
 }  // namespace vs_output_functions
 
 struct vs_output_op {
@@ -70,9 +90,9 @@ struct vs_output_op {
 
   vs_output_functions::lerp lerp;
   vs_output_functions::step_2d_unproj step_2d_unproj_pos;
-  vs_output_functions::step_2d_unproj step_2d_unproj_attr;
+  vs_output_functions::step_2d_unproj_attr step_2d_unproj_attr;
   vs_output_functions::step_2d_unproj_quad step_2d_unproj_pos_quad;
-  vs_output_functions::step_2d_unproj_quad step_2d_unproj_attr_quad;
+  vs_output_functions::step_2d_unproj_attr_quad step_2d_unproj_attr_quad;
 
   vs_output_functions::compute_derivative compute_derivative;
 
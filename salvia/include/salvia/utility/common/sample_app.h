@@ -59,6 +59,8 @@ public:
 
   std::optional<bool> is_sync_renderer;
   salvia::ext::swap_chain_types sc_type;
+  size_t thread_count;
+  int32_t numa_node;
 
   salvia::utility::gui* gui;
   salvia::core::renderer_ptr renderer;
@@ -3,6 +3,7 @@
 #include <eflib/memory/bounded_buffer.h>
 #include <salvia/core/render_core.h>
 #include <salvia/core/renderer_impl.h>
+#include <salvia/core/thread_pool.h>
 
 #include <atomic>
 #include <memory>
@@ -18,8 +19,9 @@ static const uint32_t ASYNC_RENDER_QUEUE_SIZE = 32;
 
 class async_renderer : public renderer_impl {
 public:
-  async_renderer()
-    : state_queue_(ASYNC_RENDER_QUEUE_SIZE)
+  explicit async_renderer(renderer_parameters const* params)
+    : renderer_impl(params)
+    , state_queue_(ASYNC_RENDER_QUEUE_SIZE)
     , state_pool_(ASYNC_RENDER_QUEUE_SIZE)
     , waiting_exit_(false) {
     for (auto& state : state_pool_) {
@@ -30,6 +32,9 @@ public:
   ~async_renderer() override { release(); }
 
   result flush() override {
+    state_->cmd = command_id::flush;
+    commit_state_and_command();
+
     while (object_count_in_pool() != MAX_COMMAND_QUEUE) {
       std::this_thread::yield();
     }
@@ -88,6 +93,8 @@ private:
       state_queue_.pop_back(&rendering_state);
 
       if (rendering_state) {
+        // Pipeline threads may be reconfigured by other renderers since the last command.
+        pin_pipeline_calling_thread();
         core_.update(rendering_state);
         core_.execute();
         free_render_state(rendering_state);
@@ -103,8 +110,11 @@ private:
   std::atomic<bool> waiting_exit_;
 };
 
-renderer_ptr create_async_renderer() {
-  auto ret = std::make_shared<async_renderer>();
+renderer_ptr create_async_renderer(renderer_parameters const* params) {
+  if (params) {
+    configure_pipeline_threads(*params);
+  }
+  auto ret = std::make_shared<async_renderer>(params);
   ret->run();
   return ret;
 }
@@ -0,0 +1,244 @@
+#include <salvia/core/blend_kernels.h>
+
+#include <eflib/platform/intrin.h>
+
+#include <cstring>
+
+namespace salvia::core {
+
+namespace {
+enum class blend_mode { write, alpha, premultiplied_alpha, additive, generic };
+
+// Texels are converted to colors in registers as surfaces convert them.
+template <typename Color>
+struct texel_io {
+  static __m128 load(void const* texel) {
+    color_rgba32f const c = static_cast<Color const*>(texel)->to_rgba32f();
+    return _mm_loadu_ps(&c.r);
+  }
+
+  static void store(void* texel, __m128 v) {
+    color_rgba32f c;
+    _mm_storeu_ps(&c.r, v);
+    *static_cast<Color*>(texel) = c;
+  }
+};
+
+template <>
+struct texel_io<color_rgba32f> {
+  static __m128 load(void const* texel) { return _mm_loadu_ps(static_cast<float const*>(texel)); }
+  static void store(void* texel, __m128 v) { _mm_storeu_ps(static_cast<float*>(texel), v); }
+};
+
+// Channels of 8-bit unorm texel in memory order.
+__m128 load_unorm8(void const* texel) {
+  int32_t packed;
+  memcpy(&packed, texel, sizeof(packed));
+  __m128i const zero = _mm_setzero_si128();
+  __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+  v = _mm_unpacklo_epi16(v, zero);
+  return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 255));
+}
+
+void store_unorm8(void* texel, __m128 v) {
+  __m128 const f255 = _mm_set1_ps(255.0f);
+  v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, f255), _mm_setzero_ps()), f255);
+  __m128i i = _mm_cvtps_epi32(v);
+  i = _mm_packs_epi32(i, i);
+  i = _mm_packus_epi16(i, i);
+  int32_t const packed = _mm_cvtsi128_si32(i);
+  memcpy(texel, &packed, sizeof(packed));
+}
+
+template <>
+struct texel_io<color_rgba8> {
+  static __m128 load(void const* texel) { return load_unorm8(texel); }
+  static void store(void* texel, __m128 v) { store_unorm8(texel, v); }
+};
+
+template <>
+struct texel_io<color_bgra8> {
+  static __m128 load(void const* texel) {
+    __m128 const bgra = load_unorm8(texel);
+    return _mm_shuffle_ps(bgra, bgra, _MM_SHUFFLE(3, 0, 1, 2));
+  }
+  static void store(void* texel, __m128 v) {
+    store_unorm8(texel, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2)));
+  }
+};
+
+__m128 splat_alpha(__m128 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+__m128 blend_factor_value(blend_factor factor, __m128 src, __m128 dest) {
+  __m128 const one = _mm_set1_ps(1.0f);
+  switch (factor) {
+  case blend_factor_zero: return _mm_setzero_ps();
+  case blend_factor_one: return one;
+  case blend_factor_src_color: return src;
+  case blend_factor_inv_src_color: return _mm_sub_ps(one, src);
+  case blend_factor_src_alpha: return splat_alpha(src);
+  case blend_factor_inv_src_alpha: return _mm_sub_ps(one, splat_alpha(src));
+  case blend_factor_dest_alpha: return splat_alpha(dest);
+  case blend_factor_inv_dest_alpha: return _mm_sub_ps(one, splat_alpha(dest));
+  case blend_factor_dest_color: return dest;
+  case blend_factor_inv_dest_color: return _mm_sub_ps(one, dest);
+  }
+  return one;
+}
+
+// Factors are not applied to min and max, as D3D.
+__m128 blend_operation(
+    blend_op op, blend_factor src_factor, blend_factor dest_factor, __m128 src, __m128 dest) {
+  switch (op) {
+  case blend_op_min: return _mm_min_ps(src, dest);
+  case blend_op_max: return _mm_max_ps(src, dest);
+  default: break;
+  }
+
+  __m128 const s = _mm_mul_ps(src, blend_factor_value(src_factor, src, dest));
+  __m128 const d = _mm_mul_ps(dest, blend_factor_value(dest_factor, src, dest));
+  switch (op) {
+  case blend_op_subtract: return _mm_sub_ps(s, d);
+  case blend_op_rev_subtract: return _mm_sub_ps(d, s);
+  default: return _mm_add_ps(s, d);
+  }
+}
+
+// All ones in lanes of channels in 'write_mask'.
+__m128 write_lanes(uint32_t write_mask) {
+  return _mm_castsi128_ps(_mm_set_epi32((write_mask & color_write_alpha) ? -1 : 0,
+                                        (write_mask & color_write_blue) ? -1 : 0,
+                                        (write_mask & color_write_green) ? -1 : 0,
+                                        (write_mask & color_write_red) ? -1 : 0));
+}
+
+template <blend_mode Mode>
+__m128 blend(__m128 src, __m128 dest, render_target_blend_desc const* desc) {
+  if constexpr (Mode == blend_mode::write) {
+    return src;
+  } else if constexpr (Mode == blend_mode::alpha) {
+    return _mm_add_ps(dest, _mm_mul_ps(_mm_sub_ps(src, dest), splat_alpha(src)));
+  } else if constexpr (Mode == blend_mode::premultiplied_alpha) {
+    return _mm_add_ps(src, _mm_mul_ps(dest, _mm_sub_ps(_mm_set1_ps(1.0f), splat_alpha(src))));
+  } else if constexpr (Mode == blend_mode::additive) {
+    return _mm_add_ps(src, dest);
+  } else {
+    if (!desc->blend_enable) {
+      return src;
+    }
+    __m128 const color =
+        blend_operation(desc->color_op, desc->src_blend, desc->dest_blend, src, dest);
+    __m128 const alpha =
+        blend_operation(desc->alpha_op, desc->src_blend_alpha, desc->dest_blend_alpha, src, dest);
+    __m128 const alpha_lane = write_lanes(color_write_alpha);
+    return _mm_or_ps(_mm_and_ps(alpha_lane, alpha), _mm_andnot_ps(alpha_lane, color));
+  }
+}
+
+template <typename Color, blend_mode Mode>
+void blend_quad(void* const* rows,
+                uint32_t sample_count,
+                uint64_t quad_mask,
+                eflib::vec4 const* colors,
+                render_target_blend_desc const* desc) {
+  size_t const pixel_size = sizeof(Color) * sample_count;
+  __m128 const lanes =
+      Mode == blend_mode::generic ? write_lanes(desc->render_target_write_mask) : _mm_setzero_ps();
+
+  for (int i = 0; i < 4; ++i) {
+    uint32_t px_mask = static_cast<uint32_t>(quad_mask >> (MAX_SAMPLE_COUNT * i)) & SAMPLE_MASK;
+    if (px_mask == 0) {
+      continue;
+    }
+
+    uint8_t* pixel = static_cast<uint8_t*>(rows[i >> 1]) + (i & 1) * pixel_size;
+    __m128 const src = _mm_loadu_ps(&colors[i][0]);
+
+    uint32_t i_samp;
+    if constexpr (Mode == blend_mode::write) {
+      // Texel is converted once for all samples.
+      Color texel;
+      texel_io<Color>::store(&texel, src);
+      while (_xmm_bsf(&i_samp, px_mask)) {
+        memcpy(pixel + i_samp * sizeof(Color), &texel, sizeof(Color));
+        px_mask &= px_mask - 1;
+      }
+    } else {
+      while (_xmm_bsf(&i_samp, px_mask)) {
+        void* texel = pixel + i_samp * sizeof(Color);
+        __m128 const dest = texel_io<Color>::load(texel);
+        __m128 result = blend<Mode>(src, dest, desc);
+        if constexpr (Mode == blend_mode::generic) {
+          result = _mm_or_ps(_mm_and_ps(lanes, result), _mm_andnot_ps(lanes, dest));
+        }
+        texel_io<Color>::store(texel, result);
+        px_mask &= px_mask - 1;
+      }
+    }
+  }
+}
+
+blend_mode classify_blend(render_target_blend_desc const& desc) {
+  if (desc.render_target_write_mask != color_write_all) {
+    return blend_mode::generic;
+  }
+  if (!desc.blend_enable) {
+    return blend_mode::write;
+  }
+  if (desc.color_op != blend_op_add || desc.alpha_op != blend_op_add) {
+    return blend_mode::generic;
+  }
+
+  auto const factors_are = [&desc](blend_factor src, blend_factor dest) {
+    return desc.src_blend == src && desc.dest_blend == dest && desc.src_blend_alpha == src &&
+        desc.dest_blend_alpha == dest;
+  };
+  if (factors_are(blend_factor_one, blend_factor_zero)) {
+    return blend_mode::write;
+  }
+  if (factors_are(blend_factor_src_alpha, blend_factor_inv_src_alpha)) {
+    return blend_mode::alpha;
+  }
+  if (factors_are(blend_factor_one, blend_factor_inv_src_alpha)) {
+    return blend_mode::premultiplied_alpha;
+  }
+  if (factors_are(blend_factor_one, blend_factor_one)) {
+    return blend_mode::additive;
+  }
+  return blend_mode::generic;
+}
+
+template <typename Color>
+blend_quad_fn blend_quad_kernel(blend_mode mode) {
+  switch (mode) {
+  case blend_mode::write: return blend_quad<Color, blend_mode::write>;
+  case blend_mode::alpha: return blend_quad<Color, blend_mode::alpha>;
+  case blend_mode::premultiplied_alpha: return blend_quad<Color, blend_mode::premultiplied_alpha>;
+  case blend_mode::additive: return blend_quad<Color, blend_mode::additive>;
+  case blend_mode::generic: break;
+  }
+  return blend_quad<Color, blend_mode::generic>;
+}
+}  // namespace
+
+blend_quad_fn select_blend_quad_kernel(pixel_format fmt, render_target_blend_desc const& desc) {
+  if ((desc.render_target_write_mask & color_write_all) == 0) {
+    return nullptr;
+  }
+
+  blend_mode const mode = classify_blend(desc);
+  switch (fmt) {
+  case pixel_format_color_rgba32f: return blend_quad_kernel<color_rgba32f>(mode);
+  case pixel_format_color_rgba8: return blend_quad_kernel<color_rgba8>(mode);
+  case pixel_format_color_bgra8: return blend_quad_kernel<color_bgra8>(mode);
+  case pixel_format_color_rgb32f: return blend_quad<color_rgb32f, blend_mode::generic>;
+  case pixel_format_color_r32f: return blend_quad<color_r32f, blend_mode::generic>;
+  case pixel_format_color_rg32f: return blend_quad<color_rg32f, blend_mode::generic>;
+  case pixel_format_color_r32i: return blend_quad<color_r32i, blend_mode::generic>;
+  default: return nullptr;
+  }
+}
+
+}  // namespace salvia::core
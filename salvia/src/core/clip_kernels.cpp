@@ -0,0 +1,67 @@
+#include <salvia/core/clip_kernels.h>
+
+#include <eflib/platform/cpuinfo.h>
+
+namespace salvia::core {
+
+// Projected area of a triangle is -D / (w0 * w1 * w2), where D is the determinant of rows
+// (x, y, w) of vertexes. Inside triangles have positive w, so facing is decided without division.
+void classify_triangles_generic(triangle_batch const& batch,
+                                uint32_t count,
+                                bool cull_front,
+                                bool cull_back,
+                                triangle_batch_masks& masks) {
+  masks.rejected = 0;
+  masks.inside = 0;
+  masks.front = 0;
+
+  for (uint32_t t = 0; t < count; ++t) {
+    uint32_t out_all = 0x3F;
+    bool in_depth = true;
+    for (int i = 0; i < 3; ++i) {
+      float const x = batch.x[i][t];
+      float const y = batch.y[i][t];
+      float const z = batch.z[i][t];
+      float const w = batch.w[i][t];
+      uint32_t const out = (x < -w ? 0x01 : 0) | (x > w ? 0x02 : 0) | (y < -w ? 0x04 : 0) |
+          (y > w ? 0x08 : 0) | (z < 0.0f ? 0x10 : 0) | (z > w ? 0x20 : 0);
+      out_all &= out;
+      in_depth &= (z >= 0.0f && z <= w && w > 0.0f);
+    }
+
+    uint32_t const bit = 1U << t;
+    if (out_all != 0) {
+      masks.rejected |= bit;
+      continue;
+    }
+    if (!in_depth) {
+      continue;
+    }
+
+    float const x0 = batch.x[0][t], y0 = batch.y[0][t], w0 = batch.w[0][t];
+    float const x1 = batch.x[1][t], y1 = batch.y[1][t], w1 = batch.w[1][t];
+    float const x2 = batch.x[2][t], y2 = batch.y[2][t], w2 = batch.w[2][t];
+    float const det = x0 * (y1 * w2 - w1 * y2) - y0 * (x1 * w2 - w1 * x2) + w0 * (x1 * y2 - y1 * x2);
+
+    bool const front = det < 0.0f;
+    if (det == 0.0f || (front ? cull_front : cull_back)) {
+      masks.rejected |= bit;
+      continue;
+    }
+    masks.inside |= bit;
+    masks.front |= front ? bit : 0;
+  }
+}
+
+classify_triangles_fn select_classify_triangles_kernel() {
+#if defined(EFLIB_CPU_X64)
+  static classify_triangles_fn const kernel = eflib::support_feature(eflib::cpu_avx2)
+      ? &classify_triangles_avx2
+      : &classify_triangles_generic;
+  return kernel;
+#else
+  return &classify_triangles_generic;
+#endif
+}
+
+}  // namespace salvia::core
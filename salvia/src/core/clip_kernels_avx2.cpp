@@ -0,0 +1,74 @@
+// This file is compiled with AVX2 enabled. Kernels are only called if CPU supports AVX2.
+
+#include <salvia/core/clip_kernels.h>
+
+#include <simde/x86/avx2.h>
+
+namespace salvia::core {
+
+// Same as the generic kernel with a triangle per lane.
+void classify_triangles_avx2(triangle_batch const& batch,
+                             uint32_t count,
+                             bool cull_front,
+                             bool cull_back,
+                             triangle_batch_masks& masks) {
+  __m256 const zero = _mm256_setzero_ps();
+  __m256 const sign = _mm256_set1_ps(-0.0f);
+
+  __m256 out_all[6];
+  for (__m256& out : out_all) {
+    out = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  }
+  __m256 in_depth = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+  __m256 x[3], y[3], w[3];
+  for (int i = 0; i < 3; ++i) {
+    x[i] = _mm256_load_ps(batch.x[i]);
+    y[i] = _mm256_load_ps(batch.y[i]);
+    w[i] = _mm256_load_ps(batch.w[i]);
+    __m256 const z = _mm256_load_ps(batch.z[i]);
+    __m256 const neg_w = _mm256_xor_ps(w[i], sign);
+
+    out_all[0] = _mm256_and_ps(out_all[0], _mm256_cmp_ps(x[i], neg_w, _CMP_LT_OQ));
+    out_all[1] = _mm256_and_ps(out_all[1], _mm256_cmp_ps(x[i], w[i], _CMP_GT_OQ));
+    out_all[2] = _mm256_and_ps(out_all[2], _mm256_cmp_ps(y[i], neg_w, _CMP_LT_OQ));
+    out_all[3] = _mm256_and_ps(out_all[3], _mm256_cmp_ps(y[i], w[i], _CMP_GT_OQ));
+    out_all[4] = _mm256_and_ps(out_all[4], _mm256_cmp_ps(z, zero, _CMP_LT_OQ));
+    out_all[5] = _mm256_and_ps(out_all[5], _mm256_cmp_ps(z, w[i], _CMP_GT_OQ));
+
+    __m256 const in = _mm256_and_ps(
+        _mm256_and_ps(_mm256_cmp_ps(z, zero, _CMP_GE_OQ), _mm256_cmp_ps(z, w[i], _CMP_LE_OQ)),
+        _mm256_cmp_ps(w[i], zero, _CMP_GT_OQ));
+    in_depth = _mm256_and_ps(in_depth, in);
+  }
+
+  __m256 const out = _mm256_or_ps(_mm256_or_ps(_mm256_or_ps(out_all[0], out_all[1]),
+                                               _mm256_or_ps(out_all[2], out_all[3])),
+                                  _mm256_or_ps(out_all[4], out_all[5]));
+
+  __m256 const det = _mm256_add_ps(
+      _mm256_sub_ps(
+          _mm256_mul_ps(x[0],
+                        _mm256_sub_ps(_mm256_mul_ps(y[1], w[2]), _mm256_mul_ps(w[1], y[2]))),
+          _mm256_mul_ps(y[0],
+                        _mm256_sub_ps(_mm256_mul_ps(x[1], w[2]), _mm256_mul_ps(w[1], x[2])))),
+      _mm256_mul_ps(w[0], _mm256_sub_ps(_mm256_mul_ps(x[1], y[2]), _mm256_mul_ps(y[1], x[2]))));
+
+  uint32_t const lanes = (1U << count) - 1;
+  uint32_t const out_mask = static_cast<uint32_t>(_mm256_movemask_ps(out)) & lanes;
+  uint32_t const in_depth_mask =
+      static_cast<uint32_t>(_mm256_movemask_ps(in_depth)) & lanes & ~out_mask;
+  uint32_t const front_mask = static_cast<uint32_t>(_mm256_movemask_ps(
+      _mm256_cmp_ps(det, zero, _CMP_LT_OQ)));
+  uint32_t const zero_mask = static_cast<uint32_t>(_mm256_movemask_ps(
+      _mm256_cmp_ps(det, zero, _CMP_EQ_OQ)));
+
+  uint32_t const culled = zero_mask | (cull_front ? front_mask : 0) |
+      (cull_back ? ~front_mask & ~zero_mask : 0);
+
+  masks.rejected = out_mask | (in_depth_mask & culled);
+  masks.inside = in_depth_mask & ~culled;
+  masks.front = masks.inside & front_mask;
+}
+
+}  // namespace salvia::core
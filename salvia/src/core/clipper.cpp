@@ -31,13 +31,96 @@ void clipper::set_context(clip_context const* ctxt) {
 
   // Select clipping function
   switch (ctxt->prim) {
+  case pt_point: clip_impl_ = &clipper::clip_point; break;
+  case pt_line: clip_impl_ = &clipper::clip_line; break;
+  case pt_wireframe_tri: clip_impl_ = &clipper::clip_wireframe_triangle; break;
   case pt_solid_tri: clip_impl_ = &clipper::clip_solid_triangle; break;
   default: ef_unimplemented();
   }
 }
 
-void clipper::clip_wireframe_triangle(shader::vs_output** /*tri_verts*/,
-                                      clip_results* /*results*/) {
+void clipper::clip_point(shader::vs_output** point_vert, clip_results* results) {
+  results->is_front = true;
+  results->is_clipped = false;
+  results->num_clipped_verts = 0;
+
+  // Points are not split, a point is discarded if it is out of any plane.
+  for (size_t i_plane = 0; i_plane < planes_.size(); ++i_plane) {
+    if (dot_prod4(planes_[i_plane], point_vert[0]->position()) < 0.0f) {
+      return;
+    }
+  }
+
+  results->clipped_verts[0] = point_vert[0];
+  results->num_clipped_verts = 1;
+}
+
+void clipper::clip_line(shader::vs_output** line_verts, clip_results* results) {
+  results->is_front = true;
+
+  // Clip parametric range of line by all planes.
+  float t[2] = {0.0f, 1.0f};
+  for (size_t i_plane = 0; i_plane < planes_.size(); ++i_plane) {
+    float const d0 = dot_prod4(planes_[i_plane], line_verts[0]->position());
+    float const d1 = dot_prod4(planes_[i_plane], line_verts[1]->position());
+    if (d0 < 0.0f && d1 < 0.0f) {
+      results->num_clipped_verts = 0;
+      return;
+    }
+    if (d0 < 0.0f) {
+      t[0] = max(t[0], d0 / (d0 - d1));
+    } else if (d1 < 0.0f) {
+      t[1] = min(t[1], d0 / (d0 - d1));
+    }
+  }
+
+  if (t[0] >= t[1]) {
+    results->num_clipped_verts = 0;
+    return;
+  }
+
+  results->is_clipped = false;
+  for (int i = 0; i < 2; ++i) {
+    if (t[i] == static_cast<float>(i)) {
+      results->clipped_verts[i] = line_verts[i];
+    } else {
+      vs_output* pclipped = ctxt_.vert_pool->alloc();
+      ctxt_.vso_ops->lerp(*pclipped, *line_verts[0], *line_verts[1], t[i]);
+      results->clipped_verts[i] = pclipped;
+      results->is_clipped = true;
+    }
+  }
+  results->num_clipped_verts = 2;
+}
+
+void clipper::clip_wireframe_triangle(shader::vs_output** tri_verts, clip_results* results) {
+  // Culling is decided by the clipped polygon, then edges of triangle are clipped as lines.
+  shader::vs_output* poly_verts[5];
+  clip_results poly_results;
+  poly_results.clipped_verts = poly_verts;
+  clip_triangle_to_poly_general(tri_verts, &poly_results);
+
+  if (poly_results.num_clipped_verts < 3) {
+    results->num_clipped_verts = 0;
+    return;
+  }
+
+  results->is_front = poly_results.is_front;
+  results->num_clipped_verts = 0;
+  for (int i_edge = 0; i_edge < 3; ++i_edge) {
+    shader::vs_output* edge_verts[2] = {tri_verts[i_edge], tri_verts[(i_edge + 1) % 3]};
+    if (poly_results.num_clipped_verts == 0xFF) {
+      results->clipped_verts[results->num_clipped_verts + 0] = edge_verts[0];
+      results->clipped_verts[results->num_clipped_verts + 1] = edge_verts[1];
+      results->num_clipped_verts += 2;
+      continue;
+    }
+
+    clip_results edge_results;
+    edge_results.clipped_verts = results->clipped_verts + results->num_clipped_verts;
+    clip_line(edge_verts, &edge_results);
+    results->num_clipped_verts += edge_results.num_clipped_verts;
+  }
 }
 
 void clipper::clip_solid_triangle(shader::vs_output** tri_verts, clip_results* results) {
@@ -77,4 +77,19 @@ bool cpp_pixel_shader::output_depth() const {
   return false;
 }
 
+uint32_t cpp_pixel_shader::input_attribute_mask() {
+  auto const& regmap = get_register_map();
+  if (regmap.empty()) {
+    return ~0U;
+  }
+
+  uint32_t mask = 0;
+  for (auto const& [sv, reg] : regmap) {
+    if (sv.get_system_value() != shader::sv_position && reg < MAX_VS_OUTPUT_ATTRS) {
+      mask |= 1U << reg;
+    }
+  }
+  return mask;
+}
+
 }  // namespace salvia::core
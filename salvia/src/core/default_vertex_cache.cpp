@@ -18,7 +18,9 @@
 #include <eflib/memory/pool.h>
 #include <eflib/platform/cpuinfo.h>
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <execution>
 #include <functional>
 #include <iostream>
@@ -35,8 +37,13 @@ namespace salvia::core {
 
 const int GENERATE_INDICES_PACKAGE_SIZE = 8;
 const int TRANSFORM_VERTEX_PACKAGE_SIZE = 8;
+const int MARK_INDICES_PACKAGE_SIZE = 1024;
 
-#define USE_INDEX_RANGE 0
+// Used vertexes are marked in a bitmap of the index range if the range is at most this times of
+// index count, otherwise indices are sorted.
+const size_t MAX_BITMAP_RANGE_PER_INDEX = 4;
+// The whole index range is shaded if at least this ratio of the range is used.
+const double MIN_SHADED_RANGE_DENSITY = 0.75;
 
 class vertex_cache_impl : public vertex_cache {
 public:
@@ -45,15 +52,19 @@ public:
     , host_(nullptr)
     , prim_count_(0)
     , prim_size_(0)
+    , instance_count_(1)
+    , instance_invariant_(true)
     , cpp_vs_(nullptr)
     , pipeline_stat_(nullptr)
     , pipeline_prof_(nullptr)
     , fetch_time_stamp_(nullptr)
     , acc_ia_vertices_(nullptr)
     , acc_vs_invocations_(nullptr)
+    , acc_vs_cache_hits_(nullptr)
     , acc_gather_vtx_(nullptr)
     , acc_vtx_proc_(nullptr)
-    , thread_count_(std::thread::hardware_concurrency()) {}
+    , acc_vso_bytes_saved_(nullptr)
+    , vso_size_(sizeof(vs_output)) {}
 
   void initialize(render_stages const* stages) override {
     assembler_ = stages->assembler.get();
@@ -65,9 +76,15 @@ public:
     index_fetcher_.update(state);
     cpp_vs_ = state->cpp_vs.get();
     prim_count_ = state->prim_count;
+    instance_count_ = state->instance_count;
+    // Shader units read no instance data.
+    instance_invariant_ = instance_count_ <= 1 || !cpp_vs_ || assembler_->instance_invariant();
 
     prim_size_ = 0;
     switch (state->prim_topo) {
+    case primitive_point_list:
+    case primitive_point_sprite: prim_size_ = 1; break;
+
     case primitive_line_list:
     case primitive_line_strip: prim_size_ = 2; break;
 
@@ -86,28 +103,61 @@ public:
       acc_ia_vertices_ = &async_pipeline_statistics::accumulate<pipeline_statistic_id::ia_vertices>;
       acc_vs_invocations_ =
           &async_pipeline_statistics::accumulate<pipeline_statistic_id::vs_invocations>;
+      acc_vs_cache_hits_ =
+          &async_pipeline_statistics::accumulate<pipeline_statistic_id::vs_cache_hits>;
     } else {
       acc_ia_vertices_ = &accumulate_fn<uint64_t>::null;
       acc_vs_invocations_ = &accumulate_fn<uint64_t>::null;
+      acc_vs_cache_hits_ = &accumulate_fn<uint64_t>::null;
     }
 
     if (pipeline_prof_) {
       fetch_time_stamp_ = &async_pipeline_profiles::time_stamp;
       acc_gather_vtx_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::gather_vtx>;
       acc_vtx_proc_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::vtx_proc>;
+      acc_vso_bytes_saved_ =
+          &async_pipeline_profiles::accumulate<pipeline_profile_id::vso_bytes_saved>;
     } else {
       fetch_time_stamp_ = &time_stamp_fn::null;
       acc_gather_vtx_ = &accumulate_fn<uint64_t>::null;
       acc_vtx_proc_ = &accumulate_fn<uint64_t>::null;
+      acc_vso_bytes_saved_ = &accumulate_fn<uint64_t>::null;
     }
   }
 
 protected:
+  // Vertexes are stored with attributes written by vertex shader only. Shader unit of host is
+  // updated after vertex cache, so it is called by prepare_vertices().
+  void update_vso_size() {
+    uint32_t attr_count = 0;
+    if (cpp_vs_) {
+      attr_count = cpp_vs_->num_output_attributes();
+    } else if (host_) {
+      attr_count = static_cast<uint32_t>(host_->vs_output_attr_count());
+    }
+    vso_size_ = vs_output::size_of(attr_count);
+  }
+
+  void acc_shaded_vertices(uint64_t count) {
+    acc_vso_bytes_saved_(pipeline_prof_, count * (sizeof(vs_output) - vso_size_));
+  }
+
+  // Splits primitive of draw to the instance and the primitive of instance.
+  uint32_t split_instance(cache_entry_index& prim) const {
+    uint32_t const instance_id = static_cast<uint32_t>(prim / prim_count_);
+    prim -= cache_entry_index(instance_id) * prim_count_;
+    return instance_id;
+  }
+
   stream_assembler* assembler_;
   host* host_;
 
+  // Primitives per instance.
   uint32_t prim_count_;
   uint32_t prim_size_;
+  uint32_t instance_count_;
+  // Vertexes of the first instance are used by all instances.
+  bool instance_invariant_;
   cpp_vertex_shader* cpp_vs_;
 
   index_fetcher index_fetcher_;
@@ -119,18 +169,26 @@ protected:
 
   accumulate_fn<uint64_t>::type acc_ia_vertices_;
   accumulate_fn<uint64_t>::type acc_vs_invocations_;
+  accumulate_fn<uint64_t>::type acc_vs_cache_hits_;
   accumulate_fn<uint64_t>::type acc_gather_vtx_;
   accumulate_fn<uint64_t>::type acc_vtx_proc_;
+  accumulate_fn<uint64_t>::type acc_vso_bytes_saved_;
 
-  size_t thread_count_;
+  size_t vso_size_;
 };
 
+// Vertexes used by a draw are shaded before primitives are set up. If most vertexes of the index
+// range are used, the whole range is shaded and indices are never sorted. Otherwise only used
+// vertexes are shaded, which are found by a bitmap of the range, or by sorting indices if the range
+// is too large for a bitmap. Instances share indices and the lookup, and share vertexes too if
+// they are instance invariant.
 class precomputed_vertex_cache : public vertex_cache_impl {
 public:
-  precomputed_vertex_cache() : transformed_verts_capacity_(0) {}
+  precomputed_vertex_cache() : verts_count_(0), lookup_(vertex_lookup::range) {}
 
-  void prepare_vertices() override {
+  void prepare_vertices(pipeline_threads const& threads) override {
     uint64_t gather_vtx_start_time = fetch_time_stamp_();
+    update_vso_size();
 
     indices_.resize(prim_count_ * prim_size_);
 
@@ -139,44 +197,24 @@ public:
     max_index_ = 0;
 
     execute_threads(
-        global_thread_pool(),
+        *threads.pool,
         [this](auto ctx) { this->generate_indices(ctx); },
         prim_count_,
-        GENERATE_INDICES_PACKAGE_SIZE);
-
-    uint32_t verts_count = 0;
-
-#if !USE_INDEX_RANGE
-    // Unique indices
-    unique_indices_ = indices_;
+        GENERATE_INDICES_PACKAGE_SIZE,
+        threads.count);
 
-#  if !defined(_LIBCPP_VERSION) || defined(_LIBCPP_HAS_PARALLEL_ALGORITHMS)
-    std::sort(std::execution::par, unique_indices_.begin(), unique_indices_.end());
-#  else
-    std::sort(unique_indices_.begin(), unique_indices_.end());
-#  endif
-
-    unique_indices_.erase(std::unique(unique_indices_.begin(), unique_indices_.end()),
-                          unique_indices_.end());
-
-    verts_count = static_cast<uint32_t>(unique_indices_.size());
-    if (transformed_verts_capacity_ < unique_indices_.size()) {
-      transformed_verts_.reset(new vs_output[unique_indices_.size()]);
-      transformed_verts_capacity_ = unique_indices_.size();
-    }
-
-    used_verts_.resize(unique_indices_.back() + 1);
-#else
-    uint32_t verts_count = max_index - min_index_ + 1;
-    if (transformed_verts_capacity_ < verts_count) {
-      transformed_verts_.reset(new vs_output[verts_count]);
-      transformed_verts_capacity_ = verts_count;
-    }
-#endif
+    verts_count_ = indices_.empty() ? 0 : gather_vertices(threads);
+    size_t const verts_count = size_t(verts_count_) * (instance_invariant_ ? 1 : instance_count_);
+    transformed_verts_.clear();
+    transformed_verts_.reserve(verts_count, 16, vso_size_);
+    first_transformed_vert_ = transformed_verts_.alloc(verts_count);
 
     // Accumulate query counters.
-    acc_ia_vertices_(pipeline_stat_, prim_count_ * prim_size_);
+    uint64_t const ia_vertices = uint64_t(indices_.size()) * instance_count_;
+    acc_ia_vertices_(pipeline_stat_, ia_vertices);
     acc_vs_invocations_(pipeline_stat_, verts_count);
+    acc_vs_cache_hits_(pipeline_stat_, ia_vertices > verts_count ? ia_vertices - verts_count : 0);
+    acc_shaded_vertices(verts_count);
     acc_gather_vtx_(pipeline_prof_, fetch_time_stamp_() - gather_vtx_start_time);
 
     // Transform vertexes
@@ -186,39 +224,24 @@ public:
         cpp_vs_ ? &EF_THIS_MEM_FN(transform_vertex_cppvs) : &EF_THIS_MEM_FN(transform_vertex_vs);
 
     execute_threads(
-        global_thread_pool(),
+        *threads.pool,
         [this, transform_vertex_fn](thread_context const* thread_ctx) {
           std::invoke(transform_vertex_fn, this, thread_ctx);
         },
         verts_count,
-        TRANSFORM_VERTEX_PACKAGE_SIZE);
+        TRANSFORM_VERTEX_PACKAGE_SIZE,
+        threads.count);
 
     acc_vtx_proc_(pipeline_prof_, fetch_time_stamp_() - vtx_proc_start_time);
   }
 
   void fetch3(vs_output** v, cache_entry_index prim, uint32_t /*thread_id*/) override {
-    static vs_output null_obj;
-    uint32_t id0 = indices_[prim * 3 + 0];
-    uint32_t id1 = indices_[prim * 3 + 1];
-    uint32_t id2 = indices_[prim * 3 + 2];
-#if !USE_INDEX_RANGE
-
-#  if defined(EFLIB_DEBUG)
-    if ((id2 > used_verts_.size()) || (-1 == used_verts_[id0]) || (-1 == used_verts_[id1]) ||
-        (-1 == used_verts_[id2])) {
-      EF_ASSERT(false,
-                "The vertex could not be transformed. Maybe errors occurred on index statistics or "
-                "vertex tranformation.");
-      // return null_obj;
+    uint32_t const instance_id = split_instance(prim);
+    size_t const instance_first = instance_invariant_ ? 0 : size_t(instance_id) * verts_count_;
+    uint32_t const* ids = indices_.data() + prim * prim_size_;
+    for (uint32_t i = 0; i < prim_size_; ++i) {
+      v[i] = transformed_vert(instance_first + vertex_slot(ids[i]));
     }
-#  endif
-
-    v[0] = &transformed_verts_[used_verts_[id0]];
-    v[1] = &transformed_verts_[used_verts_[id1]];
-    v[2] = &transformed_verts_[used_verts_[id2]];
-#else
-    return transformed_verts_[id - min_index_];
-#endif
   }
 
   void update_statistic() override {
@@ -226,6 +249,75 @@ public:
   }
 
 private:
+  enum class vertex_lookup {
+    range,     // Vertex of index i is at i - min_index_.
+    used_map,  // Vertex of index i is at used_verts_[i - min_index_].
+    sorted     // Vertex of index i is at the position of i in unique_indices_.
+  };
+
+  // Decides vertexes to shade and returns the count of them.
+  uint32_t gather_vertices(pipeline_threads const& threads) {
+    uint32_t const min_index = min_index_;
+    uint64_t const range_size = uint64_t(max_index_) - min_index + 1;
+
+    if (range_size <= indices_.size() * MAX_BITMAP_RANGE_PER_INDEX) {
+      used_bits_.assign((range_size + 63) / 64, 0);
+      execute_threads(
+          *threads.pool,
+          [this](thread_context const* thread_ctx) { this->mark_used_vertices(thread_ctx); },
+          indices_.size(),
+          MARK_INDICES_PACKAGE_SIZE,
+          threads.count);
+
+      uint64_t used_count = 0;
+      for (uint64_t bits : used_bits_) {
+        used_count += std::popcount(bits);
+      }
+      if (used_count >= range_size * MIN_SHADED_RANGE_DENSITY) {
+        lookup_ = vertex_lookup::range;
+        return static_cast<uint32_t>(range_size);
+      }
+
+      // Indices are in ascending order already.
+      unique_indices_.clear();
+      for (size_t i_word = 0; i_word < used_bits_.size(); ++i_word) {
+        for (uint64_t bits = used_bits_[i_word]; bits != 0; bits &= bits - 1) {
+          unique_indices_.push_back(min_index +
+                                    static_cast<uint32_t>(i_word * 64 + std::countr_zero(bits)));
+        }
+      }
+      used_verts_.resize(range_size);
+      lookup_ = vertex_lookup::used_map;
+      return static_cast<uint32_t>(unique_indices_.size());
+    }
+
+    unique_indices_ = indices_;
+#if !defined(_LIBCPP_VERSION) || defined(_LIBCPP_HAS_PARALLEL_ALGORITHMS)
+    std::sort(std::execution::par, unique_indices_.begin(), unique_indices_.end());
+#else
+    std::sort(unique_indices_.begin(), unique_indices_.end());
+#endif
+    unique_indices_.erase(std::unique(unique_indices_.begin(), unique_indices_.end()),
+                          unique_indices_.end());
+    lookup_ = vertex_lookup::sorted;
+    return static_cast<uint32_t>(unique_indices_.size());
+  }
+
+  uint32_t vertex_index(size_t slot) const {
+    return lookup_ == vertex_lookup::range ? min_index_ + static_cast<uint32_t>(slot)
+                                           : unique_indices_[slot];
+  }
+
+  size_t vertex_slot(uint32_t index) const {
+    switch (lookup_) {
+    case vertex_lookup::range: return index - min_index_;
+    case vertex_lookup::used_map: return used_verts_[index - min_index_];
+    default:
+      return std::lower_bound(unique_indices_.begin(), unique_indices_.end(), index) -
+             unique_indices_.begin();
+    }
+  }
+
   void generate_indices(thread_context const* thread_ctx) {
     // Fetch indexes and min/max of package
     uint32_t thread_min_index = std::numeric_limits<uint32_t>::max();
@@ -261,70 +353,95 @@ private:
     } while (!max_index_.compare_exchange_weak(old_max_index, new_max_index));
   }
 
-#if !USE_INDEX_RANGE
-  void transform_vertex_cppvs(thread_context const* thread_ctx) {
+  void mark_used_vertices(thread_context const* thread_ctx) {
+    uint32_t const min_index = min_index_;
     thread_context::package_cursor current_package = thread_ctx->next_package();
     while (current_package.valid()) {
-      auto vert_range = current_package.index_range();
-      for (auto i = vert_range.first; i < vert_range.second; ++i) {
-        uint32_t id = unique_indices_[i];
-        used_verts_[id] = static_cast<int32_t>(i);
-        vs_input vertex;
-        assembler_->fetch_vertex(vertex, id);
-        cpp_vs_->execute(vertex, transformed_verts_[i]);
+      auto index_range = current_package.index_range();
+      for (size_t i = index_range.first; i < index_range.second; ++i) {
+        uint32_t const bit = indices_[i] - min_index;
+        std::atomic_ref<uint64_t>(used_bits_[bit / 64])
+            .fetch_or(uint64_t(1) << (bit % 64), std::memory_order_relaxed);
       }
       current_package = thread_ctx->next_package();
     }
   }
 
-  void transform_vertex_vs(thread_context const* thread_ctx) {
-    vx_shader_unit_ptr vsu = host_->get_vx_shader_unit();
-
-    thread_context::package_cursor current_package = thread_ctx->next_package();
-    while (current_package.valid()) {
-      auto vert_range = current_package.index_range();
-      for (auto i = vert_range.first; i < vert_range.second; ++i) {
-        uint32_t vert_index = unique_indices_[i];
-        used_verts_[vert_index] = static_cast<int32_t>(i);
-        vsu->execute(vert_index, transformed_verts_[i]);
+  // Fills indices of a batch which starts from 'first' of all instances, and returns the instance
+  // of the batch. The batch is cut at the end of the instance.
+  uint32_t batch_vertex_indices(uint32_t* ids, size_t first, size_t& count) {
+    uint32_t const instance_id = static_cast<uint32_t>(first / verts_count_);
+    size_t const slot = first - size_t(instance_id) * verts_count_;
+    count = std::min<size_t>(count, verts_count_ - slot);
+    for (size_t i = 0; i < count; ++i) {
+      ids[i] = vertex_index(slot + i);
+      if (lookup_ == vertex_lookup::used_map && instance_id == 0) {
+        used_verts_[ids[i] - min_index_] = static_cast<int32_t>(slot + i);
       }
-      current_package = thread_ctx->next_package();
     }
+    return instance_id;
   }
-#else
-  void transform_vertex_cppvs(thread_context* thread_ctx) {
+
+  vs_output* transformed_vert(size_t slot) const {
+    return advance_bytes(first_transformed_vert_, slot * vso_size_);
+  }
+
+  void batch_outputs(vs_output** outs, size_t first, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+      outs[i] = transformed_vert(first + i);
+    }
+  }
+
+  void transform_vertex_cppvs(thread_context const* thread_ctx) {
+    uint32_t ids[VS_BATCH_SIZE];
+    vs_input vertices[VS_BATCH_SIZE];
+    vs_output* outs[VS_BATCH_SIZE];
+
     thread_context::package_cursor current_package = thread_ctx->next_package();
     while (current_package.valid()) {
-      auto vert_range = current_package.item_range();
-      for (auto i = vert_range.first; i < vert_range.second; ++i) {
-        vs_input vertex;
-        assembler_->fetch_vertex(vertex, i + min_index_);
-        cpp_vs_->execute(vertex, transformed_verts_[i]);
+      auto vert_range = current_package.index_range();
+      for (auto i = vert_range.first; i < vert_range.second;) {
+        size_t count = std::min<size_t>(VS_BATCH_SIZE, vert_range.second - i);
+        uint32_t const instance_id = batch_vertex_indices(ids, i, count);
+        assembler_->fetch_vertices(vertices, ids, count, instance_id);
+        batch_outputs(outs, i, count);
+        cpp_vs_->execute_batch(vertices, outs, count);
+        i += count;
       }
       current_package = thread_ctx->next_package();
     }
   }
 
-  void transform_vertex_vs(thread_context* thread_ctx) {
+  void transform_vertex_vs(thread_context const* thread_ctx) {
     vx_shader_unit_ptr vsu = host_->get_vx_shader_unit();
+    uint32_t ids[VS_BATCH_SIZE];
+    vs_output* outs[VS_BATCH_SIZE];
+
     thread_context::package_cursor current_package = thread_ctx->next_package();
     while (current_package.valid()) {
-      auto vert_range = current_package.item_range();
-      for (auto i = vert_range.first; i < vert_range.second; ++i) {
-        vsu->execute(i + min_index_, transformed_verts_[i]);
+      auto vert_range = current_package.index_range();
+      for (auto i = vert_range.first; i < vert_range.second;) {
+        size_t count = std::min<size_t>(VS_BATCH_SIZE, vert_range.second - i);
+        batch_vertex_indices(ids, i, count);
+        batch_outputs(outs, i, count);
+        vsu->execute_batch(ids, count, outs);
+        i += count;
       }
       current_package = thread_ctx->next_package();
     }
   }
-#endif
 
 private:
   vector<uint32_t> indices_;
   vector<uint32_t> unique_indices_;
+  vector<uint64_t> used_bits_;
 
-  shared_ptr<vs_output[]> transformed_verts_;
-  size_t transformed_verts_capacity_;
+  eflib::pool::reserved_pool<vs_output> transformed_verts_;
+  vs_output* first_transformed_vert_;
+  // Shaded vertexes per instance.
+  uint32_t verts_count_;
 
+  vertex_lookup lookup_;
   vector<int32_t> used_verts_;
 
   std::atomic<uint32_t> min_index_;
@@ -333,20 +450,24 @@ private:
 
 class tls_vertex_cache : public vertex_cache_impl {
 public:
-  tls_vertex_cache() : caches_(std::thread::hardware_concurrency()) {}
+  tls_vertex_cache() = default;
 
-  void prepare_vertices() override {
-    for (uint32_t i = 0; i < std::thread::hardware_concurrency(); ++i) {
+  // Caches are of threads of the draw, which call fetch3() with their own IDs.
+  void prepare_vertices(pipeline_threads const& threads) override {
+    if (caches_.size() != threads.count) {
+      caches_ = decltype(caches_)(threads.count);
+    }
+    update_vso_size();
+    for (uint32_t i = 0; i < caches_.size(); ++i) {
       auto& cache = caches_[i];
       cache.vso_pool.clear();
-      cache.vso_pool.reserve(prim_count_ * prim_size_, 16);
-      for (auto& item : cache.items) {
-        item = std::make_pair(std::numeric_limits<uint32_t>::max(), nullptr);
-      }
+      cache.vso_pool.reserve(size_t(prim_count_) * instance_count_ * prim_size_, 16, vso_size_);
+      cache.clear_items(0);
       if (host_)
         cache.vsu = host_->get_vx_shader_unit();
       cache.ia_vertices = 0;
       cache.vs_invocations = 0;
+      cache.vs_cache_hits = 0;
       cache.vs_during = 0;
     }
   }
@@ -354,51 +475,71 @@ public:
   void fetch3(vs_output** v, cache_entry_index prim, uint32_t thread_id) override {
     // uint64_t vs_start_time = fetch_time_stamp_();
 
+    uint32_t const instance_id = split_instance(prim);
     uint32_t indexes[3];
     uint32_t min_index, max_index;
     index_fetcher_.fetch_indexes(indexes, &min_index, &max_index, prim, prim + 1);
 
     auto& cache = caches_[thread_id];
+    if (!instance_invariant_ && cache.instance_id != instance_id) {
+      cache.clear_items(instance_id);
+    }
+
+    cache.ia_vertices += prim_size_;
 
-    cache.ia_vertices += 3;
+    // Missed vertexes of the primitive are shaded in one batch.
+    uint32_t missed_indexes[3];
+    vs_output* missed_verts[3];
+    uint32_t missed_count = 0;
 
-    for (int i = 0; i < 3; ++i) {
+    for (uint32_t i = 0; i < prim_size_; ++i) {
       uint32_t index = indexes[i];
       uint32_t key = indexes[i] % ENTRY_SIZE;
       auto& cache_item = cache.items[key];
       if (cache_item.first == indexes[i]) {
         v[i] = cache_item.second;
+        ++cache.vs_cache_hits;
       } else {
         ++cache.vs_invocations;
 
         auto ret = cache.vso_pool.alloc();
-
-        if (cpp_vs_) {
-          vs_input vertex;
-          assembler_->fetch_vertex(vertex, index);
-          cpp_vs_->execute(vertex, *ret);
-        } else {
-          cache.vsu->execute(index, *ret);
-        }
+        missed_verts[missed_count] = ret;
+        missed_indexes[missed_count++] = index;
 
         cache_item = std::make_pair(index, ret);
         v[i] = ret;
       }
     }
 
+    if (missed_count == 0) {
+      return;
+    }
+
+    if (cpp_vs_) {
+      vs_input vertices[3];
+      assembler_->fetch_vertices(vertices, missed_indexes, missed_count, instance_id);
+      cpp_vs_->execute_batch(vertices, missed_verts, missed_count);
+    } else {
+      cache.vsu->execute_batch(missed_indexes, missed_count, missed_verts);
+    }
+
     // cache.vs_during += fetch_time_stamp_() - vs_start_time;
   }
 
   void update_statistic() override {
-    for (uint32_t i = 0; i < std::thread::hardware_concurrency(); ++i) {
+    for (uint32_t i = 0; i < caches_.size(); ++i) {
       auto& cache = caches_[i];
 
       acc_ia_vertices_(pipeline_stat_, cache.ia_vertices);
       cache.ia_vertices = 0;
 
       acc_vs_invocations_(pipeline_stat_, cache.vs_invocations);
+      acc_shaded_vertices(cache.vs_invocations);
       cache.vs_invocations = 0;
 
+      acc_vs_cache_hits_(pipeline_stat_, cache.vs_cache_hits);
+      cache.vs_cache_hits = 0;
+
       acc_vtx_proc_(pipeline_prof_, cache.vs_during);
       cache.vs_during = 0;
     }
@@ -412,12 +553,22 @@ private:
     thread_cache(thread_cache const&);
     thread_cache& operator=(thread_cache const&) { return *this; }
 
+    // Items are vertexes of one instance.
+    void clear_items(uint32_t instance) {
+      for (auto& item : items) {
+        item = std::make_pair(std::numeric_limits<uint32_t>::max(), nullptr);
+      }
+      instance_id = instance;
+    }
+
     eflib::pool::reserved_pool<vs_output> vso_pool;
     vx_shader_unit_ptr vsu;
     uint64_t vs_invocations{};
+    uint64_t vs_cache_hits{};
     uint64_t ia_vertices{};
     uint64_t vs_during{};
 
+    uint32_t instance_id{};
     std::pair<uint32_t, vs_output*> items[ENTRY_SIZE];
   };
 
@@ -426,7 +577,7 @@ private:
 
 class shared_vertex_cache : public vertex_cache_impl {
 public:
-  shared_vertex_cache() : caches_(std::thread::hardware_concurrency()) {
+  shared_vertex_cache() {
     conflict_count_ = 0;
     l2_missing_ = 0;
     l2_hitting_ = 0;
@@ -436,20 +587,25 @@ public:
     std::cout << "L2 Missing: " << l2_missing_ << std::endl;
     std::cout << "L2 Hitting: " << l2_hitting_ << std::endl;
   }
-  void prepare_vertices() override {
+  // Caches are of threads of the draw, which call fetch3() with their own IDs.
+  void prepare_vertices(pipeline_threads const& threads) override {
     memset(shared_items_, INVALID_SHARED_ENTRY, sizeof(shared_items_));
+    memset(shared_instances_, 0, sizeof(shared_instances_));
 
-    for (uint32_t i = 0; i < std::thread::hardware_concurrency(); ++i) {
+    if (caches_.size() != threads.count) {
+      caches_ = decltype(caches_)(threads.count);
+    }
+    update_vso_size();
+    for (uint32_t i = 0; i < caches_.size(); ++i) {
       auto& cache = caches_[i];
       cache.vso_pool.clear();
-      cache.vso_pool.reserve(prim_count_ * prim_size_, 16);
-      for (int j = 0; j < ENTRY_SIZE; ++j) {
-        cache.items[j] = std::make_pair(std::numeric_limits<uint32_t>::max(), nullptr);
-      }
+      cache.vso_pool.reserve(size_t(prim_count_) * instance_count_ * prim_size_, 16, vso_size_);
+      cache.clear_items(0);
       if (host_)
         cache.vsu = host_->get_vx_shader_unit();
       cache.ia_vertices = 0;
       cache.vs_invocations = 0;
+      cache.vs_cache_hits = 0;
       cache.vs_during = 0;
       cache.conflict_count = 0;
       cache.l2_missing = 0;
@@ -483,31 +639,37 @@ public:
   void fetch3(vs_output** v, cache_entry_index prim, uint32_t thread_id) override {
     // uint64_t vs_start_time = fetch_time_stamp_();
 
+    uint32_t const instance_id = split_instance(prim);
     uint32_t indexes[3];
     uint32_t min_index, max_index;
     index_fetcher_.fetch_indexes(indexes, &min_index, &max_index, prim, prim + 1);
 
     auto& cache = caches_[thread_id];
+    if (!instance_invariant_ && cache.instance_id != instance_id) {
+      cache.clear_items(instance_id);
+    }
 
-    cache.ia_vertices += 3;
+    cache.ia_vertices += prim_size_;
 
-    for (int i = 0; i < 3; ++i) {
+    for (uint32_t i = 0; i < prim_size_; ++i) {
       uint32_t index = indexes[i];
       uint32_t key = indexes[i] % ENTRY_SIZE;
       auto& cache_item = cache.items[key];
       if (cache_item.first == indexes[i]) {
         v[i] = cache_item.second;
+        ++cache.vs_cache_hits;
       } else {
         uint32_t sc_key = index % SHARED_ENTRY_SIZE;
         auto& shared_item = shared_items_[sc_key];
         uint32_t index_in_cache = lock_shared_item(cache.conflict_count, shared_item);
 
-        if (index_in_cache == index) {
+        if (index_in_cache == index && shared_instances_[sc_key] == cache.instance_id) {
           cache_item = std::make_pair(index, shared_item.second);
           release_shared_item(shared_item, index);
 
           v[i] = cache_item.second;
           ++cache.l2_hitting;
+          ++cache.vs_cache_hits;
         } else {
           release_shared_item(shared_item, index_in_cache);
 
@@ -520,7 +682,7 @@ public:
 
           if (cpp_vs_) {
             vs_input vertex;
-            assembler_->fetch_vertex(vertex, index);
+            assembler_->fetch_vertex(vertex, index, instance_id);
             cpp_vs_->execute(vertex, *ret);
           } else {
             cache.vsu->execute(index, *ret);
@@ -531,6 +693,7 @@ public:
 
           lock_shared_item(cache.conflict_count, shared_item);
           shared_items_[sc_key].second = ret;
+          shared_instances_[sc_key] = cache.instance_id;
           release_shared_item(shared_item, index);
         }
       }
@@ -540,15 +703,19 @@ public:
   }
 
   void update_statistic() override {
-    for (uint32_t i = 0; i < std::thread::hardware_concurrency(); ++i) {
+    for (uint32_t i = 0; i < caches_.size(); ++i) {
       auto& cache = caches_[i];
 
       acc_ia_vertices_(pipeline_stat_, cache.ia_vertices);
       cache.ia_vertices = 0;
 
       acc_vs_invocations_(pipeline_stat_, cache.vs_invocations);
+      acc_shaded_vertices(cache.vs_invocations);
       cache.vs_invocations = 0;
 
+      acc_vs_cache_hits_(pipeline_stat_, cache.vs_cache_hits);
+      cache.vs_cache_hits = 0;
+
       acc_vtx_proc_(pipeline_prof_, cache.vs_during);
       cache.vs_during = 0;
 
@@ -573,12 +740,22 @@ private:
     uint32_t l2_hitting;
     uint32_t l2_missing;
 
+    // Items are vertexes of one instance.
+    void clear_items(uint32_t instance) {
+      for (auto& item : items) {
+        item = std::make_pair(std::numeric_limits<uint32_t>::max(), nullptr);
+      }
+      instance_id = instance;
+    }
+
     eflib::pool::reserved_pool<vs_output> vso_pool;
     vx_shader_unit_ptr vsu;
     uint64_t vs_invocations;
+    uint64_t vs_cache_hits;
     uint64_t ia_vertices;
     uint64_t vs_during;
 
+    uint32_t instance_id;
     std::pair<uint32_t, vs_output*> items[ENTRY_SIZE];
   };
 
@@ -588,10 +765,16 @@ private:
 
   std::vector<thread_cache, eflib::aligned_allocator<thread_cache, 64>> caches_;
   std::pair<std::atomic<uint32_t>, vs_output*> shared_items_[SHARED_ENTRY_SIZE];
+  // Instances of shared items, which are accessed while items are locked.
+  uint32_t shared_instances_[SHARED_ENTRY_SIZE];
 };
 
-vertex_cache_ptr create_default_vertex_cache() {
-  return vertex_cache_ptr(new tls_vertex_cache());
+vertex_cache_ptr create_default_vertex_cache(vertex_cache_types type) {
+  switch (type) {
+  case vertex_cache_precomputed: return vertex_cache_ptr(new precomputed_vertex_cache());
+  case vertex_cache_shared: return vertex_cache_ptr(new shared_vertex_cache());
+  default: return vertex_cache_ptr(new tls_vertex_cache());
+  }
 }
 
 }  // namespace salvia::core
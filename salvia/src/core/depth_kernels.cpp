@@ -0,0 +1,199 @@
+#include <salvia/core/depth_kernels.h>
+
+#include <eflib/platform/cpuinfo.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace salvia::core {
+
+namespace {
+template <compare_function Func>
+bool depth_passed(float z, float cur) {
+  if constexpr (Func == compare_function_less) {
+    return z < cur;
+  } else if constexpr (Func == compare_function_less_equal) {
+    return z <= cur;
+  } else if constexpr (Func == compare_function_equal) {
+    return z == cur;
+  } else if constexpr (Func == compare_function_greater_equal) {
+    return z >= cur;
+  } else if constexpr (Func == compare_function_greater) {
+    return z > cur;
+  } else if constexpr (Func == compare_function_not_equal) {
+    return z != cur;
+  } else if constexpr (Func == compare_function_never) {
+    return false;
+  } else {
+    return true;
+  }
+}
+
+bool stencil_passed(compare_function func, uint32_t ref, uint32_t cur) {
+  switch (func) {
+  case compare_function_less: return ref < cur;
+  case compare_function_equal: return ref == cur;
+  case compare_function_less_equal: return ref <= cur;
+  case compare_function_greater: return ref > cur;
+  case compare_function_not_equal: return ref != cur;
+  case compare_function_greater_equal: return ref >= cur;
+  case compare_function_always: return true;
+  default: return false;
+  }
+}
+
+uint32_t stencil_operation(stencil_op op, uint32_t ref, uint32_t cur) {
+  switch (op) {
+  case stencil_op_zero: return 0;
+  case stencil_op_replace: return ref;
+  case stencil_op_incr_sat: return std::min<uint32_t>(0xFF, cur + 1);
+  case stencil_op_decr_sat: return cur == 0 ? 0 : cur - 1;
+  case stencil_op_invert: return ~cur;
+  case stencil_op_incr_wrap: return (cur + 1) & 0xFF;
+  case stencil_op_decr_wrap: return (cur - 1) & 0xFF;
+  default: return cur;
+  }
+}
+
+template <compare_function Func>
+bool depth_row_generic(float* ds_row,
+                       uint32_t sample_count,
+                       uint32_t count,
+                       float z,
+                       float dzdx,
+                       float const* sample_z_offset,
+                       uint32_t const* pixel_masks) {
+  bool written = false;
+  for (uint32_t i = 0; i < count; ++i) {
+    float const pixel_z = z + i * dzdx;
+    uint32_t const mask = pixel_masks ? pixel_masks[i] : 0xFFFFFFFF;
+    float* ds = ds_row + i * sample_count * 2;
+    for (uint32_t s = 0; s < sample_count; ++s, ds += 2) {
+      if (mask & (1U << s)) {
+        float const sample_z = sample_count == 1 ? pixel_z : pixel_z + sample_z_offset[s];
+        if (depth_passed<Func>(sample_z, ds[0])) {
+          ds[0] = sample_z;
+          written = true;
+        }
+      }
+    }
+  }
+  return written;
+}
+
+template <compare_function Func, bool WriteDepth, bool Stencil>
+uint64_t depth_stencil_quad_generic(float* const* ds_rows,
+                                    uint32_t sample_count,
+                                    uint64_t quad_mask,
+                                    float const* depth,
+                                    float const* sample_z_offset,
+                                    stencil_quad_params const* stencil) {
+  uint64_t passed = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    uint32_t const mask = static_cast<uint32_t>(quad_mask >> (i * MAX_SAMPLE_COUNT)) & SAMPLE_MASK;
+    if (mask == 0) {
+      continue;
+    }
+
+    float* ds = ds_rows[i >> 1] + (i & 1) * sample_count * 2;
+    for (uint32_t s = 0; s < sample_count; ++s, ds += 2) {
+      if (!(mask & (1U << s))) {
+        continue;
+      }
+      float const z = sample_count == 1 ? depth[i] : depth[i] + sample_z_offset[s];
+      if (!depth_passed<Func>(z, ds[0])) {
+        continue;
+      }
+      if constexpr (Stencil) {
+        uint32_t const cur = std::bit_cast<uint32_t>(ds[1]) & stencil->read_mask;
+        if (!stencil_passed(stencil->func, stencil->ref, cur)) {
+          continue;
+        }
+        ds[1] = std::bit_cast<float>(stencil_operation(stencil->pass_op, stencil->ref, cur) &
+                                     stencil->write_mask);
+      }
+      if constexpr (WriteDepth) {
+        ds[0] = z;
+      }
+      passed |= 1ULL << (i * MAX_SAMPLE_COUNT + s);
+    }
+  }
+  return passed;
+}
+
+template <compare_function Func>
+depth_stencil_quad_fn depth_stencil_quad_generic_kernel(bool write_depth, bool stencil) {
+  if (write_depth) {
+    return stencil ? &depth_stencil_quad_generic<Func, true, true>
+                   : &depth_stencil_quad_generic<Func, true, false>;
+  }
+  return stencil ? &depth_stencil_quad_generic<Func, false, true>
+                 : &depth_stencil_quad_generic<Func, false, false>;
+}
+}  // namespace
+
+depth_row_fn generic_depth_row_kernel(compare_function func) {
+  switch (func) {
+  case compare_function_less:
+    return &depth_row_generic<compare_function_less>;
+  case compare_function_equal:
+    return &depth_row_generic<compare_function_equal>;
+  case compare_function_less_equal:
+    return &depth_row_generic<compare_function_less_equal>;
+  case compare_function_greater:
+    return &depth_row_generic<compare_function_greater>;
+  case compare_function_not_equal:
+    return &depth_row_generic<compare_function_not_equal>;
+  case compare_function_greater_equal:
+    return &depth_row_generic<compare_function_greater_equal>;
+  case compare_function_always:
+    return &depth_row_generic<compare_function_always>;
+  default:
+    return nullptr;
+  }
+}
+
+depth_stencil_quad_fn
+generic_depth_stencil_quad_kernel(compare_function depth_func, bool write_depth, bool stencil) {
+  switch (depth_func) {
+  case compare_function_never:
+    return depth_stencil_quad_generic_kernel<compare_function_never>(write_depth, stencil);
+  case compare_function_less:
+    return depth_stencil_quad_generic_kernel<compare_function_less>(write_depth, stencil);
+  case compare_function_equal:
+    return depth_stencil_quad_generic_kernel<compare_function_equal>(write_depth, stencil);
+  case compare_function_less_equal:
+    return depth_stencil_quad_generic_kernel<compare_function_less_equal>(write_depth, stencil);
+  case compare_function_greater:
+    return depth_stencil_quad_generic_kernel<compare_function_greater>(write_depth, stencil);
+  case compare_function_not_equal:
+    return depth_stencil_quad_generic_kernel<compare_function_not_equal>(write_depth, stencil);
+  case compare_function_greater_equal:
+    return depth_stencil_quad_generic_kernel<compare_function_greater_equal>(write_depth,
+                                                                             stencil);
+  default:
+    return depth_stencil_quad_generic_kernel<compare_function_always>(write_depth, stencil);
+  }
+}
+
+depth_row_fn select_depth_row_kernel(compare_function func) {
+#if defined(EFLIB_CPU_X64)
+  static bool const has_avx2 = eflib::support_feature(eflib::cpu_avx2);
+  return has_avx2 ? avx2_depth_row_kernel(func) : generic_depth_row_kernel(func);
+#else
+  return generic_depth_row_kernel(func);
+#endif
+}
+
+depth_stencil_quad_fn
+select_depth_stencil_quad_kernel(compare_function depth_func, bool write_depth, bool stencil) {
+#if defined(EFLIB_CPU_X64)
+  static bool const has_avx2 = eflib::support_feature(eflib::cpu_avx2);
+  return has_avx2 ? avx2_depth_stencil_quad_kernel(depth_func, write_depth, stencil)
+                  : generic_depth_stencil_quad_kernel(depth_func, write_depth, stencil);
+#else
+  return generic_depth_stencil_quad_kernel(depth_func, write_depth, stencil);
+#endif
+}
+
+}  // namespace salvia::core
@@ -0,0 +1,302 @@
+// This file is compiled with AVX2 enabled. Kernels are only called if CPU supports AVX2.
+
+#include <salvia/core/depth_kernels.h>
+
+#include <eflib/platform/config.h>
+
+#include <simde/x86/avx2.h>
+
+namespace salvia::core {
+
+namespace {
+// Depth and stencil of 4 pixels are in a register. Stencil lanes are never selected for writing.
+template <compare_function Func, int Predicate>
+bool depth_row_avx2(float* ds_row,
+                    uint32_t sample_count,
+                    uint32_t count,
+                    float z,
+                    float dzdx,
+                    float const* sample_z_offset,
+                    uint32_t const* pixel_masks) {
+  if (sample_count != 1) {
+    static depth_row_fn const multi_sample_kernel = generic_depth_row_kernel(Func);
+    return multi_sample_kernel(ds_row, sample_count, count, z, dzdx, sample_z_offset, pixel_masks);
+  }
+
+  __m256 const lane_pixel = _mm256_set_ps(3.0f, 3.0f, 2.0f, 2.0f, 1.0f, 1.0f, 0.0f, 0.0f);
+  __m256i const depth_lanes = _mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+  __m256i const lane_bits = _mm256_set_epi32(0, 8, 0, 4, 0, 2, 0, 1);
+  __m256 const z_step = _mm256_set1_ps(dzdx);
+
+  __m256 written = _mm256_setzero_ps();
+  for (uint32_t i = 0; i < count; i += 4) {
+    __m256i lanes = depth_lanes;
+    if (count - i < 4) {
+      __m256i const pixel_index = _mm256_cvttps_epi32(lane_pixel);
+      lanes = _mm256_and_si256(
+          lanes, _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count - i)), pixel_index));
+    }
+    if (pixel_masks) {
+      uint32_t covered = 0;
+      for (uint32_t px = 0; px < 4 && i + px < count; ++px) {
+        covered |= (pixel_masks[i + px] & 1) << px;
+      }
+      __m256i const covered_bits = _mm256_and_si256(_mm256_set1_epi32(covered), lane_bits);
+      lanes = _mm256_andnot_si256(_mm256_cmpeq_epi32(covered_bits, _mm256_setzero_si256()), lanes);
+    }
+
+    float* ds = ds_row + i * 2;
+    __m256 const pixel_z = _mm256_add_ps(
+        _mm256_set1_ps(z),
+        _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(i)), lane_pixel), z_step));
+    bool const full = count - i >= 4;
+    __m256 const cur = full ? _mm256_loadu_ps(ds) : _mm256_maskload_ps(ds, lanes);
+    __m256 const passed = _mm256_and_ps(_mm256_cmp_ps(pixel_z, cur, Predicate),
+                                        _mm256_castsi256_ps(lanes));
+    if (full) {
+      _mm256_storeu_ps(ds, _mm256_blendv_ps(cur, pixel_z, passed));
+    } else {
+      _mm256_maskstore_ps(ds, _mm256_castps_si256(passed), pixel_z);
+    }
+    written = _mm256_or_ps(written, passed);
+  }
+
+  return _mm256_movemask_ps(written) != 0;
+}
+
+// Stencil is in odd lanes.
+__m256i stencil_passed_avx2(compare_function func, __m256i ref, __m256i cur) {
+  __m256i const ones = _mm256_set1_epi32(-1);
+  switch (func) {
+  case compare_function_less: return _mm256_cmpgt_epi32(cur, ref);
+  case compare_function_equal: return _mm256_cmpeq_epi32(ref, cur);
+  case compare_function_less_equal: return _mm256_xor_si256(_mm256_cmpgt_epi32(ref, cur), ones);
+  case compare_function_greater: return _mm256_cmpgt_epi32(ref, cur);
+  case compare_function_not_equal: return _mm256_xor_si256(_mm256_cmpeq_epi32(ref, cur), ones);
+  case compare_function_greater_equal: return _mm256_xor_si256(_mm256_cmpgt_epi32(cur, ref), ones);
+  case compare_function_always: return ones;
+  default: return _mm256_setzero_si256();
+  }
+}
+
+__m256i stencil_operation_avx2(stencil_op op, __m256i ref, __m256i cur) {
+  __m256i const one = _mm256_set1_epi32(1);
+  __m256i const max_stencil = _mm256_set1_epi32(0xFF);
+  switch (op) {
+  case stencil_op_zero: return _mm256_setzero_si256();
+  case stencil_op_replace: return ref;
+  case stencil_op_incr_sat: return _mm256_min_epu32(_mm256_add_epi32(cur, one), max_stencil);
+  case stencil_op_decr_sat:
+    return _mm256_max_epi32(_mm256_sub_epi32(cur, one), _mm256_setzero_si256());
+  case stencil_op_invert: return _mm256_xor_si256(cur, _mm256_set1_epi32(-1));
+  case stencil_op_incr_wrap: return _mm256_and_si256(_mm256_add_epi32(cur, one), max_stencil);
+  case stencil_op_decr_wrap: return _mm256_and_si256(_mm256_sub_epi32(cur, one), max_stencil);
+  default: return cur;
+  }
+}
+
+// Depth and stencil of 4 samples are in a register, and z of samples are in even lanes. Returns
+// lanes of samples which pass tests, and 'ds' is updated for them.
+template <int Predicate, bool WriteDepth, bool Stencil>
+__m256i test_samples_avx2(__m256& ds,
+                          __m256 z,
+                          __m256i covered,
+                          stencil_quad_params const* stencil) {
+  __m256i const depth_lanes = _mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+  __m256 const cur = ds;
+
+  __m256i passed = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(z, cur, Predicate)),
+                                    _mm256_and_si256(covered, depth_lanes));
+  __m256 new_stencil = cur;
+  if constexpr (Stencil) {
+    __m256i const ref = _mm256_set1_epi32(static_cast<int>(stencil->ref));
+    __m256i const cur_stencil = _mm256_and_si256(
+        _mm256_castps_si256(cur), _mm256_set1_epi32(static_cast<int>(stencil->read_mask)));
+    __m256i const stencil_passed = stencil_passed_avx2(stencil->func, ref, cur_stencil);
+    passed = _mm256_and_si256(passed, _mm256_srli_epi64(stencil_passed, 32));
+    new_stencil = _mm256_castsi256_ps(
+        _mm256_and_si256(stencil_operation_avx2(stencil->pass_op, ref, cur_stencil),
+                         _mm256_set1_epi32(static_cast<int>(stencil->write_mask))));
+  }
+  passed = _mm256_or_si256(passed, _mm256_slli_epi64(passed, 32));
+
+  ds = _mm256_blend_ps(WriteDepth ? z : cur, new_stencil, 0xAA);
+  return passed;
+}
+
+// Bit i is set if sample i of the register passes.
+uint32_t passed_samples(__m256i passed) {
+  uint32_t const lanes = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(passed)));
+  return (lanes & 0x1) | ((lanes >> 1) & 0x2) | ((lanes >> 2) & 0x4) | ((lanes >> 3) & 0x8);
+}
+
+// Samples of a quad row are adjacent, so a register is filled by samples of both pixels if there
+// is one sample, or by 4 samples of a row otherwise.
+template <compare_function Func, int Predicate, bool WriteDepth, bool Stencil>
+uint64_t depth_stencil_quad_avx2(float* const* ds_rows,
+                                 uint32_t sample_count,
+                                 uint64_t quad_mask,
+                                 float const* depth,
+                                 float const* sample_z_offset,
+                                 stencil_quad_params const* stencil) {
+  if (sample_count > 2 && sample_count % 4 != 0) {
+    static depth_stencil_quad_fn const generic_kernel =
+        generic_depth_stencil_quad_kernel(Func, WriteDepth, Stencil);
+    return generic_kernel(ds_rows, sample_count, quad_mask, depth, sample_z_offset, stencil);
+  }
+
+  __m256i const sample_bits = _mm256_set_epi32(8, 8, 4, 4, 2, 2, 1, 1);
+  auto covered_lanes = [&sample_bits](uint32_t covered) {
+    __m256i const bits = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(covered)), sample_bits);
+    return _mm256_cmpeq_epi32(bits, sample_bits);
+  };
+
+  uint64_t passed = 0;
+  if (sample_count == 1) {
+    uint32_t covered = 0;
+    for (uint32_t i = 0; i < 4; ++i) {
+      covered |= static_cast<uint32_t>((quad_mask >> (i * MAX_SAMPLE_COUNT)) & 1) << i;
+    }
+    __m256i const lanes = covered_lanes(covered);
+    __m128i const lanes_lo = _mm256_castsi256_si128(lanes);
+    __m128i const lanes_hi = _mm256_extracti128_si256(lanes, 1);
+
+    __m128 const row0 = ds_rows[0] ? _mm_maskload_ps(ds_rows[0], lanes_lo) : _mm_setzero_ps();
+    __m128 const row1 = ds_rows[1] ? _mm_maskload_ps(ds_rows[1], lanes_hi) : _mm_setzero_ps();
+    __m256 ds = _mm256_set_m128(row1, row0);
+    __m256 const z = _mm256_set_ps(0.0f, depth[3], 0.0f, depth[2], 0.0f, depth[1], 0.0f, depth[0]);
+
+    __m256i const passed_lanes =
+        test_samples_avx2<Predicate, WriteDepth, Stencil>(ds, z, lanes, stencil);
+    if constexpr (WriteDepth || Stencil) {
+      if (ds_rows[0]) {
+        _mm_maskstore_ps(ds_rows[0], _mm256_castsi256_si128(passed_lanes), _mm256_castps256_ps128(ds));
+      }
+      if (ds_rows[1]) {
+        _mm_maskstore_ps(
+            ds_rows[1], _mm256_extracti128_si256(passed_lanes, 1), _mm256_extractf128_ps(ds, 1));
+      }
+    }
+
+    uint32_t const passed_pixels = passed_samples(passed_lanes);
+    for (uint32_t i = 0; i < 4; ++i) {
+      passed |= static_cast<uint64_t>((passed_pixels >> i) & 1) << (i * MAX_SAMPLE_COUNT);
+    }
+    return passed;
+  }
+
+  uint32_t const row_samples = sample_count * 2;
+  for (uint32_t row = 0; row < 2; ++row) {
+    float* ds_row = ds_rows[row];
+    if (ds_row == nullptr) {
+      continue;
+    }
+
+    for (uint32_t first = 0; first < row_samples; first += 4, ds_row += 8) {
+      uint32_t const pixel = row * 2 + first / sample_count;
+      uint32_t const sample = first % sample_count;
+      uint32_t const pixel_mask =
+          static_cast<uint32_t>(quad_mask >> (pixel * MAX_SAMPLE_COUNT)) & SAMPLE_MASK;
+
+      // Two samples of each pixel if there are two samples, otherwise four samples of a pixel.
+      uint32_t covered;
+      EFLIB_ALIGN(32) float z[8] = {};
+      if (sample_count == 2) {
+        uint32_t const next_mask =
+            static_cast<uint32_t>(quad_mask >> ((pixel + 1) * MAX_SAMPLE_COUNT)) & SAMPLE_MASK;
+        covered = (pixel_mask & 0x3) | ((next_mask & 0x3) << 2);
+        z[0] = depth[pixel] + sample_z_offset[0];
+        z[2] = depth[pixel] + sample_z_offset[1];
+        z[4] = depth[pixel + 1] + sample_z_offset[0];
+        z[6] = depth[pixel + 1] + sample_z_offset[1];
+      } else {
+        covered = (pixel_mask >> sample) & 0xF;
+        for (uint32_t i = 0; i < 4; ++i) {
+          z[i * 2] = depth[pixel] + sample_z_offset[sample + i];
+        }
+      }
+      if (covered == 0) {
+        continue;
+      }
+
+      __m256i const lanes = covered_lanes(covered);
+      __m256 ds = _mm256_maskload_ps(ds_row, lanes);
+      __m256i const passed_lanes = test_samples_avx2<Predicate, WriteDepth, Stencil>(
+          ds, _mm256_load_ps(z), lanes, stencil);
+      if constexpr (WriteDepth || Stencil) {
+        _mm256_maskstore_ps(ds_row, passed_lanes, ds);
+      }
+
+      uint32_t const passed_bits = passed_samples(passed_lanes);
+      if (sample_count == 2) {
+        passed |= static_cast<uint64_t>(passed_bits & 0x3) << (pixel * MAX_SAMPLE_COUNT);
+        passed |= static_cast<uint64_t>(passed_bits >> 2) << ((pixel + 1) * MAX_SAMPLE_COUNT);
+      } else {
+        passed |= static_cast<uint64_t>(passed_bits) << (pixel * MAX_SAMPLE_COUNT + sample);
+      }
+    }
+  }
+  return passed;
+}
+
+template <compare_function Func, int Predicate>
+depth_stencil_quad_fn depth_stencil_quad_avx2_kernel(bool write_depth, bool stencil) {
+  if (write_depth) {
+    return stencil ? &depth_stencil_quad_avx2<Func, Predicate, true, true>
+                   : &depth_stencil_quad_avx2<Func, Predicate, true, false>;
+  }
+  return stencil ? &depth_stencil_quad_avx2<Func, Predicate, false, true>
+                 : &depth_stencil_quad_avx2<Func, Predicate, false, false>;
+}
+}  // namespace
+
+depth_row_fn avx2_depth_row_kernel(compare_function func) {
+  switch (func) {
+  case compare_function_less:
+    return &depth_row_avx2<compare_function_less, _CMP_LT_OQ>;
+  case compare_function_equal:
+    return &depth_row_avx2<compare_function_equal, _CMP_EQ_OQ>;
+  case compare_function_less_equal:
+    return &depth_row_avx2<compare_function_less_equal, _CMP_LE_OQ>;
+  case compare_function_greater:
+    return &depth_row_avx2<compare_function_greater, _CMP_GT_OQ>;
+  case compare_function_not_equal:
+    return &depth_row_avx2<compare_function_not_equal, _CMP_NEQ_UQ>;
+  case compare_function_greater_equal:
+    return &depth_row_avx2<compare_function_greater_equal, _CMP_GE_OQ>;
+  case compare_function_always:
+    return &depth_row_avx2<compare_function_always, _CMP_TRUE_UQ>;
+  default:
+    return nullptr;
+  }
+}
+
+depth_stencil_quad_fn
+avx2_depth_stencil_quad_kernel(compare_function depth_func, bool write_depth, bool stencil) {
+  switch (depth_func) {
+  case compare_function_never:
+    return depth_stencil_quad_avx2_kernel<compare_function_never, _CMP_FALSE_OQ>(write_depth,
+                                                                                 stencil);
+  case compare_function_less:
+    return depth_stencil_quad_avx2_kernel<compare_function_less, _CMP_LT_OQ>(write_depth, stencil);
+  case compare_function_equal:
+    return depth_stencil_quad_avx2_kernel<compare_function_equal, _CMP_EQ_OQ>(write_depth, stencil);
+  case compare_function_less_equal:
+    return depth_stencil_quad_avx2_kernel<compare_function_less_equal, _CMP_LE_OQ>(write_depth,
+                                                                                   stencil);
+  case compare_function_greater:
+    return depth_stencil_quad_avx2_kernel<compare_function_greater, _CMP_GT_OQ>(write_depth,
+                                                                                stencil);
+  case compare_function_not_equal:
+    return depth_stencil_quad_avx2_kernel<compare_function_not_equal, _CMP_NEQ_UQ>(write_depth,
+                                                                                   stencil);
+  case compare_function_greater_equal:
+    return depth_stencil_quad_avx2_kernel<compare_function_greater_equal, _CMP_GE_OQ>(write_depth,
+                                                                                      stencil);
+  default:
+    return depth_stencil_quad_avx2_kernel<compare_function_always, _CMP_TRUE_UQ>(write_depth,
+                                                                                 stencil);
+  }
+}
+
+}  // namespace salvia::core
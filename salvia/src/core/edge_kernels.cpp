@@ -0,0 +1,208 @@
+#include <salvia/core/edge_kernels.h>
+
+#include <eflib/platform/cpuinfo.h>
+
+#include <algorithm>
+#include <cmath>
+
+using std::max;
+using std::min;
+
+namespace salvia::core {
+
+// Fixed-point positions are limited to 2^29, so edge coefficients a and b fit in int32 and
+// c fits in int64 without overflow.
+constexpr float FIXED_POSITION_LIMIT = static_cast<float>(1 << 29);
+
+// Partially covered blocks have |edge value| < (|a| + |b|) * (4 << subpixel_bits).
+constexpr int64_t LANE_SAFE_LIMIT = int64_t(1) << 30;
+
+bool setup_fixed_edge_equations(fixed_edge_equations& eq,
+                                float const* xs,
+                                float const* ys,
+                                uint32_t subpixel_bits) {
+  eq.valid = false;
+  eq.lane_safe = false;
+  eq.subpixel_bits = subpixel_bits;
+
+  float const scale = static_cast<float>(1 << subpixel_bits);
+  int64_t fx[3];
+  int64_t fy[3];
+  for (int i = 0; i < 3; ++i) {
+    float const x = xs[i] * scale;
+    float const y = ys[i] * scale;
+    // Also returns for NaN.
+    if (!(std::fabs(x) < FIXED_POSITION_LIMIT && std::fabs(y) < FIXED_POSITION_LIMIT)) {
+      return false;
+    }
+    fx[i] = std::llround(x);
+    fy[i] = std::llround(y);
+  }
+
+  int64_t max_ab = 0;
+  for (int e = 0; e < 3; ++e) {
+    int const se = e;
+    int const ee = (e + 1) % 3;
+
+    int64_t const a = fy[se] - fy[ee];
+    int64_t const b = fx[ee] - fx[se];
+    int64_t const c = fx[ee] * fy[se] - fy[ee] * fx[se];
+
+    // Samples on the edge belong to the triangle only if it is a top or left edge.
+    bool const top_left = a > 0 || (a == 0 && b > 0);
+
+    eq.a[e] = static_cast<int32_t>(a);
+    eq.b[e] = static_cast<int32_t>(b);
+    eq.c[e] = top_left ? c : c + 1;
+    max_ab = max(max_ab, std::abs(a) + std::abs(b));
+  }
+
+  // Padding lane always passes.
+  eq.a[3] = eq.b[3] = 0;
+  eq.c[3] = 0;
+
+  eq.bounding_box[0] = static_cast<int32_t>(min(min(fx[0], fx[1]), fx[2]) >> subpixel_bits);
+  eq.bounding_box[1] = static_cast<int32_t>(max(max(fx[0], fx[1]), fx[2]) >> subpixel_bits);
+  eq.bounding_box[2] = static_cast<int32_t>(min(min(fy[0], fy[1]), fy[2]) >> subpixel_bits);
+  eq.bounding_box[3] = static_cast<int32_t>(max(max(fy[0], fy[1]), fy[2]) >> subpixel_bits);
+
+  eq.lane_safe = max_ab * (int64_t(4) << subpixel_bits) < LANE_SAFE_LIMIT;
+  eq.valid = true;
+  return true;
+}
+
+block_coverage classify_block(fixed_edge_equations const& eq,
+                              int left,
+                              int top,
+                              int width,
+                              int height) {
+  if (left > eq.bounding_box[1] || left + width <= eq.bounding_box[0] ||
+      top > eq.bounding_box[3] || top + height <= eq.bounding_box[2]) {
+    return block_coverage::rejected;
+  }
+
+  uint32_t const s = eq.subpixel_bits;
+  int64_t const x0 = int64_t(left) << s;
+  int64_t const y0 = int64_t(top) << s;
+  int64_t const w = int64_t(width) << s;
+  int64_t const h = int64_t(height) << s;
+
+  bool accepted = true;
+  for (int e = 0; e < 3; ++e) {
+    int64_t const dx = eq.a[e] * w;
+    int64_t const dy = eq.b[e] * h;
+    int64_t const e0 = eq.a[e] * x0 + eq.b[e] * y0 - eq.c[e];
+    if (e0 + max<int64_t>(dx, 0) + max<int64_t>(dy, 0) < 0) {
+      return block_coverage::rejected;
+    }
+    if (e0 + min<int64_t>(dx, 0) + min<int64_t>(dy, 0) < 0) {
+      accepted = false;
+    }
+  }
+
+  return accepted ? block_coverage::accepted : block_coverage::partial;
+}
+
+namespace {
+void subdivide_generic(fixed_edge_equations const& eq,
+                       int left,
+                       int top,
+                       uint32_t region_x,
+                       uint32_t region_y,
+                       uint32_t child_size,
+                       uint32_t* regions,
+                       uint32_t& region_count) {
+  uint32_t const s = eq.subpixel_bits;
+  int64_t const child_fx = int64_t(child_size) << s;
+
+  int64_t e0[3];
+  int64_t step_x[3];
+  int64_t step_y[3];
+  int64_t min_offset[3];
+  int64_t max_offset[3];
+  for (int e = 0; e < 3; ++e) {
+    e0[e] = eq.a[e] * (int64_t(left) << s) + eq.b[e] * (int64_t(top) << s) - eq.c[e];
+    step_x[e] = eq.a[e] * child_fx;
+    step_y[e] = eq.b[e] * child_fx;
+    min_offset[e] = min<int64_t>(step_x[e], 0) + min<int64_t>(step_y[e], 0);
+    max_offset[e] = max<int64_t>(step_x[e], 0) + max<int64_t>(step_y[e], 0);
+  }
+
+  int const size = static_cast<int>(child_size);
+  for (int ty = 0; ty < 4; ++ty) {
+    int const child_top = top + ty * size;
+    if (child_top > eq.bounding_box[3] || child_top + size <= eq.bounding_box[2]) {
+      continue;
+    }
+
+    for (int tx = 0; tx < 4; ++tx) {
+      int const child_left = left + tx * size;
+      if (child_left > eq.bounding_box[1] || child_left + size <= eq.bounding_box[0]) {
+        continue;
+      }
+
+      bool rejected = false;
+      bool accepted = true;
+      for (int e = 0; e < 3; ++e) {
+        int64_t const value = e0[e] + tx * step_x[e] + ty * step_y[e];
+        rejected |= (value + max_offset[e] < 0);
+        accepted &= (value + min_offset[e] >= 0);
+      }
+
+      if (!rejected) {
+        regions[region_count] = (region_x + tx * child_size) |
+            ((region_y + ty * child_size) << 8) | (static_cast<uint32_t>(accepted) << 31);
+        ++region_count;
+      }
+    }
+  }
+}
+
+void coverage_generic(fixed_edge_equations const& eq,
+                      int left,
+                      int top,
+                      int32_t const* sample_x,
+                      int32_t const* sample_y,
+                      uint32_t sample_count,
+                      uint32_t* pixel_mask) {
+  uint32_t const s = eq.subpixel_bits;
+
+  int64_t e0[3];
+  for (int e = 0; e < 3; ++e) {
+    e0[e] = eq.a[e] * (int64_t(left) << s) + eq.b[e] * (int64_t(top) << s) - eq.c[e];
+  }
+
+  for (int iy = 0; iy < 4; ++iy) {
+    for (int ix = 0; ix < 4; ++ix) {
+      uint32_t mask = 0;
+      for (uint32_t i_sample = 0; i_sample < sample_count; ++i_sample) {
+        int64_t const px = (int64_t(ix) << s) + sample_x[i_sample];
+        int64_t const py = (int64_t(iy) << s) + sample_y[i_sample];
+        bool inside = true;
+        for (int e = 0; e < 3; ++e) {
+          inside &= (e0[e] + eq.a[e] * px + eq.b[e] * py >= 0);
+        }
+        mask |= static_cast<uint32_t>(inside) << i_sample;
+      }
+      pixel_mask[iy * 4 + ix] = mask;
+    }
+  }
+}
+}  // namespace
+
+edge_kernels const* generic_edge_kernels() {
+  static edge_kernels const kernels{&subdivide_generic, &coverage_generic};
+  return &kernels;
+}
+
+edge_kernels const* select_edge_kernels() {
+#if defined(EFLIB_CPU_X64)
+  static edge_kernels const* kernels =
+      eflib::support_feature(eflib::cpu_avx2) ? avx2_edge_kernels() : generic_edge_kernels();
+  return kernels;
+#else
+  return generic_edge_kernels();
+#endif
+}
+
+}  // namespace salvia::core
@@ -0,0 +1,175 @@
+// This file is compiled with AVX2 enabled. Kernels are only called if CPU supports AVX2.
+
+#include <salvia/core/edge_kernels.h>
+
+#include <eflib/platform/intrin.h>
+
+#include <simde/x86/avx2.h>
+
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+namespace salvia::core {
+
+namespace {
+void subdivide_avx2(fixed_edge_equations const& eq,
+                    int left,
+                    int top,
+                    uint32_t region_x,
+                    uint32_t region_y,
+                    uint32_t child_size,
+                    uint32_t* regions,
+                    uint32_t& region_count) {
+  uint32_t const s = eq.subpixel_bits;
+  int64_t const child_fx = int64_t(child_size) << s;
+  int const size = static_cast<int>(child_size);
+
+  // Edge values of 4 children in a row, one child per 64-bit lane.
+  __m256i row[3];
+  __m256i row_step[3];
+  __m256i min_offset[3];
+  __m256i max_offset[3];
+  for (int e = 0; e < 3; ++e) {
+    int64_t const e0 = eq.a[e] * (int64_t(left) << s) + eq.b[e] * (int64_t(top) << s) - eq.c[e];
+    int64_t const step_x = eq.a[e] * child_fx;
+    int64_t const step_y = eq.b[e] * child_fx;
+    row[e] = _mm256_set_epi64x(e0 + 3 * step_x, e0 + 2 * step_x, e0 + step_x, e0);
+    row_step[e] = _mm256_set1_epi64x(step_y);
+    min_offset[e] = _mm256_set1_epi64x(min<int64_t>(step_x, 0) + min<int64_t>(step_y, 0));
+    max_offset[e] = _mm256_set1_epi64x(max<int64_t>(step_x, 0) + max<int64_t>(step_y, 0));
+  }
+
+  uint32_t columns_in_box = 0;
+  for (int tx = 0; tx < 4; ++tx) {
+    int const child_left = left + tx * size;
+    if (child_left <= eq.bounding_box[1] && child_left + size > eq.bounding_box[0]) {
+      columns_in_box |= 1U << tx;
+    }
+  }
+
+  __m256i const zero = _mm256_setzero_si256();
+  for (int ty = 0; ty < 4; ++ty) {
+    int const child_top = top + ty * size;
+    bool const row_in_box =
+        child_top <= eq.bounding_box[3] && child_top + size > eq.bounding_box[2];
+
+    __m256i rejected = zero;
+    __m256i partial = zero;
+    for (int e = 0; e < 3; ++e) {
+      rejected = _mm256_or_si256(
+          rejected, _mm256_cmpgt_epi64(zero, _mm256_add_epi64(row[e], max_offset[e])));
+      partial = _mm256_or_si256(
+          partial, _mm256_cmpgt_epi64(zero, _mm256_add_epi64(row[e], min_offset[e])));
+      row[e] = _mm256_add_epi64(row[e], row_step[e]);
+    }
+
+    if (!row_in_box) {
+      continue;
+    }
+
+    uint32_t const rejected_bits = _mm256_movemask_pd(_mm256_castsi256_pd(rejected));
+    uint32_t const partial_bits = _mm256_movemask_pd(_mm256_castsi256_pd(partial));
+
+    uint32_t survivors = ~rejected_bits & columns_in_box;
+    uint32_t tx;
+    while (_xmm_bsf(&tx, survivors)) {
+      uint32_t const accepted = ~(partial_bits >> tx) & 1;
+      regions[region_count] = (region_x + tx * child_size) |
+          ((region_y + ty * child_size) << 8) | (accepted << 31);
+      ++region_count;
+
+      survivors &= survivors - 1;
+    }
+  }
+}
+
+void coverage_avx2(fixed_edge_equations const& eq,
+                   int left,
+                   int top,
+                   int32_t const* sample_x,
+                   int32_t const* sample_y,
+                   uint32_t sample_count,
+                   uint32_t* pixel_mask) {
+  // Values of huge triangles may overflow the 32-bit lanes.
+  if (!eq.lane_safe) {
+    generic_edge_kernels()->coverage(eq, left, top, sample_x, sample_y, sample_count, pixel_mask);
+    return;
+  }
+
+  uint32_t const s = eq.subpixel_bits;
+  int64_t const block_fx = int64_t(4) << s;
+
+  // Only edges which cross the block are evaluated per sample. Values of crossing edges are
+  // bounded by the block extent, so they fit in 32-bit.
+  int active_count = 0;
+  int32_t e0[3];
+  int32_t a[3];
+  int32_t b[3];
+  for (int e = 0; e < 3; ++e) {
+    int64_t const origin =
+        eq.a[e] * (int64_t(left) << s) + eq.b[e] * (int64_t(top) << s) - eq.c[e];
+    int64_t const dx = eq.a[e] * block_fx;
+    int64_t const dy = eq.b[e] * block_fx;
+    if (origin + max<int64_t>(dx, 0) + max<int64_t>(dy, 0) < 0) {
+      std::fill(pixel_mask, pixel_mask + 16, 0);
+      return;
+    }
+    if (origin + min<int64_t>(dx, 0) + min<int64_t>(dy, 0) >= 0) {
+      continue;
+    }
+    e0[active_count] = static_cast<int32_t>(origin);
+    a[active_count] = eq.a[e];
+    b[active_count] = eq.b[e];
+    ++active_count;
+  }
+
+  if (active_count == 0) {
+    std::fill(pixel_mask, pixel_mask + 16, (1U << sample_count) - 1);
+    return;
+  }
+
+  // 8 lanes are 2 rows of 4 pixels.
+  int32_t const one = 1 << s;
+  __m256i const lane_x = _mm256_set_epi32(3 * one, 2 * one, one, 0, 3 * one, 2 * one, one, 0);
+  __m256i const lane_y = _mm256_set_epi32(one, one, one, one, 0, 0, 0, 0);
+
+  __m256i lane_offset[3];
+  __m256i half_step_y[3];
+  for (int e = 0; e < active_count; ++e) {
+    lane_offset[e] = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(a[e]), lane_x),
+                                      _mm256_mullo_epi32(_mm256_set1_epi32(b[e]), lane_y));
+    half_step_y[e] = _mm256_set1_epi32(b[e] * 2 * one);
+  }
+
+  __m256i const minus_one = _mm256_set1_epi32(-1);
+  __m256i mask_lo = _mm256_setzero_si256();
+  __m256i mask_hi = _mm256_setzero_si256();
+  for (uint32_t i_sample = 0; i_sample < sample_count; ++i_sample) {
+    __m256i inside_lo = minus_one;
+    __m256i inside_hi = minus_one;
+    for (int e = 0; e < active_count; ++e) {
+      int32_t const base = e0[e] + a[e] * sample_x[i_sample] + b[e] * sample_y[i_sample];
+      __m256i const value_lo = _mm256_add_epi32(_mm256_set1_epi32(base), lane_offset[e]);
+      __m256i const value_hi = _mm256_add_epi32(value_lo, half_step_y[e]);
+      inside_lo = _mm256_and_si256(inside_lo, _mm256_cmpgt_epi32(value_lo, minus_one));
+      inside_hi = _mm256_and_si256(inside_hi, _mm256_cmpgt_epi32(value_hi, minus_one));
+    }
+
+    __m256i const sample_bit = _mm256_set1_epi32(1 << i_sample);
+    mask_lo = _mm256_or_si256(mask_lo, _mm256_and_si256(inside_lo, sample_bit));
+    mask_hi = _mm256_or_si256(mask_hi, _mm256_and_si256(inside_hi, sample_bit));
+  }
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixel_mask + 0), mask_lo);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixel_mask + 8), mask_hi);
+}
+}  // namespace
+
+edge_kernels const* avx2_edge_kernels() {
+  static edge_kernels const kernels{&subdivide_avx2, &coverage_avx2};
+  return &kernels;
+}
+
+}  // namespace salvia::core
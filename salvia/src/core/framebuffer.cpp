@@ -18,21 +18,44 @@ using namespace salvia::resource;
 
 namespace salvia::core {
 
+// Depth stencil formats are accessed by their color types, except rg32f which stores stencil bits
+// in a float.
 template <uint32_t Format>
 class depth_stencil_accessor {
+  typedef typename pixel_fmt_to_type<Format>::type ds_type;
+
 public:
-  static float read_depth(void const* /*ds_data*/) {}
+  static float read_depth(void const* ds_data) {
+    return static_cast<ds_type const*>(ds_data)->get_depth();
+  }
 
-  static uint32_t read_stencil(void const* /*ds_data*/) {}
+  static uint32_t read_stencil(void const* ds_data) {
+    return static_cast<ds_type const*>(ds_data)->get_stencil();
+  }
 
-  static void read_depth_stencil(float& /*depth*/, uint32_t& /*stencil*/, void const* /*ds_data*/) {
+  static void read_depth_stencil(float& depth, uint32_t& stencil, void const* ds_data) {
+    depth = static_cast<ds_type const*>(ds_data)->get_depth();
+    stencil = static_cast<ds_type const*>(ds_data)->get_stencil();
   }
 
-  static void write_depth(void* /*ds_data*/, float /*depth*/) {}
+  static void write_depth(void* ds_data, float depth) {
+    static_cast<ds_type*>(ds_data)->set_depth(depth);
+  }
 
-  static void write_stencil(void* /*ds_data*/, uint32_t /*stencil*/) {}
+  static void write_stencil(void* ds_data, uint32_t stencil) {
+    static_cast<ds_type*>(ds_data)->set_stencil(stencil);
+  }
+
+  static void write_depth_stencil(void* ds_data, float depth, uint32_t stencil) {
+    static_cast<ds_type*>(ds_data)->set_depth(depth);
+    static_cast<ds_type*>(ds_data)->set_stencil(stencil);
+  }
 
-  static void write_depth_stencil(void* /*ds_data*/, float /*depth*/, uint32_t /*stencil*/) {}
+  // Depth as it is read back after written.
+  static float quantize_depth(float depth) {
+    ds_type const ds(color_rgba32f(depth, 0.0f, 0.0f, 0.0f));
+    return ds.get_depth();
+  }
 };
 
 template <>
@@ -85,6 +108,18 @@ public:
   }
 };
 
+typedef float (*quantize_depth_fn)(float depth);
+
+// Null if depth is stored as float.
+quantize_depth_fn select_quantize_depth(pixel_format fmt) {
+  switch (fmt) {
+  case pixel_format_color_d16: return depth_stencil_accessor<pixel_format_color_d16>::quantize_depth;
+  case pixel_format_color_d24s8:
+    return depth_stencil_accessor<pixel_format_color_d24s8>::quantize_depth;
+  default: return nullptr;
+  }
+}
+
 uint32_t mask_stencil_0(uint32_t /*stencil*/, uint32_t /*mask*/) {
   return 0;
 }
@@ -150,7 +185,7 @@ uint32_t sop_incr_sat(uint32_t /*ref*/, uint32_t cur_stencil) {
 }
 
 uint32_t sop_decr_sat(uint32_t /*ref*/, uint32_t cur_stencil) {
-  return std::max<uint32_t>(0, cur_stencil - 1);
+  return cur_stencil == 0 ? 0 : cur_stencil - 1;
 }
 
 uint32_t sop_invert(uint32_t /*ref*/, uint32_t cur_stencil) {
@@ -241,6 +276,83 @@ uint32_t depth_stencil_state::mask_stencil(uint32_t stencil, uint32_t mask) cons
   return mask_stencil_(stencil, mask);
 }
 
+blend_state::blend_state(const blend_desc& desc) : desc_(desc) {
+}
+
+const blend_desc& blend_state::get_desc() const {
+  return desc_;
+}
+
+const render_target_blend_desc& blend_state::render_target(size_t index) const {
+  return desc_.render_target[desc_.independent_blend_enable ? index : 0];
+}
+
+namespace {
+thread_local framebuffer_tile* bound_tile = nullptr;
+
+// Buffer is reused if it has the format and sample count of target.
+surface* tile_buffer(surface_ptr& storage, surface const* target, size_t size) {
+  if (target == nullptr) {
+    return nullptr;
+  }
+  if (!storage || storage->width() != size || storage->height() != size ||
+      storage->sample_count() != target->sample_count() ||
+      storage->get_pixel_format() != target->get_pixel_format()) {
+    storage =
+        make_shared<surface>(size, size, target->sample_count(), target->get_pixel_format());
+  }
+  return storage.get();
+}
+
+// Copies rows of tile between target and buffer. Pixels out of target are skipped.
+void copy_tile_rows(surface* target, surface* buffer, size_t left, size_t top, bool load) {
+  size_t const width = min(buffer->width(), target->width() - left);
+  size_t const height = min(buffer->height(), target->height() - top);
+  size_t const row_size =
+      width * target->sample_count() * color_infos[target->get_pixel_format()].size;
+  for (size_t y = 0; y < height; ++y) {
+    void* target_row = target->texel_address(left, top + y, 0);
+    void* buffer_row = buffer->texel_address(0, y, 0);
+    if (load) {
+      memcpy(buffer_row, target_row, row_size);
+    } else {
+      memcpy(target_row, buffer_row, row_size);
+    }
+  }
+}
+
+// Tile of pending clear is filled by the texel of clear rather than read from target.
+void load_tile(surface* target, surface* buffer, size_t left, size_t top) {
+  size_t const size = buffer->width();
+  if (void const* texel = target->pending_clear(left, top, size, size)) {
+    buffer->clear(texel);
+    buffer->expand_clears();
+    return;
+  }
+  target->expand_clears(left, top, size, size);
+  copy_tile_rows(target, buffer, left, top, true);
+}
+
+// All texels of tile in target are written, so clears of the tile are not pending any more.
+void store_tile(surface* target, surface* buffer, size_t left, size_t top) {
+  copy_tile_rows(target, buffer, left, top, false);
+  target->discard_clears(left, top, buffer->width(), buffer->height());
+}
+}  // namespace
+
+framebuffer_tile::framebuffer_tile()
+  : left_(0)
+  , top_(0)
+  , ds_target_(nullptr)
+  , ds_buffer_(nullptr)
+  , color_drawn_(false)
+  , ds_drawn_(false) {
+  for (size_t i = 0; i < MAX_RENDER_TARGETS; ++i) {
+    color_targets_[i] = nullptr;
+    color_buffers_[i] = nullptr;
+  }
+}
+
 bool depth_stencil_state::depth_test(float ps_depth, float cur_depth) const {
   return depth_test_(ps_depth, cur_depth);
 }
@@ -292,6 +404,11 @@ void read_depth_1_stencil_1(float& depth,
   stencil &= stencil_mask;
 }
 
+typedef void (*write_depth_stencil_fn)(void* ds_data,
+                                       float depth,
+                                       uint32_t stencil,
+                                       uint32_t stencil_mask);
+
 void write_depth_0_stencil_0(void* /*ds_data*/,
                              float /*depth*/,
                              uint32_t /*stencil*/,
@@ -335,12 +452,32 @@ void framebuffer::update(render_state* state) {
   stencil_write_mask_ = ds_state_->get_desc().stencil_write_mask;
   stencil_ref_ = ds_state_->mask_stencil(state->stencil_ref, stencil_read_mask_);
 
+  depth_stencil_op_desc const* face_ops[2] = {&ds_state_->get_desc().front_face,
+                                              &ds_state_->get_desc().back_face};
+  for (int i = 0; i < 2; ++i) {
+    stencil_params_[i] = {stencil_ref_,
+                          stencil_read_mask_,
+                          stencil_write_mask_,
+                          face_ops[i]->stencil_func,
+                          face_ops[i]->stencil_pass_op};
+  }
+
   assert(state->color_targets.size() <= MAX_RENDER_TARGETS);
   memset(color_targets_, 0, sizeof(color_targets_));
   for (size_t i = 0; i < state->color_targets.size(); ++i) {
     color_targets_[i] = state->color_targets[i].get();
   }
 
+  blend_kernels_enabled_ = !state->cpp_bs && state->bl_state;
+  for (size_t i = 0; i < MAX_RENDER_TARGETS; ++i) {
+    blend_quad_[i] = nullptr;
+    if (blend_kernels_enabled_ && color_targets_[i] != nullptr) {
+      blend_descs_[i] = state->bl_state->render_target(i);
+      blend_quad_[i] =
+          select_blend_quad_kernel(color_targets_[i]->get_pixel_format(), blend_descs_[i]);
+    }
+  }
+
   ds_target_ = state->depth_stencil_target.get();
   sample_count_ = static_cast<uint32_t>(state->target_sample_count);
   px_full_mask_ = (1UL << sample_count_) - 1;
@@ -353,6 +490,85 @@ void framebuffer::update(render_state* state) {
   }
 
   update_ds_rw_functions(ds_format_changed, ds_state_changed, output_depth_enabled);
+  update_hiz(output_depth_enabled);
+}
+
+void framebuffer::update_hiz(bool output_depth_enabled) {
+  if (hiz_disabled_) {
+    hiz_enabled_ = false;
+    hiz_track_writes_ = false;
+    return;
+  }
+
+  hierarchical_z::read_depth_fn read_depth = nullptr;
+  if (ds_target_ != nullptr) {
+    switch (ds_target_->get_pixel_format()) {
+    case pixel_format_color_rg32f:
+      read_depth = depth_stencil_accessor<pixel_format_color_rg32f>::read_depth;
+      break;
+    case pixel_format_color_d16:
+      read_depth = depth_stencil_accessor<pixel_format_color_d16>::read_depth;
+      break;
+    case pixel_format_color_d24s8:
+      read_depth = depth_stencil_accessor<pixel_format_color_d24s8>::read_depth;
+      break;
+    case pixel_format_color_d32f:
+      read_depth = depth_stencil_accessor<pixel_format_color_d32f>::read_depth;
+      break;
+    case pixel_format_color_d32f_s8x24:
+      read_depth = depth_stencil_accessor<pixel_format_color_d32f_s8x24>::read_depth;
+      break;
+    default: break;
+    }
+  }
+
+  // Target is rebuilt if it is another surface or it is written out of framebuffer.
+  if (!hiz_.tracks(ds_target_)) {
+    hiz_.reset(ds_target_, read_depth);
+    if (ds_target_ != nullptr && ds_target_ == hiz_cleared_target_ &&
+        ds_target_->generation() == hiz_cleared_generation_) {
+      hiz_.clear(hiz_cleared_depth_);
+      hiz_cleared_target_ = nullptr;
+    }
+  }
+
+  auto const& desc = ds_state_->get_desc();
+  hiz_track_writes_ = read_depth != nullptr && desc.depth_enable && desc.depth_write_mask &&
+      desc.depth_func != compare_function_never;
+
+  hiz_enabled_ = false;
+  if (read_depth != nullptr && desc.depth_enable && !desc.stencil_enable && !output_depth_enabled) {
+    switch (desc.depth_func) {
+    case compare_function_less:
+    case compare_function_less_equal:
+    case compare_function_greater:
+    case compare_function_greater_equal: hiz_enabled_ = true; break;
+    default: break;
+    }
+  }
+}
+
+void framebuffer::refresh_hiz() {
+  hiz_.refresh();
+}
+
+void framebuffer::invalidate_hiz() {
+  hiz_.reset(nullptr, nullptr);
+}
+
+void framebuffer::hiz_depth_cleared(surface const* tar, float depth) {
+  if (quantize_depth_fn quantize_depth = select_quantize_depth(tar->get_pixel_format())) {
+    depth = quantize_depth(depth);
+  }
+  if (tar == hiz_.target()) {
+    // Surface could be a new one at the address of the bound target, so bounds are reset for it.
+    hiz_.reset(tar, hiz_.read_depth());
+    hiz_.clear(depth);
+  } else {
+    hiz_cleared_target_ = tar;
+    hiz_cleared_generation_ = tar->generation();
+    hiz_cleared_depth_ = depth;
+  }
 }
 
 void framebuffer::update_ds_rw_functions(bool ds_format_changed,
@@ -364,6 +580,10 @@ void framebuffer::update_ds_rw_functions(bool ds_format_changed,
 
   read_depth_stencil_ = read_depth_0_stencil_0;
   write_depth_stencil_ = write_depth_0_stencil_0;
+  quantize_depth_ = nullptr;
+  write_depth_enabled_ = false;
+  depth_row_ = nullptr;
+  depth_stencil_quad_ = nullptr;
 
   if (ds_target_ == nullptr) {
     return;
@@ -374,54 +594,97 @@ void framebuffer::update_ds_rw_functions(bool ds_format_changed,
   bool write_depth = false;
   bool write_stencil = false;
 
-  switch (ds_target_->get_pixel_format()) {
+  if (ds_state_->get_desc().depth_enable) {
+    if (ds_state_->get_desc().depth_func != compare_function_never &&
+        ds_state_->get_desc().depth_func != compare_function_always) {
+      read_depth = true;
+    }
+
+    if (ds_state_->get_desc().depth_write_mask &&
+        ds_state_->get_desc().depth_func != compare_function_never) {
+      write_depth = true;
+    }
+  }
+
+  read_stencil = write_stencil = ds_state_->get_desc().stencil_enable;
+
+  pixel_format const ds_format = ds_target_->get_pixel_format();
+  switch (ds_format) {
   case pixel_format_color_rg32f:
-    if (ds_state_->get_desc().depth_enable) {
-      if (ds_state_->get_desc().depth_func != compare_function_never &&
-          ds_state_->get_desc().depth_func != compare_function_always) {
-        read_depth = true;
-      }
+    update_ds_accessors<pixel_format_color_rg32f>(
+        read_depth, read_stencil, write_depth, write_stencil);
+    break;
+  case pixel_format_color_d16:
+    update_ds_accessors<pixel_format_color_d16>(
+        read_depth, read_stencil, write_depth, write_stencil);
+    break;
+  case pixel_format_color_d24s8:
+    update_ds_accessors<pixel_format_color_d24s8>(
+        read_depth, read_stencil, write_depth, write_stencil);
+    break;
+  case pixel_format_color_d32f:
+    update_ds_accessors<pixel_format_color_d32f>(
+        read_depth, read_stencil, write_depth, write_stencil);
+    break;
+  case pixel_format_color_d32f_s8x24:
+    update_ds_accessors<pixel_format_color_d32f_s8x24>(
+        read_depth, read_stencil, write_depth, write_stencil);
+    break;
+  default: return;
+  }
 
-      if (ds_state_->get_desc().depth_write_mask &&
-          ds_state_->get_desc().depth_func != compare_function_never) {
-        write_depth = true;
-      }
+  quantize_depth_ = select_quantize_depth(ds_format);
+  write_depth_enabled_ = write_depth;
+
+  // Kernels work on samples of 8 bytes with float depth followed by stencil.
+  if (ds_format == pixel_format_color_rg32f || ds_format == pixel_format_color_d32f_s8x24) {
+#if !SALVIA_TILED_SURFACE
+    if (write_depth) {
+      depth_row_ = select_depth_row_kernel(ds_state_->get_desc().depth_func);
     }
+#endif
+    depth_stencil_quad_ = select_depth_stencil_quad_kernel(ds_state_->get_desc().depth_enable
+                                                               ? ds_state_->get_desc().depth_func
+                                                               : compare_function_always,
+                                                           write_depth,
+                                                           write_stencil);
+  }
 
-    read_stencil = write_stencil = ds_state_->get_desc().stencil_enable;
+  early_z_enabled_ = !ds_state_->get_desc().stencil_enable && !output_depth_enabled;
+}
 
-    if (read_depth) {
-      if (read_stencil) {
-        read_depth_stencil_ = read_depth_1_stencil_1<pixel_format_color_rg32f>;
-      } else {
-        read_depth_stencil_ = read_depth_1_stencil_0<pixel_format_color_rg32f>;
-      }
+template <uint32_t Format>
+void framebuffer::update_ds_accessors(bool read_depth,
+                                      bool read_stencil,
+                                      bool write_depth,
+                                      bool write_stencil) {
+  if (read_depth) {
+    if (read_stencil) {
+      read_depth_stencil_ = read_depth_1_stencil_1<Format>;
     } else {
-      if (read_stencil) {
-        read_depth_stencil_ = read_depth_0_stencil_1<pixel_format_color_rg32f>;
-      } else {
-        read_depth_stencil_ = read_depth_0_stencil_0;
-      }
+      read_depth_stencil_ = read_depth_1_stencil_0<Format>;
     }
-
-    if (write_depth) {
-      if (write_stencil) {
-        write_depth_stencil_ = write_depth_1_stencil_1<pixel_format_color_rg32f>;
-      } else {
-        write_depth_stencil_ = write_depth_1_stencil_0<pixel_format_color_rg32f>;
-      }
+  } else {
+    if (read_stencil) {
+      read_depth_stencil_ = read_depth_0_stencil_1<Format>;
     } else {
-      if (write_stencil) {
-        write_depth_stencil_ = write_depth_0_stencil_1<pixel_format_color_rg32f>;
-      } else {
-        write_depth_stencil_ = write_depth_0_stencil_0;
-      }
+      read_depth_stencil_ = read_depth_0_stencil_0;
     }
-    break;
-  default: return;
   }
 
-  early_z_enabled_ = !ds_state_->get_desc().stencil_enable && !output_depth_enabled;
+  if (write_depth) {
+    if (write_stencil) {
+      write_depth_stencil_ = write_depth_1_stencil_1<Format>;
+    } else {
+      write_depth_stencil_ = write_depth_1_stencil_0<Format>;
+    }
+  } else {
+    if (write_stencil) {
+      write_depth_stencil_ = write_depth_0_stencil_1<Format>;
+    } else {
+      write_depth_stencil_ = write_depth_0_stencil_0;
+    }
+  }
 }
 
 framebuffer::framebuffer() {
@@ -437,6 +700,22 @@ framebuffer::framebuffer() {
 
   read_depth_stencil_ = nullptr;
   write_depth_stencil_ = nullptr;
+  quantize_depth_ = nullptr;
+  write_depth_enabled_ = false;
+  depth_row_ = nullptr;
+  depth_stencil_quad_ = nullptr;
+
+  blend_kernels_enabled_ = false;
+  for (size_t i = 0; i < MAX_RENDER_TARGETS; ++i) {
+    blend_quad_[i] = nullptr;
+  }
+
+  hiz_disabled_ = false;
+  hiz_enabled_ = false;
+  hiz_track_writes_ = false;
+  hiz_cleared_target_ = nullptr;
+  hiz_cleared_generation_ = 0;
+  hiz_cleared_depth_ = 0.0f;
 }
 
 framebuffer::~framebuffer() {
@@ -449,33 +728,31 @@ void framebuffer::render_sample(cpp_blend_shader* cpp_bs,
                                 const ps_output& ps,
                                 float depth,
                                 bool front_face) {
-  EF_ASSERT(cpp_bs, "Blend shader is null or invalid.");
-  if (!cpp_bs)
+  EF_ASSERT(cpp_bs || blend_kernels_enabled_, "Blend shader is null or invalid.");
+  if (!cpp_bs && !blend_kernels_enabled_)
     return;
 
-  // composing output
-  pixel_accessor target_pixel(color_targets_, ds_target_);
-  target_pixel.set_pos(x, y);
+  draw_targets const targets = bound_targets();
+  if (!early_z_enabled_) {
+    if (!depth_stencil_test(targets, x, y, i_sample, depth, front_face)) {
+      return;
+    }
+    if (hiz_track_writes_) {
+      hiz_.mark_dirty(x, y);
+    }
+  }
 
-  if (early_z_enabled_) {
-    cpp_bs->execute(i_sample, target_pixel, ps);
+  if (blend_kernels_enabled_) {
+    // Sample is blended as the first pixel of a quad.
+    blend_quad(targets, x, y, 1ULL << i_sample, &ps);
     return;
   }
 
-  void* ds_data = target_pixel.depth_stencil_address(i_sample);
-  float old_depth;
-  uint32_t old_stencil;
-  read_depth_stencil_(old_depth, old_stencil, stencil_read_mask_, ds_data);
-
-  bool depth_passed = ds_state_->depth_test(depth, old_depth);
-  bool stencil_passed = ds_state_->stencil_test(front_face, stencil_ref_, old_stencil);
-
-  if (depth_passed && stencil_passed) {
-    int32_t new_stencil = ds_state_->stencil_operation(
-        front_face, depth_passed, stencil_passed, stencil_ref_, old_stencil);
-    cpp_bs->execute(i_sample, target_pixel, ps);
-    write_depth_stencil_(ds_data, depth, new_stencil, stencil_write_mask_);
-  }
+  // composing output
+  pixel_accessor target_pixel(targets.color, targets.ds);
+  target_pixel.set_pos(x - targets.left, y - targets.top);
+  cpp_bs->execute(i_sample, target_pixel, ps);
+  targets.mark_drawn(true, false);
 }
 
 void framebuffer::render_sample_quad(cpp_blend_shader* cpp_bs,
@@ -486,79 +763,228 @@ void framebuffer::render_sample_quad(cpp_blend_shader* cpp_bs,
                                      float const* depth,
                                      bool front_face,
                                      float const* aa_offset) {
-  EF_ASSERT(cpp_bs, "Blend shader is null or invalid.");
-  if (!cpp_bs)
+  EF_ASSERT(cpp_bs || blend_kernels_enabled_, "Blend shader is null or invalid.");
+  if (!cpp_bs && !blend_kernels_enabled_)
     return;
 
-  for (int i = 0; i < 4; ++i) {
-    size_t pixel_x = x + (i & 1);
-    size_t pixel_y = y + ((i & 2) >> 1);
+  draw_targets const targets = bound_targets();
+
+  // Depth and stencil of the quad are tested and written together, then passed samples are blended.
+  if (!early_z_enabled_) {
+    sample_mask = depth_stencil_test_quad(targets, x, y, sample_mask, depth, front_face, aa_offset);
+  }
+
+  if (blend_kernels_enabled_) {
+    blend_quad(targets, x, y, sample_mask, quad);
+    return;
+  }
 
-    uint64_t px_sample_mask = sample_mask & SAMPLE_MASK;
+  targets.mark_drawn(sample_mask != 0, false);
+  for (int i = 0; i < 4; ++i) {
+    uint32_t px_sample_mask = static_cast<uint32_t>(sample_mask) & SAMPLE_MASK;
     sample_mask >>= MAX_SAMPLE_COUNT;
 
     if (px_sample_mask == 0) {
       continue;
     }
 
-    if (sample_count_ == 1) {
-      render_sample(cpp_bs, pixel_x, pixel_y, 0, quad[i], depth[i], front_face);
-    } else if (px_sample_mask == px_full_mask_) {
-      for (uint32_t i_samp = 0; i_samp < sample_count_; ++i_samp) {
-        render_sample(
-            cpp_bs, pixel_x, pixel_y, i_samp, quad[i], depth[i] + aa_offset[i_samp], front_face);
-      }
-    } else {
-      uint32_t i_samp;
-      while (_xmm_bsf(&i_samp, (uint32_t)px_sample_mask)) {
-        render_sample(
-            cpp_bs, pixel_x, pixel_y, i_samp, quad[i], depth[i] + aa_offset[i_samp], front_face);
-        px_sample_mask &= px_sample_mask - 1;
+    pixel_accessor target_pixel(targets.color, targets.ds);
+    target_pixel.set_pos(x + (i & 1) - targets.left, y + (i >> 1) - targets.top);
+    uint32_t i_samp;
+    while (_xmm_bsf(&i_samp, px_sample_mask)) {
+      cpp_bs->execute(i_samp, target_pixel, quad[i]);
+      px_sample_mask &= px_sample_mask - 1;
+    }
+  }
+}
+
+void framebuffer::late_depth_stencil(
+    size_t x, size_t y, uint32_t px_mask, float depth, bool front_face, float const* aa_offset) {
+  EF_ASSERT(!early_z_enabled_, "Depth and stencil of samples are tested by early Z.");
+
+  draw_targets const targets = bound_targets();
+  bool passed = false;
+  uint32_t i_samp;
+  while (_xmm_bsf(&i_samp, px_mask)) {
+    float const sample_depth = sample_count_ == 1 ? depth : depth + aa_offset[i_samp];
+    passed |= depth_stencil_test(targets, x, y, i_samp, sample_depth, front_face);
+    px_mask &= px_mask - 1;
+  }
+  if (hiz_track_writes_ && passed) {
+    hiz_.mark_dirty(x, y);
+  }
+}
+
+void framebuffer::late_depth_stencil_quad(size_t x,
+                                          size_t y,
+                                          uint64_t quad_mask,
+                                          float const* depth,
+                                          bool front_face,
+                                          float const* aa_offset) {
+  EF_ASSERT(!early_z_enabled_, "Depth and stencil of samples are tested by early Z.");
+
+  draw_targets const targets = bound_targets();
+  depth_stencil_test_quad(targets, x, y, quad_mask, depth, front_face, aa_offset);
+}
+
+uint64_t framebuffer::depth_stencil_test_quad(draw_targets const& targets,
+                                              size_t x,
+                                              size_t y,
+                                              uint64_t quad_mask,
+                                              float const* depth,
+                                              bool front_face,
+                                              float const* aa_offset) {
+  if (hiz_track_writes_ && quad_mask != 0) {
+    hiz_.mark_dirty(x, y);
+  }
+
+  if (depth_stencil_quad_ != nullptr) {
+    float* ds_rows[2];
+    quad_ds_rows(targets, x, y, quad_mask, ds_rows);
+    quad_mask = depth_stencil_quad_(ds_rows,
+                                    sample_count_,
+                                    quad_mask,
+                                    depth,
+                                    aa_offset,
+                                    &stencil_params_[front_face ? 0 : 1]);
+    targets.mark_drawn(false, quad_mask != 0);
+    return quad_mask;
+  }
+
+  uint64_t passed_mask = 0;
+  for (int i = 0; i < 4; ++i) {
+    uint32_t px_sample_mask =
+        static_cast<uint32_t>(quad_mask >> (MAX_SAMPLE_COUNT * i)) & SAMPLE_MASK;
+    uint32_t i_samp;
+    while (_xmm_bsf(&i_samp, px_sample_mask)) {
+      float const sample_depth = sample_count_ == 1 ? depth[i] : depth[i] + aa_offset[i_samp];
+      if (depth_stencil_test(
+              targets, x + (i & 1), y + (i >> 1), i_samp, sample_depth, front_face)) {
+        passed_mask |= 1ULL << (MAX_SAMPLE_COUNT * i + i_samp);
       }
+      px_sample_mask &= px_sample_mask - 1;
     }
   }
+  return passed_mask;
 }
 
-uint64_t framebuffer::early_z_test(size_t x, size_t y, float depth, float const* aa_z_offset) {
-  pixel_accessor target_pixel(color_targets_, ds_target_);
-  target_pixel.set_pos(x, y);
+bool framebuffer::depth_stencil_test(draw_targets const& targets,
+                                     size_t x,
+                                     size_t y,
+                                     size_t i_sample,
+                                     float depth,
+                                     bool front_face) {
+  // All samples pass without depth stencil target.
+  if (targets.ds == nullptr) {
+    return true;
+  }
 
-  if (sample_count_ == 1) {
-    void* ds_data = target_pixel.depth_stencil_address(0);
-    float old_depth;
-    uint32_t old_stencil;
-    read_depth_stencil_(old_depth, old_stencil, stencil_read_mask_, ds_data);
-    if (ds_state_->depth_test(depth, old_depth)) {
-      assert(!ds_state_->get_desc().stencil_enable);
-      write_depth_stencil_(ds_data, depth, 0, 0);
-      return 1;
+  void* ds_data = targets.ds->texel_address(x - targets.left, y - targets.top, i_sample);
+  float old_depth;
+  uint32_t old_stencil;
+  read_depth_stencil_(old_depth, old_stencil, stencil_read_mask_, ds_data);
+
+  depth = quantized_depth(depth);
+  bool depth_passed = ds_state_->depth_test(depth, old_depth);
+  bool stencil_passed = ds_state_->stencil_test(front_face, stencil_ref_, old_stencil);
+
+  if (!depth_passed || !stencil_passed) {
+    return false;
+  }
+
+  int32_t new_stencil = ds_state_->stencil_operation(
+      front_face, depth_passed, stencil_passed, stencil_ref_, old_stencil);
+  write_depth_stencil_(ds_data, depth, new_stencil, stencil_write_mask_);
+  targets.mark_drawn(false, true);
+  return true;
+}
+
+void framebuffer::blend_quad(draw_targets const& targets,
+                             size_t x,
+                             size_t y,
+                             uint64_t quad_mask,
+                             ps_output const* quad) {
+  if (quad_mask == 0) {
+    return;
+  }
+
+  targets.mark_drawn(true, false);
+  size_t const tile_x = x - targets.left;
+  size_t const tile_y = y - targets.top;
+  uint64_t const row_mask = (1ULL << (MAX_SAMPLE_COUNT * 2)) - 1;
+  vec4 colors[4];
+  for (size_t rt = 0; rt < MAX_RENDER_TARGETS; ++rt) {
+    if (blend_quad_[rt] == nullptr) {
+      continue;
+    }
+
+    for (int i = 0; i < 4; ++i) {
+      if ((quad_mask >> (MAX_SAMPLE_COUNT * i)) & SAMPLE_MASK) {
+        colors[i] = quad[i].color[rt];
+      }
     }
-    return 0;
+
+    surface* target = targets.color[rt];
+    void* rows[2] = {
+        (quad_mask & row_mask) != 0 ? target->texel_address(tile_x, tile_y, 0) : nullptr,
+        (quad_mask >> (MAX_SAMPLE_COUNT * 2)) != 0 ? target->texel_address(tile_x, tile_y + 1, 0)
+                                                   : nullptr};
+    blend_quad_[rt](rows, sample_count_, quad_mask, colors, &blend_descs_[rt]);
   }
+}
+
+uint64_t framebuffer::early_z_test(size_t x, size_t y, float depth, float const* aa_z_offset) {
+  draw_targets const targets = bound_targets();
+  targets.mark_drawn(false, write_depth_enabled_);
 
   uint64_t mask = 0;
-  for (size_t i = 0; i < sample_count_; ++i) {
-    void* ds_data = target_pixel.depth_stencil_address(i);
-    float old_depth;
-    uint32_t old_stencil;
-    read_depth_stencil_(old_depth, old_stencil, stencil_read_mask_, ds_data);
-    float new_depth = aa_z_offset[i] + depth;
-    bool depth_test_passed = ds_state_->depth_test(new_depth, old_depth);
-    mask |= (depth_test_passed ? 1 : 0) << i;
-    if (depth_test_passed) {
-      write_depth_stencil_(ds_data, new_depth, 0, 0);
+  if (depth_stencil_quad_ != nullptr) {
+    float* ds_rows[2] = {
+        static_cast<float*>(targets.ds->texel_address(x - targets.left, y - targets.top, 0)),
+        nullptr};
+    float const quad_depth[4] = {depth, depth, depth, depth};
+    mask = depth_stencil_quad_(
+        ds_rows, sample_count_, px_full_mask_, quad_depth, aa_z_offset, nullptr);
+  } else {
+    pixel_accessor target_pixel(targets.color, targets.ds);
+    target_pixel.set_pos(x - targets.left, y - targets.top);
+
+    for (size_t i = 0; i < sample_count_; ++i) {
+      void* ds_data = target_pixel.depth_stencil_address(i);
+      float old_depth;
+      uint32_t old_stencil;
+      read_depth_stencil_(old_depth, old_stencil, stencil_read_mask_, ds_data);
+      float new_depth = quantized_depth(sample_count_ == 1 ? depth : aa_z_offset[i] + depth);
+      bool depth_test_passed = ds_state_->depth_test(new_depth, old_depth);
+      mask |= (depth_test_passed ? 1 : 0) << i;
+      if (depth_test_passed) {
+        assert(!ds_state_->get_desc().stencil_enable);
+        write_depth_stencil_(ds_data, new_depth, 0, 0);
+      }
     }
   }
 
+  // Pixels drawn alone, e.g. points, update Hi-Z as quads.
+  if (hiz_track_writes_ && mask != 0) {
+    hiz_.mark_dirty(x, y);
+  }
   return mask;
 }
 
 uint64_t
 framebuffer::early_z_test_quad(size_t x, size_t y, float const* depth, float const* aa_z_offset) {
-  return (early_z_test(x + 0, y + 0, depth[0], aa_z_offset) << (MAX_SAMPLE_COUNT * 0)) |
+  if (depth_stencil_quad_ != nullptr) {
+    // Full mask of pixel is repeated for 4 pixels.
+    uint64_t const quad_mask = px_full_mask_ * 0x0001000100010001ULL;
+    return early_z_test_quad(x, y, quad_mask, depth, aa_z_offset);
+  }
+
+  uint64_t mask = (early_z_test(x + 0, y + 0, depth[0], aa_z_offset) << (MAX_SAMPLE_COUNT * 0)) |
       (early_z_test(x + 1, y + 0, depth[1], aa_z_offset) << (MAX_SAMPLE_COUNT * 1)) |
       (early_z_test(x + 0, y + 1, depth[2], aa_z_offset) << (MAX_SAMPLE_COUNT * 2)) |
       (early_z_test(x + 1, y + 1, depth[3], aa_z_offset) << (MAX_SAMPLE_COUNT * 3));
+
+  return mask;
 }
 
 uint64_t framebuffer::early_z_test(
@@ -567,8 +993,11 @@ uint64_t framebuffer::early_z_test(
     return early_z_test(x, y, depth, aa_z_offset);
   }
 
-  pixel_accessor target_pixel(color_targets_, ds_target_);
-  target_pixel.set_pos(x, y);
+  draw_targets const targets = bound_targets();
+  targets.mark_drawn(false, write_depth_enabled_);
+
+  pixel_accessor target_pixel(targets.color, targets.ds);
+  target_pixel.set_pos(x - targets.left, y - targets.top);
 
   uint64_t mask = 0;
   uint32_t i_samp;
@@ -577,7 +1006,7 @@ uint64_t framebuffer::early_z_test(
     float old_depth;
     uint32_t old_stencil;
     read_depth_stencil_(old_depth, old_stencil, stencil_read_mask_, ds_data);
-    float new_depth = aa_z_offset[i_samp] + depth;
+    float new_depth = quantized_depth(aa_z_offset[i_samp] + depth);
     bool depth_test_passed = ds_state_->depth_test(new_depth, old_depth);
     mask |= (depth_test_passed ? 1 : 0) << i_samp;
     px_mask &= (px_mask - 1);
@@ -586,11 +1015,28 @@ uint64_t framebuffer::early_z_test(
     }
   }
 
+  if (hiz_track_writes_ && mask != 0) {
+    hiz_.mark_dirty(x, y);
+  }
   return mask;
 }
 
 uint64_t framebuffer::early_z_test_quad(
     size_t x, size_t y, uint64_t quad_mask, float const* depth, float const* aa_z_offset) {
+  if (depth_stencil_quad_ != nullptr) {
+    draw_targets const targets = bound_targets();
+    targets.mark_drawn(false, write_depth_enabled_);
+
+    float* ds_rows[2];
+    quad_ds_rows(targets, x, y, quad_mask, ds_rows);
+    uint64_t const mask =
+        depth_stencil_quad_(ds_rows, sample_count_, quad_mask, depth, aa_z_offset, nullptr);
+    if (hiz_track_writes_ && mask != 0) {
+      hiz_.mark_dirty(x, y);
+    }
+    return mask;
+  }
+
   uint32_t px_mask;
 
   uint64_t mask = 0;
@@ -613,24 +1059,157 @@ uint64_t framebuffer::early_z_test_quad(
   return mask;
 }
 
+void framebuffer::quad_ds_rows(
+    draw_targets const& targets, size_t x, size_t y, uint64_t quad_mask, float** ds_rows) const {
+  size_t const tile_x = x - targets.left;
+  size_t const tile_y = y - targets.top;
+  uint64_t const row_mask = (1ULL << (MAX_SAMPLE_COUNT * 2)) - 1;
+  ds_rows[0] = (quad_mask & row_mask) != 0
+      ? static_cast<float*>(targets.ds->texel_address(tile_x, tile_y, 0))
+      : nullptr;
+  ds_rows[1] = (quad_mask >> (MAX_SAMPLE_COUNT * 2)) != 0
+      ? static_cast<float*>(targets.ds->texel_address(tile_x, tile_y + 1, 0))
+      : nullptr;
+}
+
+void framebuffer::draw_depth_row(size_t x,
+                                 size_t y,
+                                 uint32_t count,
+                                 float z,
+                                 float dzdx,
+                                 uint32_t const* pixel_masks,
+                                 float const* aa_z_offset) {
+  assert(early_z_enabled_);
+  if (!write_depth_enabled_ || count == 0) {
+    return;
+  }
+
+  // Pixels are tested one by one if no row kernel supports the target, they mark Hi-Z themselves.
+  if (depth_row_ == nullptr) {
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t const px_mask = pixel_masks ? pixel_masks[i] : px_full_mask_;
+      if (px_mask != 0) {
+        early_z_test(x + i, y, px_mask, z + i * dzdx, aa_z_offset);
+      }
+    }
+    return;
+  }
+
+  draw_targets const targets = bound_targets();
+  targets.mark_drawn(false, true);
+
+  float* ds_row =
+      static_cast<float*>(targets.ds->texel_address(x - targets.left, y - targets.top, 0));
+  if (depth_row_(ds_row, sample_count_, count, z, dzdx, aa_z_offset, pixel_masks) &&
+      hiz_track_writes_) {
+    for (size_t hiz_x = x; hiz_x < x + count; hiz_x += hierarchical_z::HIZ_SUBTILE_SIZE) {
+      hiz_.mark_dirty(hiz_x, y);
+    }
+    hiz_.mark_dirty(x + count - 1, y);
+  }
+}
+
+framebuffer::draw_targets framebuffer::bound_targets() {
+  framebuffer_tile* tile = bound_tile;
+  if (tile == nullptr) {
+    return {color_targets_, ds_target_, 0, 0, nullptr};
+  }
+  EF_ASSERT(tile->ds_target_ == ds_target_ && tile->color_targets_[0] == color_targets_[0],
+            "Tile is bound to other targets.");
+  return {tile->color_buffers_, tile->ds_buffer_, tile->left_, tile->top_, tile};
+}
+
+void framebuffer::begin_tile(framebuffer_tile* tile, size_t left, size_t top, size_t size) const {
+  EF_ASSERT(bound_tile == nullptr, "A tile has been bound to the thread.");
+
+  tile->left_ = left;
+  tile->top_ = top;
+  tile->color_drawn_ = false;
+  tile->ds_drawn_ = false;
+
+  for (size_t i = 0; i < MAX_RENDER_TARGETS; ++i) {
+    tile->color_targets_[i] = color_targets_[i];
+    tile->color_buffers_[i] = tile_buffer(tile->color_storage_[i], color_targets_[i], size);
+    if (color_targets_[i] != nullptr) {
+      load_tile(color_targets_[i], tile->color_buffers_[i], left, top);
+    }
+  }
+  tile->ds_target_ = ds_target_;
+  tile->ds_buffer_ = tile_buffer(tile->ds_storage_, ds_target_, size);
+  if (ds_target_ != nullptr) {
+    load_tile(ds_target_, tile->ds_buffer_, left, top);
+  }
+
+  bound_tile = tile;
+}
+
+void framebuffer::end_tile(framebuffer_tile* tile) {
+  EF_ASSERT(bound_tile == tile, "Tile is not bound to the thread.");
+  bound_tile = nullptr;
+
+  if (tile->color_drawn_) {
+    for (size_t i = 0; i < MAX_RENDER_TARGETS; ++i) {
+      if (tile->color_targets_[i] != nullptr) {
+        store_tile(tile->color_targets_[i], tile->color_buffers_[i], tile->left_, tile->top_);
+      }
+    }
+  }
+  if (tile->ds_drawn_ && tile->ds_target_ != nullptr) {
+    store_tile(tile->ds_target_, tile->ds_buffer_, tile->left_, tile->top_);
+  }
+}
+
+void framebuffer::expand_clears(size_t left, size_t top, size_t size) const {
+  if (bound_tile != nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < MAX_RENDER_TARGETS; ++i) {
+    if (color_targets_[i] != nullptr) {
+      color_targets_[i]->expand_clears(left, top, size, size);
+    }
+  }
+  if (ds_target_ != nullptr) {
+    ds_target_->expand_clears(left, top, size, size);
+  }
+}
+
+template <uint32_t Format>
+write_depth_stencil_fn select_clear_op(uint32_t flag) {
+  switch (flag) {
+  case (clear_depth | clear_stencil): return write_depth_1_stencil_1<Format>;
+  case clear_depth: return write_depth_1_stencil_0<Format>;
+  case clear_stencil: return write_depth_0_stencil_1<Format>;
+  default: ef_unimplemented();
+  }
+  return write_depth_0_stencil_0;
+}
+
 void framebuffer::clear_depth_stencil(surface* tar, uint32_t flag, float depth, uint32_t stencil) {
-  auto clear_op = write_depth_0_stencil_0;
+  write_depth_stencil_fn clear_op = write_depth_0_stencil_0;
 
   switch (tar->get_pixel_format()) {
-  case pixel_format_color_rg32f: {
-    switch (flag) {
-    case (clear_depth | clear_stencil):
-      clear_op = write_depth_1_stencil_1<pixel_format_color_rg32f>;
-      break;
-    case clear_depth: clear_op = write_depth_1_stencil_0<pixel_format_color_rg32f>; break;
-    case clear_stencil: clear_op = write_depth_0_stencil_1<pixel_format_color_rg32f>; break;
-    default: ef_unimplemented();
-    }
+  case pixel_format_color_rg32f: clear_op = select_clear_op<pixel_format_color_rg32f>(flag); break;
+  case pixel_format_color_d16: clear_op = select_clear_op<pixel_format_color_d16>(flag); break;
+  case pixel_format_color_d24s8: clear_op = select_clear_op<pixel_format_color_d24s8>(flag); break;
+  case pixel_format_color_d32f: clear_op = select_clear_op<pixel_format_color_d32f>(flag); break;
+  case pixel_format_color_d32f_s8x24:
+    clear_op = select_clear_op<pixel_format_color_d32f_s8x24>(flag);
     break;
-  }
   default: ef_unimplemented();
   }
 
+  uint8_t texel[sizeof(color_rgba32f)] = {};
+  void const* pending = tar->pending_clear(0, 0, tar->width(), tar->height());
+  if (pending != nullptr || flag == (clear_depth | clear_stencil)) {
+    if (pending != nullptr) {
+      memcpy(texel, pending, color_infos[tar->get_pixel_format()].size);
+    }
+    clear_op(texel, depth, stencil, 0xFFFFFFFFU);
+    tar->clear(texel);
+    return;
+  }
+
+  tar->expand_clears();
   for (size_t y = 0; y < tar->height(); ++y) {
     for (size_t x = 0; x < tar->width(); ++x) {
       pixel_accessor target_pixel(nullptr, tar);
@@ -641,6 +1220,7 @@ void framebuffer::clear_depth_stencil(surface* tar, uint32_t flag, float depth,
       }
     }
   }
+  tar->mark_written();
 }
 
 }  // namespace salvia::core
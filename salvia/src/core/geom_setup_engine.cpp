@@ -1,172 +1,143 @@
 #include <salvia/core/geom_setup_engine.h>
 
+#include <salvia/core/clip_kernels.h>
 #include <salvia/core/clipper.h>
-#include <salvia/core/thread_pool.h>
+#include <salvia/core/shader.h>
 #include <salvia/core/vertex_cache.h>
+#include <salvia/core/viewport.h>
 
 #include <salvia/shader/shader_regs.h>
+#include <salvia/shader/shader_regs_op.h>
 
-#include <eflib/concurrency/thread_context.h>
-#include <eflib/math/math.h>
-#include <eflib/platform/cpuinfo.h>
+#include <algorithm>
 
 using namespace salvia::shader;
 
-using eflib::clampss;
-using eflib::execute_threads;
-using eflib::thread_context;
-using std::atomic;
-
-int const GEOMETRY_SETUP_PACKAGE_SIZE = 8;
-int const COMPACT_CLIPPED_VERTS_PACKAGE_SIZE = 8;
-
 namespace salvia::core {
 
-geom_setup_engine::geom_setup_engine()
-  : clipped_verts_cap_(0)
-  , clipped_package_verts_count_cap_(0)
-  , compacted_vertex_cap_(0)
-  , clipped_package_compacted_addresses_cap_(0)
-  , clipping_package_count_(0)
-  , thread_count_(std::thread::hardware_concurrency())
-  , ctxt_(nullptr) {
-}
-
-void geom_setup_engine::execute(geom_setup_context const* ctxt, uint64_t (*fetch_time_stamp)()) {
-  ctxt_ = ctxt;
-
-  clip_geometries();
-  compact_start_time_ = fetch_time_stamp();
-  compact_geometries();
-}
-
-void geom_setup_engine::clip_geometries() {
-  clipping_package_count_ =
-      thread_context::compute_package_count(ctxt_->prim_count, GEOMETRY_SETUP_PACKAGE_SIZE);
-
-  if (clipping_package_count_ > clipped_package_verts_count_cap_) {
-    clipped_package_verts_count_.reset(new uint32_t[clipping_package_count_]);
-    clipped_package_verts_count_cap_ = clipping_package_count_;
-  }
-
-  // Initialize resource used by clipper.
-  if (clipped_verts_cap_ < ctxt_->prim_count * 3 * 3) {
-    clipped_verts_.reset(new vs_output*[ctxt_->prim_count * 3 *
-                                        3]);  // Every triangle can clipped out 3 triangles at most.
-    clipped_verts_cap_ = ctxt_->prim_count * 3 * 3;
-  }
+void geom_setup_engine::clip(geom_setup_context const* ctxt,
+                             size_t prim_begin,
+                             size_t prim_end,
+                             uint32_t thread_id,
+                             clipped_primitives& out) const {
+  size_t const prim_count = prim_end - prim_begin;
+  out.verts.resize(prim_count * MAX_CLIPPED_VERTS_PER_PRIM);
 
-  if (!vso_pools_) {
-    vso_pools_.reset(new vs_output_pool[thread_count_]);
-  }
-
-  for (size_t i = 0; i < thread_count_; ++i) {
-    vso_pools_[i].clear();
-    vso_pools_[i].reserve(
-        ctxt_->prim_count * 4,
-        16);  // Two clipping plane. In extreme case, there are 4 vertexes generated by clipper.
-  }
+  // Two clipping plane. In extreme case, there are 4 vertexes generated by clipper. Wireframe
+  // triangles clip their edges again after the polygon, which generates 4 vertexes more.
+  out.clipper_verts.clear();
+  out.clipper_verts.reserve(
+      prim_count * (ctxt->prim == pt_wireframe_tri ? 8 : 4), 16, ctxt->vso_size);
 
-  // Execute threads
-  execute_threads(
-      global_thread_pool(),
-      [this](thread_context const* thread_ctx) -> void {
-        this->threaded_clip_geometries(thread_ctx);
-      },
-      ctxt_->prim_count,
-      GEOMETRY_SETUP_PACKAGE_SIZE);
-
-  ctxt_->dvc->update_statistic();
-}
-
-void geom_setup_engine::threaded_clip_geometries(thread_context const* thread_ctx) {
   clip_context clip_ctxt;
-  clip_ctxt.vert_pool = &(vso_pools_[thread_ctx->thread_id]);
-  clip_ctxt.vso_ops = ctxt_->vso_ops;
-  clip_ctxt.cull = ctxt_->cull;
-  clip_ctxt.prim = ctxt_->prim;
+  clip_ctxt.vert_pool = &out.clipper_verts;
+  clip_ctxt.vso_ops = ctxt->vso_ops;
+  clip_ctxt.cull = ctxt->cull;
+  clip_ctxt.prim = ctxt->prim;
 
   clipper clp;
   clp.set_context(&clip_ctxt);
 
-  clip_results result{nullptr, 0, false, false};
+  clip_results result{out.verts.data(), 0, false, false};
 
   uint32_t clip_invocations = 0;
+  if (ctxt->prim == pt_solid_tri) {
+    clip_solid_triangles(ctxt, prim_begin, prim_end, thread_id, clp, result);
+    clip_invocations = static_cast<uint32_t>(prim_count);
+  } else {
+    for (size_t i = prim_begin; i < prim_end; ++i) {
+      vs_output* pv[3];
+      ctxt->dvc->fetch3(pv, i, thread_id);
+
+      ++clip_invocations;
+      clp.clip(pv, &result);
+
+      // Step output to next range
+      result.clipped_verts += result.num_clipped_verts;
+    }
+  }
 
-  thread_context::package_cursor cur = thread_ctx->next_package();
-  while (cur.valid()) {
-    std::pair<int32_t, int32_t> prim_range = cur.index_range();
-
-    result.clipped_verts = clipped_verts_.get() + prim_range.first * 9;
-    uint32_t& clipped_vertex_count = clipped_package_verts_count_[cur.package_index()];
-
-    clipped_vertex_count = 0;
-    for (int32_t i = prim_range.first; i < prim_range.second; ++i) {
-      if (3 == ctxt_->prim_size) {
-        vs_output* pv[3];
-        ctxt_->dvc->fetch3(pv, i, thread_ctx->thread_id);
+  size_t const vert_count = result.clipped_verts - out.verts.data();
+  out.verts.resize(vert_count);
+  out.prim_count = vert_count / ctxt->prim_size;
 
-        ++clip_invocations;
-        clp.clip(pv, &result);
+  ctxt->acc_cinvocations(ctxt->pipeline_stat, clip_invocations);
+}
 
-        // Step output to next range, sum total clipped vertexes count
-        result.clipped_verts += result.num_clipped_verts;
-        clipped_vertex_count += result.num_clipped_verts;
-      } else if (2 == ctxt_->prim_size) {
-        assert(false);
+void geom_setup_engine::clip_solid_triangles(geom_setup_context const* ctxt,
+                                             size_t prim_begin,
+                                             size_t prim_end,
+                                             uint32_t thread_id,
+                                             clipper& clp,
+                                             clip_results& result) const {
+  static classify_triangles_fn const classify = select_classify_triangles_kernel();
+  bool const cull_front = ctxt->cull(1.0f);
+  bool const cull_back = ctxt->cull(-1.0f);
+
+  triangle_batch batch;
+  triangle_batch_masks masks;
+  vs_output* pv[TRIANGLE_BATCH_SIZE][3];
+
+  for (size_t batch_begin = prim_begin; batch_begin < prim_end;
+       batch_begin += TRIANGLE_BATCH_SIZE) {
+    uint32_t const count =
+        static_cast<uint32_t>(std::min<size_t>(TRIANGLE_BATCH_SIZE, prim_end - batch_begin));
+    for (uint32_t t = 0; t < count; ++t) {
+      ctxt->dvc->fetch3(pv[t], batch_begin + t, thread_id);
+      for (int i = 0; i < 3; ++i) {
+        eflib::vec4 const& pos = pv[t][i]->position();
+        batch.x[i][t] = pos.x();
+        batch.y[i][t] = pos.y();
+        batch.z[i][t] = pos.z();
+        batch.w[i][t] = pos.w();
       }
     }
 
-    cur = thread_ctx->next_package();
-  }
+    classify(batch, count, cull_front, cull_back, masks);
 
-  ctxt_->acc_cinvocations(ctxt_->pipeline_stat, clip_invocations);
-}
-
-void geom_setup_engine::compact_geometries() {
-  // Compute compacted address of packages.
-  if (clipped_package_compacted_addresses_cap_ < clipping_package_count_ + 1) {
-    clipped_package_compacted_addresses_.reset(new uint32_t[clipping_package_count_ + 1]);
-    clipped_package_compacted_addresses_cap_ = clipping_package_count_ + 1;
-  }
+    for (uint32_t t = 0; t < count; ++t) {
+      uint32_t const bit = 1U << t;
+      if (masks.rejected & bit) {
+        continue;
+      }
 
-  uint32_t* addresses = clipped_package_compacted_addresses_.get();
-  addresses[0] = 0;
-  for (size_t i = 1; i <= clipping_package_count_; ++i) {
-    addresses[i] = addresses[i - 1] + clipped_package_verts_count_[i - 1];
-  }
+      if (masks.inside & bit) {
+        // Back-facing triangles are turned to front, as the clipper does.
+        int const offset = (masks.front & bit) ? 0 : 1;
+        result.clipped_verts[0] = pv[t][0];
+        result.clipped_verts[1] = pv[t][1 + offset];
+        result.clipped_verts[2] = pv[t][2 - offset];
+        result.clipped_verts += 3;
+        continue;
+      }
 
-  if (compacted_vertex_cap_ < addresses[clipping_package_count_]) {
-    compacted_vertexes_.reset(new vs_output*[addresses[clipping_package_count_]]);
-    compacted_vertex_cap_ = addresses[clipping_package_count_];
+      clp.clip(pv[t], &result);
+      result.clipped_verts += result.num_clipped_verts;
+    }
   }
-
-  // Execute threads for compacting
-  execute_threads(
-      global_thread_pool(),
-      [this](thread_context const* thread_ctx) -> void {
-        this->threaded_compact_geometries(thread_ctx);
-      },
-      clipping_package_count_,
-      COMPACT_CLIPPED_VERTS_PACKAGE_SIZE);
 }
 
-void geom_setup_engine::threaded_compact_geometries(thread_context const* thread_ctx) {
-  thread_context::package_cursor current_package = thread_ctx->next_package();
-
-  while (current_package.valid()) {
-    std::pair<int32_t, int32_t> compact_range = current_package.index_range();
-
-    for (int32_t i = compact_range.first; i < compact_range.second; ++i) {
-      vs_output** compacted_addr =
-          compacted_vertexes_.get() + clipped_package_compacted_addresses_[i];
-      vs_output** sparse_addr = clipped_verts_.get() + GEOMETRY_SETUP_PACKAGE_SIZE * i * 9;
-      size_t copy_size = clipped_package_verts_count_[i] * sizeof(vs_output*);
-
-      memcpy(compacted_addr, sparse_addr, copy_size);
-    }
+void geom_setup_engine::project(geom_setup_context const* ctxt, clipped_primitives& prims) const {
+  // Vertexes shared by primitives are projected once.
+  auto& unique_verts = prims.unique_verts;
+  unique_verts.assign(prims.verts.begin(), prims.verts.end());
+  std::sort(unique_verts.begin(), unique_verts.end());
+  unique_verts.erase(std::unique(unique_verts.begin(), unique_verts.end()), unique_verts.end());
+
+  prims.projected_verts.clear();
+  prims.projected_verts.reserve(unique_verts.size(), 16, ctxt->vso_size);
+  prims.projected_addresses.resize(unique_verts.size());
+  for (size_t i = 0; i < unique_verts.size(); ++i) {
+    vs_output* projected = prims.projected_verts.alloc();
+    ctxt->vso_ops->copy(*projected, *unique_verts[i]);
+    viewport_transform(projected->position(), *ctxt->vp);
+    ctxt->vso_ops->project(*projected, *projected);
+    prims.projected_addresses[i] = projected;
+  }
 
-    current_package = thread_ctx->next_package();
+  for (vs_output*& vert : prims.verts) {
+    auto it = std::lower_bound(unique_verts.begin(), unique_verts.end(), vert);
+    vert = prims.projected_addresses[it - unique_verts.begin()];
   }
 }
 
@@ -0,0 +1,250 @@
+#include <salvia/core/hierarchical_z.h>
+
+#include <salvia/core/thread_pool.h>
+#include <salvia/resource/surface.h>
+
+#include <eflib/concurrency/thread_context.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace eflib;
+using namespace salvia::resource;
+
+using std::max;
+using std::min;
+
+namespace salvia::core {
+
+constexpr size_t REFRESH_HIZ_PACKAGE_SIZE = 4;
+constexpr size_t SUBTILES_PER_TILE =
+    hierarchical_z::HIZ_TILE_SIZE / hierarchical_z::HIZ_SUBTILE_SIZE;
+
+namespace {
+bool depth_bounds_rejected(compare_function func,
+                           float min_z,
+                           float max_z,
+                           float bound_min,
+                           float bound_max) {
+  switch (func) {
+  case compare_function_less: return min_z >= bound_max;
+  case compare_function_less_equal: return min_z > bound_max;
+  case compare_function_greater: return max_z <= bound_min;
+  case compare_function_greater_equal: return max_z < bound_min;
+  default: return false;
+  }
+}
+}  // namespace
+
+hierarchical_z::hierarchical_z()
+  : target_(nullptr)
+  , target_generation_(0)
+  , read_depth_(nullptr)
+  , width_(0)
+  , height_(0)
+  , tile_x_count_(0)
+  , tile_y_count_(0)
+  , subtile_x_count_(0)
+  , subtile_y_count_(0) {}
+
+void hierarchical_z::reset(surface const* ds_target, read_depth_fn read_depth) {
+  target_ = ds_target;
+  target_generation_ = ds_target != nullptr ? ds_target->generation() : 0;
+  read_depth_ = read_depth;
+
+  if (target_ == nullptr || read_depth_ == nullptr) {
+    width_ = height_ = 0;
+    tile_x_count_ = tile_y_count_ = 0;
+    subtile_x_count_ = subtile_y_count_ = 0;
+    tile_min_.clear();
+    tile_max_.clear();
+    subtile_min_.clear();
+    subtile_max_.clear();
+    dirty_.clear();
+    return;
+  }
+
+  width_ = target_->width();
+  height_ = target_->height();
+  tile_x_count_ = (width_ + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+  tile_y_count_ = (height_ + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+  subtile_x_count_ = tile_x_count_ * SUBTILES_PER_TILE;
+  subtile_y_count_ = tile_y_count_ * SUBTILES_PER_TILE;
+
+  size_t tile_count = tile_x_count_ * tile_y_count_;
+  size_t subtile_count = subtile_x_count_ * subtile_y_count_;
+
+  float const inf = std::numeric_limits<float>::infinity();
+  tile_min_.assign(tile_count, -inf);
+  tile_max_.assign(tile_count, inf);
+  subtile_min_.assign(subtile_count, -inf);
+  subtile_max_.assign(subtile_count, inf);
+
+  // Contents of the target are unknown, so all sub-tiles will be rebuilt by the next refresh.
+  dirty_.assign(subtile_count, 1);
+}
+
+bool hierarchical_z::tracks(surface const* ds_target) const {
+  return ds_target == target_ &&
+      (target_ == nullptr || target_->generation() == target_generation_);
+}
+
+void hierarchical_z::clear(float depth) {
+  std::fill(tile_min_.begin(), tile_min_.end(), depth);
+  std::fill(tile_max_.begin(), tile_max_.end(), depth);
+  std::fill(subtile_min_.begin(), subtile_min_.end(), depth);
+  std::fill(subtile_max_.begin(), subtile_max_.end(), depth);
+  std::fill(dirty_.begin(), dirty_.end(), 0);
+}
+
+void hierarchical_z::refresh_tile(size_t tile_x, size_t tile_y) {
+  size_t const sub_x0 = tile_x * SUBTILES_PER_TILE;
+  size_t const sub_y0 = tile_y * SUBTILES_PER_TILE;
+  size_t const sample_count = target_->sample_count();
+
+  bool tile_dirty = false;
+  for (size_t sub_y = sub_y0; sub_y < sub_y0 + SUBTILES_PER_TILE; ++sub_y) {
+    uint8_t* dirty_row = dirty_.data() + sub_y * subtile_x_count_ + sub_x0;
+    if (std::memchr(dirty_row, 1, SUBTILES_PER_TILE) == nullptr) {
+      continue;
+    }
+    tile_dirty = true;
+
+    for (size_t sub_x = sub_x0; sub_x < sub_x0 + SUBTILES_PER_TILE; ++sub_x) {
+      size_t const sub_id = sub_y * subtile_x_count_ + sub_x;
+      if (!dirty_[sub_id]) {
+        continue;
+      }
+      dirty_[sub_id] = 0;
+
+      float min_z = std::numeric_limits<float>::infinity();
+      float max_z = -std::numeric_limits<float>::infinity();
+
+      size_t const left = sub_x * HIZ_SUBTILE_SIZE;
+      size_t const top = sub_y * HIZ_SUBTILE_SIZE;
+      size_t const right = min(width_, left + HIZ_SUBTILE_SIZE);
+      size_t const bottom = min(height_, top + HIZ_SUBTILE_SIZE);
+
+      // Sub-tile of pending clear has the depth of clear, and it is not expanded.
+      if (void const* clear_texel =
+              target_->pending_clear(left, top, HIZ_SUBTILE_SIZE, HIZ_SUBTILE_SIZE)) {
+        subtile_min_[sub_id] = subtile_max_[sub_id] = read_depth_(clear_texel);
+        continue;
+      }
+      target_->expand_clears(left, top, HIZ_SUBTILE_SIZE, HIZ_SUBTILE_SIZE);
+
+      for (size_t y = top; y < bottom; ++y) {
+        for (size_t x = left; x < right; ++x) {
+          for (size_t i_sample = 0; i_sample < sample_count; ++i_sample) {
+            float depth = read_depth_(target_->texel_address(x, y, i_sample));
+            min_z = min(min_z, depth);
+            max_z = max(max_z, depth);
+          }
+        }
+      }
+
+      subtile_min_[sub_id] = min_z;
+      subtile_max_[sub_id] = max_z;
+    }
+  }
+
+  if (!tile_dirty) {
+    return;
+  }
+
+  float min_z = std::numeric_limits<float>::infinity();
+  float max_z = -std::numeric_limits<float>::infinity();
+  for (size_t sub_y = sub_y0; sub_y < sub_y0 + SUBTILES_PER_TILE; ++sub_y) {
+    for (size_t sub_x = sub_x0; sub_x < sub_x0 + SUBTILES_PER_TILE; ++sub_x) {
+      min_z = min(min_z, subtile_min_[sub_y * subtile_x_count_ + sub_x]);
+      max_z = max(max_z, subtile_max_[sub_y * subtile_x_count_ + sub_x]);
+    }
+  }
+
+  tile_min_[tile_y * tile_x_count_ + tile_x] = min_z;
+  tile_max_[tile_y * tile_x_count_ + tile_x] = max_z;
+}
+
+void hierarchical_z::refresh() {
+  if (target_ == nullptr || read_depth_ == nullptr) {
+    return;
+  }
+
+  if (std::memchr(dirty_.data(), 1, dirty_.size()) == nullptr) {
+    return;
+  }
+
+  pipeline_threads const threads = current_pipeline_threads();
+  execute_threads(
+      *threads.pool,
+      [this](thread_context const* thread_ctx) {
+        thread_context::package_cursor current_package = thread_ctx->next_package();
+        while (current_package.valid()) {
+          auto tile_range = current_package.index_range();
+          for (size_t tile_id = tile_range.first; tile_id < tile_range.second; ++tile_id) {
+            refresh_tile(tile_id % tile_x_count_, tile_id / tile_x_count_);
+          }
+          current_package = thread_ctx->next_package();
+        }
+      },
+      tile_x_count_ * tile_y_count_,
+      REFRESH_HIZ_PACKAGE_SIZE,
+      threads.count);
+}
+
+bool hierarchical_z::reject(compare_function func,
+                            size_t left,
+                            size_t top,
+                            size_t right,
+                            size_t bottom,
+                            float min_z,
+                            float max_z) const {
+  right = min(right, width_);
+  bottom = min(bottom, height_);
+  if (left >= right || top >= bottom) {
+    return false;
+  }
+
+  size_t const tile_x_beg = left / HIZ_TILE_SIZE;
+  size_t const tile_y_beg = top / HIZ_TILE_SIZE;
+  size_t const tile_x_end = (right + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+  size_t const tile_y_end = (bottom + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+
+  for (size_t tile_y = tile_y_beg; tile_y < tile_y_end; ++tile_y) {
+    for (size_t tile_x = tile_x_beg; tile_x < tile_x_end; ++tile_x) {
+      size_t const tile_left = tile_x * HIZ_TILE_SIZE;
+      size_t const tile_top = tile_y * HIZ_TILE_SIZE;
+      size_t const tile_right = min(tile_left + HIZ_TILE_SIZE, width_);
+      size_t const tile_bottom = min(tile_top + HIZ_TILE_SIZE, height_);
+
+      // Whole tile is covered, tile bounds are enough.
+      if (left <= tile_left && tile_right <= right && top <= tile_top && tile_bottom <= bottom) {
+        size_t const tile_id = tile_y * tile_x_count_ + tile_x;
+        if (!depth_bounds_rejected(func, min_z, max_z, tile_min_[tile_id], tile_max_[tile_id])) {
+          return false;
+        }
+        continue;
+      }
+
+      size_t const sub_x_beg = max(left, tile_left) / HIZ_SUBTILE_SIZE;
+      size_t const sub_y_beg = max(top, tile_top) / HIZ_SUBTILE_SIZE;
+      size_t const sub_x_end = (min(right, tile_right) + HIZ_SUBTILE_SIZE - 1) / HIZ_SUBTILE_SIZE;
+      size_t const sub_y_end = (min(bottom, tile_bottom) + HIZ_SUBTILE_SIZE - 1) / HIZ_SUBTILE_SIZE;
+
+      for (size_t sub_y = sub_y_beg; sub_y < sub_y_end; ++sub_y) {
+        for (size_t sub_x = sub_x_beg; sub_x < sub_x_end; ++sub_x) {
+          size_t const sub_id = sub_y * subtile_x_count_ + sub_x;
+          if (!depth_bounds_rejected(
+                  func, min_z, max_z, subtile_min_[sub_id], subtile_max_[sub_id])) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+}  // namespace salvia::core
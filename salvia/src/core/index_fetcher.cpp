@@ -32,6 +32,9 @@ void index_fetcher::fetch_indexes(uint32_t* indexes_of_prim,
   uint32_t prim_vert_count = 0;
 
   switch (prim_topo_) {
+  case primitive_point_list:
+  case primitive_point_sprite: prim_vert_count = 1; break;
+
   case primitive_line_list:
   case primitive_line_strip: prim_vert_count = 2; break;
 
@@ -50,6 +53,9 @@ void index_fetcher::fetch_indexes(uint32_t* indexes_of_prim,
     uint32_t ids[3];
 
     switch (prim_topo_) {
+    case primitive_point_list:
+    case primitive_point_sprite: ids[0] = prim_id; break;
+
     case primitive_line_list:
       ids[0] = prim_id * 2 + 0;
       ids[1] = prim_id * 2 + 1;
@@ -0,0 +1,28 @@
+#include <salvia/core/primitive_bins.h>
+
+#include <algorithm>
+
+namespace salvia::core {
+
+void primitive_bins::reset(size_t tile_count, size_t slice_count, size_t thread_count) {
+  tile_count_ = tile_count;
+  slice_count_ = slice_count;
+
+  // Lists are cleared by open_slice() in parallel.
+  lists_.resize(tile_count * slice_count);
+
+  if (arenas_.size() < thread_count) {
+    arenas_.resize(thread_count);
+  }
+  for (auto& arena : arenas_) {
+    arena.reset();
+  }
+}
+
+primitive_bins::slice_writer primitive_bins::open_slice(size_t slice, size_t thread_id) {
+  chunk_list* lists = lists_.data() + slice * tile_count_;
+  std::fill(lists, lists + tile_count_, chunk_list{nullptr, nullptr});
+  return slice_writer(lists, &arenas_[thread_id]);
+}
+
+}  // namespace salvia::core
@@ -7,6 +7,7 @@
 #include <salvia/core/shader_unit.h>
 #include <salvia/core/thread_pool.h>
 #include <salvia/core/vertex_cache.h>
+#include <salvia/resource/surface.h>
 #include <salvia/shader/reflection.h>
 #include <salvia/shader/shader_object.h>
 #include <salvia/shader/shader_regs.h>
@@ -17,7 +18,8 @@
 #include <eflib/platform/intrin.h>
 
 #include <algorithm>
-#include <execution>
+#include <cmath>
+#include <thread>
 
 using namespace salvia::shader;
 using namespace eflib;
@@ -29,10 +31,30 @@ using std::vector;
 
 namespace salvia::core {
 
-constexpr int TILE_SIZE = 64;
-constexpr int DISPATCH_PRIMITIVE_PACKAGE_SIZE = 8;
-constexpr int VP_PROJ_TRANSFORM_PACKAGE_SIZE = 8;
-constexpr int RASTERIZE_PRIMITIVE_PACKAGE_SIZE = 1;
+constexpr int MIN_TILE_SIZE = 16;
+constexpr int MAX_TILE_SIZE = 128;
+constexpr int DEFAULT_TILE_SIZE = 64;
+constexpr size_t MIN_TILES_PER_THREAD = 4;
+
+// Tiles are scheduled by pixels which binned primitives may cover, plus the overhead of a primitive
+// in a tile, which is counted as pixels as well.
+constexpr uint64_t PRIM_TILE_COST = 32;
+
+// Tiles are loaded to tile buffers if primitives are estimated to cover them twice, so copies of
+// the tile are paid back by drawing in caches instead of rows far apart in targets.
+constexpr uint64_t TILE_RESIDENT_MIN_COVERAGE = 2;
+
+// Idle threads poll for work this many times before they block, since most waits of pipeline are
+// shorter than a sleep and wake up.
+constexpr int IDLE_SPIN_COUNT = 64;
+
+// Draws are split into chunks, which flow through stages of pipeline.
+// Primitives in bins are identified by chunk and index in chunk.
+constexpr size_t PRIMS_PER_CHUNK = 1024;
+constexpr uint32_t CHUNK_PRIM_BITS = 13;
+constexpr uint32_t CHUNK_PRIM_MASK = (1U << CHUNK_PRIM_BITS) - 1;
+static_assert(PRIMS_PER_CHUNK * geom_setup_engine::MAX_CLIPPED_VERTS_PER_PRIM / 2 <=
+              CHUNK_PRIM_MASK + 1);
 
 #define DEBUG_QUAD 0
 #if DEBUG_QUAD
@@ -47,23 +69,132 @@ bool is_valid_quad(size_t quad_x, size_t quad_y) {
 }
 #endif
 
-struct pixel_statistic {
-  uint64_t ps_invocations;
-  uint64_t backend_input_pixels;
-};
-
 struct drawing_triangle_context {
   float const* aa_z_offset;
   triangle_info const* tri_info;
   pixel_statistic* pixel_stat;
+  float const* coverage;  // Coverage of pixels in quad is multiplied to alpha if it is not null.
+  bool clipped;           // Tile is not in draw rectangle entirely, pixels have to be masked.
 };
 
+// Hierarchical rasterization splits a region into 4x4 sub-regions per stage, so it starts
+// from a power of 4 region. Sub-regions outside of the tile are skipped.
+int raster_region_size(int tile_size) {
+  int size = 4;
+  while (size < tile_size) {
+    size *= 4;
+  }
+  return size;
+}
+
+// Margin of interpolated depth for Hi-Z test, covers the rounding error of quad interpolation.
+constexpr float HIZ_DEPTH_EPSILON = 1.0e-6f;
+
+// Returns true if the triangle is behind the hierarchical Z over the whole region.
+bool hiz_reject_region(framebuffer const* fb,
+                       triangle_info const* tri_info,
+                       int left,
+                       int top,
+                       int right,
+                       int bottom) {
+  // Clamp region to bounding box of triangle to get a tighter depth range.
+  float const l = max(static_cast<float>(left), tri_info->bounding_box[0]);
+  float const r = min(static_cast<float>(right), tri_info->bounding_box[1]);
+  float const t = max(static_cast<float>(top), tri_info->bounding_box[2]);
+  float const b = min(static_cast<float>(bottom), tri_info->bounding_box[3]);
+  if (l > r || t > b) {
+    return false;
+  }
+
+  vec4 const& v0_pos = tri_info->v0->position();
+  float const dzdx = tri_info->ddx->position().z();
+  float const dzdy = tri_info->ddy->position().z();
+  float const zx0 = dzdx * (l - v0_pos.x());
+  float const zx1 = dzdx * (r - v0_pos.x());
+  float const zy0 = dzdy * (t - v0_pos.y());
+  float const zy1 = dzdy * (b - v0_pos.y());
+
+  float const min_z =
+      max(v0_pos.z() + min(zx0, zx1) + min(zy0, zy1), tri_info->depth_range[0]) - HIZ_DEPTH_EPSILON;
+  float const max_z =
+      min(v0_pos.z() + max(zx0, zx1) + max(zy0, zy1), tri_info->depth_range[1]) + HIZ_DEPTH_EPSILON;
+
+  return fb->hiz_reject(left, top, right, bottom, min_z, max_z);
+}
+
+// Line equations are kept in edge factors of primitive:
+//   edge_factors[0]: offset of pixel from the line. It is the offset along minor axis for aliased
+//                    lines, and the perpendicular distance for antialiased lines.
+//   edge_factors[1]: offset of pixel along the line from the start point.
+//   edge_factors[2]: x is the length of the line measured as edge_factors[1].
+//
+// Returns mask of pixels in quad covered by line. Pixels are ordered as (0, 0), (1, 0), (0, 1),
+// (1, 1). Coverage of pixels are written if line is antialiased.
+uint32_t line_quad_coverage(
+    vec4 const* line_eqs, bool antialiased, float quad_x, float quad_y, float* coverage) {
+  vec4 const& minor_eq = line_eqs[0];
+  vec4 const& major_eq = line_eqs[1];
+  float const len = line_eqs[2].x();
+
+#if !defined(EFLIB_NO_SIMD)
+  __m128 const px = _mm_add_ps(_mm_set1_ps(quad_x), _mm_set_ps(1.5f, 0.5f, 1.5f, 0.5f));
+  __m128 const py = _mm_add_ps(_mm_set1_ps(quad_y), _mm_set_ps(1.5f, 1.5f, 0.5f, 0.5f));
+
+  __m128 const m =
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(minor_eq.x())),
+                            _mm_mul_ps(py, _mm_set1_ps(minor_eq.y()))),
+                 _mm_set1_ps(minor_eq.z()));
+  __m128 const s =
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(major_eq.x())),
+                            _mm_mul_ps(py, _mm_set1_ps(major_eq.y()))),
+                 _mm_set1_ps(major_eq.z()));
+
+  __m128 const zero = _mm_setzero_ps();
+  __m128 const half = _mm_set1_ps(0.5f);
+  __m128 const one = _mm_set1_ps(1.0f);
+  __m128 const mlen = _mm_set1_ps(len);
+
+  if (antialiased) {
+    // Coverage of 1 pixel wide line, with half pixel caps at end points.
+    __m128 const abs_m = _mm_andnot_ps(_mm_set1_ps(-0.0f), m);
+    __m128 cov = _mm_max_ps(zero, _mm_sub_ps(one, abs_m));
+    cov = _mm_mul_ps(cov, _mm_min_ps(one, _mm_max_ps(zero, _mm_add_ps(s, half))));
+    cov = _mm_mul_ps(cov,
+                     _mm_min_ps(one, _mm_max_ps(zero, _mm_sub_ps(_mm_add_ps(mlen, half), s))));
+    _mm_storeu_ps(coverage, cov);
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpgt_ps(cov, zero)));
+  }
+
+  // Pixels whose center is in (-0.5, 0.5] of the line along minor axis, and in [0, len) along
+  // major axis.
+  __m128 const in_minor =
+      _mm_and_ps(_mm_cmpgt_ps(m, _mm_sub_ps(zero, half)), _mm_cmple_ps(m, half));
+  __m128 const in_major = _mm_and_ps(_mm_cmpge_ps(s, zero), _mm_cmplt_ps(s, mlen));
+  return static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(in_minor, in_major)));
+#else
+  uint32_t mask = 0;
+  for (int i_pixel = 0; i_pixel < 4; ++i_pixel) {
+    float const px = quad_x + (i_pixel & 1) + 0.5f;
+    float const py = quad_y + (i_pixel >> 1) + 0.5f;
+    float const m = minor_eq.x() * px + minor_eq.y() * py + minor_eq.z();
+    float const s = major_eq.x() * px + major_eq.y() * py + major_eq.z();
+    if (antialiased) {
+      coverage[i_pixel] = max(0.0f, 1.0f - abs(m)) * eflib::clamp(s + 0.5f, 0.0f, 1.0f) *
+          eflib::clamp(len + 0.5f - s, 0.0f, 1.0f);
+      mask |= (coverage[i_pixel] > 0.0f) << i_pixel;
+    } else {
+      mask |= (-0.5f < m && m <= 0.5f && 0.0f <= s && s < len) << i_pixel;
+    }
+  }
+  return mask;
+#endif
+}
+
 /*************************************************
  * Steps for line rasterization
- *      1 Find major direction and computing distance and differential on major direction.
- *      2 Calculate ddx and ddy for mip-mapping.
- *      3 Computing pixel position and interpolated attribute by DDA with major direction and
- *differential. 4 Executing pixel shader 5 Render pixel into framebuffer.
+ *      1 Walk quads along major direction of the line in the tile.
+ *      2 Compute coverage of quad by line equations set up by compute_line_info.
+ *      3 Draw quad as triangles, but attributes are interpolated along the line.
  *
  *   Note:
  *      1 Position is in window coordinate.
@@ -71,143 +202,76 @@ struct drawing_triangle_context {
  *      3 position.w() = 1.0f / clip w
  **************************************************/
 void rasterizer::rasterize_line(rasterize_prim_context const* ctx) {
-  // Extract to local variables
-  // cpp_pixel_shader *cpp_ps = ctx->shaders.cpp_ps;
-  // pixel_shader_unit *psu = ctx->shaders.ps_unit;
   viewport const& vp = *ctx->tile_vp;
-  vs_output const& v0 = *clipped_verts_[ctx->prim_id * 2 + 0];
-  vs_output const& v1 = *clipped_verts_[ctx->prim_id * 2 + 1];
+  primitive_chunk const& chunk = *chunks_[ctx->prim_id >> CHUNK_PRIM_BITS];
+  triangle_info const* line_info = chunk.tri_infos.data() + (ctx->prim_id & CHUNK_PRIM_MASK);
+  vec4 const* line_eqs = line_info->edge_factors;
+  bool const antialiased = state_->get_desc().anti_aliased_line_enable;
+
+  // Pixels in tile and draw rectangle.
+  int const left = max(fast_floori(vp.x), draw_left_);
+  int const top = max(fast_floori(vp.y), draw_top_);
+  int const right = min(fast_floori(vp.x + vp.w), draw_right_);
+  int const bottom = min(fast_floori(vp.y + vp.h), draw_bottom_);
+
+  // Quads in the bounding box of the line.
+  int const x_begin = max(left, fast_floori(line_info->bounding_box[0])) & ~1;
+  int const y_begin = max(top, fast_floori(line_info->bounding_box[2])) & ~1;
+  int const x_end = min(right, fast_ceili(line_info->bounding_box[1]) + 1);
+  int const y_end = min(bottom, fast_ceili(line_info->bounding_box[3]) + 1);
 
-  // Rasterize
-  vs_output diff;
-  vso_ops_->sub(diff, v1, v0);
-  eflib::vec4 const& dir = diff.position();
-  float diff_dir = abs(dir.x()) > abs(dir.y()) ? dir.x() : dir.y();
-
-  // Computing differential.
-  vs_output ddx, ddy;
-  vso_ops_->mul(ddx, diff, (diff.position().x() / (diff.position().xy().length_sqr())));
-  vso_ops_->mul(ddy, diff, (diff.position().y() / (diff.position().xy().length_sqr())));
-
-  int vp_left = fast_floori(max(0.0f, vp.x));
-  int vptop = fast_floori(max(0.0f, vp.y));
-  int vpright = fast_floori(min(vp.x + vp.w, target_vp_->w));
-  int vpbottom = fast_floori(min(vp.y + vp.h, target_vp_->h));
-
-  ps_output px_out;
-
-  // Divided drawing to x major DDA method and y major DDA method.
-  if (abs(dir.x()) > abs(dir.y())) {
-    // Swap start and end to make diff is positive.
-    const vs_output *start, *end;
-    if (dir.x() < 0) {
-      start = &v1;
-      end = &v0;
-      diff_dir = -diff_dir;
-    } else {
-      start = &v0;
-      end = &v1;
-    }
+  float aa_z_offset[MAX_NUM_MULTI_SAMPLES];
+  compute_aa_z_offset(line_info, aa_z_offset);
 
-    ef_unimplemented();
+  EFLIB_ALIGN(16) float coverage[4];
+  drawing_triangle_context line_ctx{
+      aa_z_offset, line_info, ctx->pixel_stat, antialiased ? coverage : nullptr, false};
 
-    float fsx = fast_floor(start->position().x() + 0.5f);
-
-    int sx = fast_floori(fsx);
-    int ex = fast_floori(end->position().x() - 0.5f);
-
-    // Clamp to visible screen.
-    sx = eflib::clamp<int>(sx, vp_left, int(vpright - 1));
-    ex = eflib::clamp<int>(ex, vp_left, int(vpright));
-
-    // Set attributes of start point.
-    vs_output px_start, px_end;
-    vso_ops_->copy(px_start, *start);
-    vso_ops_->copy(px_end, *end);
-    float step = static_cast<float>(sx) + 0.5f - start->position().x();
-    vs_output px_in;
-    vso_ops_->lerp(px_in, px_start, px_end, step / diff_dir);
-
-    // Draw line with x major DDA.
-    vs_output unprojed;
-    for (int iPixel = sx; iPixel < ex; ++iPixel) {
-      // Ingore pixels which are outside of viewport.
-      if (px_in.position().y() >= static_cast<float>(vpbottom)) {
-        if (dir.y() > 0)
-          break;
-        continue;
-      }
-      if (px_in.position().y() < 0) {
-        if (dir.y() < 0)
-          break;
-        continue;
-      }
-
-      // Render pixel.
-      vso_ops_->unproject(unprojed, px_in);
+  if (ctx->shaders.cpp_ps != nullptr) {
+    ctx->shaders.cpp_ps->update_front_face(line_info->front_face);
+  }
 
-#if 0
-      if(cpp_ps->execute(unprojed, px_out))
-      {
-        frame_buffer_->render_sample(cpp_bs_, iPixel, fast_floori(px_in.position().y()), 0, px_out, px_out.depth);
+  auto draw_line_quad = [&](int quad_x, int quad_y) {
+    uint32_t const pixel_mask = line_quad_coverage(line_eqs,
+                                                   antialiased,
+                                                   static_cast<float>(quad_x),
+                                                   static_cast<float>(quad_y),
+                                                   coverage);
+    uint64_t quad_mask = 0;
+    for (int i_pixel = 0; i_pixel < 4; ++i_pixel) {
+      int const x = quad_x + (i_pixel & 1);
+      int const y = quad_y + (i_pixel >> 1);
+      if (((pixel_mask >> i_pixel) & 1) && left <= x && x < right && top <= y && y < bottom) {
+        quad_mask |= full_mask_ << (i_pixel * MAX_SAMPLE_COUNT);
       }
-#endif
-      // Increment ddx
-      ++step;
-      vso_ops_->lerp(px_in, px_start, px_end, step / diff_dir);
     }
-  } else  // y major
-  {
-    const vs_output *start, *end;
-    if (dir.y() < 0) {
-      start = &v1;
-      end = &v0;
-      diff_dir = -diff_dir;
-    } else {
-      start = &v0;
-      end = &v1;
+    if (quad_mask != 0) {
+      draw_quad(quad_x, quad_y, quad_mask, &ctx->shaders, &line_ctx);
     }
+  };
 
-    ef_unimplemented();
-
-    float fsy = fast_floor(start->position().y() + 0.5f);
-
-    int sy = fast_floori(fsy);
-    int ey = fast_floori(end->position().y() - 0.5f);
-
-    sy = eflib::clamp<int>(sy, vptop, int(vpbottom - 1));
-    ey = eflib::clamp<int>(ey, vptop, int(vpbottom));
-
-    vs_output px_start, px_end;
-    vso_ops_->copy(px_start, *start);
-    vso_ops_->copy(px_end, *end);
-    float step = static_cast<float>(sy) + 0.5f - start->position().y();
-    vs_output px_in;
-    vso_ops_->lerp(px_in, px_start, px_end, step / diff_dir);
-
-    vs_output unprojed;
-    for (int iPixel = sy; iPixel < ey; ++iPixel) {
-      if (px_in.position().x() >= static_cast<float>(vpright)) {
-        if (dir.x() > 0)
-          break;
-        continue;
+  // A line crosses 1 or 2 quads on minor direction per quad on major direction, so quads are
+  // walked along major direction, and only a few quads around the line are tested.
+  vec4 const& minor_eq = line_eqs[0];
+  if (abs(minor_eq.y()) >= abs(minor_eq.x())) {
+    for (int quad_x = x_begin; quad_x < x_end; quad_x += 2) {
+      float const y0 = -(minor_eq.x() * quad_x + minor_eq.z()) / minor_eq.y();
+      float const y1 = -(minor_eq.x() * (quad_x + 2) + minor_eq.z()) / minor_eq.y();
+      int const quad_y_begin = max(y_begin, fast_floori(min(y0, y1)) - 2) & ~1;
+      int const quad_y_end = min(y_end, fast_ceili(max(y0, y1)) + 2);
+      for (int quad_y = quad_y_begin; quad_y < quad_y_end; quad_y += 2) {
+        draw_line_quad(quad_x, quad_y);
       }
-      if (px_in.position().x() < 0) {
-        if (dir.x() < 0)
-          break;
-        continue;
-      }
-
-      vso_ops_->unproject(unprojed, px_in);
-
-#if 0
-      if(cpp_ps->execute(unprojed, px_out))
-      {
-        frame_buffer_->render_sample(cpp_bs_, fast_floori(px_in.position().x()), iPixel, 0, px_out, px_out.depth);
+    }
+  } else {
+    for (int quad_y = y_begin; quad_y < y_end; quad_y += 2) {
+      float const x0 = -(minor_eq.y() * quad_y + minor_eq.z()) / minor_eq.x();
+      float const x1 = -(minor_eq.y() * (quad_y + 2) + minor_eq.z()) / minor_eq.x();
+      int const quad_x_begin = max(x_begin, fast_floori(min(x0, x1)) - 2) & ~1;
+      int const quad_x_end = min(x_end, fast_ceili(max(x0, x1)) + 2);
+      for (int quad_x = quad_x_begin; quad_x < quad_x_end; quad_x += 2) {
+        draw_line_quad(quad_x, quad_y);
       }
-#endif
-      ++step;
-      vso_ops_->lerp(px_in, px_start, px_end, step / diff_dir);
     }
   }
 }
@@ -216,6 +280,7 @@ void rasterizer::initialize(render_stages const* stages) {
   frame_buffer_ = stages->backend.get();
   vert_cache_ = stages->vert_cache.get();
   host_ = stages->host.get();
+  edge_kernels_ = select_edge_kernels();
 }
 
 void rasterizer::update(render_state const* state) {
@@ -227,14 +292,36 @@ void rasterizer::update(render_state const* state) {
   vp_ = &(state->vp);
   target_vp_ = &(state->target_vp);
   target_sample_count_ = state->target_sample_count;
+
+  draw_left_ = 0;
+  draw_top_ = 0;
+  draw_right_ =
+      fast_ceili(min(target_vp_->x + target_vp_->w, static_cast<float>(MAX_RENDER_TARGET_WIDTH)));
+  draw_bottom_ =
+      fast_ceili(min(target_vp_->y + target_vp_->h, static_cast<float>(MAX_RENDER_TARGET_HEIGHT)));
+  if (state_->get_desc().scissor_enable) {
+    eflib::rect<int32_t> const& scissor = state->scissor_rect;
+    draw_left_ = max(draw_left_, scissor.x);
+    draw_top_ = max(draw_top_, scissor.y);
+    draw_right_ = max(min(draw_right_, scissor.x + scissor.w), draw_left_);
+    draw_bottom_ = max(min(draw_bottom_, scissor.y + scissor.h), draw_top_);
+  }
   full_mask_ = (1ULL << target_sample_count_) - 1;
   quad_full_mask_ = (full_mask_ << (MAX_SAMPLE_COUNT * 0)) |
       (full_mask_ << (MAX_SAMPLE_COUNT * 1)) | (full_mask_ << (MAX_SAMPLE_COUNT * 2)) |
       (full_mask_ << (MAX_SAMPLE_COUNT * 3));
   prim_reorderable_ = false;
+  subpixel_bits_ = min(state_->get_desc().subpixel_bits, MAX_SUBPIXEL_BITS);
 
   vs_reflection_ = state->vx_shader ? state->vx_shader->get_reflection() : nullptr;
 
+  bool const has_color_target =
+      any_of(state->color_targets.begin(),
+             state->color_targets.end(),
+             [](resource::surface_ptr const& target) { return target != nullptr; });
+  has_pixel_shader_ = cpp_ps_ != nullptr || ps_proto_ != nullptr;
+  depth_only_shading_ = !has_color_target || !has_pixel_shader_;
+
   update_prim_info(state);
 
   // Initialize statistics.
@@ -251,11 +338,13 @@ void rasterizer::update(render_state const* state) {
     acc_cprimitives_ = &async_pipeline_statistics::accumulate<pipeline_statistic_id::cprimitives>;
     acc_ps_invocations_ =
         &async_pipeline_statistics::accumulate<pipeline_statistic_id::ps_invocations>;
+    acc_hiz_rejects_ = &async_pipeline_statistics::accumulate<pipeline_statistic_id::hiz_rejects>;
   } else {
     acc_ia_primitives_ = &accumulate_fn<uint64_t>::null;
     acc_cprimitives_ = &accumulate_fn<uint64_t>::null;
     acc_cinvocations_ = &accumulate_fn<uint64_t>::null;
     acc_ps_invocations_ = &accumulate_fn<uint64_t>::null;
+    acc_hiz_rejects_ = &accumulate_fn<uint64_t>::null;
   }
 
   if (internal_stat_) {
@@ -271,14 +360,32 @@ void rasterizer::update(render_state const* state) {
     acc_tri_dispatch_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::tri_dispatch>;
     acc_ras_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::ras>;
     acc_clipping_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::clipping>;
-    acc_compact_clip_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::compact_clip>;
+    acc_tri_setup_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::tri_setup>;
+    acc_pipeline_thread_time_ =
+        &async_pipeline_profiles::accumulate<pipeline_profile_id::pipeline_thread_time>;
+    acc_load_imbalance_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::load_imbalance>;
+    acc_tile_steals_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::tile_steals>;
+    acc_shader_clones_ = &async_pipeline_profiles::accumulate<pipeline_profile_id::shader_clones>;
+    acc_vso_bytes_saved_ =
+        &async_pipeline_profiles::accumulate<pipeline_profile_id::vso_bytes_saved>;
+    acc_tile_size_draws_ = {
+        &async_pipeline_profiles::accumulate<pipeline_profile_id::tile_16_draws>,
+        &async_pipeline_profiles::accumulate<pipeline_profile_id::tile_32_draws>,
+        &async_pipeline_profiles::accumulate<pipeline_profile_id::tile_64_draws>,
+        &async_pipeline_profiles::accumulate<pipeline_profile_id::tile_128_draws>};
   } else {
     fetch_time_stamp_ = &time_stamp_fn::null;
     acc_clipping_ = &accumulate_fn<uint64_t>::null;
-    acc_compact_clip_ = &accumulate_fn<uint64_t>::null;
+    acc_tri_setup_ = &accumulate_fn<uint64_t>::null;
+    acc_pipeline_thread_time_ = &accumulate_fn<uint64_t>::null;
+    acc_load_imbalance_ = &accumulate_fn<uint64_t>::null;
+    acc_tile_steals_ = &accumulate_fn<uint64_t>::null;
+    acc_shader_clones_ = &accumulate_fn<uint64_t>::null;
+    acc_vso_bytes_saved_ = &accumulate_fn<uint64_t>::null;
     acc_vp_trans_ = &accumulate_fn<uint64_t>::null;
     acc_tri_dispatch_ = &accumulate_fn<uint64_t>::null;
     acc_ras_ = &accumulate_fn<uint64_t>::null;
+    acc_tile_size_draws_.fill(&accumulate_fn<uint64_t>::null);
   }
 }
 
@@ -288,6 +395,31 @@ void rasterizer::draw_full_tile(int tile_left,
                                 int tile_bottom,
                                 drawing_shader_context const* shaders,
                                 drawing_triangle_context const* triangle_ctx) {
+  if (depth_only_) {
+    draw_depth_only(max(tile_left, draw_left_),
+                    max(tile_top, draw_top_),
+                    tile_right,
+                    tile_bottom,
+                    nullptr,
+                    triangle_ctx);
+    return;
+  }
+
+  if (triangle_ctx->clipped) {
+    // Quads on the border of draw rectangle are drawn partially.
+    for (int top = max(tile_top, draw_top_ & ~1); top < tile_bottom; top += 2) {
+      for (int left = max(tile_left, draw_left_ & ~1); left < tile_right; left += 2) {
+        uint64_t const quad_mask = clip_quad_mask(left, top, quad_full_mask_);
+        if (quad_mask == quad_full_mask_) {
+          draw_full_quad(left, top, shaders, triangle_ctx);
+        } else if (quad_mask != 0) {
+          draw_quad(left, top, quad_mask, shaders, triangle_ctx);
+        }
+      }
+    }
+    return;
+  }
+
   for (int top = tile_top; top < tile_bottom; top += 2) {
     for (int left = tile_left; left < tile_right; left += 2) {
       draw_full_quad(left, top, shaders, triangle_ctx);
@@ -413,6 +545,52 @@ void rasterizer::draw_partial_tile(int left,
   }
 #endif
 
+  draw_pixel_masks(left, top, pixel_mask, shaders, triangle_ctx);
+}
+
+void rasterizer::draw_partial_tile_fixed(int left,
+                                         int top,
+                                         fixed_edge_equations const& edges,
+                                         drawing_shader_context const* shaders,
+                                         drawing_triangle_context const* triangle_ctx) {
+  EFLIB_ALIGN(32) uint32_t pixel_mask[4 * 4];
+  edge_kernels_->coverage(edges,
+                          left,
+                          top,
+                          samples_fixed_x_,
+                          samples_fixed_y_,
+                          static_cast<uint32_t>(target_sample_count_),
+                          pixel_mask);
+  draw_pixel_masks(left, top, pixel_mask, shaders, triangle_ctx);
+}
+
+void rasterizer::draw_pixel_masks(int left,
+                                  int top,
+                                  uint32_t const* pixel_mask,
+                                  drawing_shader_context const* shaders,
+                                  drawing_triangle_context const* triangle_ctx) {
+  if (depth_only_) {
+    if (!triangle_ctx->clipped) {
+      draw_depth_only(left, top, left + 4, top + 4, pixel_mask, triangle_ctx);
+      return;
+    }
+
+    uint32_t clipped_mask[4 * 4];
+    for (int i = 0; i < 4 * 4; ++i) {
+      int const x = left + (i & 3);
+      int const y = top + (i >> 2);
+      bool const in_rect = draw_left_ <= x && x < draw_right_ && draw_top_ <= y && y < draw_bottom_;
+      clipped_mask[i] = in_rect ? pixel_mask[i] : 0;
+    }
+    draw_depth_only(max(left, draw_left_),
+                    max(top, draw_top_),
+                    min(left + 4, draw_right_),
+                    min(top + 4, draw_bottom_),
+                    clipped_mask + max(draw_top_ - top, 0) * 4 + max(draw_left_ - left, 0),
+                    triangle_ctx);
+    return;
+  }
+
   for (int quad = 0; quad < 4; ++quad) {
     int const quad_x = (quad & 1) << 1;
     int const quad_y = (quad & 2);
@@ -425,6 +603,10 @@ void rasterizer::draw_partial_tile(int left,
         ((pixel_mask[quad_start + 4] & SAMPLE_MASK_U64) << (MAX_SAMPLE_COUNT * 2)) |
         ((pixel_mask[quad_start + 5] & SAMPLE_MASK_U64) << (MAX_SAMPLE_COUNT * 3));
 
+    if (triangle_ctx->clipped) {
+      quad_mask = clip_quad_mask(left + quad_x, top + quad_y, quad_mask);
+    }
+
     // No sample need to render.
     if (quad_mask == 0) {
       continue;
@@ -438,6 +620,31 @@ void rasterizer::draw_partial_tile(int left,
   }
 }
 
+void rasterizer::draw_depth_only(int left,
+                                 int top,
+                                 int right,
+                                 int bottom,
+                                 uint32_t const* pixel_masks,
+                                 drawing_triangle_context const* triangle_ctx) {
+  // Depth is linear in window space, so it is interpolated by the plane of triangle.
+  triangle_info const* tri_info = triangle_ctx->tri_info;
+  vec4 const& v0 = tri_info->v0->position();
+  float const dzdx = tri_info->ddx->position().z();
+  float const dzdy = tri_info->ddy->position().z();
+  float const z = v0.z() + (0.5f + left - v0.x()) * dzdx + (0.5f + top - v0.y()) * dzdy;
+
+  uint32_t const count = static_cast<uint32_t>(right - left);
+  for (int y = top; y < bottom; ++y) {
+    frame_buffer_->draw_depth_row(left,
+                                  y,
+                                  count,
+                                  z + (y - top) * dzdy,
+                                  dzdx,
+                                  pixel_masks ? pixel_masks + (y - top) * 4 : nullptr,
+                                  triangle_ctx->aa_z_offset);
+  }
+}
+
 void rasterizer::subdivide_tile(int left,
                                 int top,
                                 const eflib::rect<uint32_t>& cur_region,
@@ -601,6 +808,29 @@ void rasterizer::subdivide_tile(int left,
 #endif
 }
 
+uint64_t rasterizer::clip_quad_mask(int left, int top, uint64_t quad_mask) const {
+  for (int i_pixel = 0; i_pixel < 4; ++i_pixel) {
+    int const x = left + (i_pixel & 1);
+    int const y = top + (i_pixel >> 1);
+    if (x < draw_left_ || x >= draw_right_ || y < draw_top_ || y >= draw_bottom_) {
+      quad_mask &= ~(static_cast<uint64_t>(SAMPLE_MASK) << (i_pixel * MAX_SAMPLE_COUNT));
+    }
+  }
+  return quad_mask;
+}
+
+void rasterizer::compute_aa_z_offset(triangle_info const* tri_info, float* aa_z_offset) const {
+  if (target_sample_count_ > 1) {
+    for (unsigned long i_sample = 0; i_sample < target_sample_count_; ++i_sample) {
+      const vec2& sp = samples_pattern_[i_sample];
+      aa_z_offset[i_sample] = (sp.x() - 0.5f) * tri_info->ddx->position().z() +
+          (sp.y() - 0.5f) * tri_info->ddy->position().z();
+    }
+  } else {
+    aa_z_offset[0] = 0.0f;
+  }
+}
+
 /*************************************************
  *  Steps of triangle rasterization:
  *    1 Generate scan line and compute derivation of scanlines
@@ -619,14 +849,12 @@ void rasterizer::rasterize_triangle(rasterize_prim_context const* ctx) {
   cpp_pixel_shader* cpp_ps = ctx->shaders.cpp_ps;
   // pixel_shader_unit *psu = ctx->shaders.ps_unit;
   viewport const& vp = *ctx->tile_vp;
-  uint32_t prim_id = ctx->prim_id >> 1;
+  primitive_chunk const& chunk = *chunks_[ctx->prim_id >> (CHUNK_PRIM_BITS + 1)];
+  uint32_t prim_id = (ctx->prim_id >> 1) & CHUNK_PRIM_MASK;
   uint32_t full = ctx->prim_id & 1;
 
-  // vs_output const &v0 = *clipped_verts_[prim_id * 3 + 0];
-  // vs_output const &v1 = *clipped_verts_[prim_id * 3 + 1];
-  // vs_output const &v2 = *clipped_verts_[prim_id * 3 + 2];
-
-  triangle_info const* tri_info = tri_infos_.data() + prim_id;
+  triangle_info const* tri_info = chunk.tri_infos.data() + prim_id;
+  fixed_edge_equations const& fixed_edges = chunk.tri_edges[prim_id];
   eflib::vec4 const* edge_factors = tri_info->edge_factors;
   bool const mark_x[3] = {
       edge_factors[0].x() > 0, edge_factors[1].x() > 0, edge_factors[2].x() > 0};
@@ -644,7 +872,7 @@ void rasterizer::rasterize_triangle(rasterize_prim_context const* ctx) {
    *   Draw triangles with Larrabee algorithm .
    *************************************************/
 
-  uint32_t test_regions[2][TILE_SIZE / 2 * TILE_SIZE / 2];
+  uint32_t test_regions[2][MAX_TILE_SIZE / 4 * MAX_TILE_SIZE / 4];
   uint32_t test_region_size[2] = {0, 0};
   test_regions[0][0] = (full << 31);
   test_region_size[0] = 1;
@@ -657,8 +885,10 @@ void rasterizer::rasterize_triangle(rasterize_prim_context const* ctx) {
   // const int vpright0 = fast_floori(vp.x + vp.w);
   // const int vpbottom0 = fast_floori(vp.y + vp.h);
 
-  uint32_t subtile_w = fast_floori(vp.w);
-  uint32_t subtile_h = fast_floori(vp.h);
+  int const tile_size = fast_floori(vp.w);
+  int const region_size = raster_region_size(tile_size);
+  uint32_t subtile_w = region_size;
+  uint32_t subtile_h = region_size;
 
   EFLIB_ALIGN(16) float step_x[4];
   EFLIB_ALIGN(16) float step_y[4];
@@ -666,35 +896,26 @@ void rasterizer::rasterize_triangle(rasterize_prim_context const* ctx) {
   EFLIB_ALIGN(16) float e_value[4];
   float part_e_value[4];
   for (int e = 0; e < 3; ++e) {
-    step_x[e] = TILE_SIZE * edge_factors[e].x();
-    step_y[e] = TILE_SIZE * edge_factors[e].y();
+    step_x[e] = region_size * edge_factors[e].x();
+    step_y[e] = region_size * edge_factors[e].y();
     rej_to_acc[e] = -abs(step_x[e]) - abs(step_y[e]);
-    part_e_value[e] =
-        mark_x[e] * TILE_SIZE * edge_factors[e].x() + mark_y[e] * TILE_SIZE * edge_factors[e].y();
+    part_e_value[e] = mark_x[e] * region_size * edge_factors[e].x() +
+        mark_y[e] * region_size * edge_factors[e].y();
     e_value[e] = edge_factors[e].z() - part_e_value[e];
   }
   step_x[3] = step_y[3] = 0;
 
   float aa_z_offset[MAX_NUM_MULTI_SAMPLES];
-  if (target_sample_count_ > 1) {
-    for (unsigned long i_sample = 0; i_sample < target_sample_count_; ++i_sample) {
-      const vec2& sp = samples_pattern_[i_sample];
-      aa_z_offset[i_sample] = (sp.x() - 0.5f) * tri_info->ddx.position().z() +
-          (sp.y() - 0.5f) * tri_info->ddy.position().z();
-    }
-  } else {
-    aa_z_offset[0] = 0.0f;
-  }
+  compute_aa_z_offset(tri_info, aa_z_offset);
 
-  drawing_triangle_context tri_ctx{aa_z_offset, tri_info, ctx->pixel_stat};
+  bool const clipped = vpleft0 < draw_left_ || vptop0 < draw_top_ ||
+      vpleft0 + tile_size > draw_right_ || vptop0 + tile_size > draw_bottom_;
+  drawing_triangle_context tri_ctx{aa_z_offset, tri_info, ctx->pixel_stat, nullptr, clipped};
 
   if (cpp_ps != nullptr) {
     cpp_ps->update_front_face(tri_info->front_face);
   }
 
-  float target_vp_right = target_vp_->w + target_vp_->x;
-  float target_vp_bottom = target_vp_->h + +target_vp_->y;
-
   while (test_region_size[src_stage] > 0) {
     test_region_size[dst_stage] = 0;
 
@@ -715,11 +936,31 @@ void rasterizer::rasterize_triangle(rasterize_prim_context const* ctx) {
           packed_region & 0xFF, (packed_region >> 8) & 0xFF, subtile_w, subtile_h);
       TRI_VS_TILE intersect = (packed_region >> 31) ? TVT_FULL : TVT_PARTIAL;
 
+      // Sub tile is out of the tile.
+      if (cur_region.x >= static_cast<uint32_t>(tile_size) ||
+          cur_region.y >= static_cast<uint32_t>(tile_size)) {
+        continue;
+      }
+
       const int vpleft = max(0U, static_cast<unsigned>(vpleft0 + cur_region.x));
       const int vptop = max(0U, static_cast<unsigned>(vptop0 + cur_region.y));
 
-      // Sub tile is out of screen.
-      if (vpleft >= target_vp_right || vptop >= target_vp_bottom) {
+      // Sub tile is out of draw rectangle.
+      if (vpleft >= draw_right_ || vptop >= draw_bottom_ ||
+          vpleft0 + static_cast<int>(cur_region.x + cur_region.w * 4) <= draw_left_ ||
+          vptop0 + static_cast<int>(cur_region.y + cur_region.h * 4) <= draw_top_) {
+        continue;
+      }
+
+      // Sub tiles are culled by hierarchical Z. Whole tile has been tested by dispatching.
+      if (hiz_enabled_ && cur_region.w * 4 < vp.w &&
+          hiz_reject_region(frame_buffer_,
+                            tri_info,
+                            vpleft,
+                            vptop,
+                            vpleft0 + cur_region.x + cur_region.w * 4,
+                            vptop0 + cur_region.y + cur_region.h * 4)) {
+        ++ctx->pixel_stat->hiz_rejects;
         continue;
       }
 
@@ -735,20 +976,37 @@ void rasterizer::rasterize_triangle(rasterize_prim_context const* ctx) {
 
       case TVT_FULL: {
         // The whole tile is inside a triangle.
-        const int vpright =
-            min(vpleft0 + cur_region.x + cur_region.w * 4, static_cast<uint32_t>(target_vp_right));
-        const int vpbottom =
-            min(vptop0 + cur_region.y + cur_region.h * 4, static_cast<uint32_t>(target_vp_bottom));
+        const int vpright = min({vpleft0 + cur_region.x + cur_region.w * 4,
+                                 static_cast<uint32_t>(vpleft0 + tile_size),
+                                 static_cast<uint32_t>(draw_right_)});
+        const int vpbottom = min({vptop0 + cur_region.y + cur_region.h * 4,
+                                  static_cast<uint32_t>(vptop0 + tile_size),
+                                  static_cast<uint32_t>(draw_bottom_)});
         this->draw_full_tile(vpleft, vptop, vpright, vpbottom, &ctx->shaders, &tri_ctx);
       } break;
 
       case TVT_PIXEL:
         // The tile is small enough for pixel level matching.
-        this->draw_partial_tile(vpleft, vptop, edge_factors, &ctx->shaders, &tri_ctx);
+        if (fixed_edges.valid) {
+          this->draw_partial_tile_fixed(vpleft, vptop, fixed_edges, &ctx->shaders, &tri_ctx);
+        } else {
+          this->draw_partial_tile(vpleft, vptop, edge_factors, &ctx->shaders, &tri_ctx);
+        }
         break;
 
       default:
         // Only a part of the triangle is inside the tile. So subdivide the tile into small ones.
+        if (fixed_edges.valid) {
+          edge_kernels_->subdivide(fixed_edges,
+                                   vpleft0 + cur_region.x,
+                                   vptop0 + cur_region.y,
+                                   cur_region.x,
+                                   cur_region.y,
+                                   cur_region.w,
+                                   test_regions[dst_stage],
+                                   test_region_size[dst_stage]);
+          break;
+        }
         this->subdivide_tile(vpleft,
                              vptop,
                              cur_region,
@@ -772,105 +1030,202 @@ void rasterizer::rasterize_triangle(rasterize_prim_context const* ctx) {
   }
 }
 
-void rasterizer::threaded_dispatch_primitive(thread_context const* thread_ctx) {
-  vector<vector<uint32_t>>& tiled_prims = threaded_tiled_prims_[thread_ctx->thread_id];
-  for (auto& prims : tiled_prims) {
-    prims.clear();
-  }
-
-  thread_context::package_cursor current_package = thread_ctx->next_package();
-  while (current_package.valid()) {
-    auto prim_range = current_package.index_range();
+void rasterizer::bin_chunk(size_t chunk_id, uint32_t thread_id, uint64_t& hiz_rejects) {
+  primitive_chunk const& chunk = *chunks_[chunk_id];
+  float const tile_size = static_cast<float>(tile_size_);
+  uint32_t const chunk_prim_base = static_cast<uint32_t>(chunk_id << CHUNK_PRIM_BITS);
+  primitive_bins::slice_writer tiled_prims = bins_.open_slice(chunk_id, thread_id);
+
+  bin_costs& costs = threaded_bin_costs_[thread_id];
+  uint64_t const tile_pixels = static_cast<uint64_t>(tile_size_) * tile_size_;
+  auto bin = [&](int x, int y, uint32_t prim_with_mask, uint64_t pixels) {
+    size_t const tile_id = y * tile_x_count_ + x;
+    tiled_prims.push(tile_id, prim_with_mask);
+    if (costs.costs[tile_id] == 0) {
+      costs.tiles.push_back(static_cast<uint32_t>(tile_id));
+    }
+    costs.costs[tile_id] += PRIM_TILE_COST + pixels;
+  };
 
-    for (size_t i = prim_range.first; i < prim_range.second; ++i) {
-      if (3 == prim_size_) {
-        compute_triangle_info(i);
+  // Tiles out of draw rectangle are never binned.
+  int const tile_x_begin = draw_left_ / tile_size_;
+  int const tile_y_begin = draw_top_ / tile_size_;
+  int const tile_x_end =
+      min((draw_right_ + tile_size_ - 1) / tile_size_, static_cast<int>(tile_x_count_));
+  int const tile_y_end =
+      min((draw_bottom_ + tile_size_ - 1) / tile_size_, static_cast<int>(tile_y_count_));
+
+  if (pt_point == prim_) {
+    // Points are binned by positions to tiles which their squares overlap.
+    float const half_size = point_sprite_ ? point_size_ * 0.5f : 0.0f;
+    uint64_t const point_pixels =
+        point_sprite_ ? min(static_cast<uint64_t>(point_size_ * point_size_), tile_pixels) : 1;
+    for (uint32_t local = 0; local < chunk.prims.prim_count; ++local) {
+      vec4 const& pos = chunk.prims.verts[local]->position();
+      int const sx = max(fast_floori((pos.x() - half_size) / tile_size), tile_x_begin);
+      int const sy = max(fast_floori((pos.y() - half_size) / tile_size), tile_y_begin);
+      int const ex = min(fast_floori((pos.x() + half_size) / tile_size) + 1, tile_x_end);
+      int const ey = min(fast_floori((pos.y() + half_size) / tile_size) + 1, tile_y_end);
+      for (int y = sy; y < ey; ++y) {
+        for (int x = sx; x < ex; ++x) {
+          bin(x, y, (chunk_prim_base | local) << 1, point_pixels);
+        }
       }
+    }
+    return;
+  }
 
-      triangle_info const* tri_info = tri_infos_.data() + i;
+  for (uint32_t local = 0; local < chunk.prims.prim_count; ++local) {
+    triangle_info const* tri_info = chunk.tri_infos.data() + local;
+    uint32_t const i = chunk_prim_base | local;
 
-      if (tri_info->v0 == nullptr) {
+    if (tri_info->v0 == nullptr) {
+      continue;
+    }
+    float const x_min = tri_info->bounding_box[0];
+    float const x_max = tri_info->bounding_box[1];
+    float const y_min = tri_info->bounding_box[2];
+    float const y_max = tri_info->bounding_box[3];
+
+    const int sx = std::max(fast_floori(std::max(0.0f, x_min) / tile_size), tile_x_begin);
+    const int sy = std::max(fast_floori(std::max(0.0f, y_min) / tile_size), tile_y_begin);
+    const int ex = std::min(fast_ceili(std::max(0.0f, x_max) / tile_size) + 1, tile_x_end);
+    const int ey = std::min(fast_ceili(std::max(0.0f, y_max) / tile_size) + 1, tile_y_end);
+    if (sx >= ex || sy >= ey) {
+      continue;
+    }
+
+    // Pixels covered by the primitive in a tile which is not accepted entirely.
+    uint64_t const prim_pixels = 3 == prim_size_
+        ? min(static_cast<uint64_t>((x_max - x_min) * (y_max - y_min) * 0.5f), tile_pixels)
+        : tile_size_;
+
+    if ((sx + 1 == ex) && (sy + 1 == ey)) {
+      // Small primitive
+      if (hiz_enabled_ &&
+          hiz_reject_region(frame_buffer_,
+                            tri_info,
+                            sx * tile_size_,
+                            sy * tile_size_,
+                            (sx + 1) * tile_size_,
+                            (sy + 1) * tile_size_)) {
+        ++hiz_rejects;
         continue;
       }
-      float const x_min = tri_info->bounding_box[0];
-      float const x_max = tri_info->bounding_box[1];
-      float const y_min = tri_info->bounding_box[2];
-      float const y_max = tri_info->bounding_box[3];
-
-      const int sx =
-          std::min(fast_floori(std::max(0.0f, x_min) / TILE_SIZE), static_cast<int>(tile_x_count_));
-      const int sy =
-          std::min(fast_floori(std::max(0.0f, y_min) / TILE_SIZE), static_cast<int>(tile_y_count_));
-      const int ex = std::min(fast_ceili(std::max(0.0f, x_max) / TILE_SIZE) + 1,
-                              static_cast<int>(tile_x_count_));
-      const int ey = std::min(fast_ceili(std::max(0.0f, y_max) / TILE_SIZE) + 1,
-                              static_cast<int>(tile_y_count_));
-
-      if ((sx + 1 == ex) && (sy + 1 == ey)) {
-        // Small primitive
-        tiled_prims[sy * tile_x_count_ + sx].push_back(i << 1);
-      } else {
-        if (3 == prim_size_) {
-          vec4 const* edge_factors = tri_infos_[i].edge_factors;
-
-          bool const mark_x[3] = {
-              edge_factors[0].x() > 0, edge_factors[1].x() > 0, edge_factors[2].x() > 0};
-
-          bool const mark_y[3] = {
-              edge_factors[0].y() > 0, edge_factors[1].y() > 0, edge_factors[2].y() > 0};
-
-          float step_x[3];
-          float step_y[3];
-          float rej_to_acc[3];
-          for (int e = 0; e < 3; ++e) {
-            step_x[e] = TILE_SIZE * edge_factors[e].x();
-            step_y[e] = TILE_SIZE * edge_factors[e].y();
-            rej_to_acc[e] = -abs(step_x[e]) - abs(step_y[e]);
+      bin(sx, sy, i << 1, prim_pixels);
+    } else {
+      if (3 == prim_size_ && chunk.tri_edges[local].valid) {
+        fixed_edge_equations const& edges = chunk.tri_edges[local];
+        for (int y = sy; y < ey; ++y) {
+          for (int x = sx; x < ex; ++x) {
+            block_coverage const coverage =
+                classify_block(edges, x * tile_size_, y * tile_size_, tile_size_, tile_size_);
+            if (coverage == block_coverage::rejected) {
+              continue;
+            }
+
+            if (hiz_enabled_ &&
+                hiz_reject_region(frame_buffer_,
+                                  tri_info,
+                                  x * tile_size_,
+                                  y * tile_size_,
+                                  (x + 1) * tile_size_,
+                                  (y + 1) * tile_size_)) {
+              ++hiz_rejects;
+              continue;
+            }
+
+            uint32_t const acceptance = (coverage == block_coverage::accepted);
+            bin(x, y, (i << 1) | acceptance, acceptance ? tile_pixels : prim_pixels);
           }
+        }
+      } else if (3 == prim_size_) {
+        vec4 const* edge_factors = tri_info->edge_factors;
+
+        bool const mark_x[3] = {
+            edge_factors[0].x() > 0, edge_factors[1].x() > 0, edge_factors[2].x() > 0};
+
+        bool const mark_y[3] = {
+            edge_factors[0].y() > 0, edge_factors[1].y() > 0, edge_factors[2].y() > 0};
+
+        float step_x[3];
+        float step_y[3];
+        float rej_to_acc[3];
+        for (int e = 0; e < 3; ++e) {
+          step_x[e] = tile_size_ * edge_factors[e].x();
+          step_y[e] = tile_size_ * edge_factors[e].y();
+          rej_to_acc[e] = -abs(step_x[e]) - abs(step_y[e]);
+        }
+
+        for (int y = sy; y < ey; ++y) {
+          for (int x = sx; x < ex; ++x) {
+            int rejection = 0;
+            int acceptance = 1;
+
+            // Trivial rejection & acceptance
+            for (int e = 0; e < 3; ++e) {
+              float e_value = edge_factors[e].z() -
+                  (static_cast<float>(x + mark_x[e]) * tile_size * edge_factors[e].x() +
+                   static_cast<float>(y + mark_y[e]) * tile_size * edge_factors[e].y());
+              rejection |= (0 < e_value);
+              acceptance &= (rej_to_acc[e] >= e_value);
+            }
+
+            if (rejection) {
+              continue;
+            }
 
-          for (int y = sy; y < ey; ++y) {
-            for (int x = sx; x < ex; ++x) {
-              int rejection = 0;
-              int acceptance = 1;
-
-              // Trivial rejection & acceptance
-              for (int e = 0; e < 3; ++e) {
-                float e_value = edge_factors[e].z() -
-                    (static_cast<float>(x + mark_x[e]) * TILE_SIZE * edge_factors[e].x() +
-                     static_cast<float>(y + mark_y[e]) * TILE_SIZE * edge_factors[e].y());
-                rejection |= (0 < e_value);
-                acceptance &= (rej_to_acc[e] >= e_value);
-              }
-
-              if (!rejection) {
-                tiled_prims[y * tile_x_count_ + x].push_back((i << 1) | acceptance);
-              }
+            if (hiz_enabled_ &&
+                hiz_reject_region(frame_buffer_,
+                                  tri_info,
+                                  x * tile_size_,
+                                  y * tile_size_,
+                                  (x + 1) * tile_size_,
+                                  (y + 1) * tile_size_)) {
+              ++hiz_rejects;
+              continue;
             }
+
+            bin(x, y, (i << 1) | acceptance, acceptance ? tile_pixels : prim_pixels);
           }
-        } else {
-          for (int y = sy; y < ey; ++y) {
-            for (int x = sx; x < ex; ++x) {
-              tiled_prims[y * tile_x_count_ + x].push_back(i << 1);
+        }
+      } else {
+        // Line is binned to tiles which it passes through.
+        vec4 const& minor_eq = tri_info->edge_factors[0];
+        for (int y = sy; y < ey; ++y) {
+          float const top = y * tile_size;
+          float const bottom = top + tile_size;
+          for (int x = sx; x < ex; ++x) {
+            float const left = x * tile_size;
+            float const right = left + tile_size;
+            float const m_lt = minor_eq.x() * left + minor_eq.y() * top + minor_eq.z();
+            float const m_rt = minor_eq.x() * right + minor_eq.y() * top + minor_eq.z();
+            float const m_lb = minor_eq.x() * left + minor_eq.y() * bottom + minor_eq.z();
+            float const m_rb = minor_eq.x() * right + minor_eq.y() * bottom + minor_eq.z();
+            if (std::min({m_lt, m_rt, m_lb, m_rb}) > 1.0f ||
+                std::max({m_lt, m_rt, m_lb, m_rb}) < -1.0f) {
+              continue;
             }
+            bin(x, y, i << 1, prim_pixels);
           }
         }
       }
     }
-
-    current_package = thread_ctx->next_package();
   }
 }
 
-void rasterizer::compute_triangle_info(uint32_t i) {
-  triangle_info* tri_info = tri_infos_.data() + i;
+float rasterizer::compute_triangle_info(primitive_chunk& chunk, uint32_t i) {
+  triangle_info* tri_info = chunk.tri_infos.data() + i;
   tri_info->v0 = nullptr;
+  tri_info->ddx = chunk.derivatives.alloc();
+  tri_info->ddy = chunk.derivatives.alloc();
+  chunk.tri_edges[i].valid = false;
 
   vs_output const* verts[3] = {
-      clipped_verts_[i * prim_size_ + 0],
-      clipped_verts_[i * prim_size_ + 1],
-      clipped_verts_[i * prim_size_ + 2],
+      chunk.prims.verts[i * prim_size_ + 0],
+      chunk.prims.verts[i * prim_size_ + 1],
+      chunk.prims.verts[i * prim_size_ + 2],
   };
-
   vec4 const* vert_pos[3] = {
       &(verts[0]->position()), &(verts[1]->position()), &(verts[2]->position())};
 
@@ -910,7 +1265,7 @@ void rasterizer::compute_triangle_info(uint32_t i) {
   float area = cross_prod2(e02.position().xy(), e01.position().xy());
   // Return for zero-area triangle.
   if (equal<float>(area, 0.0f))
-    return;
+    return 0.0f;
 
   tri_info->front_face = area > 0.0f;
   float inv_area = 1.0f / area;
@@ -925,6 +1280,11 @@ void rasterizer::compute_triangle_info(uint32_t i) {
   tri_info->bounding_box[3] =
       std::max(std::max(vert_pos[0]->y(), vert_pos[1]->y()), vert_pos[2]->y());  // ymax
 
+  tri_info->depth_range[0] =
+      std::min(std::min(vert_pos[0]->z(), vert_pos[1]->z()), vert_pos[2]->z());  // zmin
+  tri_info->depth_range[1] =
+      std::max(std::max(vert_pos[0]->z(), vert_pos[1]->z()), vert_pos[2]->z());  // zmax
+
   for (int i_vert = 0; i_vert < 3; ++i_vert) {
     // Edge factors: x * (y1 - y0) - y * (x1 - x0) - (y1 * x0 - x1 * y0)
     int const se = i_vert;
@@ -938,70 +1298,669 @@ void rasterizer::compute_triangle_info(uint32_t i) {
     edge_factors[i_vert].w(0.0f);
   }
 
+  float const xs[3] = {vert_pos[0]->x(), vert_pos[1]->x(), vert_pos[2]->x()};
+  float const ys[3] = {vert_pos[0]->y(), vert_pos[1]->y(), vert_pos[2]->y()};
+  setup_fixed_edge_equations(chunk.tri_edges[i], xs, ys, subpixel_bits_);
+
   // Compute difference of attributes.
-  { vso_ops_->compute_derivative(tri_info->ddx, tri_info->ddy, e01, e02, inv_area); }
+  {
+    vso_ops_->compute_derivative(
+        *tri_info->ddx, *tri_info->ddy, e01, e02, inv_area, used_attributes_);
+  }
 
   tri_info->v0 = reordered_verts[0];
+  return abs(area) * 0.5f;
+}
+
+
+void rasterizer::compute_line_info(primitive_chunk& chunk, uint32_t i) {
+  triangle_info* line_info = chunk.tri_infos.data() + i;
+  line_info->v0 = nullptr;
+  line_info->ddx = chunk.derivatives.alloc();
+  line_info->ddy = chunk.derivatives.alloc();
+  chunk.tri_edges[i].valid = false;
+
+  vs_output const* v0 = chunk.prims.verts[i * 2 + 0];
+  vs_output const* v1 = chunk.prims.verts[i * 2 + 1];
+  vec4 const& p0 = v0->position();
+  vec4 const& p1 = v1->position();
+
+  float const dx = p1.x() - p0.x();
+  float const dy = p1.y() - p0.y();
+  float const len_sqr = dx * dx + dy * dy;
+  // Return for zero-length line.
+  if (equal<float>(len_sqr, 0.0f)) {
+    return;
+  }
+
+  // Attributes are interpolated by projection of pixel on the line.
+  vs_output diff;
+  vso_ops_->sub(diff, *v1, *v0);
+  vso_ops_->mul(*line_info->ddx, diff, dx / len_sqr);
+  vso_ops_->mul(*line_info->ddy, diff, dy / len_sqr);
+
+  // See line_quad_coverage for equations.
+  vec4* line_eqs = line_info->edge_factors;
+  if (state_->get_desc().anti_aliased_line_enable) {
+    float const len = std::sqrt(len_sqr);
+    float const nx = -dy / len;
+    float const ny = dx / len;
+    line_eqs[0] = vec4(nx, ny, -(nx * p0.x() + ny * p0.y()), 0.0f);
+    line_eqs[1] = vec4(ny, -nx, nx * p0.y() - ny * p0.x(), 0.0f);
+    line_eqs[2] = vec4(len, 0.0f, 0.0f, 0.0f);
+  } else if (abs(dx) >= abs(dy)) {
+    // End point is excluded, so pixels are not drawn twice by line strips.
+    float const slope = dy / dx;
+    float const sign = dx > 0.0f ? 1.0f : -1.0f;
+    line_eqs[0] = vec4(-slope, 1.0f, slope * p0.x() - p0.y(), 0.0f);
+    line_eqs[1] = vec4(sign, 0.0f, -sign * p0.x(), 0.0f);
+    line_eqs[2] = vec4(abs(dx), 0.0f, 0.0f, 0.0f);
+  } else {
+    float const slope = dx / dy;
+    float const sign = dy > 0.0f ? 1.0f : -1.0f;
+    line_eqs[0] = vec4(1.0f, -slope, slope * p0.y() - p0.x(), 0.0f);
+    line_eqs[1] = vec4(0.0f, sign, -sign * p0.y(), 0.0f);
+    line_eqs[2] = vec4(abs(dy), 0.0f, 0.0f, 0.0f);
+  }
+
+  // Bounding box covers pixels touched by antialiasing.
+  line_info->bounding_box[0] = std::min(p0.x(), p1.x()) - 1.0f;
+  line_info->bounding_box[1] = std::max(p0.x(), p1.x()) + 1.0f;
+  line_info->bounding_box[2] = std::min(p0.y(), p1.y()) - 1.0f;
+  line_info->bounding_box[3] = std::max(p0.y(), p1.y()) + 1.0f;
+  line_info->depth_range[0] = std::min(p0.z(), p1.z());
+  line_info->depth_range[1] = std::max(p0.z(), p1.z());
+
+  line_info->front_face = true;
+  line_info->v0 = v0;
 }
 
-void rasterizer::threaded_rasterize_multi_prim(thread_context const* thread_ctx) {
-  viewport tile_vp{0.0f,
-                   0.0f,
-                   static_cast<float>(TILE_SIZE),
-                   static_cast<float>(TILE_SIZE),
+void rasterizer::setup_chunk(size_t chunk_id, uint32_t thread_id, pipeline_stage_times& times) {
+  primitive_chunk& chunk = *chunks_[chunk_id];
+  size_t const prim_begin = chunk_id * PRIMS_PER_CHUNK;
+  size_t const prim_end = std::min<size_t>(prim_begin + PRIMS_PER_CHUNK, prim_count_);
+
+  // Vertexes are shaded on demand by clipping.
+  uint64_t const clipping_start_time = fetch_time_stamp_();
+  gse_.clip(&gse_ctx_, prim_begin, prim_end, thread_id, chunk.prims);
+
+  uint64_t const vp_trans_start_time = fetch_time_stamp_();
+  gse_.project(&gse_ctx_, chunk.prims);
+
+  uint64_t const tri_setup_start_time = fetch_time_stamp_();
+  uint32_t const prim_count = static_cast<uint32_t>(chunk.prims.prim_count);
+  if (pt_point == prim_) {
+    // Points need no setup, they are binned and drawn with projected vertexes.
+    chunk.area = point_sprite_ ? prim_count * point_size_ * point_size_ : prim_count;
+  } else {
+    chunk.tri_infos.resize(prim_count);
+    chunk.tri_edges.resize(prim_count);
+    chunk.derivatives.clear();
+    chunk.derivatives.reserve(size_t(prim_count) * 2, 16, vso_size_);
+    double area = 0.0;
+    for (uint32_t i = 0; i < prim_count; ++i) {
+      if (3 == prim_size_) {
+        area += compute_triangle_info(chunk, i);
+      } else {
+        compute_line_info(chunk, i);
+      }
+    }
+    chunk.area = area;
+  }
+  uint64_t const tri_setup_end_time = fetch_time_stamp_();
+
+  size_t const stored_verts = chunk.prims.clipper_verts.size() +
+      chunk.prims.projected_verts.size() + (pt_point == prim_ ? 0 : size_t(prim_count) * 2);
+  acc_vso_bytes_saved_(pipeline_prof_, stored_verts * (sizeof(vs_output) - vso_size_));
+
+  times.clipping += vp_trans_start_time - clipping_start_time;
+  times.vp_trans += tri_setup_start_time - vp_trans_start_time;
+  times.tri_setup += tri_setup_end_time - tri_setup_start_time;
+}
+
+void rasterizer::update_tile_size() {
+  // Tiles are needed before the first chunk is binned, so the draw is estimated by the first chunk.
+  primitive_chunk const& first_chunk = *chunks_[0];
+  double const avg_area =
+      first_chunk.prims.prim_count > 0 ? first_chunk.area / first_chunk.prims.prim_count : 0.0;
+  size_t const clipped_prims_count = first_chunk.prims.prim_count * chunk_count_;
+
+  size_t const target_w = static_cast<size_t>(vp_->w);
+  size_t const target_h = static_cast<size_t>(vp_->h);
+  auto tile_count = [target_w, target_h](int size) {
+    return ((target_w + size - 1) / size) * ((target_h + size - 1) / size);
+  };
+  // Approximate count of bins which a primitive is dispatched to.
+  auto bins_per_prim = [avg_area](int size) {
+    double const extent = std::sqrt(avg_area) / size + 1.0;
+    return extent * extent;
+  };
+
+  size_t const min_tiles = MIN_TILES_PER_THREAD * num_threads_;
+  int size = DEFAULT_TILE_SIZE;
+
+  // Deferred draws of a frame share tiles, so they are binned with the default tile size.
+  if (!deferred_) {
+    // Dense and big primitives are dispatched to many bins. Use bigger tiles if workers are fed.
+    while (size < MAX_TILE_SIZE && bins_per_prim(size) > 4.0 &&
+           clipped_prims_count > tile_count(size) && tile_count(size * 2) >= min_tiles) {
+      size *= 2;
+    }
+
+    // Too few tiles starve workers.
+    while (size > MIN_TILE_SIZE && tile_count(size) < min_tiles) {
+      size /= 2;
+    }
+  }
+
+  tile_size_ = size;
+  tile_x_count_ = (target_w + size - 1) / size;
+  tile_y_count_ = (target_h + size - 1) / size;
+  tile_count_ = tile_x_count_ * tile_y_count_;
+
+  size_t size_index = 0;
+  for (int s = MIN_TILE_SIZE; s < size; s *= 2) {
+    ++size_index;
+  }
+  acc_tile_size_draws_[size_index](pipeline_prof_, 1);
+}
+
+void rasterizer::rasterize_tile(size_t tile_id,
+                                size_t chunk_begin,
+                                size_t chunk_end,
+                                size_t thread_id,
+                                pixel_statistic* pixel_stat,
+                                framebuffer_tile* fb_tile) {
+  if (bins_.empty(tile_id, chunk_begin, chunk_end)) {
+    return;
+  }
+
+  auto y = tile_id / tile_x_count_;
+  auto x = tile_id - y * tile_x_count_;
+
+  viewport tile_vp{static_cast<float>(x * tile_size_),
+                   static_cast<float>(y * tile_size_),
+                   static_cast<float>(tile_size_),
+                   static_cast<float>(tile_size_),
                    vp_->minz,
                    vp_->maxz};
 
-  std::vector<uint32_t> prims;
-  pixel_statistic pixel_stat;
-  pixel_stat.ps_invocations = 0;
-  pixel_stat.backend_input_pixels = 0;
-
   rasterize_multi_prim_context rast_ctxt{
-      .sorted_prims = &prims,
+      .bins = &bins_,
+      .tile_id = tile_id,
+      .slice_begin = chunk_begin,
+      .slice_end = chunk_end,
       .tile_vp = &tile_vp,
-      .pixel_stat = &pixel_stat,
-      .shaders = {.cpp_ps = threaded_cpp_ps_[thread_ctx->thread_id],
-                  .ps_unit = threaded_psu_[thread_ctx->thread_id],
+      .pixel_stat = pixel_stat,
+      .shaders = {.cpp_ps = threaded_cpp_ps_[thread_id].get(),
+                  .ps_unit = threaded_psu_[thread_id].get(),
                   .cpp_bs = cpp_bs_}};
 
-  thread_context::package_cursor current_package = thread_ctx->next_package();
-  while (current_package.valid()) {
-    auto tile_range = current_package.index_range();
-    for (size_t tile_id = tile_range.first; tile_id < tile_range.second; ++tile_id) {
-      prims.clear();
-      for (auto const& thread_prims : threaded_tiled_prims_) {
-        prims.insert(prims.end(), thread_prims[tile_id].begin(), thread_prims[tile_id].end());
+  if (fb_tile != nullptr) {
+    frame_buffer_->begin_tile(fb_tile, x * tile_size_, y * tile_size_, tile_size_);
+  } else {
+    frame_buffer_->expand_clears(x * tile_size_, y * tile_size_, tile_size_);
+  }
+  rasterize_prims_(this, &rast_ctxt);
+  if (fb_tile != nullptr) {
+    framebuffer::end_tile(fb_tile);
+  }
+}
+
+bool rasterizer::tile_resident(uint64_t cost) const {
+#if SALVIA_TILED_SURFACE
+  return false;
+#else
+  return cost >= TILE_RESIDENT_MIN_COVERAGE * tile_size_ * tile_size_;
+#endif
+}
+
+bool rasterizer::try_setup_chunk(uint32_t thread_id, pipeline_stage_times& times) {
+  if (setup_cursor_.load(std::memory_order_relaxed) >= chunk_count_) {
+    return false;
+  }
+  size_t const chunk_id = setup_cursor_.fetch_add(1);
+  if (chunk_id >= chunk_count_) {
+    return false;
+  }
+
+  setup_chunk(chunk_id, thread_id, times);
+
+  if (chunk_id == 0) {
+    update_tile_size();
+    bins_.reset(tile_count_, chunk_count_, num_threads_);
+    if (tile_progress_capacity_ < tile_count_) {
+      tile_progress_.reset(new tile_progress[tile_count_]);
+      tile_progress_capacity_ = tile_count_;
+    }
+    for (size_t i = 0; i < tile_count_; ++i) {
+      tile_progress_[i].locked.store(false, std::memory_order_relaxed);
+      tile_progress_[i].next_chunk.store(0, std::memory_order_relaxed);
+      tile_progress_[i].pending_cost.store(0, std::memory_order_relaxed);
+    }
+    for (bin_costs& costs : threaded_bin_costs_) {
+      costs.costs.assign(tile_count_, 0);
+      costs.tiles.clear();
+    }
+    tiles_ready_.store(true, std::memory_order_release);
+  }
+
+  chunk_states_[chunk_id].store(chunk_set_up, std::memory_order_release);
+  signal_progress();
+  return true;
+}
+
+bool rasterizer::try_bin_chunk(uint32_t thread_id,
+                               pipeline_stage_times& times,
+                               uint64_t& hiz_rejects) {
+  if (!tiles_ready_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  // Chunks are claimed in drawing order, but they may be binned concurrently.
+  size_t chunk_id = bin_cursor_.load();
+  do {
+    if (chunk_id >= chunk_count_ ||
+        chunk_states_[chunk_id].load(std::memory_order_acquire) != chunk_set_up) {
+      return false;
+    }
+  } while (!bin_cursor_.compare_exchange_weak(chunk_id, chunk_id + 1));
+
+  uint64_t const tri_dispatch_start_time = fetch_time_stamp_();
+  bin_chunk(chunk_id, thread_id, hiz_rejects);
+  times.tri_dispatch += fetch_time_stamp_() - tri_dispatch_start_time;
+
+  bin_costs& costs = threaded_bin_costs_[thread_id];
+  for (uint32_t tile_id : costs.tiles) {
+    tile_progress_[tile_id].pending_cost.fetch_add(costs.costs[tile_id], std::memory_order_relaxed);
+    costs.costs[tile_id] = 0;
+  }
+  costs.tiles.clear();
+
+  chunk_states_[chunk_id].store(chunk_binned);
+
+  // Publish the longest prefix of binned chunks to rasterization.
+  size_t binned = binned_chunks_.load();
+  while (binned < chunk_count_ && chunk_states_[binned].load() == chunk_binned) {
+    binned_chunks_.compare_exchange_weak(binned, binned + 1);
+  }
+  signal_progress();
+  return true;
+}
+
+bool rasterizer::try_rasterize_tile(size_t thread_id,
+                                    size_t& tile_cursor,
+                                    pipeline_stage_times& times,
+                                    pixel_statistic* pixel_stat) {
+  if (!tiles_ready_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  size_t const binned = binned_chunks_.load(std::memory_order_acquire);
+  if (binned == chunk_count_) {
+    // Tiles which are being rasterized by other threads are scheduled as well, they may have
+    // chunks left.
+    uint32_t state = schedule_state_.load(std::memory_order_acquire);
+    if (state == schedule_none &&
+        schedule_state_.compare_exchange_strong(state, schedule_building)) {
+      tile_costs_.resize(tile_count_);
+      for (size_t tile_id = 0; tile_id < tile_count_; ++tile_id) {
+        tile_costs_[tile_id] = tile_progress_[tile_id].pending_cost.load(std::memory_order_relaxed);
+      }
+      tile_scheduler_.reset(tile_costs_.data(), tile_count_, num_threads_);
+      schedule_state_.store(schedule_ready, std::memory_order_release);
+      signal_progress();
+      state = schedule_ready;
+    }
+    if (state == schedule_ready) {
+      return try_rasterize_scheduled_tile(thread_id, times, pixel_stat);
+    }
+  }
+
+  for (size_t i = 0; i < tile_count_; ++i) {
+    size_t const tile_id = (tile_cursor + i) % tile_count_;
+    tile_progress& progress = tile_progress_[tile_id];
+    if (progress.next_chunk.load(std::memory_order_relaxed) >= binned ||
+        progress.locked.exchange(true, std::memory_order_acquire)) {
+      continue;
+    }
+
+    size_t const chunk_begin = progress.next_chunk.load(std::memory_order_relaxed);
+    if (chunk_begin < binned) {
+      uint64_t const cost = progress.pending_cost.exchange(0, std::memory_order_relaxed);
+      uint64_t const ras_start_time = fetch_time_stamp_();
+      rasterize_tile(tile_id,
+                     chunk_begin,
+                     binned,
+                     thread_id,
+                     pixel_stat,
+                     tile_resident(cost) ? &threaded_fb_tiles_[thread_id] : nullptr);
+      times.ras += fetch_time_stamp_() - ras_start_time;
+
+      progress.next_chunk.store(binned, std::memory_order_relaxed);
+      if (binned == chunk_count_) {
+        ++finished_tiles_;
       }
-      std::sort(prims.begin(), prims.end());
+    }
+    unlock_tile(progress);
+
+    if (chunk_begin < binned) {
+      tile_cursor = tile_id + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool rasterizer::try_rasterize_scheduled_tile(size_t thread_id,
+                                              pipeline_stage_times& times,
+                                              pixel_statistic* pixel_stat) {
+  size_t tile_id;
+  while (tile_scheduler_.pop(thread_id, tile_id)) {
+    tile_progress& progress = tile_progress_[tile_id];
+    if (progress.next_chunk.load(std::memory_order_relaxed) == chunk_count_) {
+      continue;
+    }
+
+    // The tile was taken by a thread before scheduling, wait for its remaining chunks.
+    for (int spin = 0; progress.locked.exchange(true, std::memory_order_acquire); ++spin) {
+      if (spin < IDLE_SPIN_COUNT) {
+        std::this_thread::yield();
+      } else {
+        progress.locked.wait(true, std::memory_order_relaxed);
+      }
+    }
+
+    size_t const chunk_begin = progress.next_chunk.load(std::memory_order_relaxed);
+    if (chunk_begin < chunk_count_) {
+      uint64_t const cost = progress.pending_cost.exchange(0, std::memory_order_relaxed);
+      uint64_t const ras_start_time = fetch_time_stamp_();
+      rasterize_tile(tile_id,
+                     chunk_begin,
+                     chunk_count_,
+                     thread_id,
+                     pixel_stat,
+                     tile_resident(cost) ? &threaded_fb_tiles_[thread_id] : nullptr);
+      times.ras += fetch_time_stamp_() - ras_start_time;
+
+      progress.next_chunk.store(chunk_count_, std::memory_order_relaxed);
+      ++finished_tiles_;
+    }
+    unlock_tile(progress);
+
+    if (chunk_begin < chunk_count_) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool rasterizer::pipeline_finished() const {
+  return tiles_ready_.load() && binned_chunks_.load() == chunk_count_ &&
+      (deferred_ || finished_tiles_.load() == tile_count_);
+}
+
+void rasterizer::signal_progress() {
+  pipeline_progress_.fetch_add(1, std::memory_order_release);
+  pipeline_progress_.notify_all();
+}
+
+void rasterizer::wait_progress(uint32_t progress) const {
+  for (int spin = 0; spin < IDLE_SPIN_COUNT; ++spin) {
+    if (pipeline_progress_.load(std::memory_order_acquire) != progress) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+  pipeline_progress_.wait(progress, std::memory_order_acquire);
+}
 
-      auto y = tile_id / tile_x_count_;
-      auto x = tile_id - y * tile_x_count_;
+void rasterizer::unlock_tile(tile_progress& progress) {
+  progress.locked.store(false, std::memory_order_release);
+  progress.locked.notify_all();
+  // Chunks may be binned to the tile while it was locked, other threads could rasterize them now.
+  signal_progress();
+}
 
-      tile_vp.x = static_cast<float>(x * TILE_SIZE);
-      tile_vp.y = static_cast<float>(y * TILE_SIZE);
+void rasterizer::threaded_pipeline(thread_context const* thread_ctx) {
+  auto const thread_id = static_cast<uint32_t>(thread_ctx->thread_id);
 
-      rast_ctxt.sorted_prims = &prims;
+  pipeline_stage_times times{0, 0, 0, 0, 0};
+  pixel_statistic pixel_stat{0, 0, 0};
+  uint64_t hiz_rejects = 0;
 
-      rasterize_prims_(this, &rast_ctxt);
+  // Tiles are visited from different positions by threads to reduce contention.
+  size_t tile_cursor = thread_id * MIN_TILES_PER_THREAD;
 
-      current_package = thread_ctx->next_package();
+  // Later stages go first, so chunks in flight are drained before new chunks are set up.
+  for (;;) {
+    // Progress is observed before work is tried, so work published meanwhile is never missed.
+    uint32_t const progress = pipeline_progress_.load(std::memory_order_acquire);
+    if (try_bin_chunk(thread_id, times, hiz_rejects)) {
+      continue;
+    }
+    if (try_setup_chunk(thread_id, times)) {
+      continue;
+    }
+    if (!deferred_ && try_rasterize_tile(thread_id, tile_cursor, times, &pixel_stat)) {
+      continue;
     }
+    if (pipeline_finished()) {
+      break;
+    }
+    wait_progress(progress);
   }
+  thread_end_times_[thread_id] = fetch_time_stamp_();
+
+  acc_clipping_(pipeline_prof_, times.clipping);
+  acc_vp_trans_(pipeline_prof_, times.vp_trans);
+  acc_tri_setup_(pipeline_prof_, times.tri_setup);
+  acc_tri_dispatch_(pipeline_prof_, times.tri_dispatch);
+  acc_ras_(pipeline_prof_, times.ras);
 
   acc_ps_invocations_(pipeline_stat_, pixel_stat.ps_invocations);
+  acc_hiz_rejects_(pipeline_stat_, pixel_stat.hiz_rejects + hiz_rejects);
   acc_backend_input_pixels_(internal_stat_, pixel_stat.backend_input_pixels);
 }
 
+void rasterizer::rasterize_multi_point(rasterize_multi_prim_context const* ctx) {
+  drawing_shader_context const& shaders = ctx->shaders;
+  if (shaders.cpp_ps != nullptr) {
+    shaders.cpp_ps->update_front_face(true);
+  }
+
+  auto point_vert = [this](uint32_t prim_with_mask) -> vs_output const& {
+    uint32_t const prim_id = prim_with_mask >> 1;
+    return *chunks_[prim_id >> CHUNK_PRIM_BITS]->prims.verts[prim_id & CHUNK_PRIM_MASK];
+  };
+
+  if (point_sprite_) {
+    ctx->bins->for_each(ctx->tile_id, ctx->slice_begin, ctx->slice_end, [&](uint32_t prim) {
+      draw_point_sprite(point_vert(prim), ctx);
+    });
+    return;
+  }
+
+  viewport const& vp = *ctx->tile_vp;
+  int const left = max(fast_floori(vp.x), draw_left_);
+  int const top = max(fast_floori(vp.y), draw_top_);
+  int const right = min(fast_floori(vp.x + vp.w), draw_right_);
+  int const bottom = min(fast_floori(vp.y + vp.h), draw_bottom_);
+  float const aa_z_offset[MAX_NUM_MULTI_SAMPLES] = {};
+
+  // Pixels of 4 points are shaded as a quad, so derivatives are undefined in pixel shader.
+  EFLIB_ALIGN(16) vs_output pixels[4];
+  ps_output pso[4];
+  float depth[4];
+  int xs[4];
+  int ys[4];
+  uint64_t masks[4];
+  int batch_size = 0;
+
+  auto shade_batch = [&]() {
+    for (int i = batch_size; i < 4; ++i) {
+      vso_ops_->copy(pixels[i], pixels[0]);
+      depth[i] = depth[0];
+    }
+
+    ctx->pixel_stat->ps_invocations += 4;
+    uint64_t ps_mask = quad_full_mask_;
+    if (shaders.ps_unit) {
+      shaders.ps_unit->update(pixels, vs_reflection_);
+      shaders.ps_unit->execute(pso, depth);
+    } else {
+      ps_mask = shaders.cpp_ps->execute(pixels, pso, depth);
+    }
+
+    // Points are written in drawing order, even if they are in the same pixel.
+    for (int i = 0; i < batch_size; ++i) {
+      uint32_t sample_mask = static_cast<uint32_t>(masks[i] & (ps_mask >> (i * MAX_SAMPLE_COUNT)));
+      if (sample_mask == 0) {
+        continue;
+      }
+      ++ctx->pixel_stat->backend_input_pixels;
+      uint32_t i_sample;
+      while (_xmm_bsf(&i_sample, sample_mask)) {
+        frame_buffer_->render_sample(
+            shaders.cpp_bs, xs[i], ys[i], i_sample, pso[i], depth[i], true);
+        sample_mask &= sample_mask - 1;
+      }
+    }
+    batch_size = 0;
+  };
+
+  auto batch_point = [&](uint32_t prim_with_mask) {
+    vs_output const& point = point_vert(prim_with_mask);
+    int const x = fast_floori(point.position().x());
+    int const y = fast_floori(point.position().y());
+    if (x < left || x >= right || y < top || y >= bottom) {
+      return;
+    }
+
+    float const z = point.position().z();
+    uint64_t mask = full_mask_;
+    if (frame_buffer_->early_z_enabled()) {
+      mask = frame_buffer_->early_z_test(x, y, z, aa_z_offset);
+      if (mask == 0 || depth_only_) {
+        return;
+      }
+    } else if (!has_pixel_shader_) {
+      ++ctx->pixel_stat->backend_input_pixels;
+      frame_buffer_->late_depth_stencil(x, y, static_cast<uint32_t>(mask), z, true, aa_z_offset);
+      return;
+    }
+
+    vs_output& pixel = pixels[batch_size];
+    vso_ops_->unproject(pixel, point);
+    pixel.position().x() = x + 0.5f;
+    pixel.position().y() = y + 0.5f;
+    depth[batch_size] = z;
+    xs[batch_size] = x;
+    ys[batch_size] = y;
+    masks[batch_size] = mask;
+    if (++batch_size == 4) {
+      shade_batch();
+    }
+  };
+
+  ctx->bins->for_each(ctx->tile_id, ctx->slice_begin, ctx->slice_end, batch_point);
+  if (batch_size > 0) {
+    shade_batch();
+  }
+}
+
+void rasterizer::draw_point_sprite(vs_output const& point,
+                                   rasterize_multi_prim_context const* ctx) {
+  viewport const& vp = *ctx->tile_vp;
+  vec4 const& pos = point.position();
+  float const sprite_left = pos.x() - point_size_ * 0.5f;
+  float const sprite_top = pos.y() - point_size_ * 0.5f;
+  float const inv_size = 1.0f / point_size_;
+
+  // Pixels in tile and draw rectangle whose centers are in the sprite.
+  int const x_begin = max({fast_floori(vp.x), draw_left_, fast_ceili(sprite_left - 0.5f)});
+  int const y_begin = max({fast_floori(vp.y), draw_top_, fast_ceili(sprite_top - 0.5f)});
+  int const x_end = min({fast_floori(vp.x + vp.w),
+                         draw_right_,
+                         fast_ceili(sprite_left + point_size_ - 0.5f)});
+  int const y_end = min({fast_floori(vp.y + vp.h),
+                         draw_bottom_,
+                         fast_ceili(sprite_top + point_size_ - 0.5f)});
+  if (x_begin >= x_end || y_begin >= y_end) {
+    return;
+  }
+
+  EFLIB_ALIGN(16) vs_output sprite;
+  vso_ops_->unproject(sprite, point);
+  float const aa_z_offset[MAX_NUM_MULTI_SAMPLES] = {};
+
+  // Attributes are constant over the sprite but texture coordinate, which replaces x and y of the
+  // first attribute.
+  for (int quad_y = y_begin & ~1; quad_y < y_end; quad_y += 2) {
+    for (int quad_x = x_begin & ~1; quad_x < x_end; quad_x += 2) {
+      uint64_t quad_mask = 0;
+      for (int i_pixel = 0; i_pixel < 4; ++i_pixel) {
+        int const x = quad_x + (i_pixel & 1);
+        int const y = quad_y + (i_pixel >> 1);
+        if (x_begin <= x && x < x_end && y_begin <= y && y < y_end) {
+          quad_mask |= full_mask_ << (i_pixel * MAX_SAMPLE_COUNT);
+        }
+      }
+
+      float depth[4] = {pos.z(), pos.z(), pos.z(), pos.z()};
+      if (frame_buffer_->early_z_enabled()) {
+        quad_mask = frame_buffer_->early_z_test_quad(quad_x, quad_y, quad_mask, depth, aa_z_offset);
+        if (quad_mask == 0 || depth_only_) {
+          continue;
+        }
+      } else if (!has_pixel_shader_) {
+        ctx->pixel_stat->backend_input_pixels += 4;
+        frame_buffer_->late_depth_stencil_quad(quad_x, quad_y, quad_mask, depth, true, aa_z_offset);
+        continue;
+      }
+
+      EFLIB_ALIGN(16) vs_output pixels[4];
+      for (int i_pixel = 0; i_pixel < 4; ++i_pixel) {
+        float const x = quad_x + (i_pixel & 1) + 0.5f;
+        float const y = quad_y + (i_pixel >> 1) + 0.5f;
+        vso_ops_->copy(pixels[i_pixel], sprite);
+        pixels[i_pixel].position().x() = x;
+        pixels[i_pixel].position().y() = y;
+        if (num_vs_output_attributes_ > 0) {
+          pixels[i_pixel].attribute(0).x() = (x - sprite_left) * inv_size;
+          pixels[i_pixel].attribute(0).y() = (y - sprite_top) * inv_size;
+        }
+      }
+
+      ctx->pixel_stat->ps_invocations += 4;
+      ps_output pso[4];
+      if (ctx->shaders.ps_unit) {
+        ctx->shaders.ps_unit->update(pixels, vs_reflection_);
+        ctx->shaders.ps_unit->execute(pso, depth);
+      } else {
+        quad_mask &= ctx->shaders.cpp_ps->execute(pixels, pso, depth);
+      }
+
+      if (quad_mask != 0) {
+        ctx->pixel_stat->backend_input_pixels += 4;
+        frame_buffer_->render_sample_quad(
+            ctx->shaders.cpp_bs, quad_x, quad_y, quad_mask, pso, depth, true, aa_z_offset);
+      }
+    }
+  }
+}
+
 void rasterizer::rasterize_multi_line(rasterize_multi_prim_context const* ctx) {
   rasterize_prim_context prim_ctxt;
   prim_ctxt.shaders = ctx->shaders;
   prim_ctxt.tile_vp = ctx->tile_vp;
+  prim_ctxt.pixel_stat = ctx->pixel_stat;
 
-  for (uint32_t prim_with_mask : *ctx->sorted_prims) {
+  auto rasterize_prim = [this, &prim_ctxt](uint32_t prim_with_mask) {
     prim_ctxt.prim_id = prim_with_mask >> 1;
     rasterize_line(&prim_ctxt);
-  }
+  };
+  ctx->bins->for_each(ctx->tile_id, ctx->slice_begin, ctx->slice_end, rasterize_prim);
 }
 
 void rasterizer::rasterize_multi_triangle(rasterize_multi_prim_context const* ctx) {
@@ -1010,19 +1969,23 @@ void rasterizer::rasterize_multi_triangle(rasterize_multi_prim_context const* ct
   prim_ctxt.tile_vp = ctx->tile_vp;
   prim_ctxt.pixel_stat = ctx->pixel_stat;
 
-  for (uint32_t prim_with_mask : *ctx->sorted_prims) {
+  auto rasterize_prim = [this, &prim_ctxt](uint32_t prim_with_mask) {
     prim_ctxt.prim_id = prim_with_mask;
     rasterize_triangle(&prim_ctxt);
-  }
+  };
+  ctx->bins->for_each(ctx->tile_id, ctx->slice_begin, ctx->slice_end, rasterize_prim);
 }
 
 void rasterizer::update_prim_info(render_state const* state) {
   bool is_tri = false;
+  bool is_line = false;
+  bool is_point = false;
 
   bool is_wireframe = false;
   bool is_solid = false;
 
-  prim_count_ = state->prim_count;
+  // Primitive i of instance k is primitive 'k * state->prim_count + i' of the draw.
+  prim_count_ = state->prim_count * state->instance_count;
 
   switch (state_->get_desc().fm) {
   case fill_solid: is_solid = true; break;
@@ -1032,16 +1995,23 @@ void rasterizer::update_prim_info(render_state const* state) {
 
   switch (state->prim_topo) {
   case primitive_point_list:
-  case primitive_point_sprite:
+  case primitive_point_sprite: is_point = true; break;
   case primitive_line_list:
-  case primitive_line_strip: break;
+  case primitive_line_strip: is_line = true; break;
   case primitive_triangle_list:
   case primitive_triangle_fan:
   case primitive_triangle_strip: is_tri = true; break;
   default: break;
   }
 
-  if (is_solid && is_tri) {
+  point_sprite_ = state->prim_topo == primitive_point_sprite;
+  point_size_ = std::max(state_->get_desc().point_size, 1.0f);
+
+  if (is_point) {
+    prim_ = pt_point;
+  } else if (is_line) {
+    prim_ = pt_line;
+  } else if (is_solid && is_tri) {
     prim_ = pt_solid_tri;
   } else if (is_wireframe && is_tri) {
     prim_ = pt_wireframe_tri;
@@ -1051,6 +2021,7 @@ void rasterizer::update_prim_info(render_state const* state) {
   }
 
   switch (prim_) {
+  case pt_point: prim_size_ = 1; break;
   case pt_line:
   case pt_wireframe_tri: prim_size_ = 2; break;
   case pt_solid_tri: prim_size_ = 3; break;
@@ -1076,9 +2047,22 @@ void rasterizer::prepare_draw() {
     vso_ops_ = vso_op;
   }
 
+  vso_size_ = vs_output::size_of(num_vs_output_attributes_);
+
+  // Attributes which pixel shader never reads are neither set up nor interpolated. The mask is
+  // kept by rasterizer, since operations of vs_output are shared by draws and renderers.
+  used_attributes_ = 0;
+  if (cpp_ps_) {
+    used_attributes_ = cpp_ps_->input_attribute_mask();
+  } else if (ps_proto_) {
+    used_attributes_ = ps_proto_->input_attribute_mask(vs_reflection_);
+  }
+  used_attributes_ &= (1U << num_vs_output_attributes_) - 1;
+
   has_centroid_ = false;
   for (size_t i_attr = 0; i_attr < num_vs_output_attributes_; ++i_attr) {
-    if (vso_ops_->attribute_modifiers[i_attr] & vs_output::am_centroid) {
+    if ((used_attributes_ & (1U << i_attr)) &&
+        (vso_ops_->attribute_modifiers[i_attr] & vs_output::am_centroid)) {
       has_centroid_ = true;
     }
   }
@@ -1102,144 +2086,193 @@ void rasterizer::prepare_draw() {
   default: break;
   }
 
-  // Compute tile count
-  tile_x_count_ = static_cast<size_t>(vp_->w + TILE_SIZE - 1) / TILE_SIZE;
-  tile_y_count_ = static_cast<size_t>(vp_->h + TILE_SIZE - 1) / TILE_SIZE;
-  tile_count_ = tile_x_count_ * tile_y_count_;
+  int32_t const subpixel_one = 1 << subpixel_bits_;
+  for (size_t i_sample = 0; i_sample < target_sample_count_; ++i_sample) {
+    vec2 const& sp = samples_pattern_[i_sample];
+    samples_fixed_x_[i_sample] =
+        min(fast_roundi(sp.x() * static_cast<float>(subpixel_one)), subpixel_one - 1);
+    samples_fixed_y_[i_sample] =
+        min(fast_roundi(sp.y() * static_cast<float>(subpixel_one)), subpixel_one - 1);
+  }
 }
 
-void rasterizer::draw() {
-  vert_cache_->prepare_vertices();
-  prepare_draw();
-
-  size_t num_threads = std::thread::hardware_concurrency();
+void rasterizer::run_pipeline() {
+  // Pool and thread count are of one snapshot, per-thread state of the draw is sized by it.
+  pipeline_threads const threads = current_pipeline_threads();
+  thread_pool_ = threads.pool;
+  num_threads_ = threads.count;
 
-  geom_setup_context geom_setup_ctx;
-
-  geom_setup_ctx.cull = state_->get_cull_func();
-  geom_setup_ctx.dvc = vert_cache_;
-  geom_setup_ctx.prim = prim_;
-  geom_setup_ctx.prim_count = prim_count_;
-  geom_setup_ctx.prim_size = prim_size_;
-  geom_setup_ctx.vso_ops = vso_ops_;
-  geom_setup_ctx.pipeline_stat = pipeline_stat_;
-  geom_setup_ctx.acc_cinvocations = acc_cinvocations_;
-
-  uint64_t clipping_start_time = fetch_time_stamp_();
-  gse_.execute(&geom_setup_ctx, fetch_time_stamp_);
-  acc_clipping_(pipeline_prof_, gse_.compact_start_time() - clipping_start_time);
-  acc_compact_clip_(pipeline_prof_, fetch_time_stamp_() - gse_.compact_start_time());
+  vert_cache_->prepare_vertices(threads);
+  prepare_draw();
 
-  clipped_verts_ = gse_.vertexes();
-  clipped_verts_count_ = gse_.vertex_count();
-  clipped_prims_count_ = clipped_verts_count_ / prim_size_;
+  gse_ctx_.cull = state_->get_cull_func();
+  gse_ctx_.dvc = vert_cache_;
+  gse_ctx_.vp = vp_;
+  gse_ctx_.prim = prim_;
+  gse_ctx_.prim_size = prim_size_;
+  gse_ctx_.vso_ops = vso_ops_;
+  gse_ctx_.vso_size = vso_size_;
+  gse_ctx_.pipeline_stat = pipeline_stat_;
+  gse_ctx_.acc_cinvocations = acc_cinvocations_;
+
+  // Framebuffer is updated after rasterizer, so Hi-Z state is fetched at drawing.
+  hiz_enabled_ = (3 == prim_size_) && frame_buffer_->hiz_enabled();
+
+  chunk_count_ = (prim_count_ + PRIMS_PER_CHUNK - 1) / PRIMS_PER_CHUNK;
+  while (chunks_.size() < chunk_count_) {
+    chunks_.push_back(std::make_unique<primitive_chunk>());
+  }
+  if (chunk_states_capacity_ < chunk_count_) {
+    chunk_states_.reset(new atomic<uint32_t>[chunk_count_]);
+    chunk_states_capacity_ = chunk_count_;
+  }
+  for (size_t i = 0; i < chunk_count_; ++i) {
+    chunk_states_[i].store(chunk_pending, std::memory_order_relaxed);
+  }
+  setup_cursor_ = 0;
+  bin_cursor_ = 0;
+  binned_chunks_ = 0;
+  finished_tiles_ = 0;
+  tiles_ready_ = false;
+  pipeline_progress_ = 0;
+
+  if (chunk_count_ == 0) {
+    tile_x_count_ = tile_y_count_ = tile_count_ = 0;
+    bins_.reset(0, 0, num_threads_);
+    tiles_ready_ = true;
+  }
 
   acc_ia_primitives_(pipeline_stat_, prim_count_);
-  acc_cprimitives_(pipeline_stat_, clipped_prims_count_);
-
-  // Project and Transformed to Viewport
-  uint64_t vp_trans_start_time = fetch_time_stamp_();
-  viewport_and_project_transform(clipped_verts_, clipped_verts_count_);
-  acc_vp_trans_(pipeline_prof_, fetch_time_stamp_() - vp_trans_start_time);
 
-  uint64_t tri_dispatch_start_time = fetch_time_stamp_();
-  // Dispatch primitives into tiles' bucket
-  threaded_tiled_prims_.resize(num_threads);
-  tri_infos_.resize(clipped_prims_count_);
-  for (size_t i = 0; i < num_threads; ++i) {
-    threaded_tiled_prims_[i].resize(tile_count_);
-  }
-
-  // Execute dispatching primitive
-  execute_threads(
-      global_thread_pool(),
-      [this](thread_context const* thread_ctx) { this->threaded_dispatch_primitive(thread_ctx); },
-      clipped_prims_count_,
-      DISPATCH_PRIMITIVE_PACKAGE_SIZE,
-      num_threads);
-  acc_tri_dispatch_(pipeline_prof_, fetch_time_stamp_() - tri_dispatch_start_time);
-
-  // Rasterize tiles
   switch (prim_) {
+  case pt_point: rasterize_prims_ = std::mem_fn(&rasterizer::rasterize_multi_point); break;
   case pt_line:
   case pt_wireframe_tri: rasterize_prims_ = std::mem_fn(&rasterizer::rasterize_multi_line); break;
   case pt_solid_tri: rasterize_prims_ = std::mem_fn(&rasterizer::rasterize_multi_triangle); break;
   default: EF_ASSERT(false, "Primitive type is not correct.");
   }
 
-  std::vector<cpp_pixel_shader_ptr> ppps(num_threads);
-  std::vector<pixel_shader_unit_ptr> ppsu(num_threads);
+  // Stencil test and depth written by pixel shader disable early Z, they need the per-sample path.
+  depth_only_ = depth_only_shading_ && frame_buffer_->early_z_enabled();
 
-  threaded_cpp_ps_.resize(num_threads);
-  threaded_psu_.resize(num_threads);
+  if (!depth_only_) {
+    update_threaded_shaders();
+  }
 
-  for (size_t i = 0; i < num_threads; ++i) {
-    // create cpp_pixel_shader clone per thread from hps
-    if (cpp_ps_ != nullptr) {
-      ppps[i] = cpp_ps_->clone<cpp_pixel_shader>();
-      threaded_cpp_ps_[i] = ppps[i].get();
-    }
-    if (ps_proto_ != nullptr) {
-      ppsu[i] = ps_proto_->clone();
-      threaded_psu_[i] = ppsu[i].get();
-    }
+  if (threaded_bin_costs_.size() < num_threads_) {
+    threaded_bin_costs_.resize(num_threads_);
+  }
+  if (threaded_fb_tiles_.size() < num_threads_) {
+    threaded_fb_tiles_.resize(num_threads_);
   }
+  schedule_state_ = schedule_none;
+  thread_end_times_.assign(num_threads_, 0);
 
-  uint64_t ras_start_time = fetch_time_stamp_();
+  // Every thread runs all stages, so shading, setup and rasterization of chunks are overlapped.
+  uint64_t const pipeline_start_time = fetch_time_stamp_();
   execute_threads(
-      global_thread_pool(),
-      [this](thread_context const* thread_ctx) { this->threaded_rasterize_multi_prim(thread_ctx); },
-      tile_count_,
-      RASTERIZE_PRIMITIVE_PACKAGE_SIZE,
-      num_threads);
-  acc_ras_(pipeline_prof_, fetch_time_stamp_() - ras_start_time);
+      *thread_pool_,
+      [this](thread_context const* thread_ctx) { this->threaded_pipeline(thread_ctx); },
+      num_threads_,
+      1,
+      num_threads_);
+  acc_pipeline_thread_time_(pipeline_prof_,
+                            (fetch_time_stamp_() - pipeline_start_time) * num_threads_);
+
+  // Threads which finish early are idle until the last one finishes.
+  uint64_t const last_end_time =
+      *std::max_element(thread_end_times_.begin(), thread_end_times_.end());
+  uint64_t idle_time = 0;
+  for (uint64_t end_time : thread_end_times_) {
+    idle_time += last_end_time - end_time;
+  }
+  acc_load_imbalance_(pipeline_prof_, idle_time);
+  if (schedule_state_ == schedule_ready) {
+    acc_tile_steals_(pipeline_prof_, tile_scheduler_.steal_count());
+  }
+
+  vert_cache_->update_statistic();
 
-  // destroy all cpp_pixel_shader clone
-  for (size_t i = 0; i < num_threads; ++i) {
-    ppps[i].reset();
+  uint64_t clipped_prims_count = 0;
+  for (size_t i = 0; i < chunk_count_; ++i) {
+    clipped_prims_count += chunks_[i]->prims.prim_count;
   }
+  acc_cprimitives_(pipeline_stat_, clipped_prims_count);
 }
 
-void threaded_viewport_and_project_transform(vs_output_functions::project proj_fn,
-                                             vs_output** verts,
-                                             viewport const* vp,
-                                             thread_context const* thread_ctx) {
-  thread_context::package_cursor current_package = thread_ctx->next_package();
-  while (current_package.valid()) {
-    auto prim_range = current_package.range(verts);
-
-    for (vs_output* vso : prim_range) {
-      viewport_transform(vso->position(), *vp);
-      proj_fn(*vso, *vso);
+// Shader clones of threads are kept across draws, and refreshed only if the bound shader or its
+// constants are changed.
+void rasterizer::update_threaded_shaders() {
+  bool const resized = threaded_cpp_ps_.size() != num_threads_;
+  threaded_cpp_ps_.resize(num_threads_);
+  threaded_psu_.resize(num_threads_);
+
+  uint64_t clones = 0;
+  uint64_t const cpp_ps_version = cpp_ps_ ? cpp_ps_->version() : 0;
+  if (resized || threaded_cpp_ps_version_ != cpp_ps_version) {
+    for (auto& ps : threaded_cpp_ps_) {
+      ps = cpp_ps_ ? cpp_ps_->clone<cpp_pixel_shader>() : nullptr;
     }
+    threaded_cpp_ps_version_ = cpp_ps_version;
+    clones += cpp_ps_ ? num_threads_ : 0;
+  }
 
-    current_package = thread_ctx->next_package();
+  // Units of the same prototype only copy constants, stream buffers are kept.
+  uint64_t const psu_version = ps_proto_ ? ps_proto_->version() : 0;
+  if (resized || threaded_psu_version_ != psu_version) {
+    for (auto& psu : threaded_psu_) {
+      if (ps_proto_ == nullptr) {
+        psu.reset();
+      } else if (psu == nullptr || !psu->update_constants(*ps_proto_)) {
+        psu = ps_proto_->clone();
+        ++clones;
+      }
+    }
+    threaded_psu_version_ = psu_version;
   }
+  acc_shader_clones_(pipeline_prof_, clones);
 }
 
-void rasterizer::viewport_and_project_transform(vs_output** vertexes, size_t num_verts) {
-  // Gathering vs_output need to be processed.
-  vector<vs_output*> sorted;
-  sorted.insert(sorted.end(), vertexes, vertexes + num_verts);
+void rasterizer::draw() {
+  deferred_ = false;
+  run_pipeline();
+  thread_pool_.reset();
+  frame_buffer_->refresh_hiz();
+}
 
-#if !defined(_LIBCPP_VERSION) || defined(_LIBCPP_HAS_PARALLEL_ALGORITHMS)
-  std::sort(std::execution::par, sorted.begin(), sorted.end());
-#else
-  std::sort(sorted.begin(), sorted.end());
-#endif
+void rasterizer::bin_deferred() {
+  deferred_ = true;
+  run_pipeline();
+  threaded_pixel_stat_.assign(num_threads_, pixel_statistic{0, 0, 0});
+}
 
-  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+void rasterizer::rasterize_deferred_tile(size_t tile_x, size_t tile_y, size_t thread_id) {
+  if (tile_x < tile_x_count_ && tile_y < tile_y_count_) {
+    // Tile of deferred draws is loaded once for all draws by the caller.
+    rasterize_tile(tile_y * tile_x_count_ + tile_x,
+                   0,
+                   chunk_count_,
+                   thread_id,
+                   &threaded_pixel_stat_[thread_id],
+                   nullptr);
+  }
+}
 
-  vs_output** in_out_vertexes = sorted.data();
+uint64_t rasterizer::tile_cost(size_t tile_x, size_t tile_y) const {
+  if (tile_x >= tile_x_count_ || tile_y >= tile_y_count_) {
+    return 0;
+  }
+  return tile_progress_[tile_y * tile_x_count_ + tile_x].pending_cost.load(
+      std::memory_order_relaxed);
+}
 
-  execute_threads(
-      global_thread_pool(),
-      [this, in_out_vertexes](thread_context const* thread_ctx) {
-        threaded_viewport_and_project_transform(
-            this->vso_ops_->project, in_out_vertexes, this->vp_, thread_ctx);
-      },
-      static_cast<int>(sorted.size()),
-      VP_PROJ_TRANSFORM_PACKAGE_SIZE);
+void rasterizer::finish_deferred() {
+  for (auto const& pixel_stat : threaded_pixel_stat_) {
+    acc_ps_invocations_(pipeline_stat_, pixel_stat.ps_invocations);
+    acc_hiz_rejects_(pipeline_stat_, pixel_stat.hiz_rejects);
+    acc_backend_input_pixels_(internal_stat_, pixel_stat.backend_input_pixels);
+  }
+  thread_pool_.reset();
 }
 
 void rasterizer::draw_full_quad(uint32_t left,
@@ -1260,9 +2293,9 @@ void rasterizer::draw_full_quad(uint32_t left,
   vso_ops_->step_2d_unproj_pos_quad(pixels,
                                     *triangle_ctx->tri_info->v0,
                                     dx,
-                                    triangle_ctx->tri_info->ddx,
+                                    *triangle_ctx->tri_info->ddx,
                                     dy,
-                                    triangle_ctx->tri_info->ddy);
+                                    *triangle_ctx->tri_info->ddy);
 
   uint64_t quad_mask = quad_full_mask_;
   ps_output pso[4];
@@ -1275,7 +2308,18 @@ void rasterizer::draw_full_quad(uint32_t left,
     quad_mask = frame_buffer_->early_z_test_quad(left, top, depth, triangle_ctx->aa_z_offset);
   }
 
-  if (quad_mask == 0) {
+  if (quad_mask == 0 || depth_only_) {
+    return;
+  }
+
+  if (!has_pixel_shader_) {
+    triangle_ctx->pixel_stat->backend_input_pixels += 4;
+    frame_buffer_->late_depth_stencil_quad(left,
+                                           top,
+                                           quad_mask,
+                                           depth,
+                                           triangle_ctx->tri_info->front_face,
+                                           triangle_ctx->aa_z_offset);
     return;
   }
 
@@ -1284,9 +2328,10 @@ void rasterizer::draw_full_quad(uint32_t left,
   vso_ops_->step_2d_unproj_attr_quad(pixels,
                                      *triangle_ctx->tri_info->v0,
                                      dx,
-                                     triangle_ctx->tri_info->ddx,
+                                     *triangle_ctx->tri_info->ddx,
                                      dy,
-                                     triangle_ctx->tri_info->ddy);
+                                     *triangle_ctx->tri_info->ddy,
+                                     used_attributes_);
 
 #  if 0
 	for(int i = 0; i < 4; ++i)
@@ -1336,8 +2381,8 @@ void rasterizer::draw_quad(uint32_t left,
   EFLIB_ALIGN(16) vs_output pixels[4];
 
   auto v0 = triangle_ctx->tri_info->v0;
-  auto ddx = &triangle_ctx->tri_info->ddx;
-  auto ddy = &triangle_ctx->tri_info->ddy;
+  auto ddx = triangle_ctx->tri_info->ddx;
+  auto ddy = triangle_ctx->tri_info->ddy;
 
   float const quad_dx = 0.5f + left - v0->position().x();
   float const quad_dy = 0.5f + top - v0->position().y();
@@ -1356,12 +2401,24 @@ void rasterizer::draw_quad(uint32_t left,
         frame_buffer_->early_z_test_quad(left, top, quad_mask, depth, triangle_ctx->aa_z_offset);
   }
 
-  if (tested_quad_mask == 0) {
+  if (tested_quad_mask == 0 || depth_only_) {
+    return;
+  }
+
+  if (!has_pixel_shader_) {
+    triangle_ctx->pixel_stat->backend_input_pixels += 4;
+    frame_buffer_->late_depth_stencil_quad(left,
+                                           top,
+                                           tested_quad_mask,
+                                           depth,
+                                           triangle_ctx->tri_info->front_face,
+                                           triangle_ctx->aa_z_offset);
     return;
   }
 
   if (!has_centroid_) {
-    vso_ops_->step_2d_unproj_attr_quad(pixels, *v0, quad_dx, *ddx, quad_dy, *ddy);
+    vso_ops_->step_2d_unproj_attr_quad(
+        pixels, *v0, quad_dx, *ddx, quad_dy, *ddy, used_attributes_);
   } else {
     for (int i_pixel = 0; i_pixel < 4; ++i_pixel) {
       int ix = (i_pixel & 1);
@@ -1393,7 +2450,7 @@ void rasterizer::draw_quad(uint32_t left,
         dx += sp_centroid.x() - 0.5f;
         dy += sp_centroid.y() - 0.5f;
       }
-      vso_ops_->step_2d_unproj_attr(pixels[i_pixel], *v0, dx, *ddx, dy, *ddy);
+      vso_ops_->step_2d_unproj_attr(pixels[i_pixel], *v0, dx, *ddx, dy, *ddy, used_attributes_);
     }
   }
 
@@ -1406,6 +2463,12 @@ void rasterizer::draw_quad(uint32_t left,
     tested_quad_mask &= shaders->cpp_ps->execute(pixels, pso, depth);
   }
 
+  if (triangle_ctx->coverage != nullptr) {
+    for (int i_pixel = 0; i_pixel < 4; ++i_pixel) {
+      pso[i_pixel].color[0].w() *= triangle_ctx->coverage[i_pixel];
+    }
+  }
+
   if (quad_mask != 0) {
     triangle_ctx->pixel_stat->backend_input_pixels += 4;
     frame_buffer_->render_sample_quad(shaders->cpp_bs,
@@ -8,6 +8,7 @@
 #include <salvia/core/render_stages.h>
 #include <salvia/core/shader_unit.h>
 #include <salvia/core/stream_assembler.h>
+#include <salvia/core/thread_pool.h>
 #include <salvia/core/vertex_cache.h>
 #include <salvia/resource/input_layout.h>
 #include <salvia/resource/resource_manager.h>
@@ -18,11 +19,19 @@
 #include <salvia/shader/shader_regs.h>
 #include <salvia/shader/shader_regs_op.h>
 
+#include <eflib/concurrency/thread_context.h>
+
+#include <algorithm>
+#include <thread>
+
 namespace salvia::core {
 
 using namespace eflib;
 using std::shared_ptr;
 
+// Bounds memory of binned draws, which keep their vertexes until flush.
+constexpr size_t MAX_DEFERRED_DRAWS = 1024;
+
 void render_core::update(render_state_ptr const& state) {
   state_ = state;
 }
@@ -31,10 +40,19 @@ result render_core::execute() {
   switch (state_->cmd) {
   case command_id::draw:
   case command_id::draw_index: return draw();
+  default: break;
+  }
+
+  // Other commands access targets or statistics, so deferred draws are finished before them.
+  flush_deferred_draws();
+
+  switch (state_->cmd) {
+  case command_id::flush: return result::ok;
   case command_id::clear_color: return clear_color();
   case command_id::clear_depth_stencil: return clear_depth_stencil();
   case command_id::async_begin: return async_start();
   case command_id::async_end: return async_stop();
+  default: break;
   }
 
   ++batch_id_;
@@ -46,24 +64,155 @@ result render_core::draw() {
     return result::ok;
   }
 
-  stages_.assembler->update(state_.get());
-  stages_.ras->update(state_.get());
-  stages_.vert_cache->update(state_.get());
-  if (stages_.host) {
-    stages_.host->update(state_.get());
+  if (state_->deferred) {
+    return defer_draw();
   }
-  stages_.backend->update(state_.get());
-  apply_shader_cbuffer();
 
+  flush_deferred_draws();
+  update_stages(stages_, state_.get());
   stages_.ras->draw();
 
   return result::ok;
 }
 
-render_core::render_core() {
+void render_core::update_stages(render_stages const& stages, render_state* state) {
+  stages.assembler->update(state);
+  stages.ras->update(state);
+  stages.vert_cache->update(state);
+  if (stages.host) {
+    stages.host->update(state);
+  }
+  stages.backend->update(state);
+  apply_shader_cbuffer();
+}
+
+std::unique_ptr<render_core::deferred_draw> render_core::create_deferred_draw() {
+  if (!free_deferred_draws_.empty()) {
+    auto ret = std::move(free_deferred_draws_.back());
+    free_deferred_draws_.pop_back();
+    return ret;
+  }
+
+  auto ret = std::make_unique<deferred_draw>();
+  ret->state.reset(new render_state());
+  ret->stages.host = stages_.host;
+  ret->stages.vert_cache = create_default_vertex_cache(vertex_cache_type_);
+  ret->stages.assembler.reset(new stream_assembler());
+  ret->stages.ras.reset(new rasterizer());
+  ret->stages.backend.reset(new framebuffer());
+
+  // Targets are written by all deferred draws, Hi-Z of one draw is never up to date.
+  ret->stages.backend->disable_hiz();
+
+  ret->stages.vert_cache->initialize(&ret->stages);
+  ret->stages.ras->initialize(&ret->stages);
+  ret->stages.backend->initialize(&ret->stages);
+  return ret;
+}
+
+result render_core::defer_draw() {
+  // Draws of a batch are rasterized on the tiles of the same targets.
+  if (!deferred_draws_.empty()) {
+    render_state const* batch_state = deferred_draws_.front()->state.get();
+    if (batch_state->color_targets != state_->color_targets ||
+        batch_state->depth_stencil_target != state_->depth_stencil_target ||
+        deferred_draws_.size() >= MAX_DEFERRED_DRAWS) {
+      flush_deferred_draws();
+    }
+  }
+
+  auto draw = create_deferred_draw();
+  copy_using_state(draw->state.get(), state_.get());
+  update_stages(draw->stages, draw->state.get());
+  draw->stages.ras->bin_deferred();
+
+  deferred_draws_.push_back(std::move(draw));
+  return result::ok;
+}
+
+void render_core::flush_deferred_draws() {
+  if (deferred_draws_.empty()) {
+    return;
+  }
+
+  size_t tile_x_count = 0;
+  size_t tile_y_count = 0;
+  for (auto const& draw : deferred_draws_) {
+    tile_x_count = std::max(tile_x_count, draw->stages.ras->tile_x_count());
+    tile_y_count = std::max(tile_y_count, draw->stages.ras->tile_y_count());
+  }
+
+  // Per-thread state of a draw is sized by threads it is binned with, which are changed if
+  // pipeline threads are reconfigured between draws. Tiles are rasterized by the fewest of them.
+  pipeline_threads threads = deferred_draws_.front()->stages.ras->binned_threads();
+  for (auto const& draw : deferred_draws_) {
+    pipeline_threads draw_threads = draw->stages.ras->binned_threads();
+    if (draw_threads.count < threads.count) {
+      threads = std::move(draw_threads);
+    }
+  }
+
+  // Expensive tiles are rasterized first, idle threads steal tiles from others.
+  size_t const tile_count = tile_x_count * tile_y_count;
+  size_t const thread_count = threads.count;
+  deferred_tile_costs_.assign(tile_count, 0);
+  for (size_t tile_id = 0; tile_id < tile_count; ++tile_id) {
+    for (auto const& draw : deferred_draws_) {
+      deferred_tile_costs_[tile_id] +=
+          draw->stages.ras->tile_cost(tile_id % tile_x_count, tile_id / tile_x_count);
+    }
+  }
+  deferred_tile_scheduler_.reset(deferred_tile_costs_.data(), tile_count, thread_count);
+  if (deferred_fb_tiles_.size() < thread_count) {
+    deferred_fb_tiles_.resize(thread_count);
+  }
+
+  // Each tile is rasterized by one thread for all draws in submission order. Draws share targets,
+  // so a resident tile is loaded and written back once for all of them.
+  execute_threads(
+      *threads.pool,
+      [this, tile_x_count](thread_context const* thread_ctx) {
+        deferred_draw const& first_draw = *deferred_draws_.front();
+        size_t const tile_size = static_cast<size_t>(first_draw.stages.ras->tile_size());
+        framebuffer_tile* fb_tile = &deferred_fb_tiles_[thread_ctx->thread_id];
+
+        size_t tile_id;
+        while (deferred_tile_scheduler_.pop(thread_ctx->thread_id, tile_id)) {
+          size_t const tile_y = tile_id / tile_x_count;
+          size_t const tile_x = tile_id - tile_y * tile_x_count;
+          bool const resident = first_draw.stages.ras->tile_resident(deferred_tile_costs_[tile_id]);
+          if (resident) {
+            first_draw.stages.backend->begin_tile(
+                fb_tile, tile_x * tile_size, tile_y * tile_size, tile_size);
+          }
+          for (auto const& draw : deferred_draws_) {
+            draw->stages.ras->rasterize_deferred_tile(tile_x, tile_y, thread_ctx->thread_id);
+          }
+          if (resident) {
+            framebuffer::end_tile(fb_tile);
+          }
+        }
+      },
+      tile_count,
+      1,
+      thread_count);
+
+  for (auto& draw : deferred_draws_) {
+    draw->stages.ras->finish_deferred();
+    // Release resources referenced by the draw.
+    *draw->state = render_state();
+    free_deferred_draws_.push_back(std::move(draw));
+  }
+  deferred_draws_.clear();
+
+  stages_.backend->invalidate_hiz();
+}
+
+render_core::render_core(vertex_cache_types vertex_cache_type)
+  : vertex_cache_type_(vertex_cache_type) {
   // Create stages
   stages_.host = modules::host::create_host();
-  stages_.vert_cache = create_default_vertex_cache();
+  stages_.vert_cache = create_default_vertex_cache(vertex_cache_type_);
   stages_.assembler.reset(new stream_assembler());
   stages_.ras.reset(new rasterizer());
   stages_.backend.reset(new framebuffer());
@@ -93,19 +242,18 @@ void render_core::apply_shader_cbuffer() {
   }
 }
 
+// Clears are recorded per tile by surfaces, and tiles are filled when they are accessed.
 result render_core::clear_color() {
-  state_->clear_color_target->fill(state_->clear_color);
+  state_->clear_color_target->clear(state_->clear_color);
   return result::ok;
 }
 
 result render_core::clear_depth_stencil() {
-  if (state_->clear_f == (clear_depth | clear_stencil)) {
-    auto ds_color = color_rgba32f(
-        state_->clear_z, *reinterpret_cast<float*>(&state_->clear_stencil), 0.0f, 0.0f);
-    state_->clear_ds_target->fill(ds_color);
-  } else {
-    framebuffer::clear_depth_stencil(
-        state_->clear_ds_target.get(), state_->clear_f, state_->clear_z, state_->clear_stencil);
+  framebuffer::clear_depth_stencil(
+      state_->clear_ds_target.get(), state_->clear_f, state_->clear_z, state_->clear_stencil);
+
+  if (state_->clear_f & clear_depth) {
+    stages_.backend->hiz_depth_cleared(state_->clear_ds_target.get(), state_->clear_z);
   }
   return result::ok;
 }
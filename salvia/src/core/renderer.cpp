@@ -26,16 +26,16 @@ using std::vector;
 namespace salvia::core {
 
 #define USE_ASYNC_RENDERER
-renderer_ptr create_software_renderer() {
+renderer_ptr create_software_renderer(renderer_parameters const* params) {
 #if defined(USE_ASYNC_RENDERER)
-  return create_async_renderer();
+  return create_async_renderer(params);
 #else
-  return create_sync_renderer();
+  return create_sync_renderer(params);
 #endif
 }
 
-renderer_ptr create_benchmark_renderer() {
-  return create_sync_renderer();
+renderer_ptr create_benchmark_renderer(renderer_parameters const* params) {
+  return create_sync_renderer(params);
 }
 
 shader_object_ptr
@@ -69,6 +69,8 @@ format renderer_impl::get_index_format() const {
 //
 result renderer_impl::set_primitive_topology(primitive_topology topology) {
   switch (topology) {
+  case primitive_point_list:
+  case primitive_point_sprite:
   case primitive_line_list:
   case primitive_line_strip:
   case primitive_triangle_list:
@@ -142,6 +144,15 @@ cpp_blend_shader_ptr renderer_impl::get_blend_shader() const {
   return state_->cpp_bs;
 }
 
+result renderer_impl::set_blend_state(blend_state_ptr const& bs) {
+  state_->bl_state = bs;
+  return result::ok;
+}
+
+blend_state_ptr renderer_impl::get_blend_state() const {
+  return state_->bl_state;
+}
+
 result renderer_impl::set_viewport(const viewport& vp) {
   if (vp.x < 0 || vp.y < 0 || vp.w >= MAX_RENDER_TARGET_WIDTH || vp.h >= MAX_RENDER_TARGET_HEIGHT) {
     EF_ASSERT(false, "Viewport size is invalid.");
@@ -155,6 +166,28 @@ viewport renderer_impl::get_viewport() const {
   return state_->vp;
 }
 
+result renderer_impl::set_scissor_rects(size_t rect_count, eflib::rect<int32_t> const* rects) {
+  if (rect_count == 0) {
+    state_->scissor_rect = eflib::rect<int32_t>();
+    return result::ok;
+  }
+  if (rects[0].w < 0 || rects[0].h < 0) {
+    EF_ASSERT(false, "Scissor rectangle is invalid.");
+    return result::failed;
+  }
+  state_->scissor_rect = rects[0];
+  return result::ok;
+}
+
+eflib::rect<int32_t> renderer_impl::get_scissor_rect() const {
+  return state_->scissor_rect;
+}
+
+result renderer_impl::set_deferred_rendering(bool enabled) {
+  state_->deferred = enabled;
+  return result::ok;
+}
+
 // do not support get function for a while
 result renderer_impl::set_render_targets(size_t color_target_count,
                                          surface_ptr const* color_targets,
@@ -207,7 +240,11 @@ result renderer_impl::set_render_targets(size_t color_target_count,
 
   if (ds_target) {
     switch (ds_target->get_pixel_format()) {
-    case pixel_format_color_rg32f: break;
+    case pixel_format_color_rg32f:
+    case pixel_format_color_d16:
+    case pixel_format_color_d24s8:
+    case pixel_format_color_d32f:
+    case pixel_format_color_d32f_s8x24: break;
     default: return result::failed;
     }
 
@@ -266,7 +303,8 @@ async_object_ptr renderer_impl::create_query(async_object_ids id) {
   }
 }
 
-renderer_impl::renderer_impl() {
+renderer_impl::renderer_impl(renderer_parameters const* params)
+  : core_(params ? params->vertex_cache : vertex_cache_post_transform) {
   resource_pool_.reset(new resource_manager([this]() { this->flush(); }));
   state_.reset(new render_state());
 
@@ -275,6 +313,7 @@ renderer_impl::renderer_impl() {
 
   state_->ras_state.reset(new raster_state(raster_desc()));
   state_->ds_state.reset(new depth_stencil_state(depth_stencil_desc()));
+  state_->bl_state.reset(new blend_state(blend_desc()));
 
   state_->vp.minz = 0.0f;
   state_->vp.maxz = 1.0f;
@@ -335,19 +374,38 @@ result renderer_impl::set_vs_sampler(std::string const& name, sampler_ptr const&
 }
 
 result renderer_impl::draw(size_t startpos, size_t primcnt) {
+  return draw_instanced(startpos, primcnt, 1, 0);
+}
+
+result renderer_impl::draw_index(size_t startpos, size_t primcnt, int basevert) {
+  return draw_index_instanced(startpos, primcnt, basevert, 1, 0);
+}
+
+result renderer_impl::draw_instanced(size_t startpos,
+                                     size_t primcnt,
+                                     size_t instance_count,
+                                     size_t start_instance) {
   state_->cmd = command_id::draw;
   state_->start_index = static_cast<uint32_t>(startpos);
   state_->prim_count = static_cast<uint32_t>(primcnt);
   state_->base_vertex = 0;
+  state_->instance_count = static_cast<uint32_t>(instance_count);
+  state_->start_instance = static_cast<uint32_t>(start_instance);
 
   return commit_state_and_command();
 }
 
-result renderer_impl::draw_index(size_t startpos, size_t primcnt, int basevert) {
+result renderer_impl::draw_index_instanced(size_t startpos,
+                                           size_t primcnt,
+                                           int basevert,
+                                           size_t instance_count,
+                                           size_t start_instance) {
   state_->cmd = command_id::draw_index;
   state_->start_index = static_cast<uint32_t>(startpos);
   state_->prim_count = static_cast<uint32_t>(primcnt);
   state_->base_vertex = basevert;
+  state_->instance_count = static_cast<uint32_t>(instance_count);
+  state_->start_instance = static_cast<uint32_t>(start_instance);
 
   return commit_state_and_command();
 }
@@ -6,6 +6,8 @@
 
 #include "eflib/platform/intrin.h"
 
+#include <atomic>
+
 namespace salvia::core {
 
 using namespace boost;
@@ -211,7 +213,8 @@ vs_output& step_2d_unproj_attr_n(vs_output& out,
                                  float step0,
                                  const vs_output& derivation0,
                                  float step1,
-                                 const vs_output& derivation1) {
+                                 const vs_output& derivation1,
+                                 uint32_t used_attributes) {
 #if defined(VSO_INTERP_SSE_ENABLED)
   __m128 const* d0_m128 = reinterpret_cast<__m128 const*>(derivation0.raw_data());
   __m128 const* d1_m128 = reinterpret_cast<__m128 const*>(derivation1.raw_data());
@@ -224,6 +227,9 @@ vs_output& step_2d_unproj_attr_n(vs_output& out,
   __m128 inv_w4 = _mm_load_ps1(&inv_w);
 
   for (size_t i_attr = 0; i_attr < N; ++i_attr) {
+    if (!(used_attributes & (1U << i_attr))) {
+      continue;
+    }
     __m128 interp_attr;
     if (vs_output_ops[N].attribute_modifiers[i_attr] & vs_output::am_nointerpolation) {
       interp_attr = in_m128[i_attr + 1];
@@ -242,6 +248,9 @@ vs_output& step_2d_unproj_attr_n(vs_output& out,
   }
 #else
   for (size_t i_attr = 0; i_attr < N; ++i_attr) {
+    if (!(used_attributes & (1U << i_attr))) {
+      continue;
+    }
     if (vs_output_ops[N].attribute_modifiers[i_attr] & vs_output::am_nointerpolation) {
       out.attribute(i_attr) = in.attribute(i_attr);
     } else {
@@ -292,7 +301,8 @@ vs_output& step_2d_unproj_attr_n_quad(vs_output* out,
                                       float step0,
                                       const vs_output& derivation0,
                                       float step1,
-                                      const vs_output& derivation1) {
+                                      const vs_output& derivation1,
+                                      uint32_t used_attributes) {
 #if defined(VSO_INTERP_SSE_ENABLED)
   __m128 const* d0_m128 = reinterpret_cast<__m128 const*>(derivation0.raw_data());
   __m128 const* d1_m128 = reinterpret_cast<__m128 const*>(derivation1.raw_data());
@@ -316,6 +326,9 @@ vs_output& step_2d_unproj_attr_n_quad(vs_output* out,
   __m128 inv_w4 = _mm_set_ps(1.0f / w[0], 1.0f / w[1], 1.0f / w[2], 1.0f / w[3]);
 
   for (size_t i_attr = 0; i_attr < N; ++i_attr) {
+    if (!(used_attributes & (1U << i_attr))) {
+      continue;
+    }
     __m128 interp_attr00;
     __m128 interp_attr01;
     __m128 interp_attr10;
@@ -354,6 +367,9 @@ vs_output& step_2d_unproj_attr_n_quad(vs_output* out,
   }
 #else
   for (size_t i_attr = 0; i_attr < N; ++i_attr) {
+    if (!(used_attributes & (1U << i_attr))) {
+      continue;
+    }
     if (vs_output_ops[N].attribute_modifiers[i_attr] & vs_output::am_nointerpolation) {
       out.attribute(i_attr) = in.attribute(i_attr);
     } else {
@@ -411,11 +427,18 @@ vs_output& div_n(vs_output& out, const vs_output& vso0, float f) {
 }
 
 template <int N>
-void compute_derivative_n(
-    vs_output& ddx, vs_output& ddy, vs_output const& e01, vs_output const& e02, float inv_area) {
+void compute_derivative_n(vs_output& ddx,
+                          vs_output& ddy,
+                          vs_output const& e01,
+                          vs_output const& e02,
+                          float inv_area,
+                          uint32_t used_attributes) {
   // ddx = (e02 * e01.position.y - e02.position.y * e01) * inv_area;
   // ddy = (e01 * e02.position.x - e01.position.x * e02) * inv_area;
 
+  // Register 0 is position, which is always used.
+  uint32_t const used_registers = (used_attributes << 1) | 1U;
+
 #if !defined(EFLIB_NO_SIMD)
   __m128* mddx = reinterpret_cast<__m128*>(ddx.raw_data());
   __m128* mddy = reinterpret_cast<__m128*>(ddy.raw_data());
@@ -431,6 +454,9 @@ void compute_derivative_n(
   __m128 minv_area = _mm_set_ps1(inv_area);
 
   for (int i = 0; i < N + 1; ++i) {
+    if (!(used_registers & (1U << i))) {
+      continue;
+    }
     __m128 x_diff = _mm_sub_ps(_mm_mul_ps(me02[i], me01y), _mm_mul_ps(me01[i], me02y));
 
     __m128 y_diff = _mm_sub_ps(_mm_mul_ps(me01[i], me02x), _mm_mul_ps(me02[i], me01x));
@@ -440,6 +466,9 @@ void compute_derivative_n(
   }
 #else
   for (int i = 0; i < N + 1; ++i) {
+    if (!(used_registers & (1U << i))) {
+      continue;
+    }
     ddx.raw_data()[i] = inv_area *
         (e02.raw_data()[i] * e01.position().y() - e01.raw_data()[i] * e02.position().y());
     ddy.raw_data()[i] = inv_area *
@@ -521,10 +550,29 @@ void cpp_vertex_shader::execute(const vs_input& in, vs_output& out) {
   shader_prog(in, out);
 }
 
+void cpp_vertex_shader::execute_batch(vs_input const* ins,
+                                      vs_output* const* outs,
+                                      size_t count) {
+  shader_prog_batch(ins, outs, count);
+}
+
+void cpp_vertex_shader::shader_prog_batch(vs_input const* ins,
+                                          vs_output* const* outs,
+                                          size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    shader_prog(ins[i], *outs[i]);
+  }
+}
+
 void cpp_blend_shader::execute(size_t sample, pixel_accessor& out, const ps_output& in) {
   shader_prog(sample, out, in);
 }
 
+uint64_t cpp_shader_impl::new_version() {
+  static std::atomic<uint64_t> next_version{1};
+  return next_version.fetch_add(1, std::memory_order_relaxed);
+}
+
 result cpp_shader_impl::find_register(semantic_value const& sv, size_t& index) {
   register_map::const_iterator it = regmap_.find(sv);
   if (it != regmap_.end()) {
@@ -10,6 +10,7 @@
 #include <eflib/diagnostics/assert.h>
 #include <eflib/math/math.h>
 
+#include <atomic>
 #include <memory>
 
 using namespace eflib;
@@ -25,8 +26,16 @@ void invoke(void* callee, void* psi, void* pbi, void* pso, void* pbo) {
 
 namespace salvia::core {
 
+namespace {
+uint64_t new_version() {
+  static std::atomic<uint64_t> next_version{1};
+  return next_version.fetch_add(1, std::memory_order_relaxed);
+}
+}  // namespace
+
 void pixel_shader_unit::initialize(shader::shader_object const* code) {
   this->code = code;
+  layout_version_ = version_ = new_version();
   size_t pixel_input_data_size = code->get_reflection()->total_size(su_stream_in);
   size_t pixel_output_data_size = code->get_reflection()->total_size(su_stream_out);
 
@@ -47,7 +56,10 @@ void pixel_shader_unit::initialize(shader::shader_object const* code) {
 pixel_shader_unit::~pixel_shader_unit() {
 }
 
-pixel_shader_unit::pixel_shader_unit() : code(nullptr) {
+pixel_shader_unit::pixel_shader_unit()
+  : code(nullptr)
+  , layout_version_(new_version())
+  , version_(layout_version_) {
 }
 
 void pixel_shader_unit::reset_pointers() {
@@ -74,7 +86,9 @@ pixel_shader_unit::pixel_shader_unit(pixel_shader_unit const& rhs)
   , stream_data(rhs.stream_data)
   , buffer_data(rhs.buffer_data)
   , stream_odata(rhs.stream_odata)
-  , buffer_odata(rhs.buffer_odata) {
+  , buffer_odata(rhs.buffer_odata)
+  , layout_version_(rhs.layout_version_)
+  , version_(rhs.version_) {
   reset_pointers();
 }
 
@@ -88,6 +102,8 @@ pixel_shader_unit& pixel_shader_unit::operator=(pixel_shader_unit const& rhs) {
   buffer_data = rhs.buffer_data;
   stream_odata = rhs.stream_odata;
   buffer_odata = rhs.buffer_odata;
+  layout_version_ = rhs.layout_version_;
+  version_ = rhs.version_;
 
   reset_pointers();
 
@@ -96,13 +112,44 @@ pixel_shader_unit& pixel_shader_unit::operator=(pixel_shader_unit const& rhs) {
 
 void pixel_shader_unit::set_variable(std::string const& name, void const* data) {
   sv_layout* vsi = code->get_reflection()->input_sv_layout(name);
-  memcpy(&buffer_data[vsi->offset], data, vsi->size);
+  if (memcmp(&buffer_data[vsi->offset], data, vsi->size) != 0) {
+    memcpy(&buffer_data[vsi->offset], data, vsi->size);
+    version_ = new_version();
+  }
+}
+
+bool pixel_shader_unit::update_constants(pixel_shader_unit const& rhs) {
+  if (layout_version_ != rhs.layout_version_) {
+    return false;
+  }
+  if (version_ != rhs.version_) {
+    buffer_data = rhs.buffer_data;
+    version_ = rhs.version_;
+  }
+  return true;
 }
 
 shared_ptr<pixel_shader_unit> pixel_shader_unit::clone() const {
   return make_shared<pixel_shader_unit>(*this);
 }
 
+uint32_t pixel_shader_unit::input_attribute_mask(shader_reflection const* vs_abi) const {
+  uint32_t mask = 0;
+  size_t register_index = 0;
+  for (sv_layout* info : code->get_reflection()->layouts(su_stream_in)) {
+    if (semantic_value(sv_position) == info->sv) {
+      continue;
+    }
+    size_t const attr_index = vs_abi
+        ? static_cast<size_t>(vs_abi->input_sv_layout(info->sv)->logical_index)
+        : register_index++;
+    if (attr_index < MAX_VS_OUTPUT_ATTRS) {
+      mask |= 1U << attr_index;
+    }
+  }
+  return mask;
+}
+
 void pixel_shader_unit::update(vs_output* inputs, shader_reflection const* vs_abi) {
   vector<sv_layout*> infos = code->get_reflection()->layouts(su_stream_in);
 
@@ -9,6 +9,8 @@
 #include <salvia/core/shader.h>
 #include <salvia/core/stream_state.h>
 
+#include <bit>
+
 using namespace eflib;
 using namespace salvia::shader;
 using namespace salvia::resource;
@@ -47,6 +49,7 @@ vec4 get_vec4(format fmt, float default_wcomp, const void* data) {
 void stream_assembler::update(render_state const* state) {
   layout_ = state->layout.get();
   stream_buffer_descs_ = state->str_state.buffer_descs.data();
+  start_instance_ = state->start_instance;
 
   if (state->cpp_vs) {
     update_register_map(state->cpp_vs->get_register_map());
@@ -58,24 +61,62 @@ void stream_assembler::update_register_map(
     std::unordered_map<semantic_value, size_t> const& reg_map) {
   reg_ied_extra_.clear();
   reg_ied_extra_.reserve(reg_map.size());
+  instance_reg_ied_extra_.clear();
+  instance_id_reg_ = NO_REGISTER;
 
   for (auto const& sv_reg_pair : reg_map) {
+    if (sv_reg_pair.first == sv_instance_id) {
+      instance_id_reg_ = sv_reg_pair.second;
+      continue;
+    }
+
     input_element_desc const* elem_desc = layout_->find_desc(sv_reg_pair.first);
 
     if (elem_desc == nullptr) {
       reg_ied_extra_.clear();
+      instance_reg_ied_extra_.clear();
       return;
     }
 
-    reg_ied_extra_.push_back(reg_ied_extra_t{
+    auto& reg_ied_extras =
+        elem_desc->slot_class == input_per_instance ? instance_reg_ied_extra_ : reg_ied_extra_;
+    reg_ied_extras.push_back(reg_ied_extra_t{
         sv_reg_pair.second,
         elem_desc,
         semantic_value(elem_desc->semantic_name, elem_desc->semantic_index).default_w()});
   }
 }
 
+bool stream_assembler::instance_invariant() const {
+  return instance_reg_ied_extra_.empty() && instance_id_reg_ == NO_REGISTER;
+}
+
+// SV_InstanceID keeps bits of the unsigned integer in x, as integer formats do.
+void stream_assembler::fetch_instance(vs_input* vertices,
+                                      size_t count,
+                                      uint32_t instance_id) const {
+  for (auto const& reg_ied_extra : instance_reg_ied_extra_) {
+    auto desc = reg_ied_extra.desc;
+    uint32_t const step_rate = desc->instance_data_step_rate;
+    size_t const elem_index = start_instance_ + (step_rate == 0 ? 0 : instance_id / step_rate);
+
+    void const* pdata = element_address(*desc, elem_index);
+    vec4 const attr = get_vec4(desc->data_format, reg_ied_extra.default_wcomp, pdata);
+    for (size_t i = 0; i < count; ++i) {
+      vertices[i].attribute(reg_ied_extra.reg_id) = attr;
+    }
+  }
+
+  if (instance_id_reg_ != NO_REGISTER) {
+    vec4 const attr(std::bit_cast<float>(instance_id), 0.0f, 0.0f, 0.0f);
+    for (size_t i = 0; i < count; ++i) {
+      vertices[i].attribute(instance_id_reg_) = attr;
+    }
+  }
+}
+
 /// Only used by Cpp Vertex Shader
-void stream_assembler::fetch_vertex(vs_input& rv, size_t vert_index) const {
+void stream_assembler::fetch_vertex(vs_input& rv, size_t vert_index, uint32_t instance_id) const {
   for (auto const& reg_ied_extra : reg_ied_extra_) {
     auto reg_index = reg_ied_extra.reg_id;
     auto desc = reg_ied_extra.desc;
@@ -83,6 +124,26 @@ void stream_assembler::fetch_vertex(vs_input& rv, size_t vert_index) const {
     void const* pdata = element_address(*desc, vert_index);
     rv.attribute(reg_index) = get_vec4(desc->data_format, reg_ied_extra.default_wcomp, pdata);
   }
+  fetch_instance(&rv, 1, instance_id);
+}
+
+// Elements are fetched for all vertexes at once, so element descriptions and buffer addresses are
+// looked up once per element.
+void stream_assembler::fetch_vertices(vs_input* vertices,
+                                      uint32_t const* vert_indices,
+                                      size_t count,
+                                      uint32_t instance_id) const {
+  for (auto const& reg_ied_extra : reg_ied_extra_) {
+    auto const& desc = *reg_ied_extra.desc;
+    auto const& buf_desc = stream_buffer_descs_[desc.input_slot];
+    uint8_t const* elements = buf_desc.buf->raw_data(desc.aligned_byte_offset + buf_desc.offset);
+    for (size_t i = 0; i < count; ++i) {
+      void const* pdata = elements + buf_desc.stride * vert_indices[i];
+      vertices[i].attribute(reg_ied_extra.reg_id) =
+          get_vec4(desc.data_format, reg_ied_extra.default_wcomp, pdata);
+    }
+  }
+  fetch_instance(vertices, count, instance_id);
 }
 
 void const* stream_assembler::element_address(input_element_desc const& elem_desc,
@@ -8,6 +8,7 @@
 #include <salvia/core/render_state.h>
 #include <salvia/core/shader_unit.h>
 #include <salvia/core/stream_assembler.h>
+#include <salvia/core/thread_pool.h>
 #include <salvia/core/vertex_cache.h>
 #include <salvia/resource/input_layout.h>
 #include <salvia/resource/resource_manager.h>
@@ -24,19 +25,25 @@ using namespace eflib;
 using std::shared_ptr;
 
 result sync_renderer::commit_state_and_command() {
+  // Pipeline runs on the thread of the application, which takes the CPU reserved for it.
+  pin_pipeline_calling_thread();
   core_.update(state_);
   return core_.execute();
 }
 
 result sync_renderer::flush() {
-  return result::ok;
+  state_->cmd = command_id::flush;
+  return commit_state_and_command();
 }
 
-sync_renderer::sync_renderer() {
+sync_renderer::sync_renderer(renderer_parameters const* params) : renderer_impl(params) {
 }
 
-renderer_ptr create_sync_renderer() {
-  return renderer_ptr(new sync_renderer());
+renderer_ptr create_sync_renderer(renderer_parameters const* params) {
+  if (params) {
+    configure_pipeline_threads(*params);
+  }
+  return renderer_ptr(new sync_renderer(params));
 }
 
 }  // namespace salvia::core
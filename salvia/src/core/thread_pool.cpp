@@ -1,13 +1,97 @@
+#include <salvia/core/renderer.h>
+#include <salvia/core/thread_pool.h>
+
+#include <eflib/platform/affinity.h>
 #include <eflib/platform/config.h>
 #include <eflib/platform/cpuinfo.h>
 
 #include <eflib/concurrency/thread_pool/threadpool.h>
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace salvia::core {
 
-eflib::thread_pool& global_thread_pool() {
-  static eflib::thread_pool tp(std::thread::hardware_concurrency() - 1);
-  return tp;
+namespace {
+struct pipeline_thread_config {
+  std::mutex mutex;
+  size_t thread_count;
+  std::vector<uint32_t> cpus;
+  int32_t numa_node = -1;
+  std::shared_ptr<eflib::thread_pool> pool;
+  // Changed with CPUs and NUMA node, calling threads are pinned again if it is changed.
+  uint64_t version = 0;
+};
+
+pipeline_thread_config& threads() {
+  static pipeline_thread_config pt;
+  static std::once_flag initialized;
+  std::call_once(initialized, [] {
+    pt.thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+    pt.pool = std::make_shared<eflib::thread_pool>(static_cast<uint32_t>(pt.thread_count - 1));
+  });
+  return pt;
+}
+}  // namespace
+
+pipeline_threads current_pipeline_threads() {
+  auto& pt = threads();
+  std::lock_guard<std::mutex> lock(pt.mutex);
+  return pipeline_threads{pt.pool, pt.thread_count};
+}
+
+void configure_pipeline_threads(renderer_parameters const& params) {
+  std::vector<uint32_t> cpus = params.thread_cpus;
+  if (cpus.empty() && params.numa_node >= 0) {
+    cpus = eflib::numa_node_cpus(static_cast<uint32_t>(params.numa_node));
+  }
+
+  size_t thread_count = params.thread_count;
+  if (thread_count == 0) {
+    thread_count = cpus.empty() ? std::thread::hardware_concurrency() : cpus.size();
+  }
+  thread_count = std::max<size_t>(thread_count, 1);
+
+  auto& pt = threads();
+  std::lock_guard<std::mutex> lock(pt.mutex);
+  if (pt.thread_count == thread_count && pt.cpus == cpus && pt.numa_node == params.numa_node) {
+    return;
+  }
+
+  // The first CPU is reserved for the thread calling the pipeline.
+  std::vector<uint32_t> worker_cpus;
+  if (!cpus.empty()) {
+    worker_cpus.assign(cpus.begin() + 1, cpus.end());
+    worker_cpus.push_back(cpus.front());
+  }
+
+  // Memory policy is set by workers, so threads of the application keep their own.
+  pt.pool = std::make_shared<eflib::thread_pool>(
+      static_cast<uint32_t>(thread_count - 1), worker_cpus, params.numa_node);
+  pt.thread_count = thread_count;
+  pt.cpus = std::move(cpus);
+  pt.numa_node = params.numa_node;
+  ++pt.version;
+}
+
+void pin_pipeline_calling_thread() {
+  thread_local uint64_t pinned_version = 0;
+
+  auto& pt = threads();
+  std::lock_guard<std::mutex> lock(pt.mutex);
+  if (pinned_version == pt.version) {
+    return;
+  }
+  pinned_version = pt.version;
+  if (!pt.cpus.empty()) {
+    eflib::pin_current_thread(pt.cpus.front());
+  }
+  if (pt.numa_node >= 0) {
+    eflib::prefer_numa_node(static_cast<uint32_t>(pt.numa_node));
+  }
 }
 
 }  // namespace salvia::core
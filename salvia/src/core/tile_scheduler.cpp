@@ -0,0 +1,87 @@
+#include <salvia/core/tile_scheduler.h>
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+namespace salvia::core {
+
+void tile_scheduler::reset(uint64_t const* tile_costs, size_t tile_count, size_t thread_count) {
+  thread_count_ = thread_count;
+  steal_count_.store(0, std::memory_order_relaxed);
+  if (queue_capacity_ < thread_count) {
+    queues_.reset(new std::atomic<uint64_t>[thread_count]);
+    queue_capacity_ = thread_count;
+  }
+
+  sorted_tiles_.resize(tile_count);
+  std::iota(sorted_tiles_.begin(), sorted_tiles_.end(), 0U);
+  std::stable_sort(sorted_tiles_.begin(), sorted_tiles_.end(), [tile_costs](uint32_t l, uint32_t r) {
+    return tile_costs[l] > tile_costs[r];
+  });
+
+  // Min-heap of (load, thread). Every tile costs one at least, so cheap tiles are spread as well.
+  thread_loads_.clear();
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    thread_loads_.emplace_back(0, i);
+  }
+  std::vector<uint32_t> queue_sizes(thread_count + 1, 0);
+  tile_threads_.resize(tile_count);
+  for (size_t i = 0; i < tile_count; ++i) {
+    std::pop_heap(thread_loads_.begin(), thread_loads_.end(), std::greater<>());
+    auto& least_loaded = thread_loads_.back();
+    least_loaded.first += tile_costs[sorted_tiles_[i]] + 1;
+    tile_threads_[i] = least_loaded.second;
+    ++queue_sizes[least_loaded.second + 1];
+    std::push_heap(thread_loads_.begin(), thread_loads_.end(), std::greater<>());
+  }
+
+  // Queues keep the descending order of costs.
+  std::partial_sum(queue_sizes.begin(), queue_sizes.end(), queue_sizes.begin());
+  for (size_t i = 0; i < thread_count; ++i) {
+    queues_[i].store(pack_range(queue_sizes[i], queue_sizes[i + 1]), std::memory_order_relaxed);
+  }
+  tiles_.resize(tile_count);
+  for (size_t i = 0; i < tile_count; ++i) {
+    tiles_[queue_sizes[tile_threads_[i]]++] = sorted_tiles_[i];
+  }
+}
+
+bool tile_scheduler::pop(size_t thread_id, size_t& tile_id) {
+  std::atomic<uint64_t>& own_queue = queues_[thread_id];
+  uint64_t range = own_queue.load(std::memory_order_relaxed);
+  while (range_begin(range) < range_end(range)) {
+    uint32_t const begin = range_begin(range);
+    if (own_queue.compare_exchange_weak(range, pack_range(begin + 1, range_end(range)))) {
+      tile_id = tiles_[begin];
+      return true;
+    }
+  }
+
+  for (;;) {
+    size_t victim = thread_count_;
+    uint32_t victim_size = 0;
+    for (size_t i = 0; i < thread_count_; ++i) {
+      uint64_t const r = queues_[i].load(std::memory_order_relaxed);
+      if (range_end(r) - range_begin(r) > victim_size) {
+        victim = i;
+        victim_size = range_end(r) - range_begin(r);
+      }
+    }
+    if (victim == thread_count_) {
+      return false;
+    }
+
+    range = queues_[victim].load(std::memory_order_relaxed);
+    while (range_begin(range) < range_end(range)) {
+      uint32_t const end = range_end(range);
+      if (queues_[victim].compare_exchange_weak(range, pack_range(range_begin(range), end - 1))) {
+        tile_id = tiles_[end - 1];
+        steal_count_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+}
+
+}  // namespace salvia::core
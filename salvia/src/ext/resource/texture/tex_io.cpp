@@ -39,6 +39,9 @@ bool copy_image_to_surface_impl(
   pixel_format inter_format = salvia_rgba_color_type<FIColorT>::fmt;
   BYTE* source_line = FreeImage_GetBits(image);
 
+  // Texels are written by address, so pending clears must be filled before they are overwritten.
+  surf->expand_clears();
+
   for (size_t y = 0; y < surf->height(); ++y) {
     uint8_t* src_pixel = source_line;
     for (size_t x = 0; x < surf->width(); ++x) {
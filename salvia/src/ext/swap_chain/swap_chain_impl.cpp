@@ -60,11 +60,11 @@ void salviax_create_swap_chain_and_renderer(salvia::ext::swap_chain_ptr& out_swa
   out_swap_chain.reset();
 
   if (renderer_type == salvia::ext::renderer_sync) {
-    out_renderer = create_sync_renderer();
+    out_renderer = create_sync_renderer(render_params);
   }
 
   if (renderer_type == salvia::ext::renderer_async) {
-    out_renderer = create_async_renderer();
+    out_renderer = create_async_renderer(render_params);
   }
 
   if (!out_renderer) {
@@ -1,12 +1,20 @@
 #include <salvia/resource/internal_mapped_resource.h>
 #include <salvia/resource/surface.h>
 
+#include <algorithm>
 #include <memory>
+#include <thread>
 
 using eflib::int4;
 
 namespace salvia::resource {
 
+namespace {
+enum clear_state : uint8_t { clear_none, clear_pending, clear_expanding };
+
+std::atomic<uint64_t> surface_count(0);
+}  // namespace
+
 #if SALVIA_TILED_SURFACE
 const size_t TILE_BITS = 5;
 const size_t TILE_SIZE = 1UL << TILE_BITS;
@@ -17,7 +25,10 @@ surface::surface(size_t w, size_t h, size_t samp_count, pixel_format fmt)
   : elem_size_(color_infos[fmt].size)
   , sample_count_(samp_count)
   , size_(static_cast<int>(w), static_cast<int>(h), 1, 0)
-  , format_(fmt) {
+  , format_(fmt)
+  , clear_tile_x_count_((w + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE)
+  , pending_clears_(0)
+  , generation_(surface_count.fetch_add(1, std::memory_order_relaxed) << 32) {
 #if SALVIA_TILED_SURFACE
   tile_size_[0] = (width + TILE_SIZE - 1) >> TILE_BITS;
   tile_size_[1] = (height + TILE_SIZE - 1) >> TILE_BITS;
@@ -37,6 +48,10 @@ surface::surface(size_t w, size_t h, size_t samp_count, pixel_format fmt)
   data_.resize(pitch() * h);
 #endif
 
+  // States are clear_none.
+  clear_states_ = std::make_unique<std::atomic<uint8_t>[]>(
+      clear_tile_x_count_ * ((h + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE));
+
   to_rgba32_func_ = pixel_format_convertor::get_convertor_func(pixel_format_color_rgba32f, format_);
   from_rgba32_func_ =
       pixel_format_convertor::get_convertor_func(format_, pixel_format_color_rgba32f);
@@ -92,6 +107,11 @@ surface_ptr surface::make_mip_surface(filter_type filter) {
 }
 
 result surface::map(internal_mapped_resource& mapped, map_mode mm) {
+  expand_clears();
+  if (mm != map_read) {
+    new_generation();
+  }
+
 #if SALVIA_TILED_SURFACE
   // Unimplemented
   this->untile(mapped_data_);
@@ -115,7 +135,11 @@ result surface::map(internal_mapped_resource& mapped, map_mode mm) {
 #endif
 }
 
-result surface::unmap(internal_mapped_resource& /*mapped*/, map_mode /*mm*/) {
+result surface::unmap(internal_mapped_resource& /*mapped*/, map_mode mm) {
+  // Texels are written between map and unmap.
+  if (mm != map_read) {
+    new_generation();
+  }
   // No intermediate buffer needed in linear mode.
   return result::ok;
 }
@@ -123,6 +147,9 @@ result surface::unmap(internal_mapped_resource& /*mapped*/, map_mode /*mm*/) {
 void surface::resolve(surface& target) {
   EF_ASSERT(1 == target.sample_count(), "Resolve's target can't be a multi-sample surface");
 
+  expand_clears();
+  target.expand_clears();
+
   color_rgba32f clr;
   color_rgba32f tmp;
   for (size_t y = 0; y < size_[1]; ++y) {
@@ -140,17 +167,23 @@ void surface::resolve(surface& target) {
 }
 
 color_rgba32f surface::get_texel(size_t x, size_t y, size_t sample) const {
+  expand_clears(x, y, 1, 1);
   color_rgba32f color;
   to_rgba32_func_(&color, texel_address(x, y, sample));
   return color;
 }
 
 void surface::get_texel(void* color, size_t x, size_t y, size_t sample) const {
+  expand_clears(x, y, 1, 1);
   memcpy(color, texel_address(x, y, sample), elem_size_);
 }
 
 color_rgba32f surface::get_texel(
     size_t x0, size_t y0, size_t x1, size_t y1, float tx, float ty, size_t sample) const {
+  expand_clears(std::min(x0, x1),
+                std::min(y0, y1),
+                std::max(x0, x1) - std::min(x0, x1) + 1,
+                std::max(y0, y1) - std::min(y0, y1) + 1);
   void const* addrs[] = {texel_address(x0, y0, sample),
                          texel_address(x1, y0, sample),
                          texel_address(x0, y1, sample),
@@ -160,16 +193,22 @@ color_rgba32f surface::get_texel(
 }
 
 void surface::set_texel(size_t x, size_t y, size_t sample, const color_rgba32f& color) {
+  expand_clears(x, y, 1, 1);
+  new_generation();
   from_rgba32_func_(texel_address(x, y, sample), &color);
 }
 
 void surface::set_texel(size_t x, size_t y, size_t sample, const void* color) {
+  expand_clears(x, y, 1, 1);
+  new_generation();
   memcpy(texel_address(x, y, sample), color, elem_size_);
 }
 
 void surface::fill(size_t sx, size_t sy, size_t width, size_t height, const color_rgba32f& color) {
   uint8_t pix_clr[4 * 4 * sizeof(float)];
   from_rgba32_func_(pix_clr, &color);
+  expand_clears(sx, sy, width, height);
+  new_generation();
 
 #if SALVIA_TILED_SURFACE
   if (tile_mode_) {
@@ -256,9 +295,18 @@ void surface::fill(size_t sx, size_t sy, size_t width, size_t height, const colo
     }
   }
 #else
+  fill_texels(sx, sy, width, height, pix_clr);
+#endif
+}
+
+void surface::fill(color_rgba32f const& color) {
+  fill(0, 0, size_[0], size_[1], color);
+}
+
+void surface::fill_texels(size_t sx, size_t sy, size_t width, size_t height, void const* texel) {
   for (size_t x = sx; x < sx + width; ++x) {
     for (size_t s = 0; s < sample_count_; ++s) {
-      memcpy(&data_[((size_[0] * sy + x) * sample_count_ + s) * elem_size_], pix_clr, elem_size_);
+      memcpy(&data_[((size_[0] * sy + x) * sample_count_ + s) * elem_size_], texel, elem_size_);
     }
   }
 
@@ -267,11 +315,98 @@ void surface::fill(size_t sx, size_t sy, size_t width, size_t height, const colo
            &data_[(size_[0] * sy + sx) * sample_count_ * elem_size_],
            sample_count_ * elem_size_ * width);
   }
-#endif
 }
 
-void surface::fill(color_rgba32f const& color) {
-  fill(0, 0, size_[0], size_[1], color);
+void surface::clear(color_rgba32f const& color) {
+  uint8_t pix_clr[4 * 4 * sizeof(float)];
+  from_rgba32_func_(pix_clr, &color);
+  clear(pix_clr);
+}
+
+void surface::clear(void const* texel) {
+  new_generation();
+  memcpy(clear_texel_, texel, elem_size_);
+
+  size_t const tile_count =
+      clear_tile_x_count_ * ((size_[1] + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE);
+  for (size_t i = 0; i < tile_count; ++i) {
+    clear_states_[i].store(clear_pending, std::memory_order_relaxed);
+  }
+  pending_clears_.store(tile_count, std::memory_order_release);
+}
+
+void const* surface::pending_clear(size_t x, size_t y, size_t width, size_t height) const {
+  size_t const right = std::min<size_t>(x + width, size_[0]);
+  size_t const bottom = std::min<size_t>(y + height, size_[1]);
+  if (pending_clears_.load(std::memory_order_acquire) == 0 || right <= x || bottom <= y) {
+    return nullptr;
+  }
+
+  for (size_t tile_y = y / CLEAR_TILE_SIZE; tile_y * CLEAR_TILE_SIZE < bottom; ++tile_y) {
+    for (size_t tile_x = x / CLEAR_TILE_SIZE; tile_x * CLEAR_TILE_SIZE < right; ++tile_x) {
+      if (clear_states_[tile_y * clear_tile_x_count_ + tile_x].load(std::memory_order_acquire) !=
+          clear_pending) {
+        return nullptr;
+      }
+    }
+  }
+  return clear_texel_;
+}
+
+// Pending tile is filled by the thread which takes it, and other threads wait until it is filled.
+void surface::expand_pending_clears(size_t x, size_t y, size_t width, size_t height) const {
+  size_t const right = std::min<size_t>(x + width, size_[0]);
+  size_t const bottom = std::min<size_t>(y + height, size_[1]);
+  for (size_t tile_y = y / CLEAR_TILE_SIZE; tile_y * CLEAR_TILE_SIZE < bottom; ++tile_y) {
+    for (size_t tile_x = x / CLEAR_TILE_SIZE; tile_x * CLEAR_TILE_SIZE < right; ++tile_x) {
+      std::atomic<uint8_t>& state = clear_states_[tile_y * clear_tile_x_count_ + tile_x];
+      uint8_t expected = clear_pending;
+      if (state.compare_exchange_strong(expected, clear_expanding, std::memory_order_acquire)) {
+        size_t const left = tile_x * CLEAR_TILE_SIZE;
+        size_t const top = tile_y * CLEAR_TILE_SIZE;
+        // Texels of the tile are owned by this thread until the tile is not pending.
+        const_cast<surface*>(this)->fill_texels(left,
+                                                top,
+                                                std::min<size_t>(CLEAR_TILE_SIZE, size_[0] - left),
+                                                std::min<size_t>(CLEAR_TILE_SIZE, size_[1] - top),
+                                                clear_texel_);
+        state.store(clear_none, std::memory_order_release);
+        pending_clears_.fetch_sub(1, std::memory_order_release);
+        continue;
+      }
+      while (expected == clear_expanding) {
+        std::this_thread::yield();
+        expected = state.load(std::memory_order_acquire);
+      }
+    }
+  }
+}
+
+void surface::discard_clears(size_t x, size_t y, size_t width, size_t height) {
+  if (pending_clears_.load(std::memory_order_acquire) == 0) {
+    return;
+  }
+
+  size_t const right = std::min<size_t>(x + width, size_[0]);
+  size_t const bottom = std::min<size_t>(y + height, size_[1]);
+  size_t const tile_left = (x + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE;
+  size_t const tile_top = (y + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE;
+  for (size_t tile_y = tile_top; tile_y * CLEAR_TILE_SIZE < bottom; ++tile_y) {
+    // Tiles which are not covered by the rect are kept.
+    if (std::min<size_t>((tile_y + 1) * CLEAR_TILE_SIZE, size_[1]) > bottom) {
+      break;
+    }
+    for (size_t tile_x = tile_left; tile_x * CLEAR_TILE_SIZE < right; ++tile_x) {
+      if (std::min<size_t>((tile_x + 1) * CLEAR_TILE_SIZE, size_[0]) > right) {
+        break;
+      }
+      std::atomic<uint8_t>& state = clear_states_[tile_y * clear_tile_x_count_ + tile_x];
+      if (state.load(std::memory_order_relaxed) == clear_pending) {
+        state.store(clear_none, std::memory_order_relaxed);
+        pending_clears_.fetch_sub(1, std::memory_order_release);
+      }
+    }
+  }
 }
 
 size_t surface::texel_offset(size_t x, size_t y, size_t sample) const {
@@ -58,6 +58,8 @@ sample_app::sample_app(std::string const& app_name) : data_(new sample_app_data)
   data_->elapsed_sec = 0.0;
   data_->gui = nullptr;
   data_->is_sync_renderer = std::optional<bool>{};
+  data_->thread_count = 0;
+  data_->numa_node = -1;
   data_->frames_in_second = 0;
   data_->quit_cond = quit_conditions::user_defined;
   data_->quit_cond_data = 0;
@@ -100,6 +102,12 @@ void sample_app::init_params(int argc, char* argv[]) {
       "height,h",
       po::value<int>()->default_value(512),
       "height of screen or back buffer. should be in 1 - 8192")(
+      "threads",
+      po::value<int>()->default_value(0),
+      "threads of pipeline. 0 uses all hardware threads or CPUs of NUMA node")(
+      "numa-node",
+      po::value<int>()->default_value(-1),
+      "NUMA node which threads and memory are placed on. -1 disables placement")(
       "res-dir,r", po::value<string>()->default_value("."));
 
   auto parsed = po::parse_command_line(argc, argv, opdesc);
@@ -153,6 +161,15 @@ void sample_app::init_params(int argc, char* argv[]) {
     data_->screen_height = static_cast<uint32_t>(screen_height);
   }
 
+  auto thread_count = var_map["threads"].as<int>();
+  if (thread_count < 0) {
+    cout << "Error: threads must not be negative." << endl;
+    data_->runnable = false;
+  } else {
+    data_->thread_count = static_cast<size_t>(thread_count);
+  }
+  data_->numa_node = var_map["numa-node"].as<int>();
+
   data_->screen_aspect_ratio = static_cast<float>(data_->screen_width) / data_->screen_height;
 
   data_->screen_vp.x = data_->screen_vp.y = 0;
@@ -210,7 +227,14 @@ void sample_app::create_devices_and_targets(size_t width,
 
   cout << "Create devices and targets ..." << endl;
 
-  renderer_parameters rparams = {width, height, sample_count, color_fmt, wnd_handle};
+  renderer_parameters rparams{.backbuffer_width = width,
+                              .backbuffer_height = height,
+                              .backbuffer_num_samples = sample_count,
+                              .backbuffer_format = color_fmt,
+                              .native_window = wnd_handle,
+                              .thread_count = data_->thread_count,
+                              .thread_cpus = {},
+                              .numa_node = data_->numa_node};
 
   renderer_types rtype = salvia::ext::renderer_none;
   swap_chain_types sc_type =
@@ -512,6 +536,18 @@ void sample_app::save_profiling_result() {
       [](frame_data const& v) { return v.pipeline_stat.ps_invocations; },
       root,
       "async.pipeline_stat.ps_invocations");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_stat.hiz_rejects; },
+      root,
+      "async.pipeline_stat.hiz_rejects");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_stat.vs_cache_hits; },
+      root,
+      "async.pipeline_stat.vs_cache_hits");
 
   reduce_and_output<uint64_t>(
       data_->frame_profs.begin(),
@@ -541,15 +577,15 @@ void sample_app::save_profiling_result() {
   reduce_and_output<uint64_t>(
       data_->frame_profs.begin(),
       data_->frame_profs.end(),
-      [](frame_data const& v) { return v.pipeline_prof.compact_clip; },
+      [](frame_data const& v) { return v.pipeline_prof.vp_trans; },
       root,
-      "async.pipeline_prof.compact_clip");
+      "async.pipeline_prof.vp_trans");
   reduce_and_output<uint64_t>(
       data_->frame_profs.begin(),
       data_->frame_profs.end(),
-      [](frame_data const& v) { return v.pipeline_prof.vp_trans; },
+      [](frame_data const& v) { return v.pipeline_prof.tri_setup; },
       root,
-      "async.pipeline_prof.vp_trans");
+      "async.pipeline_prof.tri_setup");
   reduce_and_output<uint64_t>(
       data_->frame_profs.begin(),
       data_->frame_profs.end(),
@@ -562,6 +598,60 @@ void sample_app::save_profiling_result() {
       [](frame_data const& v) { return v.pipeline_prof.ras; },
       root,
       "async.pipeline_prof.ras");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.pipeline_thread_time; },
+      root,
+      "async.pipeline_prof.pipeline_thread_time");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.tile_16_draws; },
+      root,
+      "async.pipeline_prof.tile_16_draws");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.tile_32_draws; },
+      root,
+      "async.pipeline_prof.tile_32_draws");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.tile_64_draws; },
+      root,
+      "async.pipeline_prof.tile_64_draws");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.tile_128_draws; },
+      root,
+      "async.pipeline_prof.tile_128_draws");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.load_imbalance; },
+      root,
+      "async.pipeline_prof.load_imbalance");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.tile_steals; },
+      root,
+      "async.pipeline_prof.tile_steals");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.shader_clones; },
+      root,
+      "async.pipeline_prof.shader_clones");
+  reduce_and_output<uint64_t>(
+      data_->frame_profs.begin(),
+      data_->frame_profs.end(),
+      [](frame_data const& v) { return v.pipeline_prof.vso_bytes_saved; },
+      root,
+      "async.pipeline_prof.vso_bytes_saved");
 
   write_json(fmt::format("{}_Profiling.json", data_->benchmark_name), root);
 }
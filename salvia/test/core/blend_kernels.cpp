@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/blend_kernels.h>
+#include <salvia/core/framebuffer.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace salvia;
+using namespace salvia::core;
+using eflib::vec4;
+
+namespace {
+constexpr uint32_t SAMPLE_COUNT = 2;
+
+float factor_value(blend_factor factor, vec4 const& src, vec4 const& dest, int c) {
+  switch (factor) {
+  case blend_factor_zero: return 0.0f;
+  case blend_factor_one: return 1.0f;
+  case blend_factor_src_color: return src[c];
+  case blend_factor_inv_src_color: return 1.0f - src[c];
+  case blend_factor_src_alpha: return src[3];
+  case blend_factor_inv_src_alpha: return 1.0f - src[3];
+  case blend_factor_dest_alpha: return dest[3];
+  case blend_factor_inv_dest_alpha: return 1.0f - dest[3];
+  case blend_factor_dest_color: return dest[c];
+  case blend_factor_inv_dest_color: return 1.0f - dest[c];
+  }
+  return 1.0f;
+}
+
+float operation(blend_op op, float s, float s_factor, float d, float d_factor) {
+  switch (op) {
+  case blend_op_add: return s * s_factor + d * d_factor;
+  case blend_op_subtract: return s * s_factor - d * d_factor;
+  case blend_op_rev_subtract: return d * d_factor - s * s_factor;
+  case blend_op_min: return std::min(s, d);
+  case blend_op_max: return std::max(s, d);
+  }
+  return s;
+}
+
+vec4 reference_blend(render_target_blend_desc const& desc, vec4 const& src, vec4 const& dest) {
+  vec4 result = dest;
+  for (int c = 0; c < 4; ++c) {
+    if (!(desc.render_target_write_mask & (1U << c))) {
+      continue;
+    }
+    if (!desc.blend_enable) {
+      result[c] = src[c];
+      continue;
+    }
+    bool const alpha = (c == 3);
+    result[c] = operation(alpha ? desc.alpha_op : desc.color_op,
+                          src[c],
+                          factor_value(alpha ? desc.src_blend_alpha : desc.src_blend, src, dest, c),
+                          dest[c],
+                          factor_value(alpha ? desc.dest_blend_alpha : desc.dest_blend, src, dest, c));
+  }
+  return result;
+}
+
+color_rgba32f to_rgba32f(color_rgba32f const& c) {
+  return c;
+}
+
+template <typename Color>
+color_rgba32f to_rgba32f(Color const& c) {
+  return c.to_rgba32f();
+}
+
+render_target_blend_desc make_desc(blend_factor src, blend_factor dest, blend_op op) {
+  render_target_blend_desc desc;
+  desc.blend_enable = true;
+  desc.src_blend = desc.src_blend_alpha = src;
+  desc.dest_blend = desc.dest_blend_alpha = dest;
+  desc.color_op = desc.alpha_op = op;
+  return desc;
+}
+
+// Blends a quad of 2 samples per pixel by kernel, and compares every sample with reference. Unorm
+// results are saturated and compared with 'tolerance'.
+template <typename Color>
+void check_kernel(pixel_format fmt, render_target_blend_desc const& desc, float tolerance) {
+  bool const unorm = (fmt != pixel_format_color_rgba32f);
+  blend_quad_fn kernel = select_blend_quad_kernel(fmt, desc);
+  ASSERT_NE(nullptr, kernel);
+
+  vec4 const colors[4] = {vec4(0.9f, 0.1f, 0.5f, 0.25f),
+                          vec4(0.2f, 0.6f, 0.3f, 0.75f),
+                          vec4(0.0f, 1.0f, 0.4f, 0.5f),
+                          vec4(0.7f, 0.3f, 0.8f, 1.0f)};
+  vec4 const dest_color(0.4f, 0.8f, 0.2f, 0.6f);
+
+  Color initial;
+  initial = color_rgba32f(dest_color[0], dest_color[1], dest_color[2], dest_color[3]);
+  std::vector<Color> texels(4 * SAMPLE_COUNT, initial);
+  void* rows[2] = {&texels[0], &texels[2 * SAMPLE_COUNT]};
+
+  // Pixel 1 is not covered and pixel 2 has only sample 1 covered.
+  uint64_t const quad_mask = 0x3 | (0x2ULL << (MAX_SAMPLE_COUNT * 2)) |
+      (0x3ULL << (MAX_SAMPLE_COUNT * 3));
+  kernel(rows, SAMPLE_COUNT, quad_mask, colors, &desc);
+
+  color_rgba32f const stored = to_rgba32f(initial);
+  vec4 const dest(stored.r, stored.g, stored.b, stored.a);
+  for (int i = 0; i < 4; ++i) {
+    for (uint32_t s = 0; s < SAMPLE_COUNT; ++s) {
+      bool const covered = (quad_mask >> (MAX_SAMPLE_COUNT * i + s)) & 1;
+      vec4 const expected = covered ? reference_blend(desc, colors[i], dest) : dest;
+      color_rgba32f const actual = to_rgba32f(texels[i * SAMPLE_COUNT + s]);
+      for (int c = 0; c < 4; ++c) {
+        float const e = unorm ? std::clamp(expected[c], 0.0f, 1.0f) : expected[c];
+        EXPECT_NEAR(e, (&actual.r)[c], tolerance) << "pixel " << i << " sample " << s;
+      }
+    }
+  }
+}
+
+template <typename Color>
+void check_format(pixel_format fmt, float tolerance) {
+  check_kernel<Color>(fmt, render_target_blend_desc(), tolerance);
+  check_kernel<Color>(
+      fmt, make_desc(blend_factor_src_alpha, blend_factor_inv_src_alpha, blend_op_add), tolerance);
+  check_kernel<Color>(
+      fmt, make_desc(blend_factor_one, blend_factor_inv_src_alpha, blend_op_add), tolerance);
+  check_kernel<Color>(fmt, make_desc(blend_factor_one, blend_factor_one, blend_op_add), tolerance);
+  check_kernel<Color>(
+      fmt, make_desc(blend_factor_dest_color, blend_factor_zero, blend_op_add), tolerance);
+  check_kernel<Color>(
+      fmt, make_desc(blend_factor_one, blend_factor_one, blend_op_rev_subtract), tolerance);
+  check_kernel<Color>(fmt, make_desc(blend_factor_one, blend_factor_one, blend_op_min), tolerance);
+
+  render_target_blend_desc masked =
+      make_desc(blend_factor_src_alpha, blend_factor_inv_src_alpha, blend_op_add);
+  masked.render_target_write_mask = color_write_red | color_write_alpha;
+  masked.alpha_op = blend_op_max;
+  check_kernel<Color>(fmt, masked, tolerance);
+
+  masked.blend_enable = false;
+  masked.render_target_write_mask = color_write_green;
+  check_kernel<Color>(fmt, masked, tolerance);
+}
+}  // namespace
+
+TEST(salvia_core, blend_kernels_match_reference) {
+  check_format<color_rgba32f>(pixel_format_color_rgba32f, 1e-6f);
+  check_format<color_rgba8>(pixel_format_color_rgba8, 1.0f / 255);
+  check_format<color_bgra8>(pixel_format_color_bgra8, 1.0f / 255);
+}
+
+TEST(salvia_core, blend_kernels_selection) {
+  render_target_blend_desc desc;
+  desc.render_target_write_mask = 0;
+  EXPECT_EQ(nullptr, select_blend_quad_kernel(pixel_format_color_rgba8, desc));
+  EXPECT_EQ(nullptr, select_blend_quad_kernel(pixel_format_color_d24s8, render_target_blend_desc()));
+  EXPECT_NE(nullptr, select_blend_quad_kernel(pixel_format_color_r32f, render_target_blend_desc()));
+
+  blend_desc bd;
+  bd.render_target[0] = make_desc(blend_factor_one, blend_factor_one, blend_op_add);
+  bd.render_target[1].render_target_write_mask = color_write_red;
+  EXPECT_TRUE(blend_state(bd).render_target(1).blend_enable);
+  bd.independent_blend_enable = true;
+  EXPECT_FALSE(blend_state(bd).render_target(1).blend_enable);
+  EXPECT_EQ(color_write_red, blend_state(bd).render_target(1).render_target_write_mask);
+}
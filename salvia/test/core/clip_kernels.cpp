@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/clip_kernels.h>
+
+#include <random>
+
+using namespace salvia::core;
+
+namespace {
+void set_vertex(triangle_batch& batch, uint32_t t, int i, float x, float y, float z, float w) {
+  batch.x[i][t] = x;
+  batch.y[i][t] = y;
+  batch.z[i][t] = z;
+  batch.w[i][t] = w;
+}
+}  // namespace
+
+TEST(salvia_core, classify_triangles_cases) {
+  triangle_batch batch{};
+  // Back-facing.
+  set_vertex(batch, 0, 0, 0.0f, 0.0f, 0.5f, 1.0f);
+  set_vertex(batch, 0, 1, 0.5f, 0.0f, 0.5f, 1.0f);
+  set_vertex(batch, 0, 2, 0.0f, 0.5f, 0.5f, 1.0f);
+  // Front-facing.
+  set_vertex(batch, 1, 0, 0.0f, 0.0f, 0.5f, 2.0f);
+  set_vertex(batch, 1, 1, 0.0f, 0.5f, 0.5f, 2.0f);
+  set_vertex(batch, 1, 2, 0.5f, 0.0f, 0.5f, 2.0f);
+  // Left of frustum.
+  set_vertex(batch, 2, 0, -2.0f, 0.0f, 0.5f, 1.0f);
+  set_vertex(batch, 2, 1, -3.0f, 0.0f, 0.5f, 1.0f);
+  set_vertex(batch, 2, 2, -2.0f, 0.5f, 0.5f, 1.0f);
+  // Crosses near plane.
+  set_vertex(batch, 3, 0, 0.0f, 0.0f, -0.5f, 1.0f);
+  set_vertex(batch, 3, 1, 0.5f, 0.0f, 0.5f, 1.0f);
+  set_vertex(batch, 3, 2, 0.0f, 0.5f, 0.5f, 1.0f);
+  // Zero area.
+  set_vertex(batch, 4, 0, 0.0f, 0.0f, 0.5f, 1.0f);
+  set_vertex(batch, 4, 1, 0.25f, 0.25f, 0.5f, 1.0f);
+  set_vertex(batch, 4, 2, 0.5f, 0.5f, 0.5f, 1.0f);
+
+  for (classify_triangles_fn classify :
+       {&classify_triangles_generic, select_classify_triangles_kernel()}) {
+    triangle_batch_masks masks;
+    classify(batch, 5, false, false, masks);
+    EXPECT_EQ(masks.rejected, 0x14U);
+    EXPECT_EQ(masks.inside, 0x03U);
+    EXPECT_EQ(masks.front, 0x02U);
+
+    classify(batch, 5, false, true, masks);
+    EXPECT_EQ(masks.rejected, 0x15U);
+    EXPECT_EQ(masks.inside, 0x02U);
+
+    classify(batch, 2, true, false, masks);
+    EXPECT_EQ(masks.rejected, 0x02U);
+    EXPECT_EQ(masks.inside, 0x01U);
+    EXPECT_EQ(masks.front, 0x00U);
+  }
+}
+
+TEST(salvia_core, classify_triangles_kernels_agree) {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> coord(-2.0f, 2.0f);
+  std::uniform_real_distribution<float> depth(-0.5f, 1.5f);
+
+  classify_triangles_fn const selected = select_classify_triangles_kernel();
+  for (int round = 0; round < 256; ++round) {
+    triangle_batch batch;
+    for (uint32_t t = 0; t < TRIANGLE_BATCH_SIZE; ++t) {
+      for (int i = 0; i < 3; ++i) {
+        set_vertex(batch, t, i, coord(rng), coord(rng), depth(rng), depth(rng) + 0.5f);
+      }
+    }
+
+    uint32_t const count = 1 + round % TRIANGLE_BATCH_SIZE;
+    for (int cull = 0; cull < 3; ++cull) {
+      triangle_batch_masks expected;
+      triangle_batch_masks actual;
+      classify_triangles_generic(batch, count, cull == 1, cull == 2, expected);
+      selected(batch, count, cull == 1, cull == 2, actual);
+      ASSERT_EQ(expected.rejected, actual.rejected);
+      ASSERT_EQ(expected.inside, actual.inside);
+      ASSERT_EQ(expected.front, actual.front);
+    }
+  }
+}
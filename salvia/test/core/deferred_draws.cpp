@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/framebuffer.h>
+#include <salvia/core/raster_state.h>
+#include <salvia/core/renderer.h>
+#include <salvia/core/shader.h>
+#include <salvia/core/thread_pool.h>
+#include <salvia/resource/buffer.h>
+#include <salvia/resource/input_layout.h>
+#include <salvia/resource/surface.h>
+#include <salvia/resource/texture.h>
+#include <salvia/shader/shader_regs.h>
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+using namespace salvia;
+using namespace salvia::core;
+using namespace salvia::resource;
+using namespace salvia::shader;
+using eflib::vec4;
+
+namespace {
+constexpr size_t TARGET_SIZE = 16;
+
+// Outputs red to attribute 0 and green to attribute 1.
+class vs_two_colors : public cpp_vertex_shader {
+public:
+  vs_two_colors() { bind_semantic("POSITION", 0, 0); }
+
+  void shader_prog(vs_input const& in, vs_output& out) override {
+    out.position() = in.attribute(0);
+    out.attribute(0) = vec4(1.0f, 0.0f, 0.0f, 1.0f);
+    out.attribute(1) = vec4(0.0f, 1.0f, 0.0f, 1.0f);
+  }
+
+  uint32_t num_output_attributes() const override { return 2; }
+  uint32_t output_attribute_modifiers(uint32_t) const override { return vs_output::am_linear; }
+
+  cpp_shader_ptr clone() override {
+    typedef std::remove_pointer<decltype(this)>::type this_type;
+    return cpp_shader_ptr(new this_type(*this));
+  }
+};
+
+// Writes the only attribute it reads.
+class ps_attribute : public cpp_pixel_shader {
+  size_t reg_;
+
+public:
+  explicit ps_attribute(size_t reg) : reg_(reg) { bind_semantic("TEXCOORD", reg, reg); }
+
+  bool shader_prog(vs_output const& in, ps_output& out) override {
+    out.color[0] = in.attribute(reg_);
+    return true;
+  }
+
+  cpp_shader_ptr clone() override {
+    typedef std::remove_pointer<decltype(this)>::type this_type;
+    return cpp_shader_ptr(new this_type(*this));
+  }
+};
+
+// Draws left half of target by attribute 0 and right half by attribute 1 in one deferred batch.
+// If thread counts are given, pipeline threads are configured to them before the first draw, the
+// second draw and the flush, as another renderer would do.
+surface_ptr draw_deferred_halves(std::vector<size_t> const& thread_counts) {
+  renderer_ptr rend = create_benchmark_renderer();
+
+  surface_ptr color =
+      rend->create_tex2d(TARGET_SIZE, TARGET_SIZE, 1, pixel_format_color_rgba32f)->subresource(0);
+  rend->set_render_targets(1, &color, surface_ptr());
+  rend->set_viewport({0.0f, 0.0f, TARGET_SIZE, TARGET_SIZE, 0.0f, 1.0f});
+  rend->set_depth_stencil_state(std::make_shared<depth_stencil_state>(depth_stencil_desc()), 0);
+  raster_desc rs_desc;
+  rs_desc.cm = cull_none;
+  rend->set_rasterizer_state(std::make_shared<raster_state>(rs_desc));
+
+  // Left and right halves of target, two triangles each.
+  vec4 const verts[] = {vec4(-1.0f, -1.0f, 0.5f, 1.0f),
+                        vec4(0.0f, -1.0f, 0.5f, 1.0f),
+                        vec4(-1.0f, 1.0f, 0.5f, 1.0f),
+                        vec4(0.0f, -1.0f, 0.5f, 1.0f),
+                        vec4(0.0f, 1.0f, 0.5f, 1.0f),
+                        vec4(-1.0f, 1.0f, 0.5f, 1.0f),
+                        vec4(0.0f, -1.0f, 0.5f, 1.0f),
+                        vec4(1.0f, -1.0f, 0.5f, 1.0f),
+                        vec4(0.0f, 1.0f, 0.5f, 1.0f),
+                        vec4(1.0f, -1.0f, 0.5f, 1.0f),
+                        vec4(1.0f, 1.0f, 0.5f, 1.0f),
+                        vec4(0.0f, 1.0f, 0.5f, 1.0f)};
+  buffer_ptr vb = rend->create_buffer(sizeof(verts));
+  vb->transfer(0, verts, sizeof(verts), 1);
+  size_t const stride = sizeof(vec4);
+  size_t const offsets[] = {0, sizeof(vec4) * 6};
+
+  cpp_vertex_shader_ptr vs = std::make_shared<vs_two_colors>();
+  input_element_desc const elem(
+      "POSITION", 0, format_r32g32b32a32_float, 0, 0, input_per_vertex, 0);
+  rend->set_vertex_shader(vs);
+  rend->set_input_layout(rend->create_input_layout(&elem, 1, vs));
+  rend->set_primitive_topology(primitive_triangle_list);
+
+  rend->clear_color(color, color_rgba32f(0.0f, 0.0f, 0.0f, 0.0f));
+  rend->set_deferred_rendering(true);
+
+  renderer_parameters params{};
+  params.numa_node = -1;
+  auto configure_threads = [&](size_t step) {
+    if (step < thread_counts.size()) {
+      params.thread_count = thread_counts[step];
+      configure_pipeline_threads(params);
+    }
+  };
+
+  // Both draws have the same count of attributes, but pixel shaders read different ones.
+  configure_threads(0);
+  rend->set_vertex_buffers(0, 1, &vb, &stride, &offsets[0]);
+  rend->set_pixel_shader(std::make_shared<ps_attribute>(0));
+  rend->draw(0, 2);
+  configure_threads(1);
+  rend->set_vertex_buffers(0, 1, &vb, &stride, &offsets[1]);
+  rend->set_pixel_shader(std::make_shared<ps_attribute>(1));
+  rend->draw(0, 2);
+  configure_threads(2);
+  rend->flush();
+  rend->set_deferred_rendering(false);
+
+  if (!thread_counts.empty()) {
+    params.thread_count = 0;
+    configure_pipeline_threads(params);
+  }
+  return color;
+}
+
+void expect_halves(surface_ptr const& color) {
+  color_rgba32f const left = color->get_texel(2, TARGET_SIZE / 2, 0);
+  color_rgba32f const right = color->get_texel(TARGET_SIZE - 3, TARGET_SIZE / 2, 0);
+  EXPECT_EQ(1.0f, left.r);
+  EXPECT_EQ(0.0f, left.g);
+  EXPECT_EQ(0.0f, right.r);
+  EXPECT_EQ(1.0f, right.g);
+}
+}  // namespace
+
+TEST(salvia_core, deferred_draws_keep_attributes_of_their_pixel_shaders) {
+  expect_halves(draw_deferred_halves({}));
+}
+
+TEST(salvia_core, deferred_draws_survive_reconfigured_pipeline_threads) {
+  // Draws are binned with different thread counts, and flushed with more threads than both.
+  expect_halves(draw_deferred_halves({4, 2, 8}));
+}
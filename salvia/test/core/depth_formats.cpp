@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/framebuffer.h>
+#include <salvia/core/render_state.h>
+#include <salvia/core/renderer.h>
+#include <salvia/resource/surface.h>
+
+#include <memory>
+
+using namespace salvia;
+using namespace salvia::core;
+using namespace salvia::resource;
+
+TEST(salvia_core, depth_formats_round_trip) {
+  color_d16 d16;
+  color_d24s8 d24s8;
+  d24s8.value = 0;
+  for (uint32_t code : {0U, 1U, 255U, 32767U, 65534U, 65535U}) {
+    d16.depth = static_cast<uint16_t>(code);
+    d16.set_depth(d16.get_depth());
+    EXPECT_EQ(code, d16.depth);
+  }
+  for (uint32_t code : {0U, 1U, 0x7FFFFFU, 0xFFFFFEU, 0xFFFFFFU}) {
+    d24s8.value = code | 0xA5000000U;
+    d24s8.set_depth(d24s8.get_depth());
+    EXPECT_EQ(code | 0xA5000000U, d24s8.value);
+  }
+
+  d16.set_depth(2.0f);
+  EXPECT_EQ(1.0f, d16.get_depth());
+  d16.set_depth(-1.0f);
+  EXPECT_EQ(0.0f, d16.get_depth());
+
+  // Depth and stencil are written separately.
+  d24s8.set_depth(1.0f);
+  d24s8.set_stencil(0x3C);
+  d24s8.set_depth(0.0f);
+  EXPECT_EQ(0x3CU, d24s8.get_stencil());
+  d24s8.set_stencil(0x1FF);
+  EXPECT_EQ(0.0f, d24s8.get_depth());
+  EXPECT_EQ(0xFFU, d24s8.get_stencil());
+
+  color_d32f_s8x24 d32s8;
+  d32s8.set_depth(0.3f);
+  d32s8.set_stencil(0x1C3);
+  EXPECT_EQ(0.3f, d32s8.get_depth());
+  EXPECT_EQ(0xC3U, d32s8.get_stencil());
+
+  color_rgba32f const texel = d32s8.to_rgba32f();
+  EXPECT_EQ(0.3f, texel.r);
+  EXPECT_EQ(195.0f, texel.g);
+}
+
+TEST(salvia_core, depth_formats_sizes) {
+  EXPECT_EQ(2, get_color_info(pixel_format_color_d16).size);
+  EXPECT_EQ(4, get_color_info(pixel_format_color_d24s8).size);
+  EXPECT_EQ(4, get_color_info(pixel_format_color_d32f).size);
+  EXPECT_EQ(8, get_color_info(pixel_format_color_d32f_s8x24).size);
+}
+
+TEST(salvia_core, depth_formats_clear) {
+  surface ds(5, 3, 4, pixel_format_color_d24s8);
+  framebuffer::clear_depth_stencil(&ds, clear_depth | clear_stencil, 1.0f, 0x12);
+  framebuffer::clear_depth_stencil(&ds, clear_depth, 0.5f, 0);
+  ds.expand_clears();
+
+  for (size_t y = 0; y < ds.height(); ++y) {
+    for (size_t x = 0; x < ds.width(); ++x) {
+      for (size_t s = 0; s < ds.sample_count(); ++s) {
+        auto const* sample = static_cast<color_d24s8 const*>(ds.texel_address(x, y, s));
+        EXPECT_NEAR(0.5f, sample->get_depth(), 1.0f / 16777215.0f);
+        EXPECT_EQ(0x12U, sample->get_stencil());
+      }
+    }
+  }
+
+  surface d16(5, 3, 1, pixel_format_color_d16);
+  framebuffer::clear_depth_stencil(&d16, clear_depth, 0.25f, 0);
+  d16.expand_clears();
+  EXPECT_EQ(16384U, static_cast<color_d16 const*>(d16.texel_address(4, 2, 0))->depth);
+  EXPECT_NEAR(0.25f, d16.get_texel(4, 2, 0).r, 1.0f / 65535.0f);
+}
+
+TEST(salvia_core, depth_formats_late_depth_stencil_without_shading) {
+  depth_stencil_desc desc;
+  desc.stencil_enable = true;
+  desc.front_face.stencil_pass_op = stencil_op_replace;
+  render_state state{};
+  state.ds_state = std::make_shared<depth_stencil_state>(desc);
+  state.stencil_ref = 0x5A;
+  state.color_targets.push_back(std::make_shared<surface>(4, 4, 1, pixel_format_color_rgba8));
+  state.depth_stencil_target = std::make_shared<surface>(4, 4, 1, pixel_format_color_d24s8);
+  state.target_sample_count = 1;
+
+  surface& color = *state.color_targets[0];
+  surface& ds = *state.depth_stencil_target;
+  color.clear(color_rgba32f(0.0f, 0.0f, 1.0f, 1.0f));
+  framebuffer::clear_depth_stencil(&ds, clear_depth | clear_stencil, 1.0f, 0);
+  ds.expand_clears();
+
+  framebuffer fb;
+  fb.update(&state);
+  ASSERT_FALSE(fb.early_z_enabled());
+
+  // Stencil disables early Z, so samples without pixel shader are tested after rasterization.
+  float const aa_offset[1] = {0.0f};
+  float const depth[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+  uint64_t const quad_mask = 0x1 | (0x1ULL << (MAX_SAMPLE_COUNT * 3));
+  fb.late_depth_stencil_quad(0, 0, quad_mask, depth, true, aa_offset);
+  fb.late_depth_stencil(3, 3, 0x1, 0.25f, true, aa_offset);
+
+  color_d24s8 drawn;
+  ds.get_texel(&drawn, 1, 1, 0);
+  EXPECT_NEAR(0.5f, drawn.get_depth(), 1.0f / 16777215.0f);
+  EXPECT_EQ(0x5AU, drawn.get_stencil());
+  ds.get_texel(&drawn, 3, 3, 0);
+  EXPECT_NEAR(0.25f, drawn.get_depth(), 1.0f / 16777215.0f);
+  EXPECT_EQ(0x5AU, drawn.get_stencil());
+  ds.get_texel(&drawn, 1, 0, 0);
+  EXPECT_EQ(1.0f, drawn.get_depth());
+  EXPECT_EQ(0U, drawn.get_stencil());
+  EXPECT_EQ(1.0f, color.get_texel(1, 1, 0).b);
+}
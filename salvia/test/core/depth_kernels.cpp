@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/depth_kernels.h>
+
+#include <bit>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace salvia;
+using namespace salvia::core;
+
+TEST(salvia_core, depth_kernels_agree) {
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+  std::uniform_real_distribution<float> slope(-0.05f, 0.05f);
+
+  float const sample_z_offset[4] = {0.001f, -0.002f, 0.0f, 0.003f};
+
+  for (int func = compare_function_never; func <= compare_function_always; ++func) {
+    depth_row_fn generic = generic_depth_row_kernel(static_cast<compare_function>(func));
+    depth_row_fn selected = select_depth_row_kernel(static_cast<compare_function>(func));
+    if (func == compare_function_never) {
+      EXPECT_EQ(generic, nullptr);
+      EXPECT_EQ(selected, nullptr);
+      continue;
+    }
+
+    for (uint32_t sample_count : {1U, 4U}) {
+      for (uint32_t count : {1U, 3U, 4U, 7U, 16U}) {
+        std::vector<float> expected(count * sample_count * 2);
+        for (float& v : expected) {
+          v = depth(rng);
+        }
+        std::vector<float> actual = expected;
+        std::vector<float> const stencil = expected;
+
+        std::vector<uint32_t> pixel_masks(count);
+        for (uint32_t& mask : pixel_masks) {
+          mask = rng() & ((1U << sample_count) - 1);
+        }
+
+        float const z = depth(rng);
+        float const dzdx = slope(rng);
+        uint32_t const* const masks_list[] = {nullptr, pixel_masks.data()};
+        for (uint32_t const* masks : masks_list) {
+          bool const expected_written =
+              generic(expected.data(), sample_count, count, z, dzdx, sample_z_offset, masks);
+          bool const actual_written =
+              selected(actual.data(), sample_count, count, z, dzdx, sample_z_offset, masks);
+          ASSERT_EQ(expected_written, actual_written);
+          ASSERT_EQ(expected, actual);
+        }
+
+        // Stencil is never written.
+        for (size_t i = 1; i < expected.size(); i += 2) {
+          ASSERT_EQ(stencil[i], expected[i]);
+        }
+      }
+    }
+  }
+}
+
+TEST(salvia_core, depth_stencil_quad_kernels_agree) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+  float const sample_z_offset[8] = {0.001f, -0.002f, 0.0f, 0.003f, -0.001f, 0.002f, 0.0f, 0.0f};
+
+  for (int func = compare_function_never; func <= compare_function_always; ++func) {
+    for (int flags = 0; flags < 4; ++flags) {
+      bool const write_depth = (flags & 1) != 0;
+      bool const stencil = (flags & 2) != 0;
+      depth_stencil_quad_fn generic = generic_depth_stencil_quad_kernel(
+          static_cast<compare_function>(func), write_depth, stencil);
+      depth_stencil_quad_fn selected = select_depth_stencil_quad_kernel(
+          static_cast<compare_function>(func), write_depth, stencil);
+
+      for (uint32_t sample_count : {1U, 2U, 4U, 8U}) {
+        for (int round = 0; round < 32; ++round) {
+          // Two rows of two pixels.
+          size_t const row_size = sample_count * 4;
+          std::vector<float> expected(row_size * 2);
+          for (size_t i = 0; i < expected.size(); i += 2) {
+            expected[i] = depth(rng);
+            expected[i + 1] = std::bit_cast<float>(static_cast<uint32_t>(rng() & 0x3FF));
+          }
+          std::vector<float> actual = expected;
+
+          uint64_t quad_mask = 0;
+          for (uint32_t i = 0; i < 4; ++i) {
+            quad_mask |= static_cast<uint64_t>(rng() & ((1U << sample_count) - 1))
+                << (i * MAX_SAMPLE_COUNT);
+          }
+          if (round % 4 == 0) {
+            quad_mask &= round % 8 == 0 ? 0xFFFFFFFFULL : ~0xFFFFFFFFULL;
+          }
+          bool const row_covered[2] = {(quad_mask & 0xFFFFFFFFULL) != 0,
+                                       (quad_mask >> 32) != 0};
+
+          float const quad_depth[4] = {depth(rng), depth(rng), depth(rng), depth(rng)};
+          stencil_quad_params const stencil_params = {
+              static_cast<uint32_t>(rng() & 0x3),
+              round % 2 ? 0xFFU : 0x3U,
+              round % 3 ? 0xFFU : 0x0FU,
+              static_cast<compare_function>(rng() % 8),
+              static_cast<stencil_op>(stencil_op_keep + rng() % 8)};
+
+          float* expected_rows[2] = {row_covered[0] ? expected.data() : nullptr,
+                                     row_covered[1] ? expected.data() + row_size : nullptr};
+          float* actual_rows[2] = {row_covered[0] ? actual.data() : nullptr,
+                                   row_covered[1] ? actual.data() + row_size : nullptr};
+          stencil_quad_params const* params = stencil ? &stencil_params : nullptr;
+
+          uint64_t const expected_passed = generic(
+              expected_rows, sample_count, quad_mask, quad_depth, sample_z_offset, params);
+          uint64_t const actual_passed =
+              selected(actual_rows, sample_count, quad_mask, quad_depth, sample_z_offset, params);
+          ASSERT_EQ(expected_passed, actual_passed);
+          ASSERT_EQ(0, memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)));
+          ASSERT_EQ(0U, expected_passed & ~quad_mask);
+        }
+      }
+    }
+  }
+}
+
+TEST(salvia_core, depth_stencil_quad_cases) {
+  // One sample per pixel. Depth of pixels are 0.5 and stencil are 1.
+  float ds[8];
+  auto reset = [&ds]() {
+    for (int i = 0; i < 8; i += 2) {
+      ds[i] = 0.5f;
+      ds[i + 1] = std::bit_cast<float>(1U);
+    }
+  };
+  float* rows[2] = {ds, ds + 4};
+  float const quad_depth[4] = {0.25f, 0.75f, 0.25f, 0.75f};
+  uint64_t const quad_mask = 0x0001000100010001ULL;
+
+  for (depth_stencil_quad_fn kernel :
+       {generic_depth_stencil_quad_kernel(compare_function_less, true, true),
+        select_depth_stencil_quad_kernel(compare_function_less, true, true)}) {
+    reset();
+    stencil_quad_params const incr = {1, 0xFF, 0xFF, compare_function_equal, stencil_op_incr_sat};
+    EXPECT_EQ(0x0000000100000001ULL, kernel(rows, 1, quad_mask, quad_depth, nullptr, &incr));
+    EXPECT_EQ(0.25f, ds[0]);
+    EXPECT_EQ(2U, std::bit_cast<uint32_t>(ds[1]));
+    EXPECT_EQ(0.5f, ds[2]);
+    EXPECT_EQ(1U, std::bit_cast<uint32_t>(ds[3]));
+
+    // Stencil test fails.
+    reset();
+    stencil_quad_params const fail = {2, 0xFF, 0xFF, compare_function_equal, stencil_op_zero};
+    EXPECT_EQ(0U, kernel(rows, 1, quad_mask, quad_depth, nullptr, &fail));
+    EXPECT_EQ(0.5f, ds[0]);
+    EXPECT_EQ(1U, std::bit_cast<uint32_t>(ds[1]));
+
+    // Saturated at zero.
+    reset();
+    ds[1] = std::bit_cast<float>(0U);
+    stencil_quad_params const decr = {0, 0xFF, 0xFF, compare_function_always, stencil_op_decr_sat};
+    EXPECT_EQ(0x0000000100000001ULL, kernel(rows, 1, quad_mask, quad_depth, nullptr, &decr));
+    EXPECT_EQ(0U, std::bit_cast<uint32_t>(ds[1]));
+    EXPECT_EQ(0U, std::bit_cast<uint32_t>(ds[5]));
+  }
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/edge_kernels.h>
+
+#include <random>
+#include <vector>
+
+using namespace salvia::core;
+
+namespace {
+constexpr uint32_t SUBPIXEL_BITS = 8;
+constexpr uint32_t SAMPLE_COUNT = 4;
+int32_t const SAMPLE_X[SAMPLE_COUNT] = {96, 224, 32, 160};
+int32_t const SAMPLE_Y[SAMPLE_COUNT] = {32, 96, 160, 224};
+
+// Builds equations with the winding which is expected by rasterizer.
+fixed_edge_equations make_triangle(float x0, float y0, float x1, float y1, float x2, float y2) {
+  if ((x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0) < 0) {
+    std::swap(x1, x2);
+    std::swap(y1, y2);
+  }
+  float const xs[3] = {x0, x1, x2};
+  float const ys[3] = {y0, y1, y2};
+  fixed_edge_equations eq;
+  setup_fixed_edge_equations(eq, xs, ys, SUBPIXEL_BITS);
+  return eq;
+}
+}  // namespace
+
+TEST(salvia_core, fixed_edges_shared_edges_are_watertight) {
+  constexpr int CELL = 8;
+  constexpr int CELLS = 8;
+  constexpr int SIZE = CELL * CELLS;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> jitter(-CELL * 0.25f, CELL * 0.25f);
+
+  float grid_x[CELLS + 1][CELLS + 1];
+  float grid_y[CELLS + 1][CELLS + 1];
+  for (int y = 0; y <= CELLS; ++y) {
+    for (int x = 0; x <= CELLS; ++x) {
+      bool const border = x == 0 || y == 0 || x == CELLS || y == CELLS;
+      grid_x[y][x] = static_cast<float>(x * CELL) + (border ? 0.0f : jitter(rng));
+      grid_y[y][x] = static_cast<float>(y * CELL) + (border ? 0.0f : jitter(rng));
+    }
+  }
+
+  std::vector<int> hits(SIZE * SIZE * SAMPLE_COUNT, 0);
+  auto rasterize = [&](fixed_edge_equations const& eq) {
+    ASSERT_TRUE(eq.valid);
+    for (int top = 0; top < SIZE; top += 4) {
+      for (int left = 0; left < SIZE; left += 4) {
+        uint32_t pixel_mask[16];
+        generic_edge_kernels()->coverage(
+            eq, left, top, SAMPLE_X, SAMPLE_Y, SAMPLE_COUNT, pixel_mask);
+        for (int i = 0; i < 16; ++i) {
+          for (uint32_t i_sample = 0; i_sample < SAMPLE_COUNT; ++i_sample) {
+            if (pixel_mask[i] & (1U << i_sample)) {
+              int const x = left + (i & 3);
+              int const y = top + (i >> 2);
+              ++hits[(y * SIZE + x) * SAMPLE_COUNT + i_sample];
+            }
+          }
+        }
+      }
+    }
+  };
+
+  for (int y = 0; y < CELLS; ++y) {
+    for (int x = 0; x < CELLS; ++x) {
+      rasterize(make_triangle(grid_x[y][x],
+                              grid_y[y][x],
+                              grid_x[y][x + 1],
+                              grid_y[y][x + 1],
+                              grid_x[y + 1][x],
+                              grid_y[y + 1][x]));
+      rasterize(make_triangle(grid_x[y][x + 1],
+                              grid_y[y][x + 1],
+                              grid_x[y + 1][x + 1],
+                              grid_y[y + 1][x + 1],
+                              grid_x[y + 1][x],
+                              grid_y[y + 1][x]));
+    }
+  }
+
+  for (int hit : hits) {
+    ASSERT_EQ(hit, 1);
+  }
+}
+
+TEST(salvia_core, fixed_edges_kernels_agree) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> coord(-20.0f, 150.0f);
+
+  edge_kernels const* generic = generic_edge_kernels();
+  edge_kernels const* selected = select_edge_kernels();
+
+  for (int i_tri = 0; i_tri < 200; ++i_tri) {
+    fixed_edge_equations eq =
+        make_triangle(coord(rng), coord(rng), coord(rng), coord(rng), coord(rng), coord(rng));
+    ASSERT_TRUE(eq.valid);
+
+    for (int top = 0; top < 128; top += 4) {
+      for (int left = 0; left < 128; left += 4) {
+        uint32_t expected[16];
+        uint32_t actual[16];
+        generic->coverage(eq, left, top, SAMPLE_X, SAMPLE_Y, SAMPLE_COUNT, expected);
+        selected->coverage(eq, left, top, SAMPLE_X, SAMPLE_Y, SAMPLE_COUNT, actual);
+        for (int i = 0; i < 16; ++i) {
+          ASSERT_EQ(expected[i], actual[i]);
+        }
+
+        // Trivial classification never contradicts sample coverage.
+        block_coverage const coverage = classify_block(eq, left, top, 4, 4);
+        for (int i = 0; i < 16; ++i) {
+          if (coverage == block_coverage::rejected) {
+            ASSERT_EQ(expected[i], 0U);
+          } else if (coverage == block_coverage::accepted) {
+            ASSERT_EQ(expected[i], (1U << SAMPLE_COUNT) - 1);
+          }
+        }
+      }
+    }
+
+    for (uint32_t child_size : {16U, 4U, 1U}) {
+      uint32_t expected[16];
+      uint32_t actual[16];
+      uint32_t expected_count = 0;
+      uint32_t actual_count = 0;
+      generic->subdivide(eq, 0, 0, 0, 0, child_size, expected, expected_count);
+      selected->subdivide(eq, 0, 0, 0, 0, child_size, actual, actual_count);
+      ASSERT_EQ(expected_count, actual_count);
+      for (uint32_t i = 0; i < expected_count; ++i) {
+        ASSERT_EQ(expected[i], actual[i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/framebuffer.h>
+#include <salvia/core/hierarchical_z.h>
+#include <salvia/core/render_state.h>
+#include <salvia/resource/surface.h>
+#include <salvia/shader/shader_regs.h>
+
+#include <memory>
+
+using namespace salvia;
+using namespace salvia::core;
+using namespace salvia::resource;
+using eflib::vec4;
+
+namespace {
+constexpr size_t TILE = surface::CLEAR_TILE_SIZE;
+
+float read_depth_r32(void const* ds_data) {
+  return *reinterpret_cast<float const*>(ds_data);
+}
+}  // namespace
+
+TEST(salvia_core, fast_clear_expands_accessed_tiles) {
+  surface surf(TILE * 2 + 5, TILE + 3, 2, pixel_format_color_rgba8);
+  surf.fill(color_rgba32f(0.0f, 0.0f, 0.0f, 0.0f));
+  surf.clear(color_rgba32f(1.0f, 0.0f, 1.0f, 1.0f));
+  ASSERT_NE(nullptr, surf.pending_clear(0, 0, surf.width(), surf.height()));
+
+  // Only the tile of accessed texel is filled.
+  surf.set_texel(TILE + 1, 1, 1, color_rgba32f(0.0f, 1.0f, 0.0f, 1.0f));
+  EXPECT_EQ(nullptr, surf.pending_clear(TILE, 0, TILE, TILE));
+  EXPECT_NE(nullptr, surf.pending_clear(0, 0, TILE, TILE));
+  EXPECT_EQ(1.0f, surf.get_texel(TILE + 1, 1, 0).b);
+  EXPECT_EQ(1.0f, surf.get_texel(TILE + 1, 1, 1).g);
+  EXPECT_EQ(0.0f, surf.get_texel(TILE + 1, 1, 1).b);
+
+  // Partial tiles at right-bottom corner.
+  EXPECT_EQ(1.0f, surf.get_texel(TILE * 2 + 4, TILE + 2, 1).r);
+
+  // Resolve expands all tiles.
+  surface resolved(surf.width(), surf.height(), 1, pixel_format_color_rgba32f);
+  surf.resolve(resolved);
+  EXPECT_EQ(nullptr, surf.pending_clear(0, 0, TILE, TILE));
+  EXPECT_EQ(0.5f, resolved.get_texel(TILE + 1, 1, 0).r);
+  EXPECT_EQ(1.0f, resolved.get_texel(3, TILE + 2, 0).r);
+
+  // Writer of whole tiles discards their clears, and keeps tiles partially written.
+  surf.clear(color_rgba32f(0.0f, 0.0f, 1.0f, 1.0f));
+  surf.discard_clears(0, 0, TILE * 2, TILE + 3);
+  EXPECT_EQ(nullptr, surf.pending_clear(0, 0, TILE * 2, TILE + 3));
+  EXPECT_NE(nullptr, surf.pending_clear(TILE * 2, 0, 5, TILE + 3));
+}
+
+TEST(salvia_core, fast_clear_depth_stencil) {
+  surface ds(TILE * 2, TILE * 2, 1, pixel_format_color_d24s8);
+  framebuffer::clear_depth_stencil(&ds, clear_depth | clear_stencil, 0.5f, 0x3C);
+  framebuffer::clear_depth_stencil(&ds, clear_depth, 1.0f, 0);
+
+  // Depth is cleared on the texel of pending clear.
+  auto const* texel =
+      static_cast<color_d24s8 const*>(ds.pending_clear(0, 0, ds.width(), ds.height()));
+  ASSERT_NE(nullptr, texel);
+  EXPECT_EQ(1.0f, texel->get_depth());
+  EXPECT_EQ(0x3CU, texel->get_stencil());
+
+  // Stencil of expanded target is cleared per texel, as a write out of framebuffers.
+  ds.expand_clears(0, 0, 1, 1);
+  uint64_t const generation = ds.generation();
+  framebuffer::clear_depth_stencil(&ds, clear_stencil, 0.0f, 0x5A);
+  EXPECT_EQ(nullptr, ds.pending_clear(0, 0, ds.width(), ds.height()));
+  EXPECT_NE(generation, ds.generation());
+  color_d24s8 cleared;
+  ds.get_texel(&cleared, TILE + 1, TILE + 1, 0);
+  EXPECT_EQ(1.0f, cleared.get_depth());
+  EXPECT_EQ(0x5AU, cleared.get_stencil());
+}
+
+TEST(salvia_core, fast_clear_hiz_refresh) {
+  surface ds(128, 96, 1, pixel_format_color_rg32f);
+  ds.clear(color_rgba32f(0.75f, 0.0f, 0.0f, 0.0f));
+
+  hierarchical_z hiz;
+  hiz.reset(&ds, &read_depth_r32);
+  hiz.refresh();
+
+  // Bounds are depth of clear, and no tile is expanded.
+  EXPECT_TRUE(hiz.reject(compare_function_less, 0, 0, 128, 96, 0.75f, 0.75f));
+  EXPECT_FALSE(hiz.reject(compare_function_less, 0, 0, 128, 96, 0.5f, 0.5f));
+  EXPECT_NE(nullptr, ds.pending_clear(0, 0, ds.width(), ds.height()));
+}
+
+TEST(salvia_core, fast_clear_tile_draws_and_keeps_untouched_tiles) {
+  render_state state{};
+  state.ds_state = std::make_shared<depth_stencil_state>(depth_stencil_desc());
+  state.bl_state = std::make_shared<blend_state>(blend_desc());
+  state.color_targets.push_back(
+      std::make_shared<surface>(TILE * 4, TILE * 4, 1, pixel_format_color_rgba8));
+  state.depth_stencil_target =
+      std::make_shared<surface>(TILE * 4, TILE * 4, 1, pixel_format_color_rg32f);
+  state.target_sample_count = 1;
+
+  surface& color = *state.color_targets[0];
+  surface& ds = *state.depth_stencil_target;
+  color.clear(color_rgba32f(0.0f, 0.0f, 1.0f, 1.0f));
+  framebuffer::clear_depth_stencil(&ds, clear_depth | clear_stencil, 1.0f, 0);
+
+  framebuffer fb;
+  fb.update(&state);
+
+  float const aa_offset[1] = {0.0f};
+  float const depth[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+  shader::ps_output quad[4];
+  for (int i = 0; i < 4; ++i) {
+    quad[i].color[0] = vec4(1.0f, 0.0f, 0.0f, 1.0f);
+  }
+  auto const draw_quad = [&](size_t x, size_t y) {
+    uint64_t mask = 0x1 | (0x1ULL << MAX_SAMPLE_COUNT) | (0x1ULL << (MAX_SAMPLE_COUNT * 2)) |
+        (0x1ULL << (MAX_SAMPLE_COUNT * 3));
+    if (fb.early_z_enabled()) {
+      mask = fb.early_z_test_quad(x, y, mask, depth, aa_offset);
+    }
+    fb.render_sample_quad(nullptr, x, y, mask, quad, depth, true, aa_offset);
+  };
+
+  // Resident tile is loaded from clear and drawn tiles are written back.
+  framebuffer_tile tile;
+  fb.begin_tile(&tile, 0, 0, TILE * 2);
+  draw_quad(2, 2);
+  framebuffer::end_tile(&tile);
+  EXPECT_EQ(nullptr, color.pending_clear(0, 0, TILE * 2, TILE * 2));
+  EXPECT_NE(nullptr, color.pending_clear(TILE * 2, 0, TILE * 2, TILE * 4));
+
+  // Tile which is drawn without binding is expanded.
+  fb.expand_clears(TILE * 2, TILE * 2, TILE * 2);
+  draw_quad(TILE * 3, TILE * 3);
+  EXPECT_NE(nullptr, color.pending_clear(TILE * 2, 0, TILE * 2, TILE * 2));
+
+  EXPECT_EQ(1.0f, color.get_texel(3, 3, 0).r);
+  EXPECT_EQ(1.0f, color.get_texel(4, 4, 0).b);
+  EXPECT_EQ(1.0f, color.get_texel(TILE * 3 + 1, TILE * 3 + 1, 0).r);
+  EXPECT_EQ(1.0f, color.get_texel(TILE * 3 + 2, TILE * 3 + 2, 0).b);
+  EXPECT_EQ(0.5f, ds.get_texel(TILE * 3, TILE * 3, 0).r);
+  EXPECT_EQ(1.0f, ds.get_texel(TILE * 3 + 2, TILE * 3, 0).r);
+  EXPECT_EQ(1.0f, color.get_texel(TILE * 3, 0, 0).b);
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/framebuffer.h>
+#include <salvia/core/render_state.h>
+#include <salvia/resource/surface.h>
+#include <salvia/shader/shader_regs.h>
+
+#include <memory>
+
+using namespace salvia;
+using namespace salvia::core;
+using namespace salvia::resource;
+using eflib::vec4;
+
+namespace {
+constexpr size_t TARGET_SIZE = 70;
+constexpr size_t TILE_SIZE = 64;
+
+struct targets {
+  render_state state{};
+  framebuffer fb;
+
+  explicit targets(bool stencil_enable) {
+    depth_stencil_desc ds_desc;
+    ds_desc.stencil_enable = stencil_enable;
+    ds_desc.front_face.stencil_pass_op = stencil_op_incr_sat;
+    state.ds_state = std::make_shared<depth_stencil_state>(ds_desc);
+    state.stencil_ref = 0;
+
+    blend_desc bl_desc;
+    render_target_blend_desc& rt = bl_desc.render_target[0];
+    rt.blend_enable = true;
+    rt.src_blend = rt.src_blend_alpha = blend_factor_src_alpha;
+    rt.dest_blend = rt.dest_blend_alpha = blend_factor_inv_src_alpha;
+    state.bl_state = std::make_shared<blend_state>(bl_desc);
+
+    state.color_targets.push_back(
+        std::make_shared<surface>(TARGET_SIZE, TARGET_SIZE, 1, pixel_format_color_rgba8));
+    state.depth_stencil_target =
+        std::make_shared<surface>(TARGET_SIZE, TARGET_SIZE, 1, pixel_format_color_rg32f);
+    state.target_sample_count = 1;
+
+    state.color_targets[0]->fill(color_rgba32f(0.2f, 0.4f, 0.6f, 1.0f));
+    framebuffer::clear_depth_stencil(
+        state.depth_stencil_target.get(), clear_depth | clear_stencil, 1.0f, 0);
+    // Targets are drawn without rasterizer, which expands tiles of fast clear before drawing.
+    state.depth_stencil_target->expand_clears();
+    fb.update(&state);
+  }
+
+  // Quads of the right-top tile, which is clipped by targets. Later quads are partially behind.
+  void draw() {
+    float const aa_offset[1] = {0.0f};
+    shader::ps_output quad[4];
+    for (int pass = 0; pass < 2; ++pass) {
+      for (int i = 0; i < 4; ++i) {
+        quad[i].color[0] = vec4(0.1f * i, 1.0f - 0.3f * pass, 0.5f, 0.5f);
+      }
+      for (size_t y = 0; y < 8; y += 2) {
+        for (size_t x = TILE_SIZE; x < TARGET_SIZE; x += 2) {
+          float const depth[4] = {0.5f - 0.1f * pass, 0.5f + 0.1f * pass, 0.3f, 0.7f};
+          uint64_t mask = 0x1 | (0x1ULL << MAX_SAMPLE_COUNT) | (0x1ULL << (MAX_SAMPLE_COUNT * 2)) |
+              (0x1ULL << (MAX_SAMPLE_COUNT * 3));
+          if (fb.early_z_enabled()) {
+            mask = fb.early_z_test_quad(x, y, mask, depth, aa_offset);
+          }
+          fb.render_sample_quad(nullptr, x, y, mask, quad, depth, true, aa_offset);
+        }
+      }
+    }
+  }
+};
+
+void expect_same(surface const& lhs, surface const& rhs) {
+  for (size_t y = 0; y < lhs.height(); ++y) {
+    for (size_t x = 0; x < lhs.width(); ++x) {
+      color_rgba32f const l = lhs.get_texel(x, y, 0);
+      color_rgba32f const r = rhs.get_texel(x, y, 0);
+      EXPECT_EQ(l.r, r.r) << x << ", " << y;
+      EXPECT_EQ(l.g, r.g) << x << ", " << y;
+      EXPECT_EQ(l.b, r.b) << x << ", " << y;
+      EXPECT_EQ(l.a, r.a) << x << ", " << y;
+    }
+  }
+}
+}  // namespace
+
+TEST(salvia_core, framebuffer_tile_draws_as_targets) {
+  for (bool stencil_enable : {false, true}) {
+    targets direct(stencil_enable);
+    direct.draw();
+
+    targets resident(stencil_enable);
+    framebuffer_tile tile;
+    resident.fb.begin_tile(&tile, TILE_SIZE, 0, TILE_SIZE);
+    resident.draw();
+    framebuffer::end_tile(&tile);
+
+    EXPECT_EQ(0.4f, resident.state.depth_stencil_target->get_texel(TILE_SIZE, 0, 0).r);
+    expect_same(*direct.state.color_targets[0], *resident.state.color_targets[0]);
+    expect_same(*direct.state.depth_stencil_target, *resident.state.depth_stencil_target);
+  }
+}
+
+TEST(salvia_core, framebuffer_tile_skips_untouched_targets) {
+  targets t(false);
+  framebuffer_tile tile;
+  t.fb.begin_tile(&tile, 0, 0, TILE_SIZE);
+  // Written out of framebuffer while the tile is bound, and kept as the tile is not drawn.
+  t.state.color_targets[0]->set_texel(1, 1, 0, color_rgba32f(1.0f, 0.0f, 0.0f, 1.0f));
+  framebuffer::end_tile(&tile);
+  EXPECT_EQ(1.0f, t.state.color_targets[0]->get_texel(1, 1, 0).r);
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/framebuffer.h>
+#include <salvia/core/hierarchical_z.h>
+#include <salvia/core/render_state.h>
+#include <salvia/resource/surface.h>
+#include <salvia/shader/shader_regs.h>
+
+#include <memory>
+
+using namespace salvia;
+using namespace salvia::core;
+using namespace salvia::resource;
+
+namespace {
+float read_depth_r32(void const* ds_data) {
+  return *reinterpret_cast<float const*>(ds_data);
+}
+}  // namespace
+
+TEST(salvia_core, hiz_unknown_target_never_rejects) {
+  surface ds(128, 96, 1, pixel_format_color_rg32f);
+  hierarchical_z hiz;
+  hiz.reset(&ds, &read_depth_r32);
+
+  EXPECT_FALSE(hiz.reject(compare_function_less, 0, 0, 64, 64, 2.0f, 2.0f));
+  EXPECT_FALSE(hiz.reject(compare_function_greater, 0, 0, 64, 64, -1.0f, -1.0f));
+}
+
+TEST(salvia_core, hiz_clear_and_refresh) {
+  surface ds(128, 96, 1, pixel_format_color_rg32f);
+  ds.fill(color_rgba32f(1.0f, 0.0f, 0.0f, 0.0f));
+
+  hierarchical_z hiz;
+  hiz.reset(&ds, &read_depth_r32);
+  hiz.clear(1.0f);
+
+  EXPECT_TRUE(hiz.reject(compare_function_less, 0, 0, 128, 96, 1.0f, 1.0f));
+  EXPECT_FALSE(hiz.reject(compare_function_less_equal, 0, 0, 128, 96, 1.0f, 1.0f));
+  EXPECT_FALSE(hiz.reject(compare_function_less, 0, 0, 128, 96, 0.5f, 1.0f));
+
+  // Write a near pixel into the second tile and refresh it.
+  ds.set_texel(70, 10, 0, color_rgba32f(0.25f, 0.0f, 0.0f, 0.0f));
+  hiz.mark_dirty(70, 10);
+  hiz.refresh();
+
+  // Sub-tile of written pixel and the tile which contains it are updated.
+  EXPECT_FALSE(hiz.reject(compare_function_greater, 68, 8, 72, 12, 0.5f, 0.5f));
+  EXPECT_TRUE(hiz.reject(compare_function_greater, 72, 8, 76, 12, 0.5f, 0.5f));
+  EXPECT_FALSE(hiz.reject(compare_function_greater, 64, 0, 128, 64, 0.5f, 0.5f));
+  EXPECT_TRUE(hiz.reject(compare_function_greater, 0, 0, 64, 64, 0.5f, 0.5f));
+
+  // Region which covers the partial tile at bottom-right corner.
+  EXPECT_TRUE(hiz.reject(compare_function_less, 64, 64, 128, 128, 1.0f, 1.0f));
+}
+
+// Depth of single pixels, e.g. points, is tracked with or without early-z.
+TEST(salvia_core, hiz_tracks_point_writes) {
+  for (bool stencil_enable : {false, true}) {
+    render_state state{};
+    depth_stencil_desc ds_desc;
+    ds_desc.depth_func = compare_function_less;
+    ds_desc.stencil_enable = stencil_enable;
+    state.ds_state = std::make_shared<depth_stencil_state>(ds_desc);
+    state.bl_state = std::make_shared<blend_state>(blend_desc());
+    state.color_targets.push_back(std::make_shared<surface>(128, 96, 1, pixel_format_color_rgba8));
+    state.depth_stencil_target = std::make_shared<surface>(128, 96, 1, pixel_format_color_rg32f);
+    state.target_sample_count = 1;
+
+    framebuffer::clear_depth_stencil(
+        state.depth_stencil_target.get(), clear_depth | clear_stencil, 1.0f, 0);
+    state.depth_stencil_target->expand_clears();
+    framebuffer fb;
+    fb.update(&state);
+    fb.hiz_depth_cleared(state.depth_stencil_target.get(), 1.0f);
+    ASSERT_EQ(!stencil_enable, fb.early_z_enabled());
+
+    float const aa_offset[1] = {0.0f};
+    shader::ps_output ps;
+    ps.color[0] = eflib::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    if (fb.early_z_enabled()) {
+      ASSERT_EQ(1U, fb.early_z_test(70, 10, 0.1f, aa_offset));
+    } else {
+      fb.render_sample(nullptr, 70, 10, 0, ps, 0.1f, true);
+    }
+    fb.refresh_hiz();
+
+    ds_desc.depth_func = compare_function_greater;
+    ds_desc.stencil_enable = false;
+    state.ds_state = std::make_shared<depth_stencil_state>(ds_desc);
+    fb.update(&state);
+    ASSERT_TRUE(fb.hiz_enabled());
+    EXPECT_FALSE(fb.hiz_reject(68, 8, 72, 12, 0.5f, 0.5f));
+    EXPECT_TRUE(fb.hiz_reject(72, 8, 76, 12, 0.5f, 0.5f));
+  }
+}
+
+TEST(salvia_core, hiz_rebuilds_target_written_out_of_framebuffer) {
+  render_state state{};
+  depth_stencil_desc ds_desc;
+  ds_desc.depth_func = compare_function_greater;
+  state.ds_state = std::make_shared<depth_stencil_state>(ds_desc);
+  state.bl_state = std::make_shared<blend_state>(blend_desc());
+  state.depth_stencil_target = std::make_shared<surface>(128, 96, 1, pixel_format_color_rg32f);
+  state.target_sample_count = 1;
+
+  framebuffer::clear_depth_stencil(
+      state.depth_stencil_target.get(), clear_depth | clear_stencil, 1.0f, 0);
+  framebuffer fb;
+  fb.update(&state);
+  fb.hiz_depth_cleared(state.depth_stencil_target.get(), 1.0f);
+  EXPECT_TRUE(fb.hiz_reject(68, 8, 72, 12, 0.5f, 0.5f));
+
+  state.depth_stencil_target->set_texel(70, 10, 0, color_rgba32f(0.25f, 0.0f, 0.0f, 0.0f));
+  fb.update(&state);
+  fb.refresh_hiz();
+  EXPECT_FALSE(fb.hiz_reject(68, 8, 72, 12, 0.5f, 0.5f));
+  EXPECT_TRUE(fb.hiz_reject(72, 8, 76, 12, 0.5f, 0.5f));
+
+  // Surfaces never share a generation.
+  surface other(128, 96, 1, pixel_format_color_rg32f);
+  EXPECT_NE(other.generation(), state.depth_stencil_target->generation());
+}
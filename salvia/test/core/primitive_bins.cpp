@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/primitive_bins.h>
+
+#include <vector>
+
+using namespace salvia::core;
+
+TEST(salvia_core, primitive_bins_keep_drawing_order) {
+  constexpr size_t TILE_COUNT = 3;
+  constexpr size_t SLICE_COUNT = 4;
+  constexpr uint32_t PRIM_COUNT = 1000;
+
+  primitive_bins bins;
+  for (int draw = 0; draw < 2; ++draw) {
+    bins.reset(TILE_COUNT, SLICE_COUNT, 2);
+
+    // Slices are opened out of order by different threads.
+    for (size_t slice : {2, 0, 3, 1}) {
+      auto writer = bins.open_slice(slice, slice % 2);
+      for (uint32_t prim = PRIM_COUNT * slice / SLICE_COUNT;
+           prim < PRIM_COUNT * (slice + 1) / SLICE_COUNT;
+           ++prim) {
+        writer.push(prim % TILE_COUNT, prim);
+        if (prim % 7 == 0) {
+          writer.push((prim + 1) % TILE_COUNT, prim);
+        }
+      }
+    }
+
+    for (size_t tile_id = 0; tile_id < TILE_COUNT; ++tile_id) {
+      std::vector<uint32_t> expected;
+      for (uint32_t prim = 0; prim < PRIM_COUNT; ++prim) {
+        if (prim % TILE_COUNT == tile_id || (prim % 7 == 0 && (prim + 1) % TILE_COUNT == tile_id)) {
+          expected.push_back(prim);
+        }
+      }
+
+      std::vector<uint32_t> actual;
+      bins.for_each(tile_id, [&actual](uint32_t prim) { actual.push_back(prim); });
+      EXPECT_EQ(expected, actual);
+      EXPECT_FALSE(bins.empty(tile_id));
+
+      // Slices could be walked in ranges as they are binned.
+      std::vector<uint32_t> ranged;
+      for (size_t slice_begin : {0, 1, 3}) {
+        size_t const slice_end = slice_begin == 0 ? 1 : slice_begin == 1 ? 3 : SLICE_COUNT;
+        bins.for_each(
+            tile_id, slice_begin, slice_end, [&ranged](uint32_t prim) { ranged.push_back(prim); });
+      }
+      EXPECT_EQ(expected, ranged);
+    }
+  }
+}
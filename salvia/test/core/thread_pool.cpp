@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/renderer.h>
+#include <salvia/core/thread_pool.h>
+
+#include <eflib/concurrency/thread_context.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace salvia::core;
+
+TEST(salvia_core, pipeline_threads_follow_parameters) {
+  size_t const default_thread_count = current_pipeline_threads().count;
+
+  renderer_parameters params{};
+  params.numa_node = -1;
+  params.thread_count = 3;
+  configure_pipeline_threads(params);
+  pipeline_threads const threads = current_pipeline_threads();
+  ASSERT_EQ(3U, threads.count);
+
+  std::atomic<size_t> thread_ids{0};
+  eflib::execute_threads(
+      *threads.pool,
+      [&thread_ids](eflib::thread_context const* thread_ctx) {
+        thread_ids |= size_t(1) << thread_ctx->thread_id;
+      },
+      3,
+      1,
+      threads.count);
+  EXPECT_EQ(7U, thread_ids.load());
+
+  params.thread_count = 0;
+  configure_pipeline_threads(params);
+  EXPECT_EQ(std::max(std::thread::hardware_concurrency(), 1U), current_pipeline_threads().count);
+  EXPECT_EQ(default_thread_count, current_pipeline_threads().count);
+}
+
+TEST(salvia_core, pipeline_threads_outlive_reconfiguration) {
+  renderer_parameters params{};
+  params.numa_node = -1;
+  params.thread_count = 3;
+  configure_pipeline_threads(params);
+
+  // Pool of a draw in flight is kept after pipeline threads are re-created.
+  std::shared_ptr<eflib::thread_pool> pool = current_pipeline_threads().pool;
+  params.thread_count = 2;
+  configure_pipeline_threads(params);
+  EXPECT_NE(pool, current_pipeline_threads().pool);
+
+  std::atomic<size_t> thread_ids{0};
+  eflib::execute_threads(
+      *pool,
+      [&thread_ids](eflib::thread_context const* thread_ctx) {
+        thread_ids |= size_t(1) << thread_ctx->thread_id;
+      },
+      3,
+      1,
+      3);
+  EXPECT_EQ(7U, thread_ids.load());
+
+  params.thread_count = 0;
+  configure_pipeline_threads(params);
+}
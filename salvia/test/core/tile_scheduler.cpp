@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/tile_scheduler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace salvia::core;
+
+TEST(salvia_core, tile_scheduler_balances_costs) {
+  constexpr size_t TILE_COUNT = 10;
+  constexpr size_t THREAD_COUNT = 3;
+  uint64_t const costs[TILE_COUNT] = {1, 100, 5, 0, 40, 60, 2, 0, 30, 3};
+
+  tile_scheduler scheduler;
+  scheduler.reset(costs, TILE_COUNT, THREAD_COUNT);
+
+  // The most expensive tiles are started first by different threads.
+  std::vector<size_t> first_tiles;
+  for (size_t thread_id = 0; thread_id < THREAD_COUNT; ++thread_id) {
+    size_t tile_id;
+    ASSERT_TRUE(scheduler.pop(thread_id, tile_id));
+    first_tiles.push_back(tile_id);
+  }
+  std::sort(first_tiles.begin(), first_tiles.end());
+  EXPECT_EQ((std::vector<size_t>{1, 4, 5}), first_tiles);
+
+  // Thread 0 takes its own tiles, then steals the others.
+  std::vector<size_t> tiles = first_tiles;
+  size_t tile_id;
+  while (scheduler.pop(0, tile_id)) {
+    tiles.push_back(tile_id);
+  }
+  std::sort(tiles.begin(), tiles.end());
+  for (size_t i = 0; i < TILE_COUNT; ++i) {
+    EXPECT_EQ(i, tiles[i]);
+  }
+  EXPECT_GT(scheduler.steal_count(), 0U);
+  EXPECT_FALSE(scheduler.pop(1, tile_id));
+}
+
+TEST(salvia_core, tile_scheduler_pops_tiles_once) {
+  constexpr size_t TILE_COUNT = 5000;
+  constexpr size_t THREAD_COUNT = 4;
+
+  std::vector<uint64_t> costs(TILE_COUNT);
+  for (size_t i = 0; i < TILE_COUNT; ++i) {
+    costs[i] = (i * 7919) % 101;
+  }
+
+  tile_scheduler scheduler;
+  for (int round = 0; round < 2; ++round) {
+    scheduler.reset(costs.data(), TILE_COUNT, THREAD_COUNT);
+
+    // Thread 0 is slow, so its tiles are stolen by the others.
+    std::vector<std::atomic<int>> pops(TILE_COUNT);
+    std::vector<std::thread> threads;
+    for (size_t thread_id = 0; thread_id < THREAD_COUNT; ++thread_id) {
+      threads.emplace_back([&, thread_id]() {
+        size_t tile_id;
+        while (scheduler.pop(thread_id, tile_id)) {
+          ++pops[tile_id];
+          if (thread_id == 0) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    for (size_t i = 0; i < TILE_COUNT; ++i) {
+      ASSERT_EQ(1, pops[i].load());
+    }
+  }
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <salvia/core/shader.h>
+#include <salvia/shader/shader_regs.h>
+#include <salvia/shader/shader_regs_op.h>
+
+using namespace salvia::core;
+using namespace salvia::shader;
+using eflib::vec4;
+
+namespace {
+constexpr uint32_t ATTR_COUNT = 3;
+constexpr float UNSET = -1.0f;
+
+void fill(vs_output& v, float base) {
+  for (uint32_t i = 0; i < ATTR_COUNT + 1; ++i) {
+    v.raw_data()[i] = vec4(base + i, base * 2.0f - i, base - i * 0.5f, 1.0f + base * 0.25f + i);
+  }
+}
+
+void fill_unset(vs_output& v) {
+  for (uint32_t i = 0; i < ATTR_COUNT + 1; ++i) {
+    v.raw_data()[i] = vec4(UNSET, UNSET, UNSET, UNSET);
+  }
+}
+
+bool equal_register(vs_output const& lhs, vs_output const& rhs, uint32_t reg) {
+  for (int i = 0; i < 4; ++i) {
+    if (lhs.raw_data()[reg][i] != rhs.raw_data()[reg][i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool is_unset(vs_output const& v, uint32_t reg) {
+  for (int i = 0; i < 4; ++i) {
+    if (v.raw_data()[reg][i] != UNSET) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+TEST(salvia_core, vs_output_ops_skip_unused_attributes) {
+  vs_output_op& op = get_vs_output_op(ATTR_COUNT);
+  vs_output_op::interpolation_modifier_array const modifiers = op.attribute_modifiers;
+  op.attribute_modifiers.fill(vs_output::am_linear);
+
+  vs_output v0, e01, e02;
+  fill(v0, 1.0f);
+  fill(e01, 2.0f);
+  fill(e02, -3.0f);
+  v0.position()[3] = 0.5f;
+
+  // Derivatives and quad with all attributes.
+  vs_output ddx, ddy;
+  op.compute_derivative(ddx, ddy, e01, e02, 0.125f, ~0U);
+
+  vs_output quad[4];
+  op.step_2d_unproj_pos_quad(quad, v0, 0.5f, ddx, 1.5f, ddy);
+  op.step_2d_unproj_attr_quad(quad, v0, 0.5f, ddx, 1.5f, ddy, ~0U);
+
+  // Attribute 1 is not used.
+  uint32_t const mask = 0x5;
+
+  vs_output part_ddx, part_ddy;
+  fill_unset(part_ddx);
+  fill_unset(part_ddy);
+  op.compute_derivative(part_ddx, part_ddy, e01, e02, 0.125f, mask);
+
+  EXPECT_TRUE(equal_register(ddx, part_ddx, 0));
+  EXPECT_TRUE(equal_register(ddy, part_ddy, 0));
+  for (uint32_t i_attr = 0; i_attr < ATTR_COUNT; ++i_attr) {
+    if (mask & (1U << i_attr)) {
+      EXPECT_TRUE(equal_register(ddx, part_ddx, i_attr + 1));
+      EXPECT_TRUE(equal_register(ddy, part_ddy, i_attr + 1));
+    } else {
+      EXPECT_TRUE(is_unset(part_ddx, i_attr + 1));
+      EXPECT_TRUE(is_unset(part_ddy, i_attr + 1));
+    }
+  }
+
+  vs_output part_quad[4];
+  for (vs_output& px : part_quad) {
+    fill_unset(px);
+  }
+  op.step_2d_unproj_pos_quad(part_quad, v0, 0.5f, part_ddx, 1.5f, part_ddy);
+  op.step_2d_unproj_attr_quad(part_quad, v0, 0.5f, part_ddx, 1.5f, part_ddy, mask);
+
+  for (int i_px = 0; i_px < 4; ++i_px) {
+    EXPECT_TRUE(equal_register(quad[i_px], part_quad[i_px], 0));
+    for (uint32_t i_attr = 0; i_attr < ATTR_COUNT; ++i_attr) {
+      if (mask & (1U << i_attr)) {
+        EXPECT_TRUE(equal_register(quad[i_px], part_quad[i_px], i_attr + 1));
+      } else {
+        EXPECT_TRUE(is_unset(part_quad[i_px], i_attr + 1));
+      }
+    }
+  }
+
+  op.attribute_modifiers = modifiers;
+}
@@ -179,6 +179,7 @@ NTSTATUS APIENTRY D3DKMTPresent(const D3DKMT_PRESENT* pData)
 					GetClientRect(wnd, &dst_rc);
 				}
 
+				surf->expand_clears();
 				void* fb = surf->texel_address(0, 0, 0);
 				D3DKMT_CREATEDCFROMMEMORY& dc_from_mem = um_dev->dc_from_mem();
 				if ((static_cast<int>(dc_from_mem.Width) != surf->width())
@@ -704,10 +704,16 @@ void APIENTRY umd_device::set_viewports(D3D10DDI_HDEVICE device, UINT num_viewpo
 void APIENTRY umd_device::set_scissor_rects(D3D10DDI_HDEVICE device, UINT num_scissor_rects, UINT clear_scissor_rects,
 		const D3D10_DDI_RECT* rects)
 {
-	UNREFERENCED_PARAMETER(device);
-	UNREFERENCED_PARAMETER(num_scissor_rects);
 	UNREFERENCED_PARAMETER(clear_scissor_rects);
-	UNREFERENCED_PARAMETER(rects);
+
+	umd_device* dev = static_cast<umd_device*>(device.pDrvPrivate);
+	std::vector<eflib::rect<int32_t>> scissor_rects(num_scissor_rects);
+	for (UINT i = 0; i < num_scissor_rects; ++i)
+	{
+		scissor_rects[i] = eflib::rect<int32_t>(rects[i].left, rects[i].top,
+			rects[i].right - rects[i].left, rects[i].bottom - rects[i].top);
+	}
+	dev->sa_renderer_->set_scissor_rects(scissor_rects.size(), scissor_rects.data());
 }
 
 void APIENTRY umd_device::clear_render_target_view(D3D10DDI_HDEVICE device, D3D10DDI_HRENDERTARGETVIEW render_target_view,
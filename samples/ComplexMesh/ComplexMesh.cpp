@@ -13,6 +13,7 @@
 #include <salvia/resource/resource_manager.h>
 #include <salvia/shader/shader_regs.h>
 
+#include <eflib/platform/intrin.h>
 #include <eflib/platform/main.h>
 #include <eflib/utility/unref_declarator.h>
 
@@ -47,6 +48,27 @@ struct Material {
   TextureSlotsType texture_slots;
 };
 
+// Vectors of 4 vertexes are transposed between AoS registers and SoA components in place.
+void transpose4(__m128& v0, __m128& v1, __m128& v2, __m128& v3) {
+  __m128 const t0 = _mm_unpacklo_ps(v0, v1);
+  __m128 const t1 = _mm_unpacklo_ps(v2, v3);
+  __m128 const t2 = _mm_unpackhi_ps(v0, v1);
+  __m128 const t3 = _mm_unpackhi_ps(v2, v3);
+  v0 = _mm_movelh_ps(t0, t1);
+  v1 = _mm_movehl_ps(t1, t0);
+  v2 = _mm_movelh_ps(t2, t3);
+  v3 = _mm_movehl_ps(t3, t2);
+}
+
+// Component 'col' of row vectors (x, y, z, w) in SoA multiplied by 'm', the same as transform().
+__m128 transform_soa(__m128 const* v, size_t rows, mat44 const& m, int col) {
+  __m128 ret = _mm_mul_ps(v[0], _mm_set1_ps(m.data_[0][col]));
+  for (size_t row = 1; row < rows; ++row) {
+    ret = _mm_add_ps(ret, _mm_mul_ps(v[row], _mm_set1_ps(m.data_[row][col])));
+  }
+  return ret;
+}
+
 void ReadShortString(std::istream& file, std::string& str) {
   uint8_t len;
   file.read(reinterpret_cast<char*>(&len), sizeof(len));
@@ -210,6 +232,61 @@ public:
     out.attribute(2) = normal_es;
   }
 
+  // Vertexes are shaded 4 at a time with components of all vertexes in a SSE register.
+  void shader_prog_batch(vs_input const* ins, vs_output* const* outs, size_t count) override {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      shader_prog4(ins + i, outs + i);
+    }
+    for (; i < count; ++i) {
+      shader_prog(ins[i], *outs[i]);
+    }
+  }
+
+  void shader_prog4(vs_input const* ins, vs_output* const* outs) const {
+    __m128 pos[4];
+    __m128 normal[4];
+    for (int i = 0; i < 4; ++i) {
+      pos[i] = _mm_loadu_ps(&ins[i].attribute(0)[0]);
+      normal[i] = _mm_loadu_ps(&ins[i].attribute(1)[0]);
+    }
+    transpose4(pos[0], pos[1], pos[2], pos[3]);
+    transpose4(normal[0], normal[1], normal[2], normal[3]);
+
+    __m128 pos_es[4];
+    __m128 normal_es[4];
+    __m128 light_dir[4];
+    __m128 eye_dir[4];
+    for (int i = 0; i < 4; ++i) {
+      pos_es[i] = transform_soa(pos, 4, wv, i);
+    }
+    __m128 const one = _mm_set1_ps(1.0f);
+    for (int i = 0; i < 3; ++i) {
+      normal_es[i] = transform_soa(normal, 3, wv, i);
+      light_dir[i] = _mm_sub_ps(_mm_set1_ps(light_pos[i]), pos_es[i]);
+      eye_dir[i] = _mm_sub_ps(_mm_set1_ps(eye_pos[i]), pos_es[i]);
+    }
+    normal_es[3] = _mm_setzero_ps();
+    light_dir[3] = one;
+    eye_dir[3] = one;
+
+    __m128 pos_cs[4];
+    for (int i = 0; i < 4; ++i) {
+      pos_cs[i] = transform_soa(pos_es, 4, proj, i);
+    }
+
+    transpose4(pos_cs[0], pos_cs[1], pos_cs[2], pos_cs[3]);
+    transpose4(light_dir[0], light_dir[1], light_dir[2], light_dir[3]);
+    transpose4(eye_dir[0], eye_dir[1], eye_dir[2], eye_dir[3]);
+    transpose4(normal_es[0], normal_es[1], normal_es[2], normal_es[3]);
+    for (int i = 0; i < 4; ++i) {
+      _mm_storeu_ps(&outs[i]->position()[0], pos_cs[i]);
+      _mm_storeu_ps(&outs[i]->attribute(0)[0], light_dir[i]);
+      _mm_storeu_ps(&outs[i]->attribute(1)[0], eye_dir[i]);
+      _mm_storeu_ps(&outs[i]->attribute(2)[0], normal_es[i]);
+    }
+  }
+
   uint32_t num_output_attributes() const override { return 3; }
 
   uint32_t output_attribute_modifiers(uint32_t index) const override {
@@ -45,8 +45,6 @@ static float const gaussian_weights[] = {0.027681f,
                                          0.027681f};
 
 class gen_sm_cpp_ps : public cpp_pixel_shader {
-  bool output_depth() const { return true; }
-
   bool shader_prog(const vs_output& in, ps_output& out) {
     EFLIB_UNREF_DECLARATOR(in);
     EFLIB_UNREF_DECLARATOR(out);